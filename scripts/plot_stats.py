@@ -116,9 +116,14 @@ if __name__ == '__main__':
         is_epoch = False
         try:
             j_data = json.load(j_file)
-        except:
-            print('cannot load file ' + args.json)
-            exit(1)
+        except ValueError:
+            # epoch stats are one JSON object per line
+            try:
+                j_file.seek(0)
+                j_data = [json.loads(l) for l in j_file if l.strip()]
+            except ValueError:
+                print('cannot load file ' + args.json)
+                exit(1)
         if isinstance(j_data, list):
             is_epoch = True
         else:
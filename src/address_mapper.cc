@@ -0,0 +1,190 @@
+#include "address_mapper.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_PEXT
+#endif
+
+namespace dramsim3 {
+
+namespace {
+
+#ifdef HAVE_PEXT
+// compiled for BMI2 regardless of the build flags, only called after
+// checking the CPU supports it
+__attribute__((target("bmi2"))) void PextFields(uint64_t hex_addr,
+                                                const uint64_t* masks,
+                                                uint64_t* values) {
+    for (int i = 0; i < AddressMapper::NUM_FIELDS; i++) {
+        values[i] = _pext_u64(hex_addr, masks[i]);
+    }
+}
+#endif  // HAVE_PEXT
+
+bool IsContiguous(uint64_t mask) {
+    if (mask == 0) {
+        return true;
+    }
+    uint64_t low = mask >> __builtin_ctzll(mask);
+    return (low & (low + 1)) == 0;
+}
+
+}  // namespace
+
+AddressMapper::AddressMapper() : mode_(Mode::SHIFT), hashed_(false) {
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        field_mask_[i] = 0;
+        value_mask_[i] = 0;
+        shift_[i] = 0;
+        offset_[i] = 0;
+    }
+}
+
+void AddressMapper::Init(const std::vector<uint64_t>& field_masks,
+                         const std::vector<std::vector<uint64_t>>& xor_masks,
+                         bool allow_pext) {
+    if (field_masks.size() != NUM_FIELDS || xor_masks.size() != NUM_FIELDS) {
+        std::cerr << "Address mapper needs masks for all fields" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+
+    bool contiguous = true;
+    bool hashed = false;
+    uint64_t used_bits = 0;
+    int offset = 0;
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        uint64_t mask = field_masks[i];
+        int width = __builtin_popcountll(mask);
+        if (mask & used_bits) {
+            std::cerr << "Address mapping fields overlap" << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        if (xor_masks[i].size() > static_cast<size_t>(width)) {
+            // a hash bit outside the field would change its range
+            std::cerr << "More XOR masks than field bits" << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        used_bits |= mask;
+        field_mask_[i] = mask;
+        value_mask_[i] = width == 64 ? ~0ULL : (1ULL << width) - 1;
+        shift_[i] = mask == 0 ? 0 : __builtin_ctzll(mask);
+        offset_[i] = offset;
+        offset += width;
+        xor_masks_[i] = xor_masks[i];
+        contiguous = contiguous && IsContiguous(mask);
+        for (auto xor_mask : xor_masks[i]) {
+            hashed = hashed || xor_mask != 0;
+        }
+    }
+
+    hashed_ = hashed;
+    gather_table_.clear();
+    if (contiguous) {
+        mode_ = Mode::SHIFT;
+        return;
+    }
+#ifdef HAVE_PEXT
+    if (allow_pext && __builtin_cpu_supports("bmi2")) {
+        mode_ = Mode::PEXT;
+        return;
+    }
+#endif  // HAVE_PEXT
+
+    // route every bit of every address byte to its position in the packed
+    // field word, decoding is then 8 lookups OR-ed together
+    mode_ = Mode::TABLE;
+    int dst[64];
+    for (int bit = 0; bit < 64; bit++) {
+        dst[bit] = -1;
+    }
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        int pos = offset_[i];
+        for (int bit = 0; bit < 64; bit++) {
+            if ((field_mask_[i] >> bit) & 1) {
+                dst[bit] = pos++;
+            }
+        }
+    }
+    gather_table_.assign(8 * 256, 0);
+    for (int byte = 0; byte < 8; byte++) {
+        for (int value = 0; value < 256; value++) {
+            uint64_t packed = 0;
+            for (int bit = 0; bit < 8; bit++) {
+                int src = byte * 8 + bit;
+                if (((value >> bit) & 1) && dst[src] >= 0) {
+                    packed |= 1ULL << dst[src];
+                }
+            }
+            gather_table_[byte * 256 + value] = packed;
+        }
+    }
+}
+
+const char* AddressMapper::ModeName() const {
+    if (mode_ == Mode::SHIFT) {
+        return "shift";
+    } else if (mode_ == Mode::PEXT) {
+        return "pext";
+    }
+    return "table";
+}
+
+uint64_t AddressMapper::TableGather(uint64_t hex_addr) const {
+    const uint64_t* table = gather_table_.data();
+    uint64_t packed = 0;
+    for (int byte = 0; byte < 8; byte++) {
+        packed |= table[byte * 256 + ((hex_addr >> (byte * 8)) & 0xFF)];
+    }
+    return packed;
+}
+
+uint64_t AddressMapper::Hash(uint64_t hex_addr, int field) const {
+    uint64_t flips = 0;
+    const auto& masks = xor_masks_[field];
+    for (size_t i = 0; i < masks.size(); i++) {
+        flips |= static_cast<uint64_t>(__builtin_parityll(hex_addr & masks[i]))
+                 << i;
+    }
+    return flips;
+}
+
+Address AddressMapper::DecodeGeneric(uint64_t hex_addr) const {
+    uint64_t values[NUM_FIELDS];
+    if (mode_ == Mode::TABLE) {
+        uint64_t packed = TableGather(hex_addr);
+        for (int i = 0; i < NUM_FIELDS; i++) {
+            values[i] = (packed >> offset_[i]) & value_mask_[i];
+        }
+#ifdef HAVE_PEXT
+    } else if (mode_ == Mode::PEXT) {
+        PextFields(hex_addr, field_mask_, values);
+#endif  // HAVE_PEXT
+    } else {
+        for (int i = 0; i < NUM_FIELDS; i++) {
+            values[i] = (hex_addr >> shift_[i]) & value_mask_[i];
+        }
+    }
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        values[i] ^= Hash(hex_addr, i);
+    }
+    return Address(values[CH], values[RA], values[BG], values[BA], values[RO],
+                   values[CO]);
+}
+
+int AddressMapper::ChannelGeneric(uint64_t hex_addr) const {
+    uint64_t channel;
+    if (mode_ == Mode::TABLE) {
+        channel = (TableGather(hex_addr) >> offset_[CH]) & value_mask_[CH];
+#ifdef HAVE_PEXT
+    } else if (mode_ == Mode::PEXT) {
+        uint64_t values[NUM_FIELDS];
+        PextFields(hex_addr, field_mask_, values);
+        channel = values[CH];
+#endif  // HAVE_PEXT
+    } else {
+        channel = (hex_addr >> shift_[CH]) & value_mask_[CH];
+    }
+    return static_cast<int>(channel ^ Hash(hex_addr, CH));
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,78 @@
+#ifndef __ADDRESS_MAPPER_H
+#define __ADDRESS_MAPPER_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "common.h"
+
+namespace dramsim3 {
+
+// Precomputed physical address -> DRAM coordinate decoder.
+//
+// Every field (channel, rank, bankgroup, bank, row, column) is described by
+// a mask of physical address bits; the masked bits are gathered, low to
+// high, into the field value. Masks do not have to be contiguous. On top of
+// that each field bit can be XOR-ed with the parity of an arbitrary set of
+// address bits, which is how permutation based interleaving and bank/channel
+// hashing are usually described.
+//
+// Contiguous fields decode with one shift and mask each. Other layouts use
+// BMI2 pext when the host CPU has it and a table driven gather (one lookup
+// per address byte) otherwise.
+class AddressMapper {
+   public:
+    enum Field { CH, RA, BG, BA, RO, CO, NUM_FIELDS };
+
+    AddressMapper();
+    // field_masks has NUM_FIELDS entries; xor_masks[f][i] is the set of
+    // address bits whose parity flips bit i of field f (may be empty)
+    void Init(const std::vector<uint64_t>& field_masks,
+              const std::vector<std::vector<uint64_t>>& xor_masks,
+              bool allow_pext = true);
+
+    Address Decode(uint64_t hex_addr) const {
+        if (mode_ == Mode::SHIFT && !hashed_) {
+            return Address(ShiftField(hex_addr, CH), ShiftField(hex_addr, RA),
+                           ShiftField(hex_addr, BG), ShiftField(hex_addr, BA),
+                           ShiftField(hex_addr, RO), ShiftField(hex_addr, CO));
+        }
+        return DecodeGeneric(hex_addr);
+    }
+
+    int Channel(uint64_t hex_addr) const {
+        if (mode_ == Mode::SHIFT && !hashed_) {
+            return ShiftField(hex_addr, CH);
+        }
+        return ChannelGeneric(hex_addr);
+    }
+
+    // for stats and tests: "shift", "pext" or "table"
+    const char* ModeName() const;
+
+   private:
+    enum class Mode { SHIFT, PEXT, TABLE };
+
+    int ShiftField(uint64_t hex_addr, int field) const {
+        return static_cast<int>((hex_addr >> shift_[field]) &
+                                value_mask_[field]);
+    }
+    Address DecodeGeneric(uint64_t hex_addr) const;
+    int ChannelGeneric(uint64_t hex_addr) const;
+    // gathers all fields into one word, field f at bit offset_[f]
+    uint64_t TableGather(uint64_t hex_addr) const;
+    uint64_t Hash(uint64_t hex_addr, int field) const;
+
+    Mode mode_;
+    bool hashed_;
+    uint64_t field_mask_[NUM_FIELDS];
+    uint64_t value_mask_[NUM_FIELDS];
+    int shift_[NUM_FIELDS];
+    int offset_[NUM_FIELDS];
+    // 8 x 256 entries, indexed by address byte position and value
+    std::vector<uint64_t> gather_table_;
+    std::vector<uint64_t> xor_masks_[NUM_FIELDS];
+};
+
+}  // namespace dramsim3
+#endif
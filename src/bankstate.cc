@@ -2,27 +2,11 @@
 
 namespace dramsim3 {
 
-BankState::BankState()
-    : state_(State::CLOSED),
-      cmd_timing_(static_cast<int>(CommandType::SIZE)),
-      open_row_(-1),
-      row_hit_count_(0) {
-    cmd_timing_[static_cast<int>(CommandType::READ)] = 0;
-    cmd_timing_[static_cast<int>(CommandType::READ_PRECHARGE)] = 0;
-    cmd_timing_[static_cast<int>(CommandType::WRITE)] = 0;
-    cmd_timing_[static_cast<int>(CommandType::WRITE_PRECHARGE)] = 0;
-    cmd_timing_[static_cast<int>(CommandType::ACTIVATE)] = 0;
-    cmd_timing_[static_cast<int>(CommandType::PRECHARGE)] = 0;
-    cmd_timing_[static_cast<int>(CommandType::REFRESH)] = 0;
-    cmd_timing_[static_cast<int>(CommandType::SREF_ENTER)] = 0;
-    cmd_timing_[static_cast<int>(CommandType::SREF_EXIT)] = 0;
-}
-
-
-Command BankState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
+CommandType RequiredCommand(BankState state, int open_row,
+                            const Command& cmd) {
     CommandType required_type = CommandType::SIZE;
-    switch (state_) {
-        case State::CLOSED:
+    switch (state) {
+        case BankState::CLOSED:
             switch (cmd.cmd_type) {
                 case CommandType::READ:
                 case CommandType::READ_PRECHARGE:
@@ -32,7 +16,10 @@ Command BankState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
                     break;
                 case CommandType::REFRESH:
                 case CommandType::REFRESH_BANK:
+                case CommandType::REFRESH_SAME_BANK:
+                case CommandType::REFRESH_MANAGEMENT:
                 case CommandType::SREF_ENTER:
+                case CommandType::PD_ENTER:
                     required_type = cmd.cmd_type;
                     break;
                 default:
@@ -41,30 +28,37 @@ Command BankState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
                     break;
             }
             break;
-        case State::OPEN:
+        case BankState::OPEN:
             switch (cmd.cmd_type) {
                 case CommandType::READ:
                 case CommandType::READ_PRECHARGE:
                 case CommandType::WRITE:
                 case CommandType::WRITE_PRECHARGE:
-                    if (cmd.Row() == open_row_) {
+                    if (cmd.Row() == open_row) {
                         required_type = cmd.cmd_type;
                     } else {
                         required_type = CommandType::PRECHARGE;
                     }
                     break;
+                case CommandType::PRECHARGE:
                 case CommandType::REFRESH:
                 case CommandType::REFRESH_BANK:
+                case CommandType::REFRESH_SAME_BANK:
+                case CommandType::REFRESH_MANAGEMENT:
                 case CommandType::SREF_ENTER:
                     required_type = CommandType::PRECHARGE;
                     break;
+                // active power down
+                case CommandType::PD_ENTER:
+                    required_type = CommandType::PD_ENTER;
+                    break;
                 default:
                     std::cerr << "Unknown type!" << std::endl;
                     AbruptExit(__FILE__, __LINE__);
                     break;
             }
             break;
-        case State::SREF:
+        case BankState::SREF:
             switch (cmd.cmd_type) {
                 case CommandType::READ:
                 case CommandType::READ_PRECHARGE:
@@ -78,35 +72,54 @@ Command BankState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
                     break;
             }
             break;
-        case State::PD:
-        case State::SIZE:
+        case BankState::PD:
+            switch (cmd.cmd_type) {
+                case CommandType::READ:
+                case CommandType::READ_PRECHARGE:
+                case CommandType::WRITE:
+                case CommandType::WRITE_PRECHARGE:
+                case CommandType::PRECHARGE:
+                case CommandType::REFRESH:
+                case CommandType::REFRESH_BANK:
+                case CommandType::REFRESH_SAME_BANK:
+                case CommandType::REFRESH_MANAGEMENT:
+                case CommandType::SREF_ENTER:
+                case CommandType::PD_EXIT:
+                    required_type = CommandType::PD_EXIT;
+                    break;
+                default:
+                    std::cerr << "Unknown type!" << std::endl;
+                    AbruptExit(__FILE__, __LINE__);
+                    break;
+            }
+            break;
+        case BankState::SIZE:
             std::cerr << "In unknown state" << std::endl;
             AbruptExit(__FILE__, __LINE__);
             break;
     }
-
-    if (required_type != CommandType::SIZE) {
-        if (clk >= cmd_timing_[static_cast<int>(required_type)]) {
-            return Command(required_type, cmd.addr, cmd.hex_addr);
-        }
-    }
-    return Command();
+    return required_type;
 }
 
-void BankState::UpdateState(const Command& cmd) {
-    switch (state_) {
-        case State::OPEN:
+void UpdateBankState(const Command& cmd, BankState& state, int& open_row,
+                     int& row_hit_count) {
+    switch (state) {
+        case BankState::OPEN:
             switch (cmd.cmd_type) {
                 case CommandType::READ:
                 case CommandType::WRITE:
-                    row_hit_count_++;
+                    row_hit_count++;
                     break;
                 case CommandType::READ_PRECHARGE:
                 case CommandType::WRITE_PRECHARGE:
                 case CommandType::PRECHARGE:
-                    state_ = State::CLOSED;
-                    open_row_ = -1;
-                    row_hit_count_ = 0;
+                    state = BankState::CLOSED;
+                    open_row = -1;
+                    row_hit_count = 0;
+                    break;
+                case CommandType::PD_ENTER:
+                    // the row stays open
+                    state = BankState::PD;
                     break;
                 case CommandType::ACTIVATE:
                 case CommandType::REFRESH:
@@ -117,17 +130,22 @@ void BankState::UpdateState(const Command& cmd) {
                     AbruptExit(__FILE__, __LINE__);
             }
             break;
-        case State::CLOSED:
+        case BankState::CLOSED:
             switch (cmd.cmd_type) {
                 case CommandType::REFRESH:
                 case CommandType::REFRESH_BANK:
+                case CommandType::REFRESH_SAME_BANK:
+                case CommandType::REFRESH_MANAGEMENT:
                     break;
                 case CommandType::ACTIVATE:
-                    state_ = State::OPEN;
-                    open_row_ = cmd.Row();
+                    state = BankState::OPEN;
+                    open_row = cmd.Row();
                     break;
                 case CommandType::SREF_ENTER:
-                    state_ = State::SREF;
+                    state = BankState::SREF;
+                    break;
+                case CommandType::PD_ENTER:
+                    state = BankState::PD;
                     break;
                 case CommandType::READ:
                 case CommandType::WRITE:
@@ -140,10 +158,10 @@ void BankState::UpdateState(const Command& cmd) {
                     AbruptExit(__FILE__, __LINE__);
             }
             break;
-        case State::SREF:
+        case BankState::SREF:
             switch (cmd.cmd_type) {
                 case CommandType::SREF_EXIT:
-                    state_ = State::CLOSED;
+                    state = BankState::CLOSED;
                     break;
                 case CommandType::READ:
                 case CommandType::WRITE:
@@ -158,16 +176,19 @@ void BankState::UpdateState(const Command& cmd) {
                     AbruptExit(__FILE__, __LINE__);
             }
             break;
+        case BankState::PD:
+            switch (cmd.cmd_type) {
+                case CommandType::PD_EXIT:
+                    state = open_row >= 0 ? BankState::OPEN : BankState::CLOSED;
+                    break;
+                default:
+                    AbruptExit(__FILE__, __LINE__);
+            }
+            break;
         default:
             AbruptExit(__FILE__, __LINE__);
     }
     return;
 }
 
-void BankState::UpdateTiming(CommandType cmd_type, uint64_t time) {
-    cmd_timing_[static_cast<int>(cmd_type)] =
-        std::max(cmd_timing_[static_cast<int>(cmd_type)], time);
-    return;
-}
-
 }  // namespace dramsim3
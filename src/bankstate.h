@@ -1,42 +1,24 @@
 #ifndef __BANKSTATE_H
 #define __BANKSTATE_H
 
-#include <vector>
 #include "common.h"
 
 namespace dramsim3 {
 
-class BankState {
-   public:
-    BankState();
+// Per bank state machine. The states, open rows, row hit counts and timing
+// constraints of all banks of a channel live in flat arrays in ChannelState,
+// these functions only implement the transitions. A bank in PD keeps its
+// open row, so it is in active power down if it has one and in precharge
+// power down otherwise.
+enum class BankState { OPEN, CLOSED, SREF, PD, SIZE };
 
-    enum class State { OPEN, CLOSED, SREF, PD, SIZE };
-    Command GetReadyCommand(const Command& cmd, uint64_t clk) const;
+// The command that has to be issued next in order to serve cmd in a bank
+// that is in state with open_row open
+CommandType RequiredCommand(BankState state, int open_row, const Command& cmd);
 
-    // Update the state of the bank resulting after the execution of the command
-    void UpdateState(const Command& cmd);
-
-    // Update the existing timing constraints for the command
-    void UpdateTiming(const CommandType cmd_type, uint64_t time);
-
-    bool IsRowOpen() const { return state_ == State::OPEN; }
-    int OpenRow() const { return open_row_; }
-    int RowHitCount() const { return row_hit_count_; }
-
-   private:
-    // Current state of the Bank
-    // Apriori or instantaneously transitions on a command.
-    State state_;
-
-    // Earliest time when the particular Command can be executed in this bank
-    std::vector<uint64_t> cmd_timing_;
-
-    // Currently open row
-    int open_row_;
-
-    // consecutive accesses to one row
-    int row_hit_count_;
-};
+// Update the state of the bank resulting after the execution of the command
+void UpdateBankState(const Command& cmd, BankState& state, int& open_row,
+                     int& row_hit_count);
 
 }  // namespace dramsim3
 #endif
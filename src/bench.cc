@@ -0,0 +1,335 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "./../ext/headers/args.hxx"
+#include "channel_state.h"
+#include "command_queue.h"
+#include "cpu.h"
+#include "row_policy.h"
+#include "scheduler.h"
+#include "simple_stats.h"
+
+using namespace dramsim3;
+
+namespace {
+
+using BenchClock = std::chrono::steady_clock;
+
+double ElapsedNs(BenchClock::time_point start) {
+    std::chrono::duration<double, std::nano> elapsed =
+        BenchClock::now() - start;
+    return elapsed.count();
+}
+
+// one line of results per benchmark, CSV with a header or JSON lines
+class Reporter {
+   public:
+    Reporter(bool json) : json_(json) {
+        if (!json_) {
+            std::cout << "benchmark,config,param,ops,ns_per_op,ops_per_sec,"
+                         "checksum"
+                      << std::endl;
+        }
+    }
+
+    void Report(const std::string& benchmark, const std::string& config,
+                const std::string& param, uint64_t ops, double ns,
+                uint64_t checksum) const {
+        double ns_per_op = ops > 0 ? ns / ops : 0.0;
+        double ops_per_sec = ns > 0 ? ops * 1e9 / ns : 0.0;
+        if (json_) {
+            std::cout << "{\"benchmark\":\"" << benchmark << "\",\"config\":\""
+                      << config << "\",\"param\":\"" << param
+                      << "\",\"ops\":" << ops << ",\"ns_per_op\":" << ns_per_op
+                      << ",\"ops_per_sec\":" << ops_per_sec
+                      << ",\"checksum\":" << checksum << "}" << std::endl;
+        } else {
+            std::cout << benchmark << "," << config << "," << param << ","
+                      << ops << "," << ns_per_op << "," << ops_per_sec << ","
+                      << checksum << std::endl;
+        }
+    }
+
+   private:
+    bool json_;
+};
+
+Address RandomAddress(const Config& config, std::mt19937_64& rng) {
+    // few rows so that there are hits as well as conflicts
+    return Address(0, rng() % config.ranks, rng() % config.bankgroups,
+                   rng() % config.banks_per_group, rng() % 4,
+                   rng() % config.columns);
+}
+
+// GetReadyCommand on random reads and writes, issuing what it returns with
+// UpdateTimingAndStates every other cycle. The issued commands are then
+// replayed on their own to separate the cost of the updates
+void BenchChannelState(const Reporter& reporter, const std::string& name,
+                       const Config& config, uint64_t num_ops) {
+    Timing timing(config);
+    std::mt19937_64 rng(0);
+    std::vector<Command> queries;
+    queries.reserve(num_ops);
+    for (uint64_t i = 0; i < num_ops; i++) {
+        CommandType type =
+            rng() % 3 == 0 ? CommandType::WRITE : CommandType::READ;
+        queries.emplace_back(type, RandomAddress(config, rng), 0);
+    }
+
+    std::vector<std::pair<Command, uint64_t>> issued;
+    issued.reserve(num_ops);
+    ChannelState channel_state(config, timing);
+    uint64_t checksum = 0;
+    uint64_t clk = 0;
+    auto start = BenchClock::now();
+    for (const auto& query : queries) {
+        Command cmd = channel_state.GetReadyCommand(query, clk);
+        if (cmd.IsValid()) {
+            checksum += static_cast<uint64_t>(cmd.cmd_type);
+            if (clk % 2 == 0) {
+                channel_state.UpdateTimingAndStates(cmd, clk);
+                issued.emplace_back(cmd, clk);
+            }
+        }
+        clk++;
+    }
+    double both_ns = ElapsedNs(start);
+
+    ChannelState replay_state(config, timing);
+    start = BenchClock::now();
+    for (const auto& it : issued) {
+        replay_state.UpdateTimingAndStates(it.first, it.second);
+    }
+    double update_ns = ElapsedNs(start);
+    Command probe(CommandType::READ, Address(0, 0, 0, 0, 0, 0), 0);
+    uint64_t update_sum = replay_state.GetReadyCycle(probe);
+
+    reporter.Report("channel_state.get_ready_command", name, "", num_ops,
+                    std::max(both_ns - update_ns, 0.0), checksum);
+    reporter.Report("channel_state.update_timing_and_states", name, "",
+                    issued.size(), update_ns, update_sum);
+    return;
+}
+
+// GetCommandToIssue of queues kept full of random reads and writes, issued
+// commands update the channel state as in the controller
+void BenchCommandQueue(const Reporter& reporter, const std::string& name,
+                       Config& config, int depth, uint64_t num_ops) {
+    int saved_depth = config.cmd_queue_size;
+    config.cmd_queue_size = depth;
+    {
+        Timing timing(config);
+        ChannelState channel_state(config, timing);
+        SimpleStats simple_stats(config, config.output_files, 0);
+        Scheduler* scheduler = MakeScheduler(config);
+        RowPolicy row_policy(config);
+        CommandQueue cmd_queue(0, config, channel_state, simple_stats,
+                               *scheduler, row_policy);
+        std::mt19937_64 rng(0);
+        auto refill = [&]() {
+            for (int i = 0; i < config.ranks * config.banks; i++) {
+                Address addr = RandomAddress(config, rng);
+                if (!cmd_queue.WillAcceptCommand(addr.rank, addr.bankgroup,
+                                                 addr.bank)) {
+                    continue;
+                }
+                CommandType type =
+                    rng() % 3 == 0 ? CommandType::WRITE : CommandType::READ;
+                cmd_queue.AddCommand(Command(type, addr, rng()));
+            }
+        };
+        refill();
+
+        uint64_t checksum = 0;
+        uint64_t clk = 0;
+        auto start = BenchClock::now();
+        for (uint64_t i = 0; i < num_ops; i++) {
+            Command cmd = cmd_queue.GetCommandToIssue();
+            if (cmd.IsValid()) {
+                checksum += static_cast<uint64_t>(cmd.cmd_type);
+                channel_state.UpdateTimingAndStates(cmd, clk);
+                cmd_queue.InvalidateReadyCycles(cmd);
+                if (cmd.IsReadWrite()) {
+                    refill();
+                }
+            }
+            cmd_queue.ClockTick();
+            clk++;
+        }
+        reporter.Report("command_queue.get_command_to_issue", name,
+                        "depth=" + std::to_string(depth), num_ops,
+                        ElapsedNs(start), checksum);
+        delete scheduler;
+    }
+    config.cmd_queue_size = saved_depth;
+    return;
+}
+
+void BenchAddressMapping(const Reporter& reporter, const std::string& name,
+                         const Config& config, uint64_t num_ops) {
+    std::mt19937_64 rng(0);
+    std::vector<uint64_t> addrs(num_ops);
+    for (auto& addr : addrs) {
+        addr = rng();
+    }
+    uint64_t checksum = 0;
+    auto start = BenchClock::now();
+    for (auto hex_addr : addrs) {
+        Address addr = config.AddressMapping(hex_addr);
+        checksum += addr.channel + addr.bank + addr.row + addr.column;
+    }
+    reporter.Report("config.address_mapping", name, "", num_ops,
+                    ElapsedNs(start), checksum);
+    return;
+}
+
+// the updates the controllers make every cycle and per request
+void BenchSimpleStats(const Reporter& reporter, const std::string& name,
+                      const Config& config, uint64_t num_ops) {
+    SimpleStats simple_stats(config, config.output_files, 0);
+    CounterId counters[] = {simple_stats.GetCounterId("num_cycles"),
+                            simple_stats.GetCounterId("num_reads_done"),
+                            simple_stats.GetCounterId("num_read_cmds"),
+                            simple_stats.GetCounterId("num_act_cmds")};
+    VecCounterId vec_counter =
+        simple_stats.GetVecCounterId("all_bank_idle_cycles");
+    HistoId histo = simple_stats.GetHistoId("read_latency");
+
+    auto start = BenchClock::now();
+    for (uint64_t i = 0; i < num_ops; i++) {
+        simple_stats.Increment(counters[i % 4]);
+    }
+    reporter.Report("simple_stats.increment", name, "", num_ops,
+                    ElapsedNs(start), 0);
+
+    start = BenchClock::now();
+    for (uint64_t i = 0; i < num_ops; i++) {
+        simple_stats.IncrementVec(vec_counter, i % config.ranks);
+    }
+    reporter.Report("simple_stats.increment_vec", name, "", num_ops,
+                    ElapsedNs(start), 0);
+
+    std::mt19937_64 rng(0);
+    std::vector<int> values(num_ops);
+    for (auto& value : values) {
+        // mostly in range, some overflow
+        value = static_cast<int>(rng() % 250);
+    }
+    start = BenchClock::now();
+    for (auto value : values) {
+        simple_stats.AddValue(histo, value);
+    }
+    reporter.Report("simple_stats.add_value", name, "", num_ops,
+                    ElapsedNs(start), 0);
+    return;
+}
+
+// simulated cycles per second of a whole memory system
+void BenchEndToEnd(const Reporter& reporter, const std::string& name,
+                   const std::string& config_file, const std::string& cpu_type,
+                   uint64_t cycles) {
+    Config* config = new Config(config_file, ".");
+    // no stats files
+    config->output_level = -1;
+    CPU* cpu;
+    if (cpu_type == "stream") {
+        cpu = new StreamCPU(config, ".");
+    } else {
+        cpu = new RandomCPU(config, ".");
+    }
+    auto start = BenchClock::now();
+    for (uint64_t clk = 0; clk < cycles; clk++) {
+        cpu->ClockTick();
+    }
+    double ns = ElapsedNs(start);
+    delete cpu;
+    reporter.Report("memory_system.cycles", name, "cpu=" + cpu_type, cycles,
+                    ns, 0);
+    return;
+}
+
+}  // namespace
+
+int main(int argc, const char** argv) {
+    args::ArgumentParser parser(
+        "Benchmarks of the simulator hot paths and of whole memory systems, "
+        "one result per line.",
+        "Example: \n"
+        "./build/dramsim3bench configs/DDR4_8Gb_x8_2400.ini "
+        "configs/HBM2_8Gb_x128.ini configs/HMC_2GB_4Lx16.ini -f json");
+    args::HelpFlag help(parser, "help", "Display the help menu", {'h', "help"});
+    args::ValueFlag<uint64_t> num_ops_arg(
+        parser, "num_ops", "Operations per micro benchmark, default 1M",
+        {'n', "num-ops"}, 1000000);
+    args::ValueFlag<uint64_t> num_cycles_arg(
+        parser, "num_cycles",
+        "Cycles per end to end benchmark, default 200000",
+        {'c', "cycles"}, 200000);
+    args::ValueFlag<std::string> format_arg(
+        parser, "format", "Output format - (csv), json (one object per line)",
+        {'f', "format"}, "csv");
+    args::ValueFlag<std::string> filter_arg(
+        parser, "filter", "Only run benchmarks whose name contains this",
+        {"filter"}, "");
+    args::PositionalList<std::string> configs_arg(
+        parser, "configs",
+        "The config files, default DDR4, HBM2 and HMC configs");
+
+    try {
+        parser.ParseCLI(argc, argv);
+    } catch (args::Help) {
+        std::cout << parser;
+        return 0;
+    } catch (args::ParseError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    std::vector<std::string> configs = args::get(configs_arg);
+    if (configs.empty()) {
+        configs = {"configs/DDR4_8Gb_x8_2400.ini", "configs/HBM2_8Gb_x128.ini",
+                   "configs/HMC_2GB_4Lx16.ini"};
+    }
+    std::string format = args::get(format_arg);
+    if (format != "csv" && format != "json") {
+        std::cerr << "Unknown format " << format << std::endl;
+        return 1;
+    }
+    uint64_t num_ops = args::get(num_ops_arg);
+    uint64_t cycles = args::get(num_cycles_arg);
+    std::string filter = args::get(filter_arg);
+    auto selected = [&filter](const std::string& benchmark) {
+        return benchmark.find(filter) != std::string::npos;
+    };
+
+    Reporter reporter(format == "json");
+    for (const auto& config_file : configs) {
+        Config config(config_file, ".");
+        // the config name without directory and extension
+        std::string name = config_file.substr(config_file.rfind('/') + 1);
+        name = name.substr(0, name.rfind('.'));
+        if (selected("channel_state")) {
+            BenchChannelState(reporter, name, config, num_ops);
+        }
+        if (selected("command_queue")) {
+            for (int depth : {4, 8, 16, 32}) {
+                BenchCommandQueue(reporter, name, config, depth, num_ops);
+            }
+        }
+        if (selected("address_mapping")) {
+            BenchAddressMapping(reporter, name, config, num_ops);
+        }
+        if (selected("simple_stats")) {
+            BenchSimpleStats(reporter, name, config, num_ops);
+        }
+        if (selected("memory_system")) {
+            for (auto cpu_type : {"random", "stream"}) {
+                BenchEndToEnd(reporter, name, config_file, cpu_type, cycles);
+            }
+        }
+    }
+    return 0;
+}
@@ -1,44 +1,389 @@
 #include "channel_state.h"
+#include <algorithm>
 
 namespace dramsim3 {
+
+namespace {
+
+// Compile time constraint tables: which command types a command constrains
+// in each scope. The delays are only known at runtime (Timing), the kernels
+// below unroll into one max-update per listed command type. Has to match
+// what Timing builds, InitTimingKernels falls back to the Timing lists for
+// any command it doesn't match. REFRESH_SAME_BANK spans several banks and
+// always takes the Timing lists.
+enum Scope {
+    SAME_BANK,
+    OTHER_BANKS_SAME_BANKGROUP,
+    OTHER_BANKGROUPS_SAME_RANK,
+    OTHER_RANKS,
+    SAME_RANK,
+    NUM_SCOPES
+};
+
+const int kNumCmds = static_cast<int>(CommandType::SIZE);
+// marks the cmd_timing_sources_ of constraints from the bank itself
+const uint8_t kSameBankSource = 0x80;
+
+template <CommandType... Ts>
+struct TargetList;
+
+template <>
+struct TargetList<> {
+    static uint32_t Mask() { return 0; }
+    static void Update(uint64_t*, uint8_t*, int, const int*, int, int,
+                       uint64_t, uint8_t) {}
+};
+
+template <CommandType T, CommandType... Ts>
+struct TargetList<T, Ts...> {
+    static uint32_t Mask() {
+        return (1u << static_cast<int>(T)) | TargetList<Ts...>::Mask();
+    }
+    static void Update(uint64_t* timing, uint8_t* sources, int num_banks,
+                       const int* delays, int first, int last, uint64_t clk,
+                       uint8_t source) {
+        uint64_t* cmd_timing = timing + static_cast<int>(T) * num_banks;
+        uint8_t* cmd_sources = sources + static_cast<int>(T) * num_banks;
+        uint64_t time = clk + delays[static_cast<int>(T)];
+        for (int b = first; b < last; b++) {
+            if (time > cmd_timing[b]) {
+                cmd_timing[b] = time;
+                cmd_sources[b] = source;
+            }
+        }
+        TargetList<Ts...>::Update(timing, sources, num_banks, delays, first,
+                                  last, clk, source);
+    }
+};
+
+template <CommandType C, int S, bool kPPD>
+struct Targets {
+    typedef TargetList<> type;
+};
+
+#define TIMING_TARGETS(cmd, scope, ...)                                  \
+    template <bool kPPD>                                                 \
+    struct Targets<CommandType::cmd, scope, kPPD> {                      \
+        typedef TargetList<__VA_ARGS__> type;                            \
+    };
+
+const CommandType kRD = CommandType::READ;
+const CommandType kRDA = CommandType::READ_PRECHARGE;
+const CommandType kWR = CommandType::WRITE;
+const CommandType kWRA = CommandType::WRITE_PRECHARGE;
+const CommandType kACT = CommandType::ACTIVATE;
+const CommandType kPRE = CommandType::PRECHARGE;
+const CommandType kREFB = CommandType::REFRESH_BANK;
+const CommandType kREF = CommandType::REFRESH;
+const CommandType kSREFE = CommandType::SREF_ENTER;
+const CommandType kSREFX = CommandType::SREF_EXIT;
+const CommandType kPDE = CommandType::PD_ENTER;
+const CommandType kPDX = CommandType::PD_EXIT;
+const CommandType kREFSB = CommandType::REFRESH_SAME_BANK;
+const CommandType kRFM = CommandType::REFRESH_MANAGEMENT;
+
+TIMING_TARGETS(READ, SAME_BANK, kRD, kWR, kRDA, kWRA, kPRE, kPDE)
+TIMING_TARGETS(READ, OTHER_BANKS_SAME_BANKGROUP, kRD, kWR, kRDA, kWRA)
+TIMING_TARGETS(READ, OTHER_BANKGROUPS_SAME_RANK, kRD, kWR, kRDA, kWRA)
+TIMING_TARGETS(READ, OTHER_RANKS, kRD, kWR, kRDA, kWRA)
+TIMING_TARGETS(WRITE, SAME_BANK, kRD, kWR, kRDA, kWRA, kPRE, kPDE)
+TIMING_TARGETS(WRITE, OTHER_BANKS_SAME_BANKGROUP, kRD, kWR, kRDA, kWRA)
+TIMING_TARGETS(WRITE, OTHER_BANKGROUPS_SAME_RANK, kRD, kWR, kRDA, kWRA)
+TIMING_TARGETS(WRITE, OTHER_RANKS, kRD, kWR, kRDA, kWRA)
+TIMING_TARGETS(READ_PRECHARGE, SAME_BANK, kACT, kREF, kREFB, kSREFE, kPDE,
+               kREFSB, kRFM)
+TIMING_TARGETS(READ_PRECHARGE, OTHER_BANKS_SAME_BANKGROUP, kRD, kWR, kRDA,
+               kWRA)
+TIMING_TARGETS(READ_PRECHARGE, OTHER_BANKGROUPS_SAME_RANK, kRD, kWR, kRDA,
+               kWRA)
+TIMING_TARGETS(READ_PRECHARGE, OTHER_RANKS, kRD, kWR, kRDA, kWRA)
+TIMING_TARGETS(WRITE_PRECHARGE, SAME_BANK, kACT, kREF, kREFB, kSREFE,
+               kPDE, kREFSB, kRFM)
+TIMING_TARGETS(WRITE_PRECHARGE, OTHER_BANKS_SAME_BANKGROUP, kRD, kWR, kRDA,
+               kWRA)
+TIMING_TARGETS(WRITE_PRECHARGE, OTHER_BANKGROUPS_SAME_RANK, kRD, kWR, kRDA,
+               kWRA)
+TIMING_TARGETS(WRITE_PRECHARGE, OTHER_RANKS, kRD, kWR, kRDA, kWRA)
+TIMING_TARGETS(ACTIVATE, SAME_BANK, kACT, kRD, kWR, kRDA, kWRA, kPRE)
+TIMING_TARGETS(ACTIVATE, OTHER_BANKS_SAME_BANKGROUP, kACT, kREFB, kREFSB,
+               kRFM)
+TIMING_TARGETS(ACTIVATE, OTHER_BANKGROUPS_SAME_RANK, kACT, kREFB, kREFSB,
+               kRFM)
+TIMING_TARGETS(PRECHARGE, SAME_BANK, kACT, kREF, kREFB, kSREFE, kREFSB,
+               kRFM)
+TIMING_TARGETS(REFRESH_BANK, SAME_BANK, kACT, kREF, kREFB, kSREFE, kRFM)
+TIMING_TARGETS(REFRESH_BANK, OTHER_BANKS_SAME_BANKGROUP, kACT, kREFB, kRFM)
+TIMING_TARGETS(REFRESH_BANK, OTHER_BANKGROUPS_SAME_RANK, kACT, kREFB, kRFM)
+TIMING_TARGETS(REFRESH_MANAGEMENT, SAME_BANK, kACT, kREF, kREFB, kSREFE,
+               kREFSB, kRFM)
+TIMING_TARGETS(REFRESH_MANAGEMENT, OTHER_BANKS_SAME_BANKGROUP, kACT, kREFB,
+               kRFM)
+TIMING_TARGETS(REFRESH_MANAGEMENT, OTHER_BANKGROUPS_SAME_RANK, kACT, kREFB,
+               kRFM)
+TIMING_TARGETS(REFRESH, SAME_RANK, kACT, kREF, kSREFE, kREFSB, kRFM)
+TIMING_TARGETS(SREF_ENTER, SAME_RANK, kSREFX)
+TIMING_TARGETS(SREF_EXIT, SAME_RANK, kACT, kREF, kREFB, kSREFE, kPDE,
+               kREFSB, kRFM)
+TIMING_TARGETS(PD_ENTER, SAME_RANK, kPDX)
+TIMING_TARGETS(PD_EXIT, SAME_RANK, kRD, kWR, kRDA, kWRA, kACT, kPRE, kREF,
+               kREFB, kSREFE, kPDE, kREFSB, kRFM)
+
+#undef TIMING_TARGETS
+
+// tPPD, only some protocols constrain precharges to other banks
+template <>
+struct Targets<CommandType::PRECHARGE, OTHER_BANKS_SAME_BANKGROUP, true> {
+    typedef TargetList<kPRE> type;
+};
+
+template <>
+struct Targets<CommandType::PRECHARGE, OTHER_BANKGROUPS_SAME_RANK, true> {
+    typedef TargetList<kPRE> type;
+};
+
+template <CommandType C, int S>
+uint32_t TargetMask(bool ppd) {
+    return ppd ? Targets<C, S, true>::type::Mask()
+               : Targets<C, S, false>::type::Mask();
+}
+
+// compiled in command types constrained by C, per scope
+template <CommandType C>
+void CommandMasks(uint32_t* masks, bool ppd) {
+    masks[SAME_BANK] = TargetMask<C, SAME_BANK>(ppd);
+    masks[OTHER_BANKS_SAME_BANKGROUP] =
+        TargetMask<C, OTHER_BANKS_SAME_BANKGROUP>(ppd);
+    masks[OTHER_BANKGROUPS_SAME_RANK] =
+        TargetMask<C, OTHER_BANKGROUPS_SAME_RANK>(ppd);
+    masks[OTHER_RANKS] = TargetMask<C, OTHER_RANKS>(ppd);
+    masks[SAME_RANK] = TargetMask<C, SAME_RANK>(ppd);
+}
+
+uint32_t ListMask(const std::vector<std::pair<CommandType, int>>& list) {
+    uint32_t mask = 0;
+    for (const auto& cmd_timing : list) {
+        mask |= 1u << static_cast<int>(cmd_timing.first);
+    }
+    return mask;
+}
+
+}  // namespace
+
 ChannelState::ChannelState(const Config& config, const Timing& timing)
     : rank_idle_cycles(config.ranks, 0),
       config_(config),
       timing_(timing),
       rank_is_sref_(config.ranks, false),
+      rank_is_pd_(config.ranks, false),
+      num_banks_(config.ranks * config.banks),
+      bank_states_(num_banks_, BankState::CLOSED),
+      open_rows_(num_banks_, -1),
+      row_hit_counts_(num_banks_, 0),
+      cmd_timing_(static_cast<int>(CommandType::SIZE) * num_banks_, 0),
+      cmd_timing_sources_(cmd_timing_.size(), 0),
+      use_timing_kernels_(true),
       four_aw_(config_.ranks, std::vector<uint64_t>()),
       thirty_two_aw_(config_.ranks, std::vector<uint64_t>()) {
-    bank_states_.reserve(config_.ranks);
-    for (auto i = 0; i < config_.ranks; i++) {
-        auto rank_states = std::vector<std::vector<BankState>>();
-        rank_states.reserve(config_.bankgroups);
-        for (auto j = 0; j < config_.bankgroups; j++) {
-            auto bg_states =
-                std::vector<BankState>(config_.banks_per_group, BankState());
-            rank_states.push_back(bg_states);
+    InitTimingKernels();
+}
+
+void ChannelState::InitTimingKernels() {
+    const std::vector<std::vector<std::pair<CommandType, int>>>* lists[] = {
+        &timing_.same_bank, &timing_.other_banks_same_bankgroup,
+        &timing_.other_bankgroups_same_rank, &timing_.other_ranks,
+        &timing_.same_rank};
+    delays_.assign(NUM_SCOPES * kNumCmds * kNumCmds, 0);
+    for (int s = 0; s < NUM_SCOPES; s++) {
+        for (int c = 0; c < kNumCmds; c++) {
+            for (const auto& cmd_timing : (*lists[s])[c]) {
+                int& delay = delays_[(s * kNumCmds + c) * kNumCmds +
+                                     static_cast<int>(cmd_timing.first)];
+                // a command listed twice ends up at the larger delay either way
+                delay = std::max(delay, cmd_timing.second);
+            }
         }
-        bank_states_.push_back(rank_states);
     }
+
+    bool ppd = !timing_.other_banks_same_bankgroup
+                    [static_cast<int>(CommandType::PRECHARGE)].empty();
+    // one past the end so that invalid commands take the generic path
+    timing_kernels_.assign(kNumCmds + 1, nullptr);
+    auto& k = timing_kernels_;
+    if (ppd) {
+        k[static_cast<int>(kRD)] = &ChannelState::BankTimingKernel<kRD, true>;
+        k[static_cast<int>(kRDA)] = &ChannelState::BankTimingKernel<kRDA, true>;
+        k[static_cast<int>(kWR)] = &ChannelState::BankTimingKernel<kWR, true>;
+        k[static_cast<int>(kWRA)] = &ChannelState::BankTimingKernel<kWRA, true>;
+        k[static_cast<int>(kACT)] = &ChannelState::BankTimingKernel<kACT, true>;
+        k[static_cast<int>(kPRE)] = &ChannelState::BankTimingKernel<kPRE, true>;
+        k[static_cast<int>(kREFB)] =
+            &ChannelState::BankTimingKernel<kREFB, true>;
+        k[static_cast<int>(kRFM)] = &ChannelState::BankTimingKernel<kRFM, true>;
+    } else {
+        k[static_cast<int>(kRD)] = &ChannelState::BankTimingKernel<kRD, false>;
+        k[static_cast<int>(kRDA)] =
+            &ChannelState::BankTimingKernel<kRDA, false>;
+        k[static_cast<int>(kWR)] = &ChannelState::BankTimingKernel<kWR, false>;
+        k[static_cast<int>(kWRA)] =
+            &ChannelState::BankTimingKernel<kWRA, false>;
+        k[static_cast<int>(kACT)] =
+            &ChannelState::BankTimingKernel<kACT, false>;
+        k[static_cast<int>(kPRE)] =
+            &ChannelState::BankTimingKernel<kPRE, false>;
+        k[static_cast<int>(kREFB)] =
+            &ChannelState::BankTimingKernel<kREFB, false>;
+        k[static_cast<int>(kRFM)] =
+            &ChannelState::BankTimingKernel<kRFM, false>;
+    }
+    k[static_cast<int>(kREF)] = &ChannelState::RankTimingKernel<kREF>;
+    k[static_cast<int>(kSREFE)] = &ChannelState::RankTimingKernel<kSREFE>;
+    k[static_cast<int>(kSREFX)] = &ChannelState::RankTimingKernel<kSREFX>;
+    k[static_cast<int>(kPDE)] = &ChannelState::RankTimingKernel<kPDE>;
+    k[static_cast<int>(kPDX)] = &ChannelState::RankTimingKernel<kPDX>;
+
+    uint32_t masks[kNumCmds][NUM_SCOPES];
+    CommandMasks<kRD>(masks[static_cast<int>(kRD)], ppd);
+    CommandMasks<kRDA>(masks[static_cast<int>(kRDA)], ppd);
+    CommandMasks<kWR>(masks[static_cast<int>(kWR)], ppd);
+    CommandMasks<kWRA>(masks[static_cast<int>(kWRA)], ppd);
+    CommandMasks<kACT>(masks[static_cast<int>(kACT)], ppd);
+    CommandMasks<kPRE>(masks[static_cast<int>(kPRE)], ppd);
+    CommandMasks<kREFB>(masks[static_cast<int>(kREFB)], ppd);
+    CommandMasks<kRFM>(masks[static_cast<int>(kRFM)], ppd);
+    CommandMasks<kREF>(masks[static_cast<int>(kREF)], ppd);
+    CommandMasks<kSREFE>(masks[static_cast<int>(kSREFE)], ppd);
+    CommandMasks<kSREFX>(masks[static_cast<int>(kSREFX)], ppd);
+    CommandMasks<kPDE>(masks[static_cast<int>(kPDE)], ppd);
+    CommandMasks<kPDX>(masks[static_cast<int>(kPDX)], ppd);
+
+    for (int c = 0; c < kNumCmds; c++) {
+        // bank commands never look at the same rank list and vice versa
+        CommandType cmd_type = static_cast<CommandType>(c);
+        bool rank_cmd = cmd_type == kREF || cmd_type == kSREFE ||
+                        cmd_type == kSREFX || cmd_type == kPDE ||
+                        cmd_type == kPDX;
+        for (int s = 0; s < NUM_SCOPES; s++) {
+            if ((s == SAME_RANK) != rank_cmd) {
+                continue;
+            }
+            if (ListMask((*lists[s])[c]) != masks[c][s]) {
+                timing_kernels_[c] = nullptr;
+            }
+        }
+    }
+}
+
+template <CommandType C, bool kPPD>
+void ChannelState::BankTimingKernel(const Address& addr, uint64_t clk) {
+    const int c = static_cast<int>(C);
+    const int bpg = config_.banks_per_group;
+    int rank_first = BankIndex(addr.rank, 0, 0);
+    int rank_last = rank_first + config_.banks;
+    int bg_first = BankIndex(addr.rank, addr.bankgroup, 0);
+    int bg_last = bg_first + bpg;
+    int bank = bg_first + addr.bank;
+    uint64_t* timing = cmd_timing_.data();
+    uint8_t* sources = cmd_timing_sources_.data();
+    const int* delays = delays_.data();
+    const int stride = kNumCmds * kNumCmds;
+    const uint8_t source = static_cast<uint8_t>(c);
+
+    typedef typename Targets<C, SAME_BANK, kPPD>::type SameBank;
+    SameBank::Update(timing, sources, num_banks_,
+                     delays + SAME_BANK * stride + c * kNumCmds, bank,
+                     bank + 1, clk, source | kSameBankSource);
+
+    typedef typename Targets<C, OTHER_BANKS_SAME_BANKGROUP, kPPD>::type
+        OtherBanks;
+    const int* other_banks =
+        delays + OTHER_BANKS_SAME_BANKGROUP * stride + c * kNumCmds;
+    OtherBanks::Update(timing, sources, num_banks_, other_banks, bg_first,
+                       bank, clk, source);
+    OtherBanks::Update(timing, sources, num_banks_, other_banks, bank + 1,
+                       bg_last, clk, source);
+
+    typedef typename Targets<C, OTHER_BANKGROUPS_SAME_RANK, kPPD>::type
+        OtherBankgroups;
+    const int* other_bgs =
+        delays + OTHER_BANKGROUPS_SAME_RANK * stride + c * kNumCmds;
+    OtherBankgroups::Update(timing, sources, num_banks_, other_bgs,
+                            rank_first, bg_first, clk, source);
+    OtherBankgroups::Update(timing, sources, num_banks_, other_bgs, bg_last,
+                            rank_last, clk, source);
+
+    typedef typename Targets<C, OTHER_RANKS, kPPD>::type OtherRanks;
+    const int* other_ranks = delays + OTHER_RANKS * stride + c * kNumCmds;
+    OtherRanks::Update(timing, sources, num_banks_, other_ranks, 0,
+                       rank_first, clk, source);
+    OtherRanks::Update(timing, sources, num_banks_, other_ranks, rank_last,
+                       num_banks_, clk, source);
+    return;
+}
+
+template <CommandType C>
+void ChannelState::RankTimingKernel(const Address& addr, uint64_t clk) {
+    typedef typename Targets<C, SAME_RANK, false>::type SameRank;
+    int first = BankIndex(addr.rank, 0, 0);
+    SameRank::Update(cmd_timing_.data(), cmd_timing_sources_.data(),
+                     num_banks_,
+                     delays_.data() + SAME_RANK * kNumCmds * kNumCmds +
+                         static_cast<int>(C) * kNumCmds,
+                     first, first + config_.banks, clk,
+                     static_cast<uint8_t>(C));
+    return;
 }
 
 bool ChannelState::IsAllBankIdleInRank(int rank) const {
-    for (int j = 0; j < config_.bankgroups; j++) {
-        for (int k = 0; k < config_.banks_per_group; k++) {
-            if (bank_states_[rank][j][k].IsRowOpen()) {
-                return false;
-            }
+    int first = BankIndex(rank, 0, 0);
+    for (int b = first; b < first + config_.banks; b++) {
+        if (bank_states_[b] == BankState::OPEN) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ChannelState::IsAllBankPrechargedInRank(int rank) const {
+    int first = BankIndex(rank, 0, 0);
+    for (int b = first; b < first + config_.banks; b++) {
+        if (open_rows_[b] >= 0) {
+            return false;
         }
     }
     return true;
 }
 
+void ChannelState::SetOpenRows(const std::vector<int>& rows) {
+    for (int i = 0; i < num_banks_; i++) {
+        if (bank_states_[i] == BankState::SREF) {
+            continue;
+        }
+        if (bank_states_[i] != BankState::PD) {
+            bank_states_[i] =
+                rows[i] >= 0 ? BankState::OPEN : BankState::CLOSED;
+        }
+        open_rows_[i] = rows[i];
+        row_hit_counts_[i] = 0;
+    }
+    return;
+}
+
+bool ChannelState::IsRankRefreshWaiting(int rank) const {
+    for (const auto& ref : refresh_q_) {
+        if (ref.Rank() == rank) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool ChannelState::IsRWPendingOnRef(const Command& cmd) const {
     int rank = cmd.Rank();
     int bankgroup = cmd.Bankgroup();
     int bank = cmd.Bank();
     return (IsRowOpen(rank, bankgroup, bank) &&
             RowHitCount(rank, bankgroup, bank) == 0 &&
-            bank_states_[rank][bankgroup][bank].OpenRow() == cmd.Row());
+            OpenRow(rank, bankgroup, bank) == cmd.Row());
 }
 
 void ChannelState::BankNeedRefresh(int rank, int bankgroup, int bank,
@@ -48,7 +393,25 @@ void ChannelState::BankNeedRefresh(int rank, int bankgroup, int bank,
         refresh_q_.emplace_back(CommandType::REFRESH_BANK, addr, -1);
     } else {
         for (auto it = refresh_q_.begin(); it != refresh_q_.end(); it++) {
-            if (it->Rank() == rank && it->Bankgroup() == bankgroup &&
+            if (it->cmd_type == CommandType::REFRESH_BANK &&
+                it->Rank() == rank && it->Bankgroup() == bankgroup &&
+                it->Bank() == bank) {
+                refresh_q_.erase(it);
+                break;
+            }
+        }
+    }
+    return;
+}
+
+void ChannelState::BankNeedRFM(int rank, int bankgroup, int bank, bool need) {
+    if (need) {
+        Address addr = Address(-1, rank, bankgroup, bank, -1, -1);
+        refresh_q_.emplace_back(CommandType::REFRESH_MANAGEMENT, addr, -1);
+    } else {
+        for (auto it = refresh_q_.begin(); it != refresh_q_.end(); it++) {
+            if (it->cmd_type == CommandType::REFRESH_MANAGEMENT &&
+                it->Rank() == rank && it->Bankgroup() == bankgroup &&
                 it->Bank() == bank) {
                 refresh_q_.erase(it);
                 break;
@@ -58,13 +421,29 @@ void ChannelState::BankNeedRefresh(int rank, int bankgroup, int bank,
     return;
 }
 
+void ChannelState::SameBankNeedRefresh(int rank, int bank, bool need) {
+    if (need) {
+        Address addr = Address(-1, rank, -1, bank, -1, -1);
+        refresh_q_.emplace_back(CommandType::REFRESH_SAME_BANK, addr, -1);
+    } else {
+        for (auto it = refresh_q_.begin(); it != refresh_q_.end(); it++) {
+            if (it->cmd_type == CommandType::REFRESH_SAME_BANK &&
+                it->Rank() == rank && it->Bank() == bank) {
+                refresh_q_.erase(it);
+                break;
+            }
+        }
+    }
+    return;
+}
+
 void ChannelState::RankNeedRefresh(int rank, bool need) {
     if (need) {
         Address addr = Address(-1, rank, -1, -1, -1, -1);
         refresh_q_.emplace_back(CommandType::REFRESH, addr, -1);
     } else {
         for (auto it = refresh_q_.begin(); it != refresh_q_.end(); it++) {
-            if (it->Rank() == rank) {
+            if (it->cmd_type == CommandType::REFRESH && it->Rank() == rank) {
                 refresh_q_.erase(it);
                 break;
             }
@@ -73,14 +452,32 @@ void ChannelState::RankNeedRefresh(int rank, bool need) {
     return;
 }
 
+Command ChannelState::GetReadyBankCommand(int bank_idx, const Command& cmd,
+                                          uint64_t clk) const {
+    CommandType required_type =
+        RequiredCommand(bank_states_[bank_idx], open_rows_[bank_idx], cmd);
+    if (required_type != CommandType::SIZE) {
+        if (clk >= CmdTiming(required_type, bank_idx)) {
+            return Command(required_type, cmd.addr, cmd.hex_addr);
+        }
+    }
+    return Command();
+}
+
 Command ChannelState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
     Command ready_cmd = Command();
-    if (cmd.IsRankCMD()) {
+    bool same_bank = cmd.cmd_type == CommandType::REFRESH_SAME_BANK;
+    if (cmd.IsRankCMD() || same_bank) {
+        // same bank refreshes go to one bank of every bankgroup
+        int num_banks = same_bank ? config_.bankgroups : config_.banks;
         int num_ready = 0;
         for (auto j = 0; j < config_.bankgroups; j++) {
             for (auto k = 0; k < config_.banks_per_group; k++) {
+                if (same_bank && k != cmd.Bank()) {
+                    continue;
+                }
                 ready_cmd =
-                    bank_states_[cmd.Rank()][j][k].GetReadyCommand(cmd, clk);
+                    GetReadyBankCommand(BankIndex(cmd.Rank(), j, k), cmd, clk);
                 if (!ready_cmd.IsValid()) {  // Not ready
                     continue;
                 }
@@ -94,32 +491,105 @@ Command ChannelState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
             }
         }
         // All bank ready
-        if (num_ready == config_.banks) {
+        if (num_ready == num_banks) {
             return ready_cmd;
         } else {
             return Command();
         }
     } else {
-        ready_cmd = bank_states_[cmd.Rank()][cmd.Bankgroup()][cmd.Bank()]
-                        .GetReadyCommand(cmd, clk);
-        if (!ready_cmd.IsValid()) {
+        CommandType ready_type = GetReadyType(cmd, clk);
+        if (ready_type == CommandType::SIZE) {
             return Command();
         }
-        if (ready_cmd.cmd_type == CommandType::ACTIVATE) {
-            if (!ActivationWindowOk(ready_cmd.Rank(), clk)) {
-                return Command();
-            }
+        return Command(ready_type, cmd.addr, cmd.hex_addr);
+    }
+}
+
+CommandType ChannelState::GetReadyType(const Command& cmd,
+                                       uint64_t clk) const {
+    int bank_idx = BankIndex(cmd.Rank(), cmd.Bankgroup(), cmd.Bank());
+    CommandType required_type =
+        RequiredCommand(bank_states_[bank_idx], open_rows_[bank_idx], cmd);
+    if (required_type == CommandType::SIZE ||
+        clk < CmdTiming(required_type, bank_idx)) {
+        return CommandType::SIZE;
+    }
+    if (required_type == CommandType::ACTIVATE &&
+        !ActivationWindowOk(cmd.Rank(), clk)) {
+        return CommandType::SIZE;
+    }
+    return required_type;
+}
+
+uint64_t ChannelState::GetReadyCycle(const Command& cmd) const {
+    int bank_idx = BankIndex(cmd.Rank(), cmd.Bankgroup(), cmd.Bank());
+    CommandType required_type =
+        RequiredCommand(bank_states_[bank_idx], open_rows_[bank_idx], cmd);
+    uint64_t ready_cycle = CmdTiming(required_type, bank_idx);
+    if (bank_states_[bank_idx] == BankState::CLOSED && cmd.IsReadWrite()) {
+        // an ACT is needed first, which also has to respect tFAW/t32AW
+        ready_cycle =
+            std::max(ready_cycle, ActivationWindowReadyCycle(cmd.Rank()));
+    }
+    return ready_cycle;
+}
+
+StallReason ChannelState::BlockingReason(const Command& cmd,
+                                         uint64_t clk) const {
+    int bank_idx = BankIndex(cmd.Rank(), cmd.Bankgroup(), cmd.Bank());
+    CommandType required_type =
+        RequiredCommand(bank_states_[bank_idx], open_rows_[bank_idx], cmd);
+    if (required_type == CommandType::SREF_EXIT ||
+        required_type == CommandType::PD_EXIT) {
+        return StallReason::POWER;
+    } else if (required_type == CommandType::SIZE) {
+        return StallReason::OTHER;
+    }
+    int idx = static_cast<int>(required_type) * num_banks_ + bank_idx;
+    if (required_type == CommandType::ACTIVATE) {
+        uint64_t window_cycle = ActivationWindowReadyCycle(cmd.Rank());
+        if (window_cycle > clk && window_cycle >= cmd_timing_[idx]) {
+            return StallReason::TFAW;
         }
-        return ready_cmd;
     }
+    if (clk >= cmd_timing_[idx]) {
+        return StallReason::SIZE;
+    }
+    uint8_t source = cmd_timing_sources_[idx];
+    bool same_bank = (source & kSameBankSource) != 0;
+    Command from(static_cast<CommandType>(source & ~kSameBankSource),
+                 cmd.addr, cmd.hex_addr);
+    Command to(required_type, cmd.addr, cmd.hex_addr);
+    if (from.IsRefresh()) {
+        return StallReason::REFRESH;
+    } else if (from.IsRankCMD()) {
+        // REFRESH is taken above, the rest are power down and self refresh
+        return StallReason::POWER;
+    } else if (to.IsReadWrite()) {
+        if (from.cmd_type == CommandType::ACTIVATE) {
+            return StallReason::TRCD;
+        } else if (from.IsReadWrite()) {
+            return from.IsRead() == to.IsRead() ? StallReason::TCCD
+                                                : StallReason::TWTR;
+        }
+    } else if (to.cmd_type == CommandType::ACTIVATE) {
+        if (from.cmd_type == CommandType::ACTIVATE) {
+            return same_bank ? StallReason::TRAS : StallReason::TFAW;
+        }
+        return StallReason::TRP;
+    } else if (to.cmd_type == CommandType::PRECHARGE &&
+               from.cmd_type != CommandType::PRECHARGE) {
+        return StallReason::TRAS;
+    }
+    return StallReason::OTHER;
 }
 
 void ChannelState::UpdateState(const Command& cmd) {
     if (cmd.IsRankCMD()) {
-        for (auto j = 0; j < config_.bankgroups; j++) {
-            for (auto k = 0; k < config_.banks_per_group; k++) {
-                bank_states_[cmd.Rank()][j][k].UpdateState(cmd);
-            }
+        int first = BankIndex(cmd.Rank(), 0, 0);
+        for (int b = first; b < first + config_.banks; b++) {
+            UpdateBankState(cmd, bank_states_[b], open_rows_[b],
+                            row_hit_counts_[b]);
         }
         if (cmd.IsRefresh()) {
             RankNeedRefresh(cmd.Rank(), false);
@@ -127,10 +597,25 @@ void ChannelState::UpdateState(const Command& cmd) {
             rank_is_sref_[cmd.Rank()] = true;
         } else if (cmd.cmd_type == CommandType::SREF_EXIT) {
             rank_is_sref_[cmd.Rank()] = false;
+        } else if (cmd.cmd_type == CommandType::PD_ENTER) {
+            rank_is_pd_[cmd.Rank()] = true;
+        } else if (cmd.cmd_type == CommandType::PD_EXIT) {
+            rank_is_pd_[cmd.Rank()] = false;
+        }
+    } else if (cmd.cmd_type == CommandType::REFRESH_SAME_BANK) {
+        for (int g = 0; g < config_.bankgroups; g++) {
+            int b = BankIndex(cmd.Rank(), g, cmd.Bank());
+            UpdateBankState(cmd, bank_states_[b], open_rows_[b],
+                            row_hit_counts_[b]);
         }
+        SameBankNeedRefresh(cmd.Rank(), cmd.Bank(), false);
     } else {
-        bank_states_[cmd.Rank()][cmd.Bankgroup()][cmd.Bank()].UpdateState(cmd);
-        if (cmd.IsRefresh()) {
+        int b = BankIndex(cmd.Rank(), cmd.Bankgroup(), cmd.Bank());
+        UpdateBankState(cmd, bank_states_[b], open_rows_[b],
+                        row_hit_counts_[b]);
+        if (cmd.cmd_type == CommandType::REFRESH_MANAGEMENT) {
+            BankNeedRFM(cmd.Rank(), cmd.Bankgroup(), cmd.Bank(), false);
+        } else if (cmd.IsRefresh()) {
             BankNeedRefresh(cmd.Rank(), cmd.Bankgroup(), cmd.Bank(), false);
         }
     }
@@ -138,46 +623,71 @@ void ChannelState::UpdateState(const Command& cmd) {
 }
 
 void ChannelState::UpdateTiming(const Command& cmd, uint64_t clk) {
+    TimingKernel kernel = timing_kernels_[static_cast<int>(cmd.cmd_type)];
+    if (use_timing_kernels_ && kernel != nullptr) {
+        if (cmd.cmd_type == CommandType::ACTIVATE) {
+            UpdateActivationTimes(cmd.Rank(), clk);
+        }
+        (this->*kernel)(cmd.addr, clk);
+        return;
+    }
+
+    uint8_t source = static_cast<uint8_t>(cmd.cmd_type);
     switch (cmd.cmd_type) {
         case CommandType::ACTIVATE:
             UpdateActivationTimes(cmd.Rank(), clk);
+            // fall through
         case CommandType::READ:
         case CommandType::READ_PRECHARGE:
         case CommandType::WRITE:
         case CommandType::WRITE_PRECHARGE:
         case CommandType::PRECHARGE:
         case CommandType::REFRESH_BANK:
-            // TODO - simulator speed? - Speciazlize which of the below
-            // functions to call depending on the command type  Same Bank
+        case CommandType::REFRESH_MANAGEMENT:
+            // Same Bank
             UpdateSameBankTiming(
                 cmd.addr, timing_.same_bank[static_cast<int>(cmd.cmd_type)],
-                clk);
+                clk, source);
 
             // Same Bankgroup other banks
             UpdateOtherBanksSameBankgroupTiming(
                 cmd.addr,
                 timing_
                     .other_banks_same_bankgroup[static_cast<int>(cmd.cmd_type)],
-                clk);
+                clk, source);
 
             // Other bankgroups
             UpdateOtherBankgroupsSameRankTiming(
                 cmd.addr,
                 timing_
                     .other_bankgroups_same_rank[static_cast<int>(cmd.cmd_type)],
-                clk);
+                clk, source);
 
             // Other ranks
             UpdateOtherRanksTiming(
                 cmd.addr, timing_.other_ranks[static_cast<int>(cmd.cmd_type)],
-                clk);
+                clk, source);
             break;
         case CommandType::REFRESH:
         case CommandType::SREF_ENTER:
         case CommandType::SREF_EXIT:
+        case CommandType::PD_ENTER:
+        case CommandType::PD_EXIT:
+            UpdateSameRankTiming(
+                cmd.addr, timing_.same_rank[static_cast<int>(cmd.cmd_type)],
+                clk, source);
+            break;
+        case CommandType::REFRESH_SAME_BANK:
             UpdateSameRankTiming(
                 cmd.addr, timing_.same_rank[static_cast<int>(cmd.cmd_type)],
-                clk);
+                clk, source);
+            for (int g = 0; g < config_.bankgroups; g++) {
+                Address addr = cmd.addr;
+                addr.bankgroup = g;
+                UpdateSameBankTiming(
+                    addr, timing_.same_bank[static_cast<int>(cmd.cmd_type)],
+                    clk, source);
+            }
             break;
         default:
             AbruptExit(__FILE__, __LINE__);
@@ -185,80 +695,77 @@ void ChannelState::UpdateTiming(const Command& cmd, uint64_t clk) {
     return;
 }
 
+void ChannelState::UpdateBanksTiming(
+    int first_bank, int last_bank,
+    const std::vector<std::pair<CommandType, int>>& cmd_timing_list,
+    uint64_t clk, uint8_t source) {
+    for (const auto& cmd_timing : cmd_timing_list) {
+        uint64_t time = clk + cmd_timing.second;
+        int offset = static_cast<int>(cmd_timing.first) * num_banks_;
+        uint64_t* timing = &cmd_timing_[offset];
+        uint8_t* sources = &cmd_timing_sources_[offset];
+        for (int b = first_bank; b < last_bank; b++) {
+            if (time > timing[b]) {
+                timing[b] = time;
+                sources[b] = source;
+            }
+        }
+    }
+    return;
+}
+
 void ChannelState::UpdateSameBankTiming(
     const Address& addr,
     const std::vector<std::pair<CommandType, int>>& cmd_timing_list,
-    uint64_t clk) {
-    for (auto cmd_timing : cmd_timing_list) {
-        bank_states_[addr.rank][addr.bankgroup][addr.bank].UpdateTiming(
-            cmd_timing.first, clk + cmd_timing.second);
-    }
+    uint64_t clk, uint8_t source) {
+    int bank = BankIndex(addr.rank, addr.bankgroup, addr.bank);
+    UpdateBanksTiming(bank, bank + 1, cmd_timing_list, clk,
+                      source | kSameBankSource);
     return;
 }
 
 void ChannelState::UpdateOtherBanksSameBankgroupTiming(
     const Address& addr,
     const std::vector<std::pair<CommandType, int>>& cmd_timing_list,
-    uint64_t clk) {
-    for (auto k = 0; k < config_.banks_per_group; k++) {
-        if (k != addr.bank) {
-            for (auto cmd_timing : cmd_timing_list) {
-                bank_states_[addr.rank][addr.bankgroup][k].UpdateTiming(
-                    cmd_timing.first, clk + cmd_timing.second);
-            }
-        }
-    }
+    uint64_t clk, uint8_t source) {
+    int first = BankIndex(addr.rank, addr.bankgroup, 0);
+    int bank = first + addr.bank;
+    UpdateBanksTiming(first, bank, cmd_timing_list, clk, source);
+    UpdateBanksTiming(bank + 1, first + config_.banks_per_group,
+                      cmd_timing_list, clk, source);
     return;
 }
 
 void ChannelState::UpdateOtherBankgroupsSameRankTiming(
     const Address& addr,
     const std::vector<std::pair<CommandType, int>>& cmd_timing_list,
-    uint64_t clk) {
-    for (auto j = 0; j < config_.bankgroups; j++) {
-        if (j != addr.bankgroup) {
-            for (auto k = 0; k < config_.banks_per_group; k++) {
-                for (auto cmd_timing : cmd_timing_list) {
-                    bank_states_[addr.rank][j][k].UpdateTiming(
-                        cmd_timing.first, clk + cmd_timing.second);
-                }
-            }
-        }
-    }
+    uint64_t clk, uint8_t source) {
+    int first = BankIndex(addr.rank, 0, 0);
+    int bg_first = BankIndex(addr.rank, addr.bankgroup, 0);
+    UpdateBanksTiming(first, bg_first, cmd_timing_list, clk, source);
+    UpdateBanksTiming(bg_first + config_.banks_per_group,
+                      first + config_.banks, cmd_timing_list, clk, source);
     return;
 }
 
 void ChannelState::UpdateOtherRanksTiming(
     const Address& addr,
     const std::vector<std::pair<CommandType, int>>& cmd_timing_list,
-    uint64_t clk) {
-    for (auto i = 0; i < config_.ranks; i++) {
-        if (i != addr.rank) {
-            for (auto j = 0; j < config_.bankgroups; j++) {
-                for (auto k = 0; k < config_.banks_per_group; k++) {
-                    for (auto cmd_timing : cmd_timing_list) {
-                        bank_states_[i][j][k].UpdateTiming(
-                            cmd_timing.first, clk + cmd_timing.second);
-                    }
-                }
-            }
-        }
-    }
+    uint64_t clk, uint8_t source) {
+    int first = BankIndex(addr.rank, 0, 0);
+    UpdateBanksTiming(0, first, cmd_timing_list, clk, source);
+    UpdateBanksTiming(first + config_.banks, num_banks_, cmd_timing_list, clk,
+                      source);
     return;
 }
 
 void ChannelState::UpdateSameRankTiming(
     const Address& addr,
     const std::vector<std::pair<CommandType, int>>& cmd_timing_list,
-    uint64_t clk) {
-    for (auto j = 0; j < config_.bankgroups; j++) {
-        for (auto k = 0; k < config_.banks_per_group; k++) {
-            for (auto cmd_timing : cmd_timing_list) {
-                bank_states_[addr.rank][j][k].UpdateTiming(
-                    cmd_timing.first, clk + cmd_timing.second);
-            }
-        }
-    }
+    uint64_t clk, uint8_t source) {
+    int first = BankIndex(addr.rank, 0, 0);
+    UpdateBanksTiming(first, first + config_.banks, cmd_timing_list, clk,
+                      source);
     return;
 }
 
@@ -294,6 +801,17 @@ void ChannelState::UpdateActivationTimes(int rank, uint64_t curr_time) {
     return;
 }
 
+uint64_t ChannelState::ActivationWindowReadyCycle(int rank) const {
+    uint64_t ready_cycle = 0;
+    if (four_aw_[rank].size() >= 4) {
+        ready_cycle = four_aw_[rank][0];
+    }
+    if (config_.IsGDDR() && thirty_two_aw_[rank].size() >= 32) {
+        ready_cycle = std::max(ready_cycle, thirty_two_aw_[rank][0]);
+    }
+    return ready_cycle;
+}
+
 bool ChannelState::IsFAWReady(int rank, uint64_t curr_time) const {
     if (!four_aw_[rank].empty()) {
         if (curr_time < four_aw_[rank][0] && four_aw_[rank].size() >= 4) {
@@ -313,4 +831,36 @@ bool ChannelState::Is32AWReady(int rank, uint64_t curr_time) const {
     return true;
 }
 
+void ChannelState::Save(CheckpointWriter& writer) const {
+    writer.Section("channel_state");
+    writer.Put(rank_idle_cycles);
+    writer.Put(rank_is_sref_);
+    writer.Put(rank_is_pd_);
+    writer.Put(refresh_q_);
+    writer.Put(bank_states_);
+    writer.Put(open_rows_);
+    writer.Put(row_hit_counts_);
+    writer.Put(cmd_timing_);
+    writer.Put(cmd_timing_sources_);
+    writer.Put(four_aw_);
+    writer.Put(thirty_two_aw_);
+    return;
+}
+
+void ChannelState::Restore(CheckpointReader& reader) {
+    reader.Section("channel_state");
+    reader.Get(rank_idle_cycles);
+    reader.Get(rank_is_sref_);
+    reader.Get(rank_is_pd_);
+    reader.Get(refresh_q_);
+    reader.Get(bank_states_);
+    reader.Get(open_rows_);
+    reader.Get(row_hit_counts_);
+    reader.Get(cmd_timing_);
+    reader.Get(cmd_timing_sources_);
+    reader.Get(four_aw_);
+    reader.Get(thirty_two_aw_);
+    return;
+}
+
 }  // namespace dramsim3
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include "bankstate.h"
+#include "checkpoint.h"
 #include "common.h"
 #include "configuration.h"
 #include "timing.h"
@@ -13,27 +14,60 @@ class ChannelState {
    public:
     ChannelState(const Config& config, const Timing& timing);
     Command GetReadyCommand(const Command& cmd, uint64_t clk) const;
+    // type of the command GetReadyCommand returns for a (bank level) cmd,
+    // SIZE if none, without building the command
+    CommandType GetReadyType(const Command& cmd, uint64_t clk) const;
+    // Lower bound of the cycle at which GetReadyCommand could return a valid
+    // command for a (bank level) cmd, given no other command is issued
+    uint64_t GetReadyCycle(const Command& cmd) const;
+    // what holds up a (bank level) cmd at clk, going by the constraint that
+    // is met last: the command that set it, tFAW/t32AW for an ACT, or SIZE
+    // if cmd can go. Doesn't change until a command is issued
+    StallReason BlockingReason(const Command& cmd, uint64_t clk) const;
     void UpdateState(const Command& cmd);
     void UpdateTiming(const Command& cmd, uint64_t clk);
     void UpdateTimingAndStates(const Command& cmd, uint64_t clk);
     bool ActivationWindowOk(int rank, uint64_t curr_time) const;
     void UpdateActivationTimes(int rank, uint64_t curr_time);
     bool IsRowOpen(int rank, int bankgroup, int bank) const {
-        return bank_states_[rank][bankgroup][bank].IsRowOpen();
+        return bank_states_[BankIndex(rank, bankgroup, bank)] ==
+               BankState::OPEN;
     }
     bool IsAllBankIdleInRank(int rank) const;
+    // no open rows, unlike IsAllBankIdleInRank this also holds for the rows
+    // a powered down rank keeps open
+    bool IsAllBankPrechargedInRank(int rank) const;
     bool IsRankSelfRefreshing(int rank) const { return rank_is_sref_[rank]; }
+    bool IsRankPoweredDown(int rank) const { return rank_is_pd_[rank]; }
     bool IsRefreshWaiting() const { return !refresh_q_.empty(); }
+    bool IsRankRefreshWaiting(int rank) const;
     bool IsRWPendingOnRef(const Command& cmd) const;
     const Command& PendingRefCommand() const {return refresh_q_.front(); }
     void BankNeedRefresh(int rank, int bankgroup, int bank, bool need);
     void RankNeedRefresh(int rank, bool need);
+    // DDR5 same bank refresh of bank in all bankgroups of the rank
+    void SameBankNeedRefresh(int rank, int bank, bool need);
+    // refresh management of a bank for RowHammer mitigation, see rowhammer.h
+    void BankNeedRFM(int rank, int bankgroup, int bank, bool need);
     int OpenRow(int rank, int bankgroup, int bank) const {
-        return bank_states_[rank][bankgroup][bank].OpenRow();
+        return open_rows_[BankIndex(rank, bankgroup, bank)];
     }
     int RowHitCount(int rank, int bankgroup, int bank) const {
-        return bank_states_[rank][bankgroup][bank].RowHitCount();
+        return row_hit_counts_[BankIndex(rank, bankgroup, bank)];
     };
+    // open rows of all banks in BankIndex order, -1 for closed banks
+    const std::vector<int>& OpenRows() const { return open_rows_; }
+    // opens or closes rows without going through commands, for banks that
+    // have no commands queued. Banks in self refresh stay closed and
+    // powered down banks stay powered down
+    void SetOpenRows(const std::vector<int>& rows);
+    // timing updates go through update kernels specialized per command type
+    // at compile time unless turned off, the generic walk over the Timing
+    // lists is kept for validation and benchmarking
+    void UseTimingKernels(bool use) { use_timing_kernels_ = use; }
+    // write/read the state to/from a checkpoint, see checkpoint.h
+    void Save(CheckpointWriter& writer) const;
+    void Restore(CheckpointReader& reader);
 
     std::vector<int> rank_idle_cycles;
 
@@ -42,43 +76,89 @@ class ChannelState {
     const Timing& timing_;
 
     std::vector<bool> rank_is_sref_;
-    std::vector<std::vector<std::vector<BankState> > > bank_states_;
+    std::vector<bool> rank_is_pd_;
     std::vector<Command> refresh_q_;
 
+    // Bank states as parallel arrays, the banks of the channel are flattened
+    // in (rank, bankgroup, bank) order, see BankIndex()
+    int num_banks_;
+    std::vector<BankState> bank_states_;
+    std::vector<int> open_rows_;
+    std::vector<int> row_hit_counts_;
+    // earliest cycle each command type can be issued to each bank. Command
+    // type major, so the banks a timing constraint applies to (a bankgroup,
+    // a rank, all other ranks...) are contiguous and updating them is a
+    // plain max over a range
+    std::vector<uint64_t> cmd_timing_;
+    // the command type that set each cmd_timing_ entry, the top bit is set
+    // if it was issued to the bank itself
+    std::vector<uint8_t> cmd_timing_sources_;
+
+    // per command type kernel, nullptr if the Timing lists of the command
+    // don't match the compiled in constraint table
+    typedef void (ChannelState::*TimingKernel)(const Address&, uint64_t);
+    std::vector<TimingKernel> timing_kernels_;
+    // the Timing lists as dense [scope][command][constrained command] delays
+    std::vector<int> delays_;
+    bool use_timing_kernels_;
+    void InitTimingKernels();
+    template <CommandType C, bool kPPD>
+    void BankTimingKernel(const Address& addr, uint64_t clk);
+    template <CommandType C>
+    void RankTimingKernel(const Address& addr, uint64_t clk);
+
+    int BankIndex(int rank, int bankgroup, int bank) const {
+        return rank * config_.banks + bankgroup * config_.banks_per_group +
+               bank;
+    }
+    uint64_t CmdTiming(CommandType cmd_type, int bank_idx) const {
+        return cmd_timing_[static_cast<int>(cmd_type) * num_banks_ + bank_idx];
+    }
+    // readiness of cmd_type in one bank, either cmd_type itself or the
+    // command that has to come first
+    Command GetReadyBankCommand(int bank_idx, const Command& cmd,
+                                uint64_t clk) const;
+    // raise the timing constraints of banks [first_bank, last_bank)
+    void UpdateBanksTiming(
+        int first_bank, int last_bank,
+        const std::vector<std::pair<CommandType, int> >& cmd_timing_list,
+        uint64_t clk, uint8_t source);
+
     std::vector<std::vector<uint64_t> > four_aw_;
     std::vector<std::vector<uint64_t> > thirty_two_aw_;
     bool IsFAWReady(int rank, uint64_t curr_time) const;
     bool Is32AWReady(int rank, uint64_t curr_time) const;
+    uint64_t ActivationWindowReadyCycle(int rank) const;
     // Update timing of the bank the command corresponds to
     void UpdateSameBankTiming(
         const Address& addr,
         const std::vector<std::pair<CommandType, int> >& cmd_timing_list,
-        uint64_t clk);
+        uint64_t clk, uint8_t source);
 
     // Update timing of the other banks in the same bankgroup as the command
     void UpdateOtherBanksSameBankgroupTiming(
         const Address& addr,
         const std::vector<std::pair<CommandType, int> >& cmd_timing_list,
-        uint64_t clk);
+        uint64_t clk, uint8_t source);
 
     // Update timing of banks in the same rank but different bankgroup as the
     // command
     void UpdateOtherBankgroupsSameRankTiming(
         const Address& addr,
         const std::vector<std::pair<CommandType, int> >& cmd_timing_list,
-        uint64_t clk);
+        uint64_t clk, uint8_t source);
 
     // Update timing of banks in a different rank as the command
     void UpdateOtherRanksTiming(
         const Address& addr,
         const std::vector<std::pair<CommandType, int> >& cmd_timing_list,
-        uint64_t clk);
+        uint64_t clk, uint8_t source);
 
     // Update timing of the entire rank (for rank level commands)
     void UpdateSameRankTiming(
         const Address& addr,
         const std::vector<std::pair<CommandType, int> >& cmd_timing_list,
-        uint64_t clk);
+        uint64_t clk, uint8_t source);
 };
 
 }  // namespace dramsim3
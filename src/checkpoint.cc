@@ -0,0 +1,240 @@
+#include "checkpoint.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+namespace dramsim3 {
+
+namespace {
+
+const char kMagic[4] = {'D', 'S', '3', 'C'};
+const uint32_t kVersion = 4;
+
+}  // namespace
+
+CheckpointWriter::CheckpointWriter(const std::string& file_name,
+                                   const std::string& layout)
+    : file_name_(file_name),
+      file_(file_name, std::ofstream::out | std::ofstream::binary) {
+    if (!file_) {
+        std::cerr << "Cannot open checkpoint " << file_name << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    Write(kMagic, sizeof(kMagic));
+    Put(kVersion);
+    Put(layout);
+}
+
+void CheckpointWriter::Put(const std::string& str) {
+    Put(static_cast<uint64_t>(str.size()));
+    Write(str.data(), str.size());
+    return;
+}
+
+void CheckpointWriter::Put(const Address& addr) {
+    Put(addr.channel);
+    Put(addr.rank);
+    Put(addr.bankgroup);
+    Put(addr.bank);
+    Put(addr.row);
+    Put(addr.column);
+    return;
+}
+
+void CheckpointWriter::Put(const Command& cmd) {
+    Put(cmd.cmd_type);
+    Put(cmd.addr);
+    Put(cmd.hex_addr);
+    Put(cmd.source_id);
+    Put(cmd.priority);
+    return;
+}
+
+void CheckpointWriter::Put(const Transaction& trans) {
+    Put(trans.addr);
+    Put(trans.added_cycle);
+    Put(trans.complete_cycle);
+    Put(trans.is_write);
+    Put(trans.source_id);
+    Put(trans.priority);
+    Put(trans.req_id);
+    Put(trans.issue_cycle);
+    Put(trans.dram_addr);
+    Put(trans.queue_idx);
+    return;
+}
+
+void CheckpointWriter::Put(const std::vector<bool>& vals) {
+    Put(static_cast<uint64_t>(vals.size()));
+    for (bool val : vals) {
+        Put(val);
+    }
+    return;
+}
+
+void CheckpointWriter::Write(const void* data, size_t size) {
+    file_.write(static_cast<const char*>(data), size);
+    if (!file_) {
+        std::cerr << "Cannot write checkpoint " << file_name_ << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    return;
+}
+
+CheckpointReader::CheckpointReader(const std::string& file_name,
+                                   const std::string& layout)
+    : file_name_(file_name),
+      file_(file_name, std::ifstream::in | std::ifstream::binary) {
+    if (!file_) {
+        std::cerr << "Cannot open checkpoint " << file_name << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    file_.seekg(0, std::ifstream::end);
+    file_size_ = static_cast<uint64_t>(file_.tellg());
+    file_.seekg(0, std::ifstream::beg);
+    char magic[sizeof(kMagic)];
+    file_.read(magic, sizeof(magic));
+    if (!file_ || !std::equal(magic, magic + sizeof(magic), kMagic)) {
+        std::cerr << file_name << " is not a checkpoint" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    uint32_t version;
+    Get(version);
+    if (version != kVersion) {
+        std::cerr << "Checkpoint " << file_name << " has version " << version
+                  << ", expected " << kVersion << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    std::string saved_layout;
+    Get(saved_layout);
+    if (saved_layout != layout) {
+        std::cerr << "Checkpoint " << file_name
+                  << " was taken with another config" << std::endl
+                  << "  checkpoint: " << saved_layout << std::endl
+                  << "  config:     " << layout << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+}
+
+void CheckpointReader::Get(std::string& str) {
+    str.resize(GetSize());
+    if (!str.empty()) {
+        Read(&str[0], str.size());
+    }
+    return;
+}
+
+void CheckpointReader::Get(Address& addr) {
+    Get(addr.channel);
+    Get(addr.rank);
+    Get(addr.bankgroup);
+    Get(addr.bank);
+    Get(addr.row);
+    Get(addr.column);
+    return;
+}
+
+void CheckpointReader::Get(Command& cmd) {
+    Get(cmd.cmd_type);
+    Get(cmd.addr);
+    Get(cmd.hex_addr);
+    Get(cmd.source_id);
+    Get(cmd.priority);
+    return;
+}
+
+void CheckpointReader::Get(Transaction& trans) {
+    Get(trans.addr);
+    Get(trans.added_cycle);
+    Get(trans.complete_cycle);
+    Get(trans.is_write);
+    Get(trans.source_id);
+    Get(trans.priority);
+    Get(trans.req_id);
+    Get(trans.issue_cycle);
+    Get(trans.dram_addr);
+    Get(trans.queue_idx);
+    return;
+}
+
+void CheckpointReader::Get(std::vector<bool>& vals) {
+    vals.resize(GetSize());
+    for (size_t i = 0; i < vals.size(); i++) {
+        bool val;
+        Get(val);
+        vals[i] = val;
+    }
+    return;
+}
+
+void CheckpointReader::Section(const std::string& name) {
+    std::string saved_name;
+    Get(saved_name);
+    if (saved_name != name) {
+        std::cerr << "Checkpoint " << file_name_ << " has " << saved_name
+                  << " state where " << name << " state was expected"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    return;
+}
+
+void CheckpointReader::Read(void* data, size_t size) {
+    file_.read(static_cast<char*>(data), size);
+    if (!file_) {
+        std::cerr << "Checkpoint " << file_name_ << " is truncated"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    return;
+}
+
+uint64_t CheckpointReader::GetSize() {
+    uint64_t size;
+    Get(size);
+    // a size beyond the file means a corrupted checkpoint, don't try to
+    // allocate it
+    if (size > file_size_ - static_cast<uint64_t>(file_.tellg())) {
+        std::cerr << "Checkpoint " << file_name_
+                  << " is truncated or corrupted" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    return size;
+}
+
+std::string CheckpointLayout(const Config& config) {
+    std::stringstream layout;
+    layout << "protocol=" << static_cast<int>(config.protocol)
+           << " channels=" << config.channels << " ranks=" << config.ranks
+           << " bankgroups=" << config.bankgroups
+           << " banks_per_group=" << config.banks_per_group
+           << " address_mapping=" << config.address_mapping
+           << " queue_structure=" << config.queue_structure
+           << " cmd_queue_size=" << config.cmd_queue_size
+           << " unified_queue=" << config.unified_queue
+           << " trans_queue_size=" << config.trans_queue_size
+           << " write_buf_size=" << config.write_buf_size
+           << " scheduler=" << config.scheduler
+           << " qos_sources=" << config.qos_sources
+           << " row_buf_policy=" << config.row_buf_policy
+           << " refresh_policy=" << static_cast<int>(config.refresh_policy)
+           << " refresh_granularity=" << config.refresh_granularity;
+    if (config.rowhammer_mitigation != "NONE") {
+        layout << " rowhammer_mitigation=" << config.rowhammer_mitigation
+               << " rh_tracker=" << config.rh_tracker
+               << " rh_table_entries=" << config.rh_table_entries
+               << " rh_cms_hashes=" << config.rh_cms_hashes;
+    }
+    if (config.prefetcher != "NONE") {
+        layout << " prefetcher=" << config.prefetcher
+               << " prefetch_buffer_size=" << config.prefetch_buffer_size;
+    }
+    if (config.IsHMC()) {
+        layout << " num_links=" << config.num_links
+               << " xbar_queue_depth=" << config.xbar_queue_depth;
+    }
+    return layout.str();
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,142 @@
+#ifndef __CHECKPOINT_H
+#define __CHECKPOINT_H
+
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+#include "configuration.h"
+
+namespace dramsim3 {
+
+// Binary checkpoints of a memory system, see MemorySystem::SaveCheckpoint.
+// A checkpoint starts with a magic, a version and the layout of the config
+// it was taken with (see CheckpointLayout), then every component writes its
+// state in construction order, each one behind a section name so that a
+// stream that gets out of step stops at the component that caused it.
+// Values are written in host byte order, checkpoints are meant to be
+// restored by the same build on the same machine.
+//
+// Plain values (trivially copyable types) are written as they are in
+// memory, vectors and maps as their size followed by their elements.
+// Address, Command and Transaction are plain but written field by field,
+// so that padding doesn't end up in the checkpoint
+template <typename T>
+struct IsPlainCheckpointValue
+    : std::integral_constant<bool, std::is_trivially_copyable<T>::value> {};
+template <>
+struct IsPlainCheckpointValue<Address> : std::false_type {};
+template <>
+struct IsPlainCheckpointValue<Command> : std::false_type {};
+template <>
+struct IsPlainCheckpointValue<Transaction> : std::false_type {};
+
+class CheckpointWriter {
+   public:
+    CheckpointWriter(const std::string& file_name, const std::string& layout);
+
+    template <typename T>
+    void Put(const T& val) {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "no checkpoint format for this type");
+        Write(&val, sizeof(T));
+    }
+    void Put(const std::string& str);
+    void Put(const Address& addr);
+    void Put(const Command& cmd);
+    void Put(const Transaction& trans);
+    void Put(const std::vector<bool>& vals);
+    template <typename T>
+    void Put(const std::vector<T>& vals) {
+        Put(static_cast<uint64_t>(vals.size()));
+        for (const auto& val : vals) {
+            Put(val);
+        }
+    }
+    template <typename K, typename V>
+    void Put(const std::unordered_map<K, V>& vals) {
+        Put(static_cast<uint64_t>(vals.size()));
+        for (const auto& it : vals) {
+            Put(it.first);
+            Put(it.second);
+        }
+    }
+    // starts the state of a component
+    void Section(const std::string& name) { Put(name); }
+
+   private:
+    std::string file_name_;
+    std::ofstream file_;
+    void Write(const void* data, size_t size);
+};
+
+class CheckpointReader {
+   public:
+    // exits if the file is no checkpoint or was taken with another layout
+    CheckpointReader(const std::string& file_name, const std::string& layout);
+
+    template <typename T>
+    void Get(T& val) {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "no checkpoint format for this type");
+        Read(&val, sizeof(T));
+    }
+    void Get(std::string& str);
+    void Get(Address& addr);
+    void Get(Command& cmd);
+    void Get(Transaction& trans);
+    void Get(std::vector<bool>& vals);
+    template <typename T>
+    void Get(std::vector<T>& vals) {
+        uint64_t size = GetSize();
+        vals.clear();
+        vals.reserve(size);
+        for (uint64_t i = 0; i < size; i++) {
+            vals.push_back(GetElement<T>(IsPlainCheckpointValue<T>()));
+        }
+    }
+    template <typename K, typename V>
+    void Get(std::unordered_map<K, V>& vals) {
+        uint64_t size = GetSize();
+        vals.clear();
+        for (uint64_t i = 0; i < size; i++) {
+            K key;
+            Get(key);
+            Get(vals[key]);
+        }
+    }
+    // exits unless the state of component name comes next
+    void Section(const std::string& name);
+
+   private:
+    std::string file_name_;
+    std::ifstream file_;
+    uint64_t file_size_;
+    void Read(void* data, size_t size);
+    uint64_t GetSize();
+    // plain types need not be default constructible (e.g. HMC packets)
+    template <typename T>
+    T GetElement(std::true_type) {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+        Read(&storage, sizeof(T));
+        return *reinterpret_cast<T*>(&storage);
+    }
+    template <typename T>
+    T GetElement(std::false_type) {
+        T val;
+        Get(val);
+        return val;
+    }
+};
+
+// the config parameters that shape the state of a memory system, a
+// checkpoint can only be restored into a memory system built with the same
+// layout. Timing and power parameters may differ.
+std::string CheckpointLayout(const Config& config);
+
+}  // namespace dramsim3
+#endif
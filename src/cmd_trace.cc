@@ -0,0 +1,283 @@
+#include "cmd_trace.h"
+#include <string.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif  // HAVE_ZLIB
+
+namespace dramsim3 {
+
+namespace {
+
+void StoreLE(uint8_t* p, uint64_t val, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = static_cast<uint8_t>(val >> (8 * i));
+    }
+}
+
+uint64_t LoadLE(const uint8_t* p, int bytes) {
+    uint64_t val = 0;
+    for (int i = 0; i < bytes; i++) {
+        val |= static_cast<uint64_t>(p[i]) << (8 * i);
+    }
+    return val;
+}
+
+// false if the varint runs past end
+bool ReadVarint(const uint8_t*& cur, const uint8_t* end, uint64_t& val) {
+    val = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (cur == end) {
+            return false;
+        }
+        uint8_t byte = *cur++;
+        val |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CorruptedBlock() {
+    std::cerr << "Command trace block is corrupted" << std::endl;
+    AbruptExit(__FILE__, __LINE__);
+}
+
+}  // namespace
+
+CommandTraceWriter::CommandTraceWriter(const std::string& file_name,
+                                       bool compress, bool text)
+    : file_name_(file_name),
+      compress_(compress && !text),
+      text_(text),
+      num_commands_(0),
+      last_clk_(0) {
+#ifndef HAVE_ZLIB
+    if (compress_) {
+        std::cerr << "Built without zlib, cannot compress " << file_name
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+#endif  // HAVE_ZLIB
+    file_ = fopen(file_name.c_str(), "wb");
+    if (file_ == nullptr) {
+        std::cerr << "Cannot open " << file_name << " for writing"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    // a command takes 8 bytes or so
+    block_.reserve(kCommandTraceBlockCommands * 8);
+    if (text_) {
+        return;
+    }
+    uint8_t header[kCommandTraceHeaderSize];
+    memcpy(header, kCommandTraceMagic, 4);
+    StoreLE(header + 4, kCommandTraceVersion, 4);
+    StoreLE(header + 8, compress_ ? kCommandTraceCompressed : 0, 4);
+    fwrite(header, 1, sizeof(header), file_);
+}
+
+CommandTraceWriter::~CommandTraceWriter() {
+    FlushBlock();
+    if (fclose(file_) != 0) {
+        std::cerr << "Cannot write " << file_name_ << std::endl;
+    }
+}
+
+void CommandTraceWriter::WriteVarint(uint64_t val) {
+    while (val >= 0x80) {
+        block_.push_back(static_cast<uint8_t>(val) | 0x80);
+        val >>= 7;
+    }
+    block_.push_back(static_cast<uint8_t>(val));
+}
+
+void CommandTraceWriter::Write(int channel, const Command& cmd,
+                               uint64_t clk) {
+    if (text_) {
+        std::ostringstream line;
+        line << std::left << std::setw(18) << clk << " " << cmd << "\n";
+        const std::string& str = line.str();
+        block_.insert(block_.end(), str.begin(), str.end());
+        if (++num_commands_ == kCommandTraceBlockCommands) {
+            FlushBlock();
+        }
+        return;
+    }
+    WriteVarint(num_commands_ == 0 ? clk : clk - last_clk_);
+    block_.push_back(static_cast<uint8_t>(cmd.cmd_type));
+    WriteVarint(static_cast<uint64_t>(channel));
+    WriteVarint(static_cast<uint64_t>(cmd.Rank()));
+    WriteVarint(static_cast<uint64_t>(cmd.Bankgroup()));
+    WriteVarint(static_cast<uint64_t>(cmd.Bank()));
+    WriteVarint(static_cast<uint64_t>(cmd.Row()));
+    WriteVarint(static_cast<uint64_t>(cmd.Column()));
+    last_clk_ = clk;
+    num_commands_++;
+    if (num_commands_ == kCommandTraceBlockCommands) {
+        FlushBlock();
+    }
+}
+
+void CommandTraceWriter::FlushBlock() {
+    if (num_commands_ == 0) {
+        return;
+    }
+    if (text_) {
+        if (fwrite(block_.data(), 1, block_.size(), file_) != block_.size()) {
+            std::cerr << "Cannot write " << file_name_ << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        block_.clear();
+        num_commands_ = 0;
+        return;
+    }
+    const std::vector<uint8_t>* payload = &block_;
+#ifdef HAVE_ZLIB
+    if (compress_) {
+        uLongf stored_size = compressBound(block_.size());
+        stored_.resize(stored_size);
+        if (compress2(stored_.data(), &stored_size, block_.data(),
+                      block_.size(), Z_BEST_SPEED) != Z_OK) {
+            std::cerr << "Cannot compress " << file_name_ << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        stored_.resize(stored_size);
+        payload = &stored_;
+    }
+#endif  // HAVE_ZLIB
+    uint8_t header[kCommandTraceBlockHeaderSize];
+    StoreLE(header, payload->size(), 4);
+    StoreLE(header + 4, block_.size(), 4);
+    StoreLE(header + 8, num_commands_, 4);
+    if (fwrite(header, 1, sizeof(header), file_) != sizeof(header) ||
+        fwrite(payload->data(), 1, payload->size(), file_) !=
+            payload->size()) {
+        std::cerr << "Cannot write " << file_name_ << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    block_.clear();
+    num_commands_ = 0;
+}
+
+CommandTraceReader::CommandTraceReader(const std::string& file_name)
+    : file_name_(file_name) {
+    file_ = fopen(file_name.c_str(), "rb");
+    if (file_ == nullptr) {
+        std::cerr << "Cannot open " << file_name << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    // large reads, the file is only read front to back
+    setvbuf(file_, nullptr, _IOFBF, 1 << 20);
+    uint8_t header[kCommandTraceHeaderSize];
+    if (fread(header, 1, sizeof(header), file_) != sizeof(header) ||
+        memcmp(header, kCommandTraceMagic, 4) != 0 ||
+        LoadLE(header + 4, 4) != kCommandTraceVersion) {
+        std::cerr << file_name << " is not a version "
+                  << kCommandTraceVersion << " command trace" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    compressed_ = (LoadLE(header + 8, 4) & kCommandTraceCompressed) != 0;
+#ifndef HAVE_ZLIB
+    if (compressed_) {
+        std::cerr << "Built without zlib, cannot read " << file_name
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+#endif  // HAVE_ZLIB
+}
+
+CommandTraceReader::~CommandTraceReader() { fclose(file_); }
+
+bool CommandTraceReader::NextBlock(CommandTraceBlock& block) {
+    uint8_t header[kCommandTraceBlockHeaderSize];
+    size_t len = fread(header, 1, sizeof(header), file_);
+    if (len == 0) {
+        return false;
+    }
+    if (len != sizeof(header)) {
+        std::cerr << "Command trace " << file_name_ << " is truncated"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    block.payload.resize(LoadLE(header, 4));
+    block.raw_size = static_cast<uint32_t>(LoadLE(header + 4, 4));
+    block.num_commands = static_cast<uint32_t>(LoadLE(header + 8, 4));
+    if (fread(block.payload.data(), 1, block.payload.size(), file_) !=
+        block.payload.size()) {
+        std::cerr << "Command trace " << file_name_ << " is truncated"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    return true;
+}
+
+bool CommandTraceReader::IsCommandTrace(const std::string& file_name) {
+    FILE* file = fopen(file_name.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    char magic[4];
+    bool is_trace = fread(magic, 1, 4, file) == 4 &&
+                    memcmp(magic, kCommandTraceMagic, 4) == 0;
+    fclose(file);
+    return is_trace;
+}
+
+void DecodeCommandBlock(const CommandTraceBlock& block, bool compressed,
+                        std::vector<TimedCommand>& cmds) {
+    const std::vector<uint8_t>* raw = &block.payload;
+#ifdef HAVE_ZLIB
+    std::vector<uint8_t> inflated;
+    if (compressed) {
+        inflated.resize(block.raw_size);
+        uLongf raw_size = block.raw_size;
+        if (uncompress(inflated.data(), &raw_size, block.payload.data(),
+                       block.payload.size()) != Z_OK ||
+            raw_size != block.raw_size) {
+            CorruptedBlock();
+        }
+        raw = &inflated;
+    }
+#else
+    if (compressed) {
+        CorruptedBlock();
+    }
+#endif  // HAVE_ZLIB
+    if (raw->size() != block.raw_size) {
+        CorruptedBlock();
+    }
+    const uint8_t* cur = raw->data();
+    const uint8_t* end = cur + raw->size();
+    cmds.resize(block.num_commands);
+    uint64_t clk = 0;
+    for (auto& timed_cmd : cmds) {
+        uint64_t delta, fields[6];
+        if (!ReadVarint(cur, end, delta) || cur == end) {
+            CorruptedBlock();
+        }
+        uint8_t type = *cur++;
+        for (auto& field : fields) {
+            if (!ReadVarint(cur, end, field)) {
+                CorruptedBlock();
+            }
+        }
+        if (type >= static_cast<uint8_t>(CommandType::SIZE)) {
+            CorruptedBlock();
+        }
+        clk += delta;
+        timed_cmd.clk = clk;
+        timed_cmd.cmd = Command(
+            static_cast<CommandType>(type),
+            Address(static_cast<int>(fields[0]), static_cast<int>(fields[1]),
+                    static_cast<int>(fields[2]), static_cast<int>(fields[3]),
+                    static_cast<int>(fields[4]), static_cast<int>(fields[5])),
+            0);
+    }
+    return;
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,86 @@
+#ifndef __CMD_TRACE_H
+#define __CMD_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "common.h"
+
+namespace dramsim3 {
+
+// Binary command trace of a channel, written by the controller with
+// cmd_trace = true and replayed by thermalreplay. All integers little endian:
+//   header:  "D3CT", uint32 version, uint32 flags (bit 0: zlib compressed)
+//   block:   uint32 stored size, uint32 raw size, uint32 number of commands,
+//            then the payload, deflated on its own if the trace is compressed
+//   command: varint clk delta, uint8 type, varint channel, rank, bankgroup,
+//            bank, row, column
+// The clk of the first command of a block is absolute, so that blocks can be
+// decoded independently of each other and on several threads.
+constexpr char kCommandTraceMagic[4] = {'D', '3', 'C', 'T'};
+constexpr uint32_t kCommandTraceVersion = 1;
+constexpr uint32_t kCommandTraceCompressed = 1;
+constexpr size_t kCommandTraceHeaderSize = 12;
+constexpr size_t kCommandTraceBlockHeaderSize = 12;
+constexpr uint32_t kCommandTraceBlockCommands = 1 << 16;
+
+struct TimedCommand {
+    uint64_t clk;
+    Command cmd;
+};
+
+// one block as it is stored in the trace file
+struct CommandTraceBlock {
+    std::vector<uint8_t> payload;
+    uint32_t raw_size;
+    uint32_t num_commands;
+};
+
+// Commands are buffered and written a block at a time, compression needs
+// a build with zlib (HAVE_ZLIB). A text trace has one "<clk> <command>" line
+// per command instead (CMD_TRACE builds, for the Verilog validation)
+class CommandTraceWriter {
+   public:
+    CommandTraceWriter(const std::string& file_name, bool compress,
+                       bool text = false);
+    ~CommandTraceWriter();
+    // channel is that of the controller, the address of commands such as
+    // the precharges before a refresh doesn't have it
+    void Write(int channel, const Command& cmd, uint64_t clk);
+
+   private:
+    std::string file_name_;
+    FILE* file_;
+    bool compress_;
+    bool text_;
+    std::vector<uint8_t> block_;
+    std::vector<uint8_t> stored_;
+    uint32_t num_commands_;
+    uint64_t last_clk_;
+    void WriteVarint(uint64_t val);
+    void FlushBlock();
+};
+
+class CommandTraceReader {
+   public:
+    CommandTraceReader(const std::string& file_name);
+    ~CommandTraceReader();
+    // reads the next block without decoding it, false at the end of the trace
+    bool NextBlock(CommandTraceBlock& block);
+    bool Compressed() const { return compressed_; }
+    // whether the file starts like a command trace, text traces don't
+    static bool IsCommandTrace(const std::string& file_name);
+
+   private:
+    std::string file_name_;
+    FILE* file_;
+    bool compressed_;
+};
+
+// inflates and decodes a block into cmds, exits on a corrupted block
+void DecodeCommandBlock(const CommandTraceBlock& block, bool compressed,
+                        std::vector<TimedCommand>& cmds);
+
+}  // namespace dramsim3
+#endif
@@ -1,14 +1,24 @@
 #include "command_queue.h"
 
+#include <algorithm>
+#include <limits>
+
 namespace dramsim3 {
 
-CommandQueue::CommandQueue(int channel_id, const Config& config,
+CommandQueue::CommandQueue(int, const Config& config,
                            const ChannelState& channel_state,
-                           SimpleStats& simple_stats)
+                           SimpleStats& simple_stats, Scheduler& scheduler,
+                           const RowPolicy& row_policy)
     : rank_q_empty(config.ranks, true),
       config_(config),
       channel_state_(channel_state),
       simple_stats_(simple_stats),
+      num_ondemand_pres_(simple_stats.GetCounterId("num_ondemand_pres")),
+      num_policy_closes_(simple_stats.GetCounterId("num_policy_closes")),
+      scheduler_(scheduler),
+      row_policy_(row_policy),
+      stall_reason_(StallReason::EMPTY),
+      stall_reason_until_(0),
       is_in_ref_(false),
       queue_size_(static_cast<size_t>(config_.cmd_queue_size)),
       queue_idx_(0),
@@ -25,6 +35,9 @@ CommandQueue::CommandQueue(int channel_id, const Config& config,
         AbruptExit(__FILE__, __LINE__);
     }
 
+    queue_ready_cycles_.resize(num_queues_, 0);
+    QueueScan no_scan = {std::numeric_limits<uint64_t>::max(), 0, 0, false};
+    queue_scans_.resize(num_queues_, no_scan);
     queues_.reserve(num_queues_);
     for (int i = 0; i < num_queues_; i++) {
         auto cmd_queue = std::vector<Command>();
@@ -34,6 +47,10 @@ CommandQueue::CommandQueue(int channel_id, const Config& config,
 }
 
 Command CommandQueue::GetCommandToIssue() {
+    scheduler_.Update(queues_, clk_);
+    Command best_cmd;
+    int best_rank = 0;
+    int best_idx = queue_idx_;
     for (int i = 0; i < num_queues_; i++) {
         auto& queue = GetNextQueue();
         // if we're refresing, skip the command queues that are involved
@@ -42,15 +59,40 @@ Command CommandQueue::GetCommandToIssue() {
                 continue;
             }
         }
-        auto cmd = GetFirstReadyInQueue(queue);
-        if (cmd.IsValid()) {
-            if (cmd.IsReadWrite()) {
-                EraseRWCommand(cmd);
+        // nothing in this queue can be issued yet
+        if (clk_ < queue_ready_cycles_[queue_idx_]) {
+            continue;
+        }
+        int rank;
+        auto cmd = GetFirstReadyInQueue(queue, queue_ready_cycles_[queue_idx_],
+                                        queue_scans_[queue_idx_], rank);
+        // other banks of the rank could keep a per bank refresh from ever
+        // meeting ACT to REFb timing, so their ACTs wait for it
+        if (cmd.IsValid() && is_in_ref_ &&
+            cmd.cmd_type == CommandType::ACTIVATE &&
+            cmd.Rank() == channel_state_.PendingRefCommand().Rank()) {
+            continue;
+        }
+        if (cmd.IsValid() && (!best_cmd.IsValid() || rank < best_rank)) {
+            best_cmd = cmd;
+            best_rank = rank;
+            best_idx = queue_idx_;
+            if (rank == 0) {
+                break;
             }
-            return cmd;
         }
     }
-    return Command();
+    if (best_cmd.IsValid()) {
+        // round robin goes on from the queue that got to issue
+        queue_idx_ = best_idx;
+        if (best_cmd.cmd_type == CommandType::PRECHARGE) {
+            simple_stats_.Increment(num_ondemand_pres_);
+        } else if (best_cmd.IsReadWrite()) {
+            EraseRWCommand(best_cmd);
+            best_cmd = ApplyRowPolicy(best_cmd);
+        }
+    }
+    return best_cmd;
 }
 
 Command CommandQueue::FinishRefresh() {
@@ -99,23 +141,17 @@ bool CommandQueue::ArbitratePrecharge(const CMDIterator& cmd_it,
         }
     }
 
-    bool rowhit_limit_reached =
-        channel_state_.RowHitCount(cmd.Rank(), cmd.Bankgroup(), cmd.Bank()) >=
-        4;
-    if (!pending_row_hits_exist || rowhit_limit_reached) {
-        simple_stats_.Increment("num_ondemand_pres");
-        return true;
-    }
-    return false;
+    bool rowhit_limit_reached = scheduler_.RowHitCapReached(
+        channel_state_.RowHitCount(cmd.Rank(), cmd.Bankgroup(), cmd.Bank()));
+    return !pending_row_hits_exist || rowhit_limit_reached;
 }
 
 bool CommandQueue::WillAcceptCommand(int rank, int bankgroup, int bank) const {
-    int q_idx = GetQueueIndex(rank, bankgroup, bank);
-    return queues_[q_idx].size() < queue_size_;
+    return WillAcceptCommand(GetQueueIndex(rank, bankgroup, bank));
 }
 
 bool CommandQueue::QueueEmpty() const {
-    for (const auto q : queues_) {
+    for (const auto& q : queues_) {
         if (!q.empty()) {
             return false;
         }
@@ -128,6 +164,9 @@ bool CommandQueue::AddCommand(Command cmd) {
     auto& queue = GetQueue(cmd.Rank(), cmd.Bankgroup(), cmd.Bank());
     if (queue.size() < queue_size_) {
         queue.push_back(cmd);
+        queue_ready_cycles_[GetQueueIndex(cmd.Rank(), cmd.Bankgroup(),
+                                          cmd.Bank())] = 0;
+        stall_reason_until_ = 0;
         rank_q_empty[cmd.Rank()] = false;
         return true;
     } else {
@@ -135,6 +174,62 @@ bool CommandQueue::AddCommand(Command cmd) {
     }
 }
 
+bool CommandQueue::HasCommandsToBank(int rank, int bankgroup,
+                                     int bank) const {
+    const auto& queue = queues_[GetQueueIndex(rank, bankgroup, bank)];
+    if (queue_structure_ == QueueStructure::PER_BANK) {
+        return !queue.empty();
+    }
+    for (const auto& cmd : queue) {
+        if (cmd.Bankgroup() == bankgroup && cmd.Bank() == bank) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CommandQueue::HasCommandsToRank(int rank) const {
+    int first = GetQueueIndex(rank, 0, 0);
+    int last = queue_structure_ == QueueStructure::PER_RANK
+                   ? first + 1
+                   : first + config_.banks;
+    for (int i = first; i < last; i++) {
+        if (!queues_[i].empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Command CommandQueue::ApplyRowPolicy(const Command& cmd) {
+    if (cmd.cmd_type != CommandType::READ &&
+        cmd.cmd_type != CommandType::WRITE) {
+        return cmd;
+    }
+    bool queued_hits = false;
+    for (const auto& queued : GetQueue(cmd.Rank(), cmd.Bankgroup(),
+                                       cmd.Bank())) {
+        if (queued.Row() == cmd.Row() && queued.Bank() == cmd.Bank() &&
+            queued.Bankgroup() == cmd.Bankgroup()) {
+            queued_hits = true;
+            break;
+        }
+    }
+    int row_hits =
+        channel_state_.RowHitCount(cmd.Rank(), cmd.Bankgroup(), cmd.Bank());
+    if (!row_policy_.ClosesRow(cmd, queued_hits, row_hits)) {
+        return cmd;
+    }
+    Command closing = cmd;
+    closing.cmd_type = cmd.IsRead() ? CommandType::READ_PRECHARGE
+                                    : CommandType::WRITE_PRECHARGE;
+    if (channel_state_.GetReadyType(closing, clk_) != closing.cmd_type) {
+        return cmd;
+    }
+    simple_stats_.Increment(num_policy_closes_);
+    return closing;
+}
+
 CMDQueue& CommandQueue::GetNextQueue() {
     queue_idx_++;
     if (queue_idx_ == num_queues_) {
@@ -154,6 +249,10 @@ void CommandQueue::GetRefQIndices(const Command& ref) {
         } else {
             ref_q_indices_.insert(ref.Rank());
         }
+    } else if (ref.cmd_type == CommandType::REFRESH_SAME_BANK) {
+        for (int g = 0; g < config_.bankgroups; g++) {
+            ref_q_indices_.insert(GetQueueIndex(ref.Rank(), g, ref.Bank()));
+        }
     } else {  // refb
         int idx = GetQueueIndex(ref.Rank(), ref.Bankgroup(), ref.Bank());
         ref_q_indices_.insert(idx);
@@ -175,24 +274,52 @@ CMDQueue& CommandQueue::GetQueue(int rank, int bankgroup, int bank) {
     return queues_[index];
 }
 
-Command CommandQueue::GetFirstReadyInQueue(CMDQueue& queue) const {
+Command CommandQueue::GetFirstReadyInQueue(CMDQueue& queue,
+                                           uint64_t& ready_cycle,
+                                           QueueScan& scan, int& rank) const {
+    Command best_cmd;
+    ready_cycle = std::numeric_limits<uint64_t>::max();
+    scan.cycle = clk_;
+    scan.wait_cycle = std::numeric_limits<uint64_t>::max();
+    scan.rw_dependency = false;
     for (auto cmd_it = queue.begin(); cmd_it != queue.end(); cmd_it++) {
-        Command cmd = channel_state_.GetReadyCommand(*cmd_it, clk_);
-        if (!cmd.IsValid()) {
+        uint64_t cmd_ready_cycle = channel_state_.GetReadyCycle(*cmd_it);
+        ready_cycle = std::min(ready_cycle, cmd_ready_cycle);
+        if (clk_ < cmd_ready_cycle) {
+            if (cmd_ready_cycle < scan.wait_cycle) {
+                scan.wait_cycle = cmd_ready_cycle;
+                scan.waiter = cmd_it - queue.begin();
+            }
+            continue;
+        }
+        CommandType ready_type = channel_state_.GetReadyType(*cmd_it, clk_);
+        if (ready_type == CommandType::SIZE) {
             continue;
         }
-        if (cmd.cmd_type == CommandType::PRECHARGE) {
+        if (ready_type == CommandType::PRECHARGE) {
             if (!ArbitratePrecharge(cmd_it, queue)) {
                 continue;
             }
-        } else if (cmd.IsWrite()) {
+        } else if (ready_type == CommandType::WRITE ||
+                   ready_type == CommandType::WRITE_PRECHARGE) {
             if (HasRWDependency(cmd_it, queue)) {
+                scan.rw_dependency = true;
                 continue;
             }
         }
-        return cmd;
+        Command cmd(ready_type, cmd_it->addr, cmd_it->hex_addr);
+        cmd.source_id = cmd_it->source_id;
+        cmd.priority = cmd_it->priority;
+        int cmd_rank = scheduler_.CommandRank(*cmd_it, cmd);
+        if (!best_cmd.IsValid() || cmd_rank < rank) {
+            best_cmd = cmd;
+            rank = cmd_rank;
+            if (rank == 0) {
+                break;
+            }
+        }
     }
-    return Command();
+    return best_cmd;
 }
 
 void CommandQueue::EraseRWCommand(const Command& cmd) {
@@ -207,6 +334,130 @@ void CommandQueue::EraseRWCommand(const Command& cmd) {
     exit(1);
 }
 
+uint64_t CommandQueue::QueueReadyCycle(const CMDQueue& queue,
+                                       size_t& first) const {
+    uint64_t ready_cycle = std::numeric_limits<uint64_t>::max();
+    first = 0;
+    for (size_t i = 0; i < queue.size(); i++) {
+        uint64_t cmd_ready_cycle = channel_state_.GetReadyCycle(queue[i]);
+        if (cmd_ready_cycle < ready_cycle) {
+            ready_cycle = cmd_ready_cycle;
+            first = i;
+        }
+    }
+    return ready_cycle;
+}
+
+uint64_t CommandQueue::NextReadyCycle() const {
+    uint64_t next_cycle = std::numeric_limits<uint64_t>::max();
+    size_t first;
+    for (int i = 0; i < num_queues_; i++) {
+        uint64_t ready_cycle = queue_ready_cycles_[i];
+        if (ready_cycle <= clk_) {
+            ready_cycle = QueueReadyCycle(queues_[i], first);
+        }
+        next_cycle = std::min(next_cycle, ready_cycle);
+    }
+    return std::max(next_cycle, clk_);
+}
+
+StallReason CommandQueue::GetStallReason() {
+    if (clk_ < stall_reason_until_) {
+        return stall_reason_;
+    }
+    // commands that meet their timing but still wait are held back behind
+    // others, so it's the first command that waits for timing
+    const Command* first_cmd = nullptr;
+    uint64_t first_cycle = std::numeric_limits<uint64_t>::max();
+    bool empty = true;
+    bool rw_dependency = false;
+    for (int i = 0; i < num_queues_; i++) {
+        const auto& queue = queues_[i];
+        if (queue.empty() || (is_in_ref_ && ref_q_indices_.count(i) > 0)) {
+            continue;
+        }
+        empty = false;
+        if (queue_ready_cycles_[i] > clk_) {
+            // only a lower bound, commands issued to other banks may have
+            // pushed the queue back since. The tighter one is still a bound
+            if (queue_ready_cycles_[i] < first_cycle) {
+                size_t first;
+                uint64_t ready_cycle = QueueReadyCycle(queue, first);
+                queue_ready_cycles_[i] = ready_cycle;
+                if (ready_cycle < first_cycle) {
+                    first_cycle = ready_cycle;
+                    first_cmd = &queue[first];
+                }
+            }
+            continue;
+        }
+        // commands of the queue meet their timing, GetCommandToIssue
+        // usually scanned it this cycle already
+        QueueScan& scan = queue_scans_[i];
+        if (scan.cycle != clk_ || queue_ready_cycles_[i] == 0) {
+            ScanQueue(queue, scan);
+        }
+        if (scan.wait_cycle < first_cycle) {
+            first_cycle = scan.wait_cycle;
+            first_cmd = &queue[scan.waiter];
+        }
+        rw_dependency = rw_dependency || scan.rw_dependency;
+    }
+    stall_reason_until_ = first_cycle;
+    stall_reason_ = StallReason::SIZE;
+    if (first_cmd != nullptr) {
+        stall_reason_ = channel_state_.BlockingReason(*first_cmd, clk_);
+    }
+    if (empty) {
+        stall_reason_ = StallReason::EMPTY;
+    } else if (stall_reason_ == StallReason::SIZE) {
+        stall_reason_ = rw_dependency ? StallReason::RW_DEPENDENCY
+                                      : StallReason::OTHER;
+    }
+    return stall_reason_;
+}
+
+void CommandQueue::ScanQueue(const CMDQueue& queue, QueueScan& scan) const {
+    scan.cycle = clk_;
+    scan.wait_cycle = std::numeric_limits<uint64_t>::max();
+    scan.rw_dependency = false;
+    for (auto cmd_it = queue.begin(); cmd_it != queue.end(); cmd_it++) {
+        uint64_t ready_cycle = channel_state_.GetReadyCycle(*cmd_it);
+        if (clk_ < ready_cycle) {
+            if (ready_cycle < scan.wait_cycle) {
+                scan.wait_cycle = ready_cycle;
+                scan.waiter = cmd_it - queue.begin();
+            }
+        } else if (!scan.rw_dependency && cmd_it->IsWrite() &&
+                   channel_state_.GetReadyType(*cmd_it, clk_) ==
+                       cmd_it->cmd_type) {
+            scan.rw_dependency = HasRWDependency(cmd_it, queue);
+        }
+    }
+    return;
+}
+
+void CommandQueue::InvalidateReadyCycles(const Command& cmd) {
+    stall_reason_until_ = 0;
+    if (cmd.IsRankCMD() || queue_structure_ == QueueStructure::PER_RANK) {
+        int first = GetQueueIndex(cmd.Rank(), 0, 0);
+        int last = queue_structure_ == QueueStructure::PER_RANK
+                       ? first + 1
+                       : first + config_.banks;
+        for (int i = first; i < last; i++) {
+            queue_ready_cycles_[i] = 0;
+        }
+    } else if (cmd.cmd_type == CommandType::REFRESH_SAME_BANK) {
+        for (int g = 0; g < config_.bankgroups; g++) {
+            queue_ready_cycles_[GetQueueIndex(cmd.Rank(), g, cmd.Bank())] = 0;
+        }
+    } else {
+        queue_ready_cycles_[GetQueueIndex(cmd.Rank(), cmd.Bankgroup(),
+                                          cmd.Bank())] = 0;
+    }
+    return;
+}
+
 int CommandQueue::QueueUsage() const {
     int usage = 0;
     for (auto i = queues_.begin(); i != queues_.end(); i++) {
@@ -215,7 +466,7 @@ int CommandQueue::QueueUsage() const {
     return usage;
 }
 
-bool CommandQueue::HasRWDependency(const CMDIterator& cmd_it,
+bool CommandQueue::HasRWDependency(const CMDQueue::const_iterator& cmd_it,
                                    const CMDQueue& queue) const {
     // Read after write has been checked in controller so we only
     // check write after read here
@@ -229,4 +480,40 @@ bool CommandQueue::HasRWDependency(const CMDIterator& cmd_it,
     return false;
 }
 
+void CommandQueue::Save(CheckpointWriter& writer) const {
+    writer.Section("command_queue");
+    writer.Put(rank_q_empty);
+    writer.Put(queues_);
+    writer.Put(queue_ready_cycles_);
+    // sorted so that equal states give equal checkpoints
+    std::vector<int> ref_q_indices(ref_q_indices_.begin(),
+                                   ref_q_indices_.end());
+    std::sort(ref_q_indices.begin(), ref_q_indices.end());
+    writer.Put(ref_q_indices);
+    writer.Put(is_in_ref_);
+    writer.Put(queue_idx_);
+    writer.Put(clk_);
+    return;
+}
+
+void CommandQueue::Restore(CheckpointReader& reader) {
+    reader.Section("command_queue");
+    reader.Get(rank_q_empty);
+    reader.Get(queues_);
+    // the queues keep the capacity they are built with
+    for (auto& queue : queues_) {
+        queue.reserve(queue_size_);
+    }
+    reader.Get(queue_ready_cycles_);
+    std::vector<int> ref_q_indices;
+    reader.Get(ref_q_indices);
+    ref_q_indices_.clear();
+    ref_q_indices_.insert(ref_q_indices.begin(), ref_q_indices.end());
+    reader.Get(is_in_ref_);
+    reader.Get(queue_idx_);
+    reader.Get(clk_);
+    stall_reason_until_ = 0;
+    return;
+}
+
 }  // namespace dramsim3
@@ -6,6 +6,8 @@
 #include "channel_state.h"
 #include "common.h"
 #include "configuration.h"
+#include "row_policy.h"
+#include "scheduler.h"
 #include "simple_stats.h"
 
 namespace dramsim3 {
@@ -17,35 +19,88 @@ enum class QueueStructure { PER_RANK, PER_BANK, SIZE };
 class CommandQueue {
    public:
     CommandQueue(int channel_id, const Config& config,
-                 const ChannelState& channel_state, SimpleStats& simple_stats);
+                 const ChannelState& channel_state, SimpleStats& simple_stats,
+                 Scheduler& scheduler, const RowPolicy& row_policy);
     Command GetCommandToIssue();
     Command FinishRefresh();
     void ClockTick() { clk_ += 1; };
+    void SkipCycles(uint64_t cycles) { clk_ += cycles; }
+    // earliest cycle any of the queued commands could become issuable
+    uint64_t NextReadyCycle() const;
+    // why nothing queued could be issued this cycle (EMPTY if nothing is),
+    // judged by the first command that waits for its timing constraints
+    StallReason GetStallReason();
+    // drop the cached ready cycles of the queues whose commands may need a
+    // different command after cmd was issued (i.e. bank/rank state changed)
+    void InvalidateReadyCycles(const Command& cmd);
     bool WillAcceptCommand(int rank, int bankgroup, int bank) const;
+    bool WillAcceptCommand(int queue_idx) const {
+        return queues_[queue_idx].size() < queue_size_;
+    }
     bool AddCommand(Command cmd);
+    bool HasCommandsToBank(int rank, int bankgroup, int bank) const;
+    bool HasCommandsToRank(int rank) const;
     bool QueueEmpty() const;
     int QueueUsage() const;
+    int NumQueues() const { return num_queues_; }
+    int GetQueueIndex(int rank, int bankgroup, int bank) const;
+    // write/read the queued commands to/from a checkpoint, see checkpoint.h
+    void Save(CheckpointWriter& writer) const;
+    void Restore(CheckpointReader& reader);
     std::vector<bool> rank_q_empty;
 
    private:
+    // what a scan of a queue found for the stall reasons
+    struct QueueScan {
+        uint64_t cycle;
+        // earliest ready cycle of the commands that wait for timing and
+        // the index of the first of them
+        uint64_t wait_cycle;
+        size_t waiter;
+        // a WRITE that meets its timing waits for an older READ
+        bool rw_dependency;
+    };
+
     bool ArbitratePrecharge(const CMDIterator& cmd_it,
                             const CMDQueue& queue) const;
-    bool HasRWDependency(const CMDIterator& cmd_it,
+    bool HasRWDependency(const CMDQueue::const_iterator& cmd_it,
                          const CMDQueue& queue) const;
-    Command GetFirstReadyInQueue(CMDQueue& queue) const;
-    int GetQueueIndex(int rank, int bankgroup, int bank) const;
+    // best ranked ready command of the queue and its rank, also computes
+    // the ready cycle bound of the queue and its scan if nothing is found
+    Command GetFirstReadyInQueue(CMDQueue& queue, uint64_t& ready_cycle,
+                                 QueueScan& scan, int& rank) const;
+    // the scan without looking for a command to issue
+    void ScanQueue(const CMDQueue& queue, QueueScan& scan) const;
     CMDQueue& GetQueue(int rank, int bankgroup, int bank);
     CMDQueue& GetNextQueue();
     void GetRefQIndices(const Command& ref);
     void EraseRWCommand(const Command& cmd);
+    // READ/WRITE that is issued as its auto-precharge variant if the row
+    // policy decides to close the row and the timing allows it
+    Command ApplyRowPolicy(const Command& cmd);
     Command PrepRefCmd(const CMDIterator& it, const Command& ref) const;
+    // also gives the index of the command that is ready first
+    uint64_t QueueReadyCycle(const CMDQueue& queue, size_t& first) const;
 
     QueueStructure queue_structure_;
     const Config& config_;
     const ChannelState& channel_state_;
     SimpleStats& simple_stats_;
+    CounterId num_ondemand_pres_;
+    CounterId num_policy_closes_;
+    Scheduler& scheduler_;
+    const RowPolicy& row_policy_;
 
     std::vector<CMDQueue> queues_;
+    // per queue lower bound of the cycle any of its commands can be issued,
+    // timing constraints only ever move forward so the bound stays valid
+    // until a bank state changes or a command is added
+    std::vector<uint64_t> queue_ready_cycles_;
+    // the last stall reason holds until a command is added or issued, or
+    // until the command it was judged by meets its timing
+    StallReason stall_reason_;
+    uint64_t stall_reason_until_;
+    std::vector<QueueScan> queue_scans_;
 
     // Refresh related data structures
     std::unordered_set<int> ref_q_indices_;
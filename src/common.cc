@@ -18,6 +18,10 @@ std::ostream& operator<<(std::ostream& os, const Command& cmd) {
         "refresh",
         "self_refresh_enter",
         "self_refresh_exit",
+        "power_down_enter",
+        "power_down_exit",
+        "refresh_same_bank",
+        "refresh_management",
         "WRONG"};
     os << fmt::format("{:<20} {:>3} {:>3} {:>3} {:>3} {:>#8x} {:>#8x}",
                       command_string[static_cast<int>(cmd.cmd_type)],
@@ -26,18 +30,29 @@ std::ostream& operator<<(std::ostream& os, const Command& cmd) {
     return os;
 }
 
+std::string StallReasonName(StallReason reason) {
+    static const std::vector<std::string> names = {
+        "refresh", "empty", "trcd",  "trp",           "tras", "tccd",
+        "twtr",    "tfaw",  "power", "rw_dependency", "other"};
+    return names[static_cast<int>(reason)];
+}
+
 std::ostream& operator<<(std::ostream& os, const Transaction& trans) {
     const std::string trans_type = trans.is_write ? "WRITE" : "READ";
     os << fmt::format("{:<30} {:>8}", trans.addr, trans_type);
     return os;
 }
 
+bool IsWriteOp(const std::string& mem_op) {
+    static const std::unordered_set<std::string> write_types = {
+        "WRITE", "write", "P_MEM_WR", "BOFF"};
+    return write_types.count(mem_op) == 1;
+}
+
 std::istream& operator>>(std::istream& is, Transaction& trans) {
-    std::unordered_set<std::string> write_types = {"WRITE", "write", "P_MEM_WR",
-                                                   "BOFF"};
     std::string mem_op;
     is >> std::hex >> trans.addr >> mem_op >> std::dec >> trans.added_cycle;
-    trans.is_write = write_types.count(mem_op) == 1;
+    trans.is_write = IsWriteOp(mem_op);
     return is;
 }
 
@@ -3,33 +3,30 @@
 
 #include <stdint.h>
 #include <iostream>
+#include <type_traits>
 #include <vector>
 
 namespace dramsim3 {
 
+// Address, Command and Transaction are trivially copyable and packed, the
+// command queues copy them around a lot. Config makes sure the coordinates
+// fit, -1 stands for none
 struct Address {
     Address()
-        : channel(-1), rank(-1), bankgroup(-1), bank(-1), row(-1), column(-1) {}
+        : row(-1), channel(-1), column(-1), rank(-1), bankgroup(-1), bank(-1) {}
     Address(int channel, int rank, int bankgroup, int bank, int row, int column)
-        : channel(channel),
-          rank(rank),
-          bankgroup(bankgroup),
-          bank(bank),
-          row(row),
-          column(column) {}
-    Address(const Address& addr)
-        : channel(addr.channel),
-          rank(addr.rank),
-          bankgroup(addr.bankgroup),
-          bank(addr.bank),
-          row(addr.row),
-          column(addr.column) {}
-    int channel;
-    int rank;
-    int bankgroup;
-    int bank;
-    int row;
-    int column;
+        : row(row),
+          channel(static_cast<int16_t>(channel)),
+          column(static_cast<int16_t>(column)),
+          rank(static_cast<int8_t>(rank)),
+          bankgroup(static_cast<int8_t>(bankgroup)),
+          bank(static_cast<int8_t>(bank)) {}
+    int32_t row;
+    int16_t channel;
+    int16_t column;
+    int8_t rank;
+    int8_t bankgroup;
+    int8_t bank;
 };
 
 inline uint32_t ModuloWidth(uint64_t addr, uint32_t bit_width, uint32_t pos) {
@@ -48,10 +45,12 @@ template <typename Out>
 void StringSplit(const std::string& s, char delim, Out result);
 
 int LogBase2(int power_of_two);
+// whether a memory operation name in a trace stands for a write
+bool IsWriteOp(const std::string& mem_op);
 void AbruptExit(const std::string& file, int line);
 bool DirExist(std::string dir);
 
-enum class CommandType {
+enum class CommandType : uint8_t {
     READ,
     READ_PRECHARGE,
     WRITE,
@@ -62,19 +61,50 @@ enum class CommandType {
     REFRESH,
     SREF_ENTER,
     SREF_EXIT,
+    PD_ENTER,
+    PD_EXIT,
+    REFRESH_SAME_BANK,
+    // refresh management (DDR5 RFM) of one bank, refreshes the neighbours of
+    // the rows it got the most activations in
+    REFRESH_MANAGEMENT,
     SIZE
 };
 
+// what keeps a channel from issuing a command in a cycle, the stats count
+// the cycles of each as stall_<StallReasonName>_cycles
+enum class StallReason {
+    REFRESH,        // a refresh is pending, or tRFC after one
+    EMPTY,          // no commands queued
+    TRCD,           // ACT to READ/WRITE
+    TRP,            // PRE or auto precharge to ACT
+    TRAS,           // ACT/READ/WRITE to PRE and ACT to ACT of a bank (tRC)
+    TCCD,           // READ to READ and WRITE to WRITE
+    TWTR,           // WRITE to READ and READ to WRITE turnarounds
+    TFAW,           // ACT to ACT of other banks (tRRD) and tFAW/t32AW
+    POWER,          // power down and self refresh entry and exit
+    RW_DEPENDENCY,  // a WRITE waits for an older READ of its address
+    OTHER,          // commands the scheduler holds back
+    SIZE
+};
+
+std::string StallReasonName(StallReason reason);
+
 struct Command {
-    Command() : cmd_type(CommandType::SIZE), hex_addr(0) {}
+    Command()
+        : hex_addr(0), source_id(0), priority(0), cmd_type(CommandType::SIZE) {}
     Command(CommandType cmd_type, const Address& addr, uint64_t hex_addr)
-        : cmd_type(cmd_type), addr(addr), hex_addr(hex_addr) {}
-    // Command(const Command& cmd) {}
+        : hex_addr(hex_addr),
+          addr(addr),
+          source_id(0),
+          priority(0),
+          cmd_type(cmd_type) {}
 
     bool IsValid() const { return cmd_type != CommandType::SIZE; }
     bool IsRefresh() const {
         return cmd_type == CommandType::REFRESH ||
-               cmd_type == CommandType::REFRESH_BANK;
+               cmd_type == CommandType::REFRESH_BANK ||
+               cmd_type == CommandType::REFRESH_SAME_BANK ||
+               cmd_type == CommandType::REFRESH_MANAGEMENT;
     }
     bool IsRead() const {
         return cmd_type == CommandType::READ ||
@@ -88,11 +118,17 @@ struct Command {
     bool IsRankCMD() const {
         return cmd_type == CommandType::REFRESH ||
                cmd_type == CommandType::SREF_ENTER ||
-               cmd_type == CommandType::SREF_EXIT;
+               cmd_type == CommandType::SREF_EXIT ||
+               cmd_type == CommandType::PD_ENTER ||
+               cmd_type == CommandType::PD_EXIT;
     }
-    CommandType cmd_type;
-    Address addr;
     uint64_t hex_addr;
+    Address addr;
+    // requester the command is issued for and the priority of its request,
+    // used by fairness and QoS schedulers
+    int source_id;
+    int priority;
+    CommandType cmd_type;
 
     int Channel() const { return addr.channel; }
     int Rank() const { return addr.rank; }
@@ -105,25 +141,40 @@ struct Command {
 };
 
 struct Transaction {
-    Transaction() {}
+    Transaction() : issue_cycle(0), priority(0), queue_idx(-1) {}
     Transaction(uint64_t addr, bool is_write)
         : addr(addr),
           added_cycle(0),
           complete_cycle(0),
+          req_id(addr),
+          issue_cycle(0),
+          source_id(0),
+          priority(0),
+          queue_idx(-1),
           is_write(is_write) {}
-    Transaction(const Transaction& tran)
-        : addr(tran.addr),
-          added_cycle(tran.added_cycle),
-          complete_cycle(tran.complete_cycle),
-          is_write(tran.is_write) {}
     uint64_t addr;
     uint64_t added_cycle;
     uint64_t complete_cycle;
+    // handed back on completion, the address unless given
+    uint64_t req_id;
+    // memory system cycle the request was handed to the memory system
+    uint64_t issue_cycle;
+    // decoded address and command queue, set once the controller takes it
+    Address dram_addr;
+    int source_id;
+    // priority class of the request, 0 unless given
+    int priority;
+    int queue_idx;
     bool is_write;
 
     friend std::ostream& operator<<(std::ostream& os, const Transaction& trans);
     friend std::istream& operator>>(std::istream& is, Transaction& trans);
 };
 
+static_assert(std::is_trivially_copyable<Command>::value &&
+                  std::is_trivially_copyable<Transaction>::value,
+              "commands and transactions are copied as plain memory");
+static_assert(sizeof(Command) == 32, "two commands per cache line");
+
 }  // namespace dramsim3
 #endif
@@ -0,0 +1,58 @@
+#include "completion_queue.h"
+#include <algorithm>
+#include <limits>
+
+namespace dramsim3 {
+
+bool CompletionQueue::Later(const Entry& a, const Entry& b) {
+    if (a.trans.complete_cycle != b.trans.complete_cycle) {
+        return a.trans.complete_cycle > b.trans.complete_cycle;
+    }
+    return a.seq > b.seq;
+}
+
+void CompletionQueue::Push(const Transaction& trans) {
+    heap_.push_back(Entry{trans, next_seq_++});
+    std::push_heap(heap_.begin(), heap_.end(), Later);
+    return;
+}
+
+void CompletionQueue::PopDone(uint64_t clk, std::vector<Transaction>& done) {
+    while (!heap_.empty() && heap_.front().trans.complete_cycle <= clk) {
+        std::pop_heap(heap_.begin(), heap_.end(), Later);
+        done.push_back(heap_.back().trans);
+        heap_.pop_back();
+    }
+    return;
+}
+
+uint64_t CompletionQueue::NextCycle() const {
+    if (heap_.empty()) {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    return heap_.front().trans.complete_cycle;
+}
+
+void CompletionQueue::Save(CheckpointWriter& writer) const {
+    std::vector<Entry> sorted = heap_;
+    std::sort(sorted.begin(), sorted.end(),
+              [](const Entry& a, const Entry& b) { return Later(b, a); });
+    writer.Put(static_cast<uint64_t>(sorted.size()));
+    for (const auto& entry : sorted) {
+        writer.Put(entry.trans);
+    }
+    return;
+}
+
+void CompletionQueue::Restore(CheckpointReader& reader) {
+    std::vector<Transaction> transactions;
+    reader.Get(transactions);
+    heap_.clear();
+    next_seq_ = 0;
+    for (const auto& trans : transactions) {
+        Push(trans);
+    }
+    return;
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,46 @@
+#ifndef __COMPLETION_QUEUE_H
+#define __COMPLETION_QUEUE_H
+
+#include <stdint.h>
+#include <vector>
+#include "checkpoint.h"
+#include "common.h"
+
+namespace dramsim3 {
+
+// Completed transactions waiting for their complete_cycle, a binary min-heap
+// keyed by (complete_cycle, arrival order). Transactions done by a cycle are
+// popped in one pass in (complete_cycle, arrival) order, and the earliest
+// complete_cycle is known without a scan so that the event driven mode can
+// skip to it.
+class CompletionQueue {
+   public:
+    CompletionQueue() : next_seq_(0) {}
+    // trans.complete_cycle must be set
+    void Push(const Transaction& trans);
+    // appends the transactions with complete_cycle <= clk to done
+    void PopDone(uint64_t clk, std::vector<Transaction>& done);
+    // earliest complete_cycle, UINT64_MAX if there is none
+    uint64_t NextCycle() const;
+    size_t Size() const { return heap_.size(); }
+    bool Empty() const { return heap_.empty(); }
+    // stored as the list of transactions in completion order
+    void Save(CheckpointWriter& writer) const;
+    void Restore(CheckpointReader& reader);
+
+   private:
+    struct Entry {
+        Transaction trans;
+        uint64_t seq;
+    };
+
+    std::vector<Entry> heap_;
+    uint64_t next_seq_;
+
+    // whether a completes after b, the heap keeps the first to complete on
+    // top
+    static bool Later(const Entry& a, const Entry& b);
+};
+
+}  // namespace dramsim3
+#endif
@@ -1,5 +1,7 @@
 #include "configuration.h"
 
+#include <algorithm>
+#include <stdexcept>
 #include <vector>
 
 #ifdef THERMAL
@@ -8,13 +10,43 @@
 
 namespace dramsim3 {
 
+namespace {
+
+// an address bit mask given as value of [system] key, exits unless the
+// whole value is a number
+uint64_t ParseMask(const std::string& key, const std::string& value) {
+    size_t end = 0;
+    uint64_t mask = 0;
+    try {
+        mask = std::stoull(value, &end, 0);
+    } catch (const std::logic_error&) {
+        end = 0;
+    }
+    if (end == 0 || value.find_first_not_of(" \t", end) != std::string::npos) {
+        std::cerr << "Invalid address bit mask " << value << " for " << key
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    return mask;
+}
+
+}  // namespace
+
 Config::Config(std::string config_file, std::string out_dir)
     : output_dir(out_dir), reader_(new INIReader(config_file)) {
     if (reader_->ParseError() < 0) {
         std::cerr << "Can't load config file - " << config_file << std::endl;
         AbruptExit(__FILE__, __LINE__);
     }
+    Init();
+}
+
+Config::Config(const INIReader& reader, std::string out_dir)
+    : output_dir(out_dir), reader_(new INIReader(reader)) {
+    Init();
+}
 
+void Config::Init() {
     // The initialization of the parameters has to be strictly in this order
     // because of internal dependencies
     InitSystemParams();
@@ -28,17 +60,12 @@ Config::Config(std::string config_file, std::string out_dir)
     InitThermalParams();
 #endif  // THERMAL
     delete (reader_);
+    reader_ = nullptr;
+    return;
 }
 
 Address Config::AddressMapping(uint64_t hex_addr) const {
-    hex_addr >>= shift_bits;
-    int channel = (hex_addr >> ch_pos) & ch_mask;
-    int rank = (hex_addr >> ra_pos) & ra_mask;
-    int bg = (hex_addr >> bg_pos) & bg_mask;
-    int ba = (hex_addr >> ba_pos) & ba_mask;
-    int ro = (hex_addr >> ro_pos) & ro_mask;
-    int co = (hex_addr >> co_pos) & co_mask;
-    return Address(channel, rank, bg, ba, ro, co);
+    return address_mapper.Decode(hex_addr);
 }
 
 void Config::CalculateSize() {
@@ -59,12 +86,19 @@ void Config::CalculateSize() {
         ranks = channel_size / megs_per_rank;
         channel_size = ranks * megs_per_rank;
     }
+    // the coordinates have to fit the packed Address
+    if (channels > INT16_MAX || columns > INT16_MAX || ranks > INT8_MAX ||
+        bankgroups > INT8_MAX || banks_per_group > INT8_MAX) {
+        std::cerr << "Too many channels, ranks, banks or columns" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
     return;
 }
 
 DRAMProtocol Config::GetDRAMProtocol(std::string protocol_str) {
     std::map<std::string, DRAMProtocol> protocol_pairs = {
         {"DDR3", DRAMProtocol::DDR3},     {"DDR4", DRAMProtocol::DDR4},
+        {"DDR5", DRAMProtocol::DDR5},     {"HBM3", DRAMProtocol::HBM3},
         {"GDDR5", DRAMProtocol::GDDR5},   {"GDDR5X", DRAMProtocol::GDDR5X},  {"GDDR6", DRAMProtocol::GDDR6},
         {"LPDDR", DRAMProtocol::LPDDR},   {"LPDDR3", DRAMProtocol::LPDDR3},
         {"LPDDR4", DRAMProtocol::LPDDR4}, {"HBM", DRAMProtocol::HBM},
@@ -84,6 +118,22 @@ int Config::GetInteger(const std::string& sec, const std::string& opt,
     return static_cast<int>(reader_->GetInteger(sec, opt, default_val));
 }
 
+std::vector<int> Config::GetIntegerList(const std::string& sec,
+                                        const std::string& opt, int len,
+                                        int default_val) const {
+    std::vector<int> values;
+    for (const auto& token : StringSplit(reader_->Get(sec, opt, ""), ',')) {
+        values.push_back(std::stoi(token, nullptr, 0));
+    }
+    if (static_cast<int>(values.size()) > len) {
+        std::cerr << opt << " has more than " << len << " entries"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    values.resize(len, default_val);
+    return values;
+}
+
 void Config::InitDRAMParams() {
     const auto& reader = *reader_;
     protocol =
@@ -98,6 +148,17 @@ void Config::InitDRAMParams() {
         bankgroups = 1;
     }
     banks = bankgroups * banks_per_group;
+    // the sub-channels of a channel are simulated as channels of their own
+    sub_channels = GetInteger("dram_structure", "sub_channels",
+                              (IsDDR5() || protocol == DRAMProtocol::HBM3)
+                                  ? 2
+                                  : 1);
+    if (sub_channels < 1 || (sub_channels & (sub_channels - 1)) != 0) {
+        std::cerr << "sub_channels must be a power of 2" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    channels *= sub_channels;
+    channel_size /= sub_channels;
     rows = GetInteger("dram_structure", "rows", 1 << 16);
     columns = GetInteger("dram_structure", "columns", 1 << 10);
     device_width = GetInteger("dram_structure", "device_width", 8);
@@ -113,11 +174,18 @@ void Config::InitDRAMParams() {
     link_speed = GetInteger("hmc", "link_speed", 15000);  //MHz
     block_size = GetInteger("hmc", "block_size", 64);
     xbar_queue_depth = GetInteger("hmc", "xbar_queue_depth", 16);
+    xbar_bandwidth = GetInteger("hmc", "xbar_bandwidth", 2);
+    // limit each link to the flits its lanes can carry per cycle
+    link_flow_control = reader.GetBoolean("hmc", "link_flow_control", false);
     if (IsHMC()) {
         // the BL for HMC is determined by max block_size, which is a multiple
         // of 32B, each "device" transfer 32b per half cycle therefore BL is 8
         // for 32B block size
         BL = block_size * 8 / device_width;
+        if (xbar_bandwidth <= 0) {
+            std::cerr << "xbar_bandwidth must be positive" << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
     }
     // set burst cycle according to protocol
     // We use burst_cycle for timing and use BL for capacity calculation
@@ -128,6 +196,10 @@ void Config::InitDRAMParams() {
     } else if (protocol == DRAMProtocol::GDDR5X) {
         burst_cycle = (BL == 0) ? 0 : BL / 8;
         BL = (BL == 0) ? 8 : BL;
+    } else if (protocol == DRAMProtocol::HBM3) {
+        // data is on a strobe twice as fast as the command clock
+        burst_cycle = (BL == 0) ? 0 : BL / 4;
+        BL = (BL == 0) ? 8 : BL;
     } else if (protocol == DRAMProtocol::GDDR6){
         burst_cycle = (BL == 0) ? 0 : BL / 16;
         BL = (BL == 0 ) ? 8 : BL;
@@ -172,14 +244,43 @@ void Config::InitOtherParams() {
     } else {
         output_dir = output_dir + "/";
     }
-    output_prefix =
-        output_dir + reader.Get("other", "output_prefix", "dramsim3");
-    json_stats_name = output_prefix + ".json";
-    json_epoch_name = output_prefix + "epoch.json";
-    txt_stats_name = output_prefix + ".txt";
+    output_name_ = reader.Get("other", "output_prefix", "dramsim3");
+    // epoch stats are newline delimited JSON, or csv/msgpack
+    epoch_format = reader.Get("other", "epoch_format", "ndjson");
+    if (epoch_format != "ndjson" && epoch_format != "csv" &&
+        epoch_format != "msgpack") {
+        std::cerr << "Unknown epoch_format " << epoch_format << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    output_files = OutputFilesIn(output_dir);
+    // binary per channel command traces, see cmd_trace.h
+    cmd_trace = reader.GetBoolean("other", "cmd_trace", false);
+    cmd_trace_compress =
+        reader.GetBoolean("other", "cmd_trace_compress", false);
     return;
 }
 
+OutputFiles Config::OutputFilesIn(const std::string& dir) const {
+    OutputFiles files;
+    files.prefix = dir;
+    if (files.prefix.empty()) {
+        files.prefix = "./";
+    } else if (files.prefix.back() != '/') {
+        files.prefix += "/";
+    }
+    files.prefix += output_name_;
+    files.json_stats = files.prefix + ".json";
+    if (epoch_format == "csv") {
+        files.epoch_stats = files.prefix + "epoch.csv";
+    } else if (epoch_format == "msgpack") {
+        files.epoch_stats = files.prefix + "epoch.msgpack";
+    } else {
+        files.epoch_stats = files.prefix + "epoch.json";
+    }
+    files.txt_stats = files.prefix + ".txt";
+    return files;
+}
+
 void Config::InitPowerParams() {
     const auto& reader = *reader_;
     // Power-related parameters
@@ -187,13 +288,20 @@ void Config::InitPowerParams() {
     double IDD0 = reader.GetReal("power", "IDD0", 48);
     double IDD2P = reader.GetReal("power", "IDD2P", 25);
     double IDD2N = reader.GetReal("power", "IDD2N", 34);
-    // double IDD3P = reader.GetReal("power", "IDD3P", 37);
+    double IDD3P = reader.GetReal("power", "IDD3P", 37);
     double IDD3N = reader.GetReal("power", "IDD3N", 43);
     double IDD4W = reader.GetReal("power", "IDD4W", 123);
     double IDD4R = reader.GetReal("power", "IDD4R", 135);
     double IDD5AB = reader.GetReal("power", "IDD5AB", 250);  // all-bank ref
     double IDD5PB = reader.GetReal("power", "IDD5PB", 5);    // per-bank ref
+    double IDD5SB = reader.GetReal("power", "IDD5SB", -1);  // same-bank
     double IDD6x = reader.GetReal("power", "IDD6x", 31);
+    if (IDD5SB < 0) {
+        // a REFsb refreshes one bank per bankgroup, charge it the share of
+        // an all-bank refresh that these banks take
+        IDD5SB = IDD3N + (IDD5AB - IDD3N) * tRFC * bankgroups /
+                             (static_cast<double>(banks) * tRFCsb);
+    }
 
     // energy increments per command/cycle, calculated as voltage * current *
     // time(in cycles) units are V * mA * Cycles and if we convert cycles to ns
@@ -206,9 +314,12 @@ void Config::InitPowerParams() {
     write_energy_inc = VDD * (IDD4W - IDD3N) * burst_cycle * devices;
     ref_energy_inc = VDD * (IDD5AB - IDD3N) * tRFC * devices;
     refb_energy_inc = VDD * (IDD5PB - IDD3N) * tRFCb * devices;
+    refsb_energy_inc = VDD * std::max(IDD5SB - IDD3N, 0.0) * tRFCsb * devices;
+    rfm_energy_inc = VDD * std::max(IDD5SB - IDD3N, 0.0) * tRFM * devices;
     // the following are added per cycle
     act_stb_energy_inc = VDD * IDD3N * devices;
     pre_stb_energy_inc = VDD * IDD2N * devices;
+    act_pd_energy_inc = VDD * IDD3P * devices;
     pre_pd_energy_inc = VDD * IDD2P * devices;
     sref_energy_inc = VDD * IDD6x * devices;
     return;
@@ -221,11 +332,71 @@ void Config::InitSystemParams() {
     bus_width = GetInteger("system", "bus_width", 64);
     address_mapping = reader.Get("system", "address_mapping", "chrobabgraco");
     queue_structure = reader.Get("system", "queue_structure", "PER_BANK");
+    // see row_policy.h for the available policies
     row_buf_policy = reader.Get("system", "row_buf_policy", "OPEN_PAGE");
+    row_timeout = GetInteger("system", "row_timeout", 50);
+    minimalist_hits = GetInteger("system", "minimalist_hits", 4);
+    if (row_timeout < 0 || minimalist_hits < 1) {
+        std::cerr << "row_timeout must not be negative and minimalist_hits "
+                     "must be positive"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    // see prefetcher.h
+    prefetcher = reader.Get("system", "prefetcher", "NONE");
+    prefetch_degree = GetInteger("system", "prefetch_degree", 2);
+    prefetch_buffer_size = GetInteger("system", "prefetch_buffer_size", 16);
+    if (prefetch_degree < 1 || prefetch_buffer_size < 1) {
+        std::cerr << "prefetch_degree and prefetch_buffer_size must be "
+                     "positive"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    // see rowhammer.h
+    rowhammer_mitigation = reader.Get("system", "rowhammer_mitigation", "NONE");
+    rh_tracker = reader.Get("system", "rh_tracker", "MISRA_GRIES");
+    rh_threshold = GetInteger("system", "rh_threshold", 1024);
+    rh_table_entries = GetInteger("system", "rh_table_entries", 32);
+    rh_cms_hashes = GetInteger("system", "rh_cms_hashes", 4);
+    para_probability = reader.GetReal("system", "para_probability", 0.001);
+    rfm_raaimt = GetInteger("system", "rfm_raaimt", 32);
+    if (rh_threshold < 1 || rh_table_entries < 1 || rh_cms_hashes < 1 ||
+        rfm_raaimt < 1) {
+        std::cerr << "rh_threshold, rh_table_entries, rh_cms_hashes and "
+                     "rfm_raaimt must be positive"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (para_probability < 0 || para_probability > 1) {
+        std::cerr << "para_probability must be within [0, 1]" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
     cmd_queue_size = GetInteger("system", "cmd_queue_size", 16);
     trans_queue_size = GetInteger("system", "trans_queue_size", 32);
     unified_queue = reader.GetBoolean("system", "unified_queue", false);
-    write_buf_size = GetInteger("system", "write_buf_size", 16);
+    // without a unified queue writes wait in a write buffer of their own,
+    // writes drain from it between the watermarks: once write_high_watermark
+    // writes are buffered (or there is no read to serve) until no more than
+    // write_low_watermark are left, and no fewer than write_min_batch at a
+    // time. A high watermark of 0 leaves the drain to the scheduler
+    write_buf_size = GetInteger("system", "write_buf_size", trans_queue_size);
+    write_high_watermark = GetInteger("system", "write_high_watermark", 0);
+    write_low_watermark = GetInteger("system", "write_low_watermark", 0);
+    write_min_batch = GetInteger("system", "write_min_batch", 1);
+    // drain writes to open rows first
+    write_row_hit_first =
+        reader.GetBoolean("system", "write_row_hit_first", true);
+    if (write_buf_size < 1 || write_high_watermark < 0 ||
+        write_high_watermark > write_buf_size || write_min_batch < 1 ||
+        (write_high_watermark > 0 &&
+         (write_low_watermark < 0 ||
+          write_low_watermark >= write_high_watermark))) {
+        std::cerr << "Write drain watermarks must satisfy 0 <= "
+                     "write_low_watermark < write_high_watermark <= "
+                     "write_buf_size"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
     std::string ref_policy =
         reader.Get("system", "refresh_policy", "RANK_LEVEL_STAGGERED");
     if (ref_policy == "RANK_LEVEL_SIMULTANEOUS") {
@@ -234,15 +405,97 @@ void Config::InitSystemParams() {
         refresh_policy = RefreshPolicy::RANK_LEVEL_STAGGERED;
     } else if (ref_policy == "BANK_LEVEL_STAGGERED") {
         refresh_policy = RefreshPolicy::BANK_LEVEL_STAGGERED;
+    } else if (ref_policy == "SAME_BANK_STAGGERED") {
+        refresh_policy = RefreshPolicy::SAME_BANK_STAGGERED;
     } else {
         AbruptExit(__FILE__, __LINE__);
     }
+    // DDR4 fine granularity refresh: 2x and 4x refresh twice and four times
+    // as often, each REF takes tRFC2 and tRFC4 instead of tRFC
+    refresh_granularity = GetInteger("system", "refresh_granularity", 1);
+    if (refresh_granularity != 1 && refresh_granularity != 2 &&
+        refresh_granularity != 4) {
+        std::cerr << "refresh_granularity must be 1, 2 or 4" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    // refreshes that may be postponed while there are queued commands for
+    // the refreshed banks and issued ahead of time while there are none,
+    // JEDEC allows up to 8 each way
+    refresh_postpone_max = GetInteger("system", "refresh_postpone_max", 0);
+    refresh_pullin_max = GetInteger("system", "refresh_pullin_max", 0);
+    if (refresh_postpone_max < 0 || refresh_pullin_max < 0) {
+        std::cerr << "refresh_postpone_max and refresh_pullin_max must not "
+                     "be negative"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
 
     enable_self_refresh =
         reader.GetBoolean("system", "enable_self_refresh", false);
     sref_threshold = GetInteger("system", "sref_threshold", 1000);
+    // power down ranks without queued commands after pd_threshold cycles,
+    // with self refresh enabled as well ranks that are predicted to stay
+    // idle for sref_threshold cycles go into self refresh instead
+    enable_power_down =
+        reader.GetBoolean("system", "enable_power_down", false);
+    pd_threshold = GetInteger("system", "pd_threshold", 16);
+    if (pd_threshold < 0) {
+        std::cerr << "pd_threshold must not be negative" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
     aggressive_precharging_enabled =
         reader.GetBoolean("system", "aggressive_precharging_enabled", false);
+    // scheduling policy, see scheduler.h for the available ones
+    scheduler = reader.Get("system", "scheduler", "FRFCFS");
+    // row hits served before a pending row miss may close the row, 0 for no
+    // limit
+    row_hit_cap = GetInteger("system", "row_hit_cap", 4);
+    bliss_threshold = GetInteger("system", "bliss_threshold", 4);
+    bliss_clear_interval = GetInteger("system", "bliss_clear_interval", 10000);
+    parbs_marking_cap = GetInteger("system", "parbs_marking_cap", 5);
+    // per source QoS: priority class (higher goes first, requests may ask
+    // for a higher one), bandwidth share within a class and the cap of
+    // READ/WRITE commands per qos_window cycles (0 for no cap)
+    qos_sources = GetInteger("system", "qos_sources", 0);
+    qos_window = GetInteger("system", "qos_window", 10000);
+    if (qos_sources < 0 || qos_window < 1) {
+        std::cerr << "qos_sources must not be negative and qos_window must "
+                     "be positive"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    qos_priorities = GetIntegerList("system", "qos_priorities", qos_sources, 0);
+    qos_weights = GetIntegerList("system", "qos_weights", qos_sources, 1);
+    qos_bw_caps = GetIntegerList("system", "qos_bw_caps", qos_sources, 0);
+    for (int i = 0; i < qos_sources; i++) {
+        if (qos_weights[i] < 1 || qos_bw_caps[i] < 0) {
+            std::cerr << "qos_weights must be positive and qos_bw_caps must "
+                         "not be negative"
+                      << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+    }
+    // skip over cycles in which no controller can make progress
+    event_driven = reader.GetBoolean("system", "event_driven", false);
+    // tick channels on this many threads, synchronizing every
+    // parallel_quantum cycles, a quantum larger than 1 lets controllers run
+    // ahead of the CPU side and is therefore not cycle accurate
+    num_threads = GetInteger("system", "num_threads", 1);
+    parallel_quantum = GetInteger("system", "parallel_quantum", 1);
+    if (num_threads < 1 || parallel_quantum < 1) {
+        std::cerr << "num_threads and parallel_quantum must be positive"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+#ifdef THERMAL
+    if (num_threads > 1) {
+        // the thermal calculator is shared by all channels
+        std::cout << "WARNING: multi-threaded ticking is not supported with "
+                     "the thermal module, using 1 thread!"
+                  << std::endl;
+        num_threads = 1;
+    }
+#endif  // THERMAL
 
     return;
 }
@@ -251,6 +504,7 @@ void Config::InitSystemParams() {
 void Config::InitThermalParams() {
     const auto& reader = *reader_;
     const_logic_power = reader.GetReal("thermal", "const_logic_power", 5.0);
+    case_threads = GetInteger("thermal", "case_threads", 1);
     mat_dim_x = GetInteger("thermal", "mat_dim_x", 512);
     mat_dim_y = GetInteger("thermal", "mat_dim_y", 512);
     // row_tile = GetInteger("thermal", "row_tile", 1));
@@ -320,8 +574,20 @@ void Config::InitTimingParams() {
     tXS = GetInteger("timing", "tXS", 432);
     tXP = GetInteger("timing", "tXP", 8);
     tRFCb = GetInteger("timing", "tRFCb", 20);
+    tRFCsb = GetInteger("timing", "tRFCsb", tRFCb);
     tREFI = GetInteger("timing", "tREFI", 7800);
     tREFIb = GetInteger("timing", "tREFIb", 1950);
+    tRREFD = GetInteger("timing", "tRREFD", tRRD_L);
+    tREFSBRD = GetInteger("timing", "tREFSBRD", tRRD_L);
+    // a DDR5 same bank RFM takes as long as a same bank refresh
+    tRFM = GetInteger("timing", "tRFM", tRFCsb);
+    if (refresh_granularity == 2) {
+        tRFC = GetInteger("timing", "tRFC2", tRFC);
+        tREFI /= 2;
+    } else if (refresh_granularity == 4) {
+        tRFC = GetInteger("timing", "tRFC4", tRFC);
+        tREFI /= 4;
+    }
     tFAW = GetInteger("timing", "tFAW", 50);
     tRPRE = GetInteger("timing", "tRPRE", 1);
     tWPRE = GetInteger("timing", "tWPRE", 1);
@@ -401,6 +667,45 @@ void Config::SetAddressMapping() {
     ba_mask = (1 << field_widths.at("ba")) - 1;
     ro_mask = (1 << field_widths.at("ro")) - 1;
     co_mask = (1 << field_widths.at("co")) - 1;
+
+    // Optional per field overrides, all masks are over physical (byte)
+    // address bits:
+    //   <field>_bits = 0x...       the bits that make up the field, low to
+    //                              high, they don't have to be contiguous
+    //   <field>_xor = 0x..,0x..    bit i of the field is XOR-ed with the
+    //                              parity of the address bits in mask i
+    // e.g. bank_xor = 0x2000000,0x4000000 hashes the bank with 2 row bits
+    const char* keys[] = {"channel", "rank", "bankgroup",
+                          "bank",    "row",  "column"};
+    const char* tokens[] = {"ch", "ra", "bg", "ba", "ro", "co"};
+    std::vector<uint64_t> field_masks;
+    std::vector<std::vector<uint64_t>> xor_masks;
+    for (int i = 0; i < AddressMapper::NUM_FIELDS; i++) {
+        int width = field_widths.at(tokens[i]);
+        uint64_t mask = ((1ULL << width) - 1)
+                        << (field_pos.at(tokens[i]) + shift_bits);
+        std::string key = keys[i];
+        std::string bits = reader_->Get("system", key + "_bits", "");
+        if (!bits.empty()) {
+            mask = ParseMask(key + "_bits", bits);
+            if (__builtin_popcountll(mask) != width) {
+                std::cerr << key << "_bits must have " << width
+                          << " bits set" << std::endl;
+                AbruptExit(__FILE__, __LINE__);
+            }
+        }
+        field_masks.push_back(mask);
+
+        std::vector<uint64_t> hash;
+        std::string xors = reader_->Get("system", key + "_xor", "");
+        if (!xors.empty()) {
+            for (const auto& token : StringSplit(xors, ',')) {
+                hash.push_back(ParseMask(key + "_xor", token));
+            }
+        }
+        xor_masks.push_back(hash);
+    }
+    address_mapper.Init(field_masks, xor_masks);
 }
 
 }  // namespace dramsim3
@@ -3,6 +3,8 @@
 
 #include <fstream>
 #include <string>
+#include <vector>
+#include "address_mapper.h"
 #include "common.h"
 
 #include "INIReader.h"
@@ -12,6 +14,7 @@ namespace dramsim3 {
 enum class DRAMProtocol {
     DDR3,
     DDR4,
+    DDR5,
     GDDR5,
     GDDR5X,
     GDDR6,
@@ -20,6 +23,7 @@ enum class DRAMProtocol {
     LPDDR4,
     HBM,
     HBM2,
+    HBM3,
     HMC,
     SIZE
 };
@@ -28,17 +32,36 @@ enum class RefreshPolicy {
     RANK_LEVEL_SIMULTANEOUS,  // impractical due to high power requirement
     RANK_LEVEL_STAGGERED,
     BANK_LEVEL_STAGGERED,
-    SIZE 
+    SAME_BANK_STAGGERED,  // DDR5 REFsb, one bank in all bankgroups
+    SIZE
+};
+
+// Stats and trace files of a memory system, per channel files append to
+// the prefix
+struct OutputFiles {
+    std::string prefix;
+    std::string json_stats;
+    std::string epoch_stats;
+    std::string txt_stats;
 };
 
+// Read only once built, so one config can be shared by any number of memory
+// systems, also on different threads
 class Config {
    public:
     Config(std::string config_file, std::string out_dir);
+    // takes the parameters from an ini that is already parsed, the
+    // parameter sweep uses it to apply its overrides to one shared copy
+    Config(const INIReader& reader, std::string out_dir);
     Address AddressMapping(uint64_t hex_addr) const;
     // DRAM physical structure
     DRAMProtocol protocol;
     int channel_size;
+    // DDR5 DIMMs have two independent 32 bit sub-channels and HBM3 channels
+    // two pseudo channels, each with a controller of its own: channels and
+    // channel_size count sub-channels, bus_width is that of a sub-channel
     int channels;
+    int sub_channels;
     int ranks;
     int banks;
     int bankgroups;
@@ -51,9 +74,13 @@ class Config {
     int BL;
 
     // Address mapping numbers
+    // the *_pos fields describe the address_mapping string, the decoding
+    // itself (including [system] *_bits and *_xor overrides) is done by
+    // address_mapper
     int shift_bits;
     int ch_pos, ra_pos, bg_pos, ba_pos, ro_pos, co_pos;
     uint64_t ch_mask, ra_mask, bg_mask, ba_mask, ro_mask, co_mask;
+    AddressMapper address_mapper;
 
     // Generic DRAM timing parameters
     double tCK;
@@ -84,8 +111,12 @@ class Config {
     int tXS;
     int tXP;
     int tRFCb;
+    int tRFCsb;
     int tREFI;
     int tREFIb;
+    int tRREFD;     // per bank refresh to ACT/REFb of another bank
+    int tREFSBRD;   // same bank refresh to ACT/REFsb of another bank
+    int tRFM;       // refresh management (RFM) to ACT of the bank
     int tFAW;
     int tRPRE;  // read preamble and write preamble are important
     int tWPRE;
@@ -106,8 +137,11 @@ class Config {
     double write_energy_inc;
     double ref_energy_inc;
     double refb_energy_inc;
+    double refsb_energy_inc;
+    double rfm_energy_inc;
     double act_stb_energy_inc;
     double pre_stb_energy_inc;
+    double act_pd_energy_inc;
     double pre_pd_energy_inc;
     double sref_energy_inc;
 
@@ -119,29 +153,70 @@ class Config {
     int num_vaults;
     int block_size;  // block size in bytes
     int xbar_queue_depth;
+    int xbar_bandwidth;  // flits per logic cycle
+    bool link_flow_control;
 
     // System
     std::string address_mapping;
     std::string queue_structure;
     std::string row_buf_policy;
+    int row_timeout;
+    int minimalist_hits;
+    std::string prefetcher;
+    int prefetch_degree;
+    int prefetch_buffer_size;
+    std::string rowhammer_mitigation;
+    std::string rh_tracker;
+    int rh_threshold;
+    int rh_table_entries;
+    int rh_cms_hashes;
+    double para_probability;
+    int rfm_raaimt;
     RefreshPolicy refresh_policy;
+    int refresh_granularity;
+    int refresh_postpone_max;
+    int refresh_pullin_max;
     int cmd_queue_size;
     bool unified_queue;
     int trans_queue_size;
     int write_buf_size;
+    int write_high_watermark;
+    int write_low_watermark;
+    int write_min_batch;
+    bool write_row_hit_first;
     bool enable_self_refresh;
     int sref_threshold;
+    bool enable_power_down;
+    int pd_threshold;
     bool aggressive_precharging_enabled;
     bool enable_hbm_dual_cmd;
+    bool event_driven;
+    int num_threads;
+    int parallel_quantum;
+    std::string scheduler;
+    int row_hit_cap;
+    int bliss_threshold;
+    int bliss_clear_interval;
+    int parbs_marking_cap;
+    // sources (request source ids 0..qos_sources-1) with their own QoS
+    // settings and stats, missing list entries take the defaults
+    int qos_sources;
+    int qos_window;
+    std::vector<int> qos_priorities;
+    std::vector<int> qos_weights;
+    std::vector<int> qos_bw_caps;
 
 
     int epoch_period;
     int output_level;
     std::string output_dir;
-    std::string output_prefix;
-    std::string json_stats_name;
-    std::string json_epoch_name;
-    std::string txt_stats_name;
+    std::string epoch_format;
+    // the files under output_dir
+    OutputFiles output_files;
+    // the files of a memory system that writes to dir instead
+    OutputFiles OutputFilesIn(const std::string& dir) const;
+    bool cmd_trace;
+    bool cmd_trace_compress;
 
     // Computed parameters
     int request_size_bytes;
@@ -153,11 +228,13 @@ class Config {
     }
     bool IsHBM() const {
         return (protocol == DRAMProtocol::HBM ||
-                protocol == DRAMProtocol::HBM2);
+                protocol == DRAMProtocol::HBM2 ||
+                protocol == DRAMProtocol::HBM3);
     }
     bool IsHMC() const { return (protocol == DRAMProtocol::HMC); }
     // yzy: add another function
     bool IsDDR4() const { return (protocol == DRAMProtocol::DDR4); }
+    bool IsDDR5() const { return (protocol == DRAMProtocol::DDR5); }
 
     int ideal_memory_latency;
 
@@ -166,6 +243,8 @@ class Config {
     int num_row_refresh;       // number of rows to be refreshed for one time
     double amb_temp;         // the ambient temperature in [C]
     double const_logic_power;
+    // cases solved concurrently, 0 uses all OpenMP threads
+    int case_threads;
 
     double chip_dim_x;
     double chip_dim_y;
@@ -184,10 +263,17 @@ class Config {
 
    private:
     INIReader* reader_;
+    // output_prefix of [other], without the directory
+    std::string output_name_;
+    void Init();
     void CalculateSize();
     DRAMProtocol GetDRAMProtocol(std::string protocol_str);
     int GetInteger(const std::string& sec, const std::string& opt,
                    int default_val) const;
+    // comma separated integers, padded with default_val to len entries
+    std::vector<int> GetIntegerList(const std::string& sec,
+                                    const std::string& opt, int len,
+                                    int default_val) const;
     void InitDRAMParams();
     void InitOtherParams();
     void InitPowerParams();
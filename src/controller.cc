@@ -1,287 +1,760 @@
 #include "controller.h"
-#include <iomanip>
 #include <iostream>
 #include <limits>
 
 namespace dramsim3 {
 
 #ifdef THERMAL
-Controller::Controller(int channel, const Config &config, const Timing &timing,
+Controller::Controller(int channel, const Config &config,
+                       const OutputFiles &output_files, const Timing &timing,
                        ThermalCalculator &thermal_calc)
 #else
-Controller::Controller(int channel, const Config &config, const Timing &timing)
+Controller::Controller(int channel, const Config &config,
+                       const OutputFiles &output_files, const Timing &timing)
 #endif  // THERMAL
     : channel_id_(channel),
       clk_(0),
       config_(config),
-      simple_stats_(config_, channel_id_),
+      simple_stats_(config_, output_files, channel_id_),
       channel_state_(config, timing),
-      cmd_queue_(channel_id_, config, channel_state_, simple_stats_),
-      refresh_(config, channel_state_),
+      scheduler_(MakeScheduler(config)),
+      row_policy_(config),
+      cmd_queue_(channel_id_, config, channel_state_, simple_stats_,
+                 *scheduler_, row_policy_),
+      refresh_(config, channel_state_, cmd_queue_, simple_stats_),
+      rowhammer_(channel_id_, config, channel_state_, simple_stats_),
+      power_policy_(config),
+      prefetcher_(config),
 #ifdef THERMAL
       thermal_calc_(thermal_calc),
 #endif  // THERMAL
       is_unified_queue_(config.unified_queue),
-      row_buf_policy_(config.row_buf_policy == "CLOSE_PAGE"
-                          ? RowBufPolicy::CLOSE_PAGE
-                          : RowBufPolicy::OPEN_PAGE),
+      unified_queue_(is_unified_queue_ ? config.trans_queue_size : 0,
+                     cmd_queue_.NumQueues()),
+      read_queue_(is_unified_queue_ ? 0 : config.trans_queue_size,
+                  cmd_queue_.NumQueues()),
+      write_buffer_(is_unified_queue_ ? 0 : config.write_buf_size,
+                    cmd_queue_.NumQueues()),
+      // a transaction is pending while in the transaction queues or in the
+      // command queues, merged reads may chain beyond that
+      pending_rd_q_(config.trans_queue_size +
+                    config.cmd_queue_size * cmd_queue_.NumQueues()),
+      pending_wr_q_((is_unified_queue_ ? config.trans_queue_size
+                                       : config.write_buf_size) +
+                    config.cmd_queue_size * cmd_queue_.NumQueues()),
       last_trans_clk_(0),
-      write_draining_(0) {
-    if (is_unified_queue_) {
-        unified_queue_.reserve(config_.trans_queue_size);
-    } else {
-        read_queue_.reserve(config_.trans_queue_size);
-        write_buffer_.reserve(config_.trans_queue_size);
+      last_rw_dir_(-1),
+      use_watermarks_(!is_unified_queue_ && config.write_high_watermark > 0),
+      write_draining_(0),
+      drain_length_(0),
+      trans_blocked_(false) {
+    num_cycles_ = simple_stats_.GetCounterId("num_cycles");
+    epoch_num_ = simple_stats_.GetCounterId("epoch_num");
+    num_reads_done_ = simple_stats_.GetCounterId("num_reads_done");
+    num_writes_done_ = simple_stats_.GetCounterId("num_writes_done");
+    num_read_row_hits_ = simple_stats_.GetCounterId("num_read_row_hits");
+    num_write_row_hits_ = simple_stats_.GetCounterId("num_write_row_hits");
+    num_read_cmds_ = simple_stats_.GetCounterId("num_read_cmds");
+    num_write_cmds_ = simple_stats_.GetCounterId("num_write_cmds");
+    num_act_cmds_ = simple_stats_.GetCounterId("num_act_cmds");
+    num_pre_cmds_ = simple_stats_.GetCounterId("num_pre_cmds");
+    num_ref_cmds_ = simple_stats_.GetCounterId("num_ref_cmds");
+    num_refb_cmds_ = simple_stats_.GetCounterId("num_refb_cmds");
+    num_refsb_cmds_ = simple_stats_.GetCounterId("num_refsb_cmds");
+    num_rfm_cmds_ = simple_stats_.GetCounterId("num_rfm_cmds");
+    num_srefe_cmds_ = simple_stats_.GetCounterId("num_srefe_cmds");
+    num_srefx_cmds_ = simple_stats_.GetCounterId("num_srefx_cmds");
+    num_pde_cmds_ = simple_stats_.GetCounterId("num_pde_cmds");
+    num_pdx_cmds_ = simple_stats_.GetCounterId("num_pdx_cmds");
+    hbm_dual_cmds_ = simple_stats_.GetCounterId("hbm_dual_cmds");
+    num_policy_closes_ = simple_stats_.GetCounterId("num_policy_closes");
+    num_rw_turnarounds_ = simple_stats_.GetCounterId("num_rw_turnarounds");
+    num_wr_turnarounds_ = simple_stats_.GetCounterId("num_wr_turnarounds");
+    num_write_drains_ = simple_stats_.GetCounterId("num_write_drains");
+    if (config_.IsHMC()) {
+        num_atomic_reqs_ = simple_stats_.GetCounterId("num_atomic_reqs");
+        atomic_link_bytes_saved_ =
+            simple_stats_.GetCounterId("atomic_link_bytes_saved");
+    }
+    if (prefetcher_.Enabled()) {
+        num_prefetches_ = simple_stats_.GetCounterId("num_prefetches");
+        num_prefetch_hits_ = simple_stats_.GetCounterId("num_prefetch_hits");
+        num_late_prefetch_hits_ =
+            simple_stats_.GetCounterId("num_late_prefetch_hits");
+        num_prefetch_misses_ =
+            simple_stats_.GetCounterId("num_prefetch_misses");
+    }
+    all_bank_idle_cycles_ =
+        simple_stats_.GetVecCounterId("all_bank_idle_cycles");
+    rank_active_cycles_ = simple_stats_.GetVecCounterId("rank_active_cycles");
+    sref_cycles_ = simple_stats_.GetVecCounterId("sref_cycles");
+    act_pd_cycles_ = simple_stats_.GetVecCounterId("act_pd_cycles");
+    pre_pd_cycles_ = simple_stats_.GetVecCounterId("pre_pd_cycles");
+    read_latency_ = simple_stats_.GetHistoId("read_latency");
+    write_latency_ = simple_stats_.GetHistoId("write_latency");
+    interarrival_latency_ = simple_stats_.GetHistoId("interarrival_latency");
+    write_drain_length_ = simple_stats_.GetHistoId("write_drain_length");
+    for (int i = 0; i < static_cast<int>(StallReason::SIZE); i++) {
+        stall_cycles_.push_back(simple_stats_.GetCounterId(
+            "stall_" + StallReasonName(static_cast<StallReason>(i)) +
+            "_cycles"));
+    }
+    stall_queue_full_cycles_ =
+        simple_stats_.GetCounterId("stall_queue_full_cycles");
+    if (config_.qos_sources > 0) {
+        source_reads_done_ = simple_stats_.GetVecCounterId("source_reads_done");
+        source_writes_done_ =
+            simple_stats_.GetVecCounterId("source_writes_done");
+        for (int i = 0; i < config_.qos_sources; i++) {
+            source_read_latency_.push_back(simple_stats_.GetHistoId(
+                "source_" + std::to_string(i) + "_read_latency"));
+        }
     }
 
+    cmd_trace_writer_ = nullptr;
+    std::string trace_prefix =
+        output_files.prefix + "ch_" + std::to_string(channel_id_);
+    if (config_.cmd_trace) {
+        cmd_trace_writer_ = new CommandTraceWriter(
+            trace_prefix + "cmd.bin", config_.cmd_trace_compress);
+    }
 #ifdef CMD_TRACE
-    std::string trace_file_name = config_.output_prefix + "ch_" +
-                                  std::to_string(channel_id_) + "cmd.trace";
-    std::cout << "Command Trace write to " << trace_file_name << std::endl;
-    cmd_trace_.open(trace_file_name, std::ofstream::out);
+    // the text trace of the Verilog validation, unless there is a binary one
+    if (cmd_trace_writer_ == nullptr) {
+        std::string trace_file_name = trace_prefix + "cmd.trace";
+        std::cout << "Command Trace write to " << trace_file_name << std::endl;
+        cmd_trace_writer_ = new CommandTraceWriter(trace_file_name, false, true);
+    }
 #endif  // CMD_TRACE
 }
 
-std::pair<uint64_t, int> Controller::ReturnDoneTrans(uint64_t clk) {
-    auto it = return_queue_.begin();
-    while (it != return_queue_.end()) {
-        if (clk >= it->complete_cycle) {
-            if (it->is_write) {
-                simple_stats_.Increment("num_writes_done");
-            } else {
-                simple_stats_.Increment("num_reads_done");
-                simple_stats_.AddValue("read_latency", clk_ - it->added_cycle);
-            }
-            auto pair = std::make_pair(it->addr, it->is_write);
-            it = return_queue_.erase(it);
-            return pair;
+Controller::~Controller() {
+    delete (scheduler_);
+    delete (cmd_trace_writer_);
+}
+
+void Controller::ReturnDoneTrans(uint64_t clk,
+                                 std::vector<Transaction> &done) {
+    size_t first = done.size();
+    return_queue_.PopDone(clk, done);
+    for (size_t i = first; i < done.size(); i++) {
+        const Transaction &trans = done[i];
+        if (trans.is_write) {
+            simple_stats_.Increment(num_writes_done_);
         } else {
-            ++it;
+            simple_stats_.Increment(num_reads_done_);
+            simple_stats_.AddValue(read_latency_, clk_ - trans.added_cycle);
         }
+        UpdateSourceStats(trans);
     }
-    return std::make_pair(-1, -1);
+    return;
 }
 
 void Controller::ClockTick() {
     // update refresh counter
-    refresh_.ClockTick();
+    {
+        PROFILE_SCOPE(profiler_, CTRL_REFRESH);
+        refresh_.ClockTick();
+        if (rowhammer_.Enabled()) {
+            rowhammer_.ClockTick();
+        }
+    }
 
     bool cmd_issued = false;
     Command cmd;
-    if (channel_state_.IsRefreshWaiting()) {
-        cmd = cmd_queue_.FinishRefresh();
-    }
+    {
+        PROFILE_SCOPE(profiler_, CTRL_COMMAND_ISSUE);
+        if (channel_state_.IsRefreshWaiting()) {
+            cmd = cmd_queue_.FinishRefresh();
+        }
 
-    // cannot find a refresh related command or there's no refresh
-    if (!cmd.IsValid()) {
-        cmd = cmd_queue_.GetCommandToIssue();
-    }
+        // cannot find a refresh related command or there's no refresh
+        if (!cmd.IsValid()) {
+            cmd = cmd_queue_.GetCommandToIssue();
+        }
 
-    if (cmd.IsValid()) {
-        IssueCommand(cmd);
-        cmd_issued = true;
+        if (cmd.IsValid()) {
+            IssueCommand(cmd);
+            cmd_issued = true;
 
-        if (config_.enable_hbm_dual_cmd) {
-            auto second_cmd = cmd_queue_.GetCommandToIssue();
-            if (second_cmd.IsValid()) {
-                if (second_cmd.IsReadWrite() != cmd.IsReadWrite()) {
-                    IssueCommand(second_cmd);
-                    simple_stats_.Increment("hbm_dual_cmds");
+            if (config_.enable_hbm_dual_cmd) {
+                auto second_cmd = cmd_queue_.GetCommandToIssue();
+                if (second_cmd.IsValid()) {
+                    if (second_cmd.IsReadWrite() != cmd.IsReadWrite()) {
+                        IssueCommand(second_cmd);
+                        simple_stats_.Increment(hbm_dual_cmds_);
+                    }
                 }
             }
         }
     }
 
-    // power updates pt 1
-    for (int i = 0; i < config_.ranks; i++) {
-        if (channel_state_.IsRankSelfRefreshing(i)) {
-            simple_stats_.IncrementVec("sref_cycles", i);
-        } else {
-            bool all_idle = channel_state_.IsAllBankIdleInRank(i);
-            if (all_idle) {
-                simple_stats_.IncrementVec("all_bank_idle_cycles", i);
-                channel_state_.rank_idle_cycles[i] += 1;
-            } else {
-                simple_stats_.IncrementVec("rank_active_cycles", i);
-                // reset
-                channel_state_.rank_idle_cycles[i] = 0;
+    {
+        PROFILE_SCOPE(profiler_, CTRL_LOW_POWER);
+        // close rows that went idle when nothing else could issue
+        if (!cmd_issued && row_policy_.ClosesIdleRows()) {
+            cmd = IdlePrecharge();
+            if (cmd.IsValid()) {
+                IssueCommand(cmd);
+                simple_stats_.Increment(num_policy_closes_);
+                cmd_issued = true;
             }
         }
-    }
 
-    // power updates pt 2: move idle ranks into self-refresh mode to save power
-    if (config_.enable_self_refresh && !cmd_issued) {
-        for (auto i = 0; i < config_.ranks; i++) {
-            if (channel_state_.IsRankSelfRefreshing(i)) {
-                // wake up!
-                if (!cmd_queue_.rank_q_empty[i]) {
-                    auto addr = Address();
-                    addr.rank = i;
-                    auto cmd = Command(CommandType::SREF_EXIT, addr, -1);
-                    cmd = channel_state_.GetReadyCommand(cmd, clk_);
-                    if (cmd.IsValid()) {
-                        IssueCommand(cmd);
-                        break;
+        // move idle ranks into power down or self refresh
+        if (config_.enable_power_down && !cmd_issued) {
+            cmd = LowPowerCommand();
+            if (cmd.IsValid()) {
+                IssueCommand(cmd);
+                cmd_issued = true;
+            }
+        }
+
+        // power updates pt 1
+        UpdateRankCycles(1);
+
+        // power updates pt 2: idle ranks go into self-refresh to save power
+        if (config_.enable_self_refresh && !config_.enable_power_down &&
+            !cmd_issued) {
+            for (auto i = 0; i < config_.ranks; i++) {
+                if (channel_state_.IsRankSelfRefreshing(i)) {
+                    // wake up!
+                    if (!cmd_queue_.rank_q_empty[i]) {
+                        auto addr = Address();
+                        addr.rank = i;
+                        auto cmd = Command(CommandType::SREF_EXIT, addr, -1);
+                        cmd = channel_state_.GetReadyCommand(cmd, clk_);
+                        if (cmd.IsValid()) {
+                            IssueCommand(cmd);
+                            cmd_issued = true;
+                            break;
+                        }
                     }
-                }
-            } else {
-                if (cmd_queue_.rank_q_empty[i] &&
-                    channel_state_.rank_idle_cycles[i] >=
-                        config_.sref_threshold) {
-                    auto addr = Address();
-                    addr.rank = i;
-                    auto cmd = Command(CommandType::SREF_ENTER, addr, -1);
-                    cmd = channel_state_.GetReadyCommand(cmd, clk_);
-                    if (cmd.IsValid()) {
-                        IssueCommand(cmd);
-                        break;
+                } else {
+                    if (cmd_queue_.rank_q_empty[i] &&
+                        channel_state_.rank_idle_cycles[i] >=
+                            config_.sref_threshold) {
+                        auto addr = Address();
+                        addr.rank = i;
+                        auto cmd = Command(CommandType::SREF_ENTER, addr, -1);
+                        cmd = channel_state_.GetReadyCommand(cmd, clk_);
+                        if (cmd.IsValid()) {
+                            IssueCommand(cmd);
+                            cmd_issued = true;
+                            break;
+                        }
                     }
                 }
             }
         }
     }
 
+    if (!cmd_issued) {
+        UpdateStallCycles(1);
+    }
+
     ScheduleTransaction();
+    if (prefetcher_.Enabled()) {
+        IssuePrefetch();
+    }
     clk_++;
     cmd_queue_.ClockTick();
-    simple_stats_.Increment("num_cycles");
+    simple_stats_.Increment(num_cycles_);
+    return;
+}
+
+uint64_t Controller::NextEventCycle() const {
+    // pending refreshes and schedulable transactions may go out right away
+    if (channel_state_.IsRefreshWaiting() || CanScheduleTransaction()) {
+        return clk_;
+    }
+
+    // candidates are taken or dropped as soon as the queues are idle
+    if (prefetcher_.NumCandidates() > 0 && PrefetchIdle()) {
+        return clk_;
+    }
+
+    uint64_t next_cycle = refresh_.NextRefreshCycle();
+    next_cycle = std::min(next_cycle, cmd_queue_.NextReadyCycle());
+    next_cycle = std::min(next_cycle, return_queue_.NextCycle());
+
+    if (row_policy_.ClosesIdleRows()) {
+        for (int r = 0; r < config_.ranks; r++) {
+            for (int g = 0; g < config_.bankgroups; g++) {
+                for (int b = 0; b < config_.banks_per_group; b++) {
+                    if (!channel_state_.IsRowOpen(r, g, b) ||
+                        cmd_queue_.HasCommandsToBank(r, g, b)) {
+                        continue;
+                    }
+                    Address addr(-1, r, g, b, -1, -1);
+                    Command pre(CommandType::PRECHARGE, addr, 0);
+                    uint64_t close_cycle =
+                        std::max(row_policy_.TimeoutCycle(r, g, b),
+                                 channel_state_.GetReadyCycle(pre));
+                    next_cycle = std::min(next_cycle, close_cycle);
+                }
+            }
+        }
+    }
+
+    if (config_.enable_power_down) {
+        for (int i = 0; i < config_.ranks; i++) {
+            if (channel_state_.IsRankSelfRefreshing(i) ||
+                cmd_queue_.HasCommandsToRank(i)) {
+                continue;
+            }
+            next_cycle = std::min(next_cycle,
+                                  power_policy_.NextLowPowerCycle(
+                                      i, channel_state_.IsRankPoweredDown(i)));
+        }
+    } else if (config_.enable_self_refresh) {
+        for (int i = 0; i < config_.ranks; i++) {
+            if (channel_state_.IsRankSelfRefreshing(i)) {
+                if (!cmd_queue_.rank_q_empty[i]) {
+                    return clk_;
+                }
+            } else if (cmd_queue_.rank_q_empty[i] &&
+                       channel_state_.IsAllBankIdleInRank(i)) {
+                // idle cycles of this tick are counted before the check
+                int cycles_left = config_.sref_threshold -
+                                  channel_state_.rank_idle_cycles[i] - 1;
+                uint64_t sref_cycle =
+                    clk_ + static_cast<uint64_t>(std::max(cycles_left, 0));
+                next_cycle = std::min(next_cycle, sref_cycle);
+            }
+        }
+    }
+    return std::max(next_cycle, clk_);
+}
+
+void Controller::SkipCycles(uint64_t cycles) {
+    // nothing gets issued during these cycles so rank states stay the same
+    UpdateRankCycles(cycles);
+    UpdateStallCycles(cycles);
+    refresh_.SkipCycles(cycles);
+    cmd_queue_.SkipCycles(cycles);
+    clk_ += cycles;
+    simple_stats_.IncrementBy(num_cycles_, cycles);
+    return;
+}
+
+bool Controller::IsIdle() const {
+    return unified_queue_.Empty() && read_queue_.Empty() &&
+           write_buffer_.Empty() && pending_rd_q_.Empty() &&
+           pending_wr_q_.Empty() && return_queue_.Empty() &&
+           cmd_queue_.QueueEmpty();
+}
+
+void Controller::ForwardClock(uint64_t cycles) {
+    refresh_.SkipCycles(cycles);
+    cmd_queue_.SkipCycles(cycles);
+    clk_ += cycles;
     return;
 }
 
-bool Controller::WillAcceptTransaction(uint64_t hex_addr, bool is_write) const {
+void Controller::UpdateRankCycles(uint64_t cycles) {
+    for (int i = 0; i < config_.ranks; i++) {
+        if (channel_state_.IsRankSelfRefreshing(i)) {
+            simple_stats_.IncrementVecBy(sref_cycles_, i, cycles);
+        } else if (channel_state_.IsRankPoweredDown(i)) {
+            if (channel_state_.IsAllBankPrechargedInRank(i)) {
+                simple_stats_.IncrementVecBy(pre_pd_cycles_, i, cycles);
+            } else {
+                simple_stats_.IncrementVecBy(act_pd_cycles_, i, cycles);
+            }
+        } else if (channel_state_.IsAllBankIdleInRank(i)) {
+            simple_stats_.IncrementVecBy(all_bank_idle_cycles_, i, cycles);
+            channel_state_.rank_idle_cycles[i] += cycles;
+        } else {
+            simple_stats_.IncrementVecBy(rank_active_cycles_, i, cycles);
+            channel_state_.rank_idle_cycles[i] = 0;
+        }
+    }
+    return;
+}
+
+void Controller::UpdateStallCycles(uint64_t cycles) {
+    StallReason reason = channel_state_.IsRefreshWaiting()
+                             ? StallReason::REFRESH
+                             : cmd_queue_.GetStallReason();
+    simple_stats_.IncrementBy(stall_cycles_[static_cast<int>(reason)], cycles);
+    if (trans_blocked_) {
+        simple_stats_.IncrementBy(stall_queue_full_cycles_, cycles);
+    }
+    return;
+}
+
+bool Controller::WillAcceptTransaction(uint64_t, bool is_write) const {
     if (is_unified_queue_) {
-        return unified_queue_.size() < unified_queue_.capacity();
+        return unified_queue_.Size() < unified_queue_.Capacity();
     } else if (!is_write) {
-        return read_queue_.size() < read_queue_.capacity();
+        return read_queue_.Size() < read_queue_.Capacity();
     } else {
-        return write_buffer_.size() < write_buffer_.capacity();
+        return write_buffer_.Size() < write_buffer_.Capacity();
     }
 }
 
 bool Controller::AddTransaction(Transaction trans) {
     trans.added_cycle = clk_;
-    simple_stats_.AddValue("interarrival_latency", clk_ - last_trans_clk_);
+    trans.dram_addr = config_.AddressMapping(trans.addr);
+    trans.queue_idx = cmd_queue_.GetQueueIndex(
+        trans.dram_addr.rank, trans.dram_addr.bankgroup, trans.dram_addr.bank);
+    simple_stats_.AddValue(interarrival_latency_, clk_ - last_trans_clk_);
     last_trans_clk_ = clk_;
 
     if (trans.is_write) {
-        if (pending_wr_q_.count(trans.addr) == 0) {  // can not merge writes
-            pending_wr_q_.insert(std::make_pair(trans.addr, trans));
+        if (prefetcher_.Enabled()) {
+            prefetcher_.Write(trans.addr);
+        }
+        if (pending_wr_q_.Count(trans.addr) == 0) {  // can not merge writes
+            pending_wr_q_.Insert(trans);
             if (is_unified_queue_) {
-                unified_queue_.push_back(trans);
+                unified_queue_.Push(trans);
             } else {
-                write_buffer_.push_back(trans);
+                write_buffer_.Push(trans);
             }
         }
         trans.complete_cycle = clk_ + 1;
-        return_queue_.push_back(trans);
+        return_queue_.Push(trans);
         return true;
     } else {  // read
+        if (prefetcher_.Enabled()) {
+            const Address &addr = trans.dram_addr;
+            prefetcher_.Train(trans.addr,
+                              addr.rank * config_.banks +
+                                  addr.bankgroup * config_.banks_per_group +
+                                  addr.bank);
+        }
         // if in write buffer, use the write buffer value
-        if (pending_wr_q_.count(trans.addr) > 0) {
+        if (pending_wr_q_.Count(trans.addr) > 0) {
             trans.complete_cycle = clk_ + 1;
-            return_queue_.push_back(trans);
+            return_queue_.Push(trans);
             return true;
         }
-        pending_rd_q_.insert(std::make_pair(trans.addr, trans));
-        if (pending_rd_q_.count(trans.addr) == 1) {
+        if (prefetcher_.Enabled() && ServePrefetched(trans)) {
+            return true;
+        }
+        pending_rd_q_.Insert(trans);
+        if (pending_rd_q_.Count(trans.addr) == 1) {
             if (is_unified_queue_) {
-                unified_queue_.push_back(trans);
+                unified_queue_.Push(trans);
             } else {
-                read_queue_.push_back(trans);
+                read_queue_.Push(trans);
             }
         }
         return true;
     }
 }
 
+int Controller::WritesToDrain() const {
+    return scheduler_->WritesToDrain(read_queue_.Size(), write_buffer_.Size(),
+                                     write_buffer_.Capacity(),
+                                     cmd_queue_.QueueEmpty());
+}
+
+bool Controller::WatermarkDrain() const {
+    int num_writes = static_cast<int>(write_buffer_.Size());
+    if (num_writes == 0) {
+        return false;
+    } else if (write_draining_ > 0) {
+        return num_writes > config_.write_low_watermark ||
+               drain_length_ < config_.write_min_batch;
+    }
+    return num_writes >= config_.write_high_watermark ||
+           (read_queue_.Empty() && num_writes > config_.write_low_watermark);
+}
+
+void Controller::StartWriteDrain(int writes) {
+    write_draining_ = writes;
+    drain_length_ = 0;
+    simple_stats_.Increment(num_write_drains_);
+}
+
+void Controller::EndWriteDrain() {
+    write_draining_ = 0;
+    simple_stats_.AddValue(write_drain_length_, drain_length_);
+}
+
+const Transaction *Controller::PickWrite() const {
+    // writes held back by a pending read to the same address go last, then
+    // writes to open rows so that a drain needs fewer row switches, then
+    // the older one
+    return write_buffer_.Best(
+        [this](int queue_idx) {
+            return cmd_queue_.WillAcceptCommand(queue_idx);
+        },
+        [this](const Transaction &a, const Transaction &b) {
+            bool blocked_a = pending_rd_q_.Count(a.addr) > 0;
+            bool blocked_b = pending_rd_q_.Count(b.addr) > 0;
+            if (blocked_a != blocked_b) {
+                return blocked_b;
+            }
+            if (!config_.write_row_hit_first) {
+                return false;
+            }
+            bool hit_a = channel_state_.OpenRow(a.dram_addr.rank,
+                                                a.dram_addr.bankgroup,
+                                                a.dram_addr.bank) ==
+                         a.dram_addr.row;
+            bool hit_b = channel_state_.OpenRow(b.dram_addr.rank,
+                                                b.dram_addr.bankgroup,
+                                                b.dram_addr.bank) ==
+                         b.dram_addr.row;
+            return hit_a && !hit_b;
+        });
+}
+
+bool Controller::CanScheduleTransaction() const {
+    if (is_unified_queue_) {
+        return !unified_queue_.Empty();
+    } else if (use_watermarks_) {
+        // a drain that is held back by reads lets them go first
+        return WatermarkDrain() || !read_queue_.Empty();
+    } else if (write_draining_ > 0 || WritesToDrain() > 0) {
+        return !write_buffer_.Empty();
+    } else {
+        return !read_queue_.Empty();
+    }
+}
+
 void Controller::ScheduleTransaction() {
+    PROFILE_SCOPE(profiler_, CTRL_SCHEDULE);
     // determine whether to schedule read or write
-    if (write_draining_ == 0 && !is_unified_queue_) {
-        // we basically have a upper and lower threshold for write buffer
-        if ((write_buffer_.size() >= write_buffer_.capacity()) ||
-            (write_buffer_.size() > 8 && cmd_queue_.QueueEmpty())) {
-            write_draining_ = write_buffer_.size();
+    if (use_watermarks_) {
+        bool drain = WatermarkDrain();
+        if (drain && write_draining_ == 0) {
+            StartWriteDrain(1);
+        } else if (!drain && write_draining_ > 0) {
+            EndWriteDrain();
+        }
+    } else if (write_draining_ == 0 && !is_unified_queue_) {
+        int writes = WritesToDrain();
+        if (writes > 0) {
+            StartWriteDrain(writes);
         }
     }
 
-    std::vector<Transaction> &queue =
+    TransactionQueue &queue =
         is_unified_queue_ ? unified_queue_
                           : write_draining_ > 0 ? write_buffer_ : read_queue_;
-    for (auto it = queue.begin(); it != queue.end(); it++) {
-        auto cmd = TransToCommand(*it);
-        if (cmd_queue_.WillAcceptCommand(cmd.Rank(), cmd.Bankgroup(),
-                                         cmd.Bank())) {
-            if (!is_unified_queue_ && cmd.IsWrite()) {
-                // Enforce R->W dependency
-                if (pending_rd_q_.count(it->addr) > 0) {
-                    write_draining_ = 0;
-                    break;
-                }
-                write_draining_ -= 1;
+    auto trans = use_watermarks_ && write_draining_ > 0
+                     ? PickWrite()
+                     : scheduler_->PickTransaction(queue, cmd_queue_);
+    trans_blocked_ = trans == nullptr && !queue.Empty();
+    if (trans == nullptr) {
+        return;
+    }
+    auto cmd = TransToCommand(*trans);
+    if (!is_unified_queue_ && cmd.IsWrite()) {
+        // Enforce R->W dependency
+        if (pending_rd_q_.Count(trans->addr) > 0) {
+            if (!use_watermarks_) {
+                EndWriteDrain();
+                return;
+            }
+            // only held back writes are left, let reads go in the meantime
+            trans = scheduler_->PickTransaction(read_queue_, cmd_queue_);
+            if (trans != nullptr) {
+                cmd_queue_.AddCommand(TransToCommand(*trans));
+                read_queue_.Remove(trans);
+            }
+            return;
+        }
+        drain_length_++;
+        if (!use_watermarks_) {
+            write_draining_ -= 1;
+            if (write_draining_ == 0) {
+                EndWriteDrain();
             }
-            cmd_queue_.AddCommand(cmd);
-            queue.erase(it);
-            break;
         }
     }
+    cmd_queue_.AddCommand(cmd);
+    queue.Remove(trans);
 }
 
 void Controller::IssueCommand(const Command &cmd) {
-#ifdef CMD_TRACE
-    cmd_trace_ << std::left << std::setw(18) << clk_ << " " << cmd << std::endl;
-#endif  // CMD_TRACE
+    if (cmd_trace_writer_ != nullptr) {
+        cmd_trace_writer_->Write(channel_id_, cmd, clk_);
+    }
 #ifdef THERMAL
     // add channel in, only needed by thermal module
-    thermal_calc_.UpdateCMDPower(channel_id_, cmd, clk_);
+    {
+        PROFILE_SCOPE(profiler_, THERMAL_POWER);
+        thermal_calc_.UpdateCMDPower(channel_id_, cmd, clk_);
+    }
 #endif  // THERMAL
+    if (cmd.IsReadWrite()) {
+        int dir = cmd.IsWrite() ? 1 : 0;
+        if (last_rw_dir_ == 0 && dir == 1) {
+            simple_stats_.Increment(num_rw_turnarounds_);
+        } else if (last_rw_dir_ == 1 && dir == 0) {
+            simple_stats_.Increment(num_wr_turnarounds_);
+        }
+        last_rw_dir_ = dir;
+    }
     // if read/write, update pending queue and return queue
     if (cmd.IsRead()) {
-        auto num_reads = pending_rd_q_.count(cmd.hex_addr);
-        if (num_reads == 0) {
+        auto num_reads = pending_rd_q_.Count(cmd.hex_addr);
+        bool prefetch =
+            prefetcher_.Enabled() &&
+            prefetcher_.Fill(cmd.hex_addr, clk_ + config_.read_delay);
+        if (num_reads == 0 && !prefetch) {
             std::cerr << cmd.hex_addr << " not in read queue! " << std::endl;
             exit(1);
         }
         // if there are multiple reads pending return them all
         while (num_reads > 0) {
-            auto it = pending_rd_q_.find(cmd.hex_addr);
-            it->second.complete_cycle = clk_ + config_.read_delay;
-            return_queue_.push_back(it->second);
-            pending_rd_q_.erase(it);
+            auto trans = pending_rd_q_.Find(cmd.hex_addr);
+            trans->complete_cycle = clk_ + config_.read_delay;
+            return_queue_.Push(*trans);
+            pending_rd_q_.Erase(cmd.hex_addr);
             num_reads -= 1;
         }
     } else if (cmd.IsWrite()) {
         // there should be only 1 write to the same location at a time
-        auto it = pending_wr_q_.find(cmd.hex_addr);
-        if (it == pending_wr_q_.end()) {
+        auto trans = pending_wr_q_.Find(cmd.hex_addr);
+        if (trans == nullptr) {
             std::cerr << cmd.hex_addr << " not in write queue!" << std::endl;
             exit(1);
         }
-        auto wr_lat = clk_ - it->second.added_cycle + config_.write_delay;
-        simple_stats_.AddValue("write_latency", wr_lat);
-        pending_wr_q_.erase(it);
+        auto wr_lat = clk_ - trans->added_cycle + config_.write_delay;
+        simple_stats_.AddValue(write_latency_, wr_lat);
+        pending_wr_q_.Erase(cmd.hex_addr);
+    }
+    if (config_.enable_power_down) {
+        power_policy_.CommandIssued(cmd, clk_,
+                                    cmd_queue_.HasCommandsToRank(cmd.Rank()));
+    }
+    if (rowhammer_.Enabled()) {
+        rowhammer_.CommandIssued(cmd, clk_);
     }
     // must update stats before states (for row hits)
     UpdateCommandStats(cmd);
     channel_state_.UpdateTimingAndStates(cmd, clk_);
+    cmd_queue_.InvalidateReadyCycles(cmd);
+    scheduler_->CommandIssued(cmd, clk_);
+    row_policy_.CommandIssued(cmd, clk_);
+}
+
+bool Controller::ServePrefetched(const Transaction &trans) {
+    uint64_t ready_cycle = 0;
+    PrefetchLine line = prefetcher_.Lookup(trans.addr, ready_cycle);
+    if (line == PrefetchLine::FILLED) {
+        Transaction done = trans;
+        done.complete_cycle = std::max(clk_ + 1, ready_cycle);
+        return_queue_.Push(done);
+        simple_stats_.Increment(num_prefetch_hits_);
+        return true;
+    } else if (line == PrefetchLine::QUEUED) {
+        // returned along with the prefetch READ
+        pending_rd_q_.Insert(trans);
+        simple_stats_.Increment(num_prefetch_hits_);
+        simple_stats_.Increment(num_late_prefetch_hits_);
+        return true;
+    }
+    simple_stats_.Increment(num_prefetch_misses_);
+    return false;
+}
+
+bool Controller::PrefetchIdle() const {
+    return unified_queue_.Empty() && read_queue_.Empty() &&
+           write_draining_ == 0;
+}
+
+void Controller::IssuePrefetch() {
+    if (!PrefetchIdle()) {
+        return;
+    }
+    size_t i = 0;
+    while (i < prefetcher_.NumCandidates() && prefetcher_.CanQueue()) {
+        uint64_t hex_addr = prefetcher_.Candidate(i);
+        Address addr = config_.AddressMapping(hex_addr);
+        if (addr.channel != channel_id_ || pending_rd_q_.Count(hex_addr) > 0 ||
+            pending_wr_q_.Count(hex_addr) > 0) {
+            prefetcher_.RemoveCandidate(i);
+            continue;
+        }
+        // queued commands may still open the row, or leave it open
+        if (cmd_queue_.HasCommandsToBank(addr.rank, addr.bankgroup,
+                                         addr.bank)) {
+            i++;
+            continue;
+        }
+        prefetcher_.RemoveCandidate(i);
+        if (channel_state_.OpenRow(addr.rank, addr.bankgroup, addr.bank) !=
+                addr.row ||
+            !cmd_queue_.WillAcceptCommand(addr.rank, addr.bankgroup,
+                                          addr.bank)) {
+            continue;
+        }
+        Command cmd(row_policy_.ColumnCommand(false), addr, hex_addr);
+        cmd_queue_.AddCommand(cmd);
+        prefetcher_.Queue(hex_addr);
+        simple_stats_.Increment(num_prefetches_);
+        return;
+    }
+    return;
 }
 
 Command Controller::TransToCommand(const Transaction &trans) {
-    auto addr = config_.AddressMapping(trans.addr);
-    CommandType cmd_type;
-    if (row_buf_policy_ == RowBufPolicy::OPEN_PAGE) {
-        cmd_type = trans.is_write ? CommandType::WRITE : CommandType::READ;
-    } else {
-        cmd_type = trans.is_write ? CommandType::WRITE_PRECHARGE
-                                  : CommandType::READ_PRECHARGE;
+    CommandType cmd_type = row_policy_.ColumnCommand(trans.is_write);
+    auto cmd = Command(cmd_type, trans.dram_addr, trans.addr);
+    cmd.source_id = trans.source_id;
+    cmd.priority = trans.priority;
+    return cmd;
+}
+
+Command Controller::IdlePrecharge() const {
+    for (int r = 0; r < config_.ranks; r++) {
+        for (int g = 0; g < config_.bankgroups; g++) {
+            for (int b = 0; b < config_.banks_per_group; b++) {
+                if (!channel_state_.IsRowOpen(r, g, b) ||
+                    clk_ < row_policy_.TimeoutCycle(r, g, b) ||
+                    cmd_queue_.HasCommandsToBank(r, g, b)) {
+                    continue;
+                }
+                Address addr(-1, r, g, b, -1, -1);
+                Command pre(CommandType::PRECHARGE, addr, 0);
+                pre = channel_state_.GetReadyCommand(pre, clk_);
+                if (pre.cmd_type == CommandType::PRECHARGE) {
+                    return pre;
+                }
+            }
+        }
+    }
+    return Command();
+}
+
+Command Controller::LowPowerCommand() const {
+    for (int r = 0; r < config_.ranks; r++) {
+        // busy ranks wake up by themselves through the commands they need
+        if (channel_state_.IsRankSelfRefreshing(r) ||
+            channel_state_.IsRankRefreshWaiting(r) ||
+            cmd_queue_.HasCommandsToRank(r)) {
+            continue;
+        }
+        CommandType cmd_type = power_policy_.LowPowerCommand(
+            r, channel_state_.IsRankPoweredDown(r), clk_);
+        if (cmd_type == CommandType::SIZE) {
+            continue;
+        }
+        Address addr;
+        addr.rank = r;
+        // may be a PRECHARGE that has to go before SREF_ENTER
+        Command cmd = channel_state_.GetReadyCommand(
+            Command(cmd_type, addr, -1), clk_);
+        if (cmd.IsValid()) {
+            return cmd;
+        }
     }
-    return Command(cmd_type, addr, trans.addr);
+    return Command();
 }
 
 int Controller::QueueUsage() const { return cmd_queue_.QueueUsage(); }
 
-void Controller::PrintEpochStats() {
-    simple_stats_.Increment("epoch_num");
-    simple_stats_.PrintEpochStats();
+void Controller::PrintEpochStats(EpochWriter *epoch_writer) {
+    simple_stats_.Increment(epoch_num_);
+    simple_stats_.PrintEpochStats(epoch_writer);
 #ifdef THERMAL
     for (int r = 0; r < config_.ranks; r++) {
         double bg_energy = simple_stats_.RankBackgroundEnergy(r);
@@ -291,6 +764,20 @@ void Controller::PrintEpochStats() {
     return;
 }
 
+void Controller::ResetStats() {
+    simple_stats_.Reset();
+#ifdef PROFILE
+    profiler_.Reset(clk_);
+#endif  // PROFILE
+    return;
+}
+
+void Controller::RecordAtomic(int link_bytes_saved) {
+    simple_stats_.Increment(num_atomic_reqs_);
+    simple_stats_.IncrementBy(atomic_link_bytes_saved_, link_bytes_saved);
+    return;
+}
+
 void Controller::PrintFinalStats() {
     simple_stats_.PrintFinalStats();
 
@@ -303,45 +790,132 @@ void Controller::PrintFinalStats() {
     return;
 }
 
+void Controller::UpdateSourceStats(const Transaction &trans) {
+    int source = trans.source_id;
+    if (source < 0 || source >= config_.qos_sources) {
+        return;
+    }
+    if (trans.is_write) {
+        simple_stats_.IncrementVec(source_writes_done_, source);
+    } else {
+        simple_stats_.IncrementVec(source_reads_done_, source);
+        simple_stats_.AddValue(source_read_latency_[source],
+                               clk_ - trans.added_cycle);
+    }
+}
+
 void Controller::UpdateCommandStats(const Command &cmd) {
+    PROFILE_SCOPE(profiler_, CTRL_COMMAND_STATS);
     switch (cmd.cmd_type) {
         case CommandType::READ:
         case CommandType::READ_PRECHARGE:
-            simple_stats_.Increment("num_read_cmds");
+            simple_stats_.Increment(num_read_cmds_);
             if (channel_state_.RowHitCount(cmd.Rank(), cmd.Bankgroup(),
                                            cmd.Bank()) != 0) {
-                simple_stats_.Increment("num_read_row_hits");
+                simple_stats_.Increment(num_read_row_hits_);
             }
             break;
         case CommandType::WRITE:
         case CommandType::WRITE_PRECHARGE:
-            simple_stats_.Increment("num_write_cmds");
+            simple_stats_.Increment(num_write_cmds_);
             if (channel_state_.RowHitCount(cmd.Rank(), cmd.Bankgroup(),
                                            cmd.Bank()) != 0) {
-                simple_stats_.Increment("num_write_row_hits");
+                simple_stats_.Increment(num_write_row_hits_);
             }
             break;
         case CommandType::ACTIVATE:
-            simple_stats_.Increment("num_act_cmds");
+            simple_stats_.Increment(num_act_cmds_);
             break;
         case CommandType::PRECHARGE:
-            simple_stats_.Increment("num_pre_cmds");
+            simple_stats_.Increment(num_pre_cmds_);
             break;
         case CommandType::REFRESH:
-            simple_stats_.Increment("num_ref_cmds");
+            simple_stats_.Increment(num_ref_cmds_);
             break;
         case CommandType::REFRESH_BANK:
-            simple_stats_.Increment("num_refb_cmds");
+            simple_stats_.Increment(num_refb_cmds_);
+            break;
+        case CommandType::REFRESH_SAME_BANK:
+            simple_stats_.Increment(num_refsb_cmds_);
+            break;
+        case CommandType::REFRESH_MANAGEMENT:
+            simple_stats_.Increment(num_rfm_cmds_);
             break;
         case CommandType::SREF_ENTER:
-            simple_stats_.Increment("num_srefe_cmds");
+            simple_stats_.Increment(num_srefe_cmds_);
             break;
         case CommandType::SREF_EXIT:
-            simple_stats_.Increment("num_srefx_cmds");
+            simple_stats_.Increment(num_srefx_cmds_);
+            break;
+        case CommandType::PD_ENTER:
+            simple_stats_.Increment(num_pde_cmds_);
+            break;
+        case CommandType::PD_EXIT:
+            simple_stats_.Increment(num_pdx_cmds_);
             break;
         default:
             AbruptExit(__FILE__, __LINE__);
     }
 }
 
+void Controller::Save(CheckpointWriter &writer) const {
+    writer.Section("controller_" + std::to_string(channel_id_));
+    writer.Put(clk_);
+    simple_stats_.Save(writer);
+    channel_state_.Save(writer);
+    scheduler_->Save(writer);
+    row_policy_.Save(writer);
+    cmd_queue_.Save(writer);
+    refresh_.Save(writer);
+    if (rowhammer_.Enabled()) {
+        rowhammer_.Save(writer);
+    }
+    power_policy_.Save(writer);
+    if (prefetcher_.Enabled()) {
+        prefetcher_.Save(writer);
+    }
+    unified_queue_.Save(writer);
+    read_queue_.Save(writer);
+    write_buffer_.Save(writer);
+    pending_rd_q_.Save(writer);
+    pending_wr_q_.Save(writer);
+    return_queue_.Save(writer);
+    writer.Put(last_trans_clk_);
+    writer.Put(last_rw_dir_);
+    writer.Put(write_draining_);
+    writer.Put(drain_length_);
+    writer.Put(trans_blocked_);
+    return;
+}
+
+void Controller::Restore(CheckpointReader &reader) {
+    reader.Section("controller_" + std::to_string(channel_id_));
+    reader.Get(clk_);
+    simple_stats_.Restore(reader);
+    channel_state_.Restore(reader);
+    scheduler_->Restore(reader);
+    row_policy_.Restore(reader);
+    cmd_queue_.Restore(reader);
+    refresh_.Restore(reader);
+    if (rowhammer_.Enabled()) {
+        rowhammer_.Restore(reader);
+    }
+    power_policy_.Restore(reader);
+    if (prefetcher_.Enabled()) {
+        prefetcher_.Restore(reader);
+    }
+    unified_queue_.Restore(reader);
+    read_queue_.Restore(reader);
+    write_buffer_.Restore(reader);
+    pending_rd_q_.Restore(reader);
+    pending_wr_q_.Restore(reader);
+    return_queue_.Restore(reader);
+    reader.Get(last_trans_clk_);
+    reader.Get(last_rw_dir_);
+    reader.Get(write_draining_);
+    reader.Get(drain_length_);
+    reader.Get(trans_blocked_);
+    return;
+}
+
 }  // namespace dramsim3
@@ -1,15 +1,23 @@
 #ifndef __CONTROLLER_H
 #define __CONTROLLER_H
 
-#include <fstream>
-#include <map>
 #include <unordered_set>
 #include <vector>
 #include "channel_state.h"
+#include "cmd_trace.h"
 #include "command_queue.h"
 #include "common.h"
+#include "completion_queue.h"
+#include "pending_table.h"
+#include "power_policy.h"
+#include "prefetcher.h"
+#include "profiler.h"
 #include "refresh.h"
+#include "row_policy.h"
+#include "rowhammer.h"
+#include "scheduler.h"
 #include "simple_stats.h"
+#include "transaction_queue.h"
 
 #ifdef THERMAL
 #include "thermal.h"
@@ -17,25 +25,60 @@
 
 namespace dramsim3 {
 
-enum class RowBufPolicy { OPEN_PAGE, CLOSE_PAGE, SIZE };
-
 class Controller {
    public:
 #ifdef THERMAL
-    Controller(int channel, const Config &config, const Timing &timing,
+    Controller(int channel, const Config &config,
+               const OutputFiles &output_files, const Timing &timing,
                ThermalCalculator &thermalcalc);
 #else
-    Controller(int channel, const Config &config, const Timing &timing);
+    Controller(int channel, const Config &config,
+               const OutputFiles &output_files, const Timing &timing);
 #endif  // THERMAL
+    ~Controller();
     void ClockTick();
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const;
     bool AddTransaction(Transaction trans);
     int QueueUsage() const;
     // Stats output
-    void PrintEpochStats();
+    void PrintEpochStats(EpochWriter *epoch_writer);
     void PrintFinalStats();
-    void ResetStats() { simple_stats_.Reset(); }
-    std::pair<uint64_t, int> ReturnDoneTrans(uint64_t clock);
+    // the final stats once they are printed
+    const nlohmann::json &FinalStats() const { return simple_stats_.Values(); }
+    void ResetStats();
+    // appends the transactions that are done by clock to done, in the order
+    // they completed
+    void ReturnDoneTrans(uint64_t clock, std::vector<Transaction> &done);
+    // HMC only, an atomic request has been executed by this vault
+    void RecordAtomic(int link_bytes_saved);
+
+    // Event driven mode: the earliest cycle at which ClockTick could do more
+    // than advancing clocks and idle/active counters, and the batched
+    // equivalent of calling ClockTick for that many idle cycles
+    uint64_t NextEventCycle() const;
+    void SkipCycles(uint64_t cycles);
+
+    // Fast forward support: whether any transaction is in flight, moving
+    // the clocks of an idle controller without accounting for the cycles,
+    // and the open rows of the banks (-1 if closed) in (rank, bankgroup,
+    // bank) order. Rows are only set in banks that are not in self refresh
+    bool IsIdle() const;
+    void ForwardClock(uint64_t cycles);
+    const std::vector<int> &OpenRows() const {
+        return channel_state_.OpenRows();
+    }
+    void SetOpenRows(const std::vector<int> &rows) {
+        channel_state_.SetOpenRows(rows);
+    }
+
+    // the state of the channel (queues, bank states and timings, refresh,
+    // policies and stats) to/from a checkpoint
+    void Save(CheckpointWriter &writer) const;
+    void Restore(CheckpointReader &reader);
+
+#ifdef PROFILE
+    const Profiler &GetProfiler() const { return profiler_; }
+#endif  // PROFILE
 
     int channel_id_;
 
@@ -44,42 +87,125 @@ class Controller {
     const Config &config_;
     SimpleStats simple_stats_;
     ChannelState channel_state_;
+    Scheduler *scheduler_;
+    RowPolicy row_policy_;
     CommandQueue cmd_queue_;
     Refresh refresh_;
+    RowHammer rowhammer_;
+    PowerPolicy power_policy_;
+    Prefetcher prefetcher_;
 
 #ifdef THERMAL
     ThermalCalculator &thermal_calc_;
 #endif  // THERMAL
 
+#ifdef PROFILE
+    Profiler profiler_;
+#endif  // PROFILE
+
     // queue that takes transactions from CPU side
     bool is_unified_queue_;
-    std::vector<Transaction> unified_queue_;
-    std::vector<Transaction> read_queue_;
-    std::vector<Transaction> write_buffer_;
+    TransactionQueue unified_queue_;
+    TransactionQueue read_queue_;
+    TransactionQueue write_buffer_;
 
-    // transactions that are not completed, use map for convenience
-    std::multimap<uint64_t, Transaction> pending_rd_q_;
-    std::multimap<uint64_t, Transaction> pending_wr_q_;
+    // transactions that are not completed
+    PendingTable pending_rd_q_;
+    PendingTable pending_wr_q_;
 
     // completed transactions
-    std::vector<Transaction> return_queue_;
-
-    // row buffer policy
-    RowBufPolicy row_buf_policy_;
+    CompletionQueue return_queue_;
 
-#ifdef CMD_TRACE
-    std::ofstream cmd_trace_;
-#endif  // CMD_TRACE
+    // binary command trace with cmd_trace = true, text trace in CMD_TRACE
+    // builds otherwise
+    CommandTraceWriter *cmd_trace_writer_;
 
     // used to calculate inter-arrival latency
     uint64_t last_trans_clk_;
 
-    // transaction queueing
+    // stat handles, looked up once so that updates do not hash stat names
+    CounterId num_cycles_;
+    CounterId epoch_num_;
+    CounterId num_reads_done_;
+    CounterId num_writes_done_;
+    CounterId num_read_row_hits_;
+    CounterId num_write_row_hits_;
+    CounterId num_read_cmds_;
+    CounterId num_write_cmds_;
+    CounterId num_act_cmds_;
+    CounterId num_pre_cmds_;
+    CounterId num_ref_cmds_;
+    CounterId num_refb_cmds_;
+    CounterId num_refsb_cmds_;
+    CounterId num_rfm_cmds_;
+    CounterId num_srefe_cmds_;
+    CounterId num_srefx_cmds_;
+    CounterId num_pde_cmds_;
+    CounterId num_pdx_cmds_;
+    CounterId hbm_dual_cmds_;
+    CounterId num_policy_closes_;
+    CounterId num_rw_turnarounds_;
+    CounterId num_wr_turnarounds_;
+    CounterId num_write_drains_;
+    CounterId num_atomic_reqs_;
+    CounterId atomic_link_bytes_saved_;
+    CounterId num_prefetches_;
+    CounterId num_prefetch_hits_;
+    CounterId num_late_prefetch_hits_;
+    CounterId num_prefetch_misses_;
+    VecCounterId all_bank_idle_cycles_;
+    VecCounterId rank_active_cycles_;
+    VecCounterId sref_cycles_;
+    VecCounterId act_pd_cycles_;
+    VecCounterId pre_pd_cycles_;
+    HistoId read_latency_;
+    HistoId write_latency_;
+    HistoId interarrival_latency_;
+    HistoId write_drain_length_;
+    VecCounterId source_reads_done_;
+    VecCounterId source_writes_done_;
+    std::vector<HistoId> source_read_latency_;
+    // indexed by StallReason
+    std::vector<CounterId> stall_cycles_;
+    CounterId stall_queue_full_cycles_;
+
+    // direction of the last READ/WRITE, -1 before the first one, 0 for
+    // reads and 1 for writes
+    int last_rw_dir_;
+
+    // transaction queueing, with watermarks write_draining_ is 1 while
+    // draining, otherwise the number of writes left to drain
+    bool use_watermarks_;
     int write_draining_;
+    // writes scheduled in the current drain
+    int drain_length_;
+    // transactions waited for full command queues at the last scheduling
+    bool trans_blocked_;
     void ScheduleTransaction();
+    int WritesToDrain() const;
+    bool WatermarkDrain() const;
+    void StartWriteDrain(int writes);
+    void EndWriteDrain();
+    const Transaction *PickWrite() const;
+    bool CanScheduleTransaction() const;
     void IssueCommand(const Command &tmp_cmd);
+    // demand read served by the prefetch buffer, false if it is not there
+    bool ServePrefetched(const Transaction &trans);
+    // prefetches only go out while no demand transactions wait
+    bool PrefetchIdle() const;
+    // sends at most one prefetch READ to the command queues
+    void IssuePrefetch();
     Command TransToCommand(const Transaction &trans);
+    // PRECHARGE of a row that timed out, invalid if there is none
+    Command IdlePrecharge() const;
+    // command moving an idle rank into (or towards) a low power mode,
+    // invalid if there is none
+    Command LowPowerCommand() const;
+    void UpdateRankCycles(uint64_t cycles);
+    // cycles in which no command was issued, all for the same reason
+    void UpdateStallCycles(uint64_t cycles);
     void UpdateCommandStats(const Command &cmd);
+    void UpdateSourceStats(const Transaction &trans);
 };
 }  // namespace dramsim3
 #endif
@@ -1,4 +1,6 @@
 #include "cpu.h"
+#include <iomanip>
+#include <iostream>
 
 namespace dramsim3 {
 
@@ -62,21 +64,20 @@ void StreamCPU::ClockTick() {
 TraceBasedCPU::TraceBasedCPU(const std::string& config_file,
                              const std::string& output_dir,
                              const std::string& trace_file)
-    : CPU(config_file, output_dir) {
-    trace_file_.open(trace_file);
-    if (trace_file_.fail()) {
-        std::cerr << "Trace file does not exist" << std::endl;
-        AbruptExit(__FILE__, __LINE__);
-    }
-}
+    : CPU(config_file, output_dir),
+      trace_reader_(MakeTraceReader(trace_file, true)) {}
+
+TraceBasedCPU::TraceBasedCPU(Config* config, const std::string& output_dir,
+                             TraceReader* trace_reader)
+    : CPU(config, output_dir), trace_reader_(trace_reader) {}
 
 void TraceBasedCPU::ClockTick() {
     memory_system_.ClockTick();
-    if (!trace_file_.eof()) {
-        if (get_next_) {
-            get_next_ = false;
-            trace_file_ >> trans_;
-        }
+    if (get_next_ && !trace_done_) {
+        get_next_ = false;
+        trace_done_ = !trace_reader_->Next(trans_);
+    }
+    if (!trace_done_) {
         if (trans_.added_cycle <= clk_) {
             get_next_ = memory_system_.WillAcceptTransaction(trans_.addr,
                                                              trans_.is_write);
@@ -89,4 +90,205 @@ void TraceBasedCPU::ClockTick() {
     return;
 }
 
+MultiCoreTraceCPU::MultiCoreTraceCPU(
+    const std::string& config_file, const std::string& output_dir,
+    const std::vector<std::string>& trace_files, const CoreParams& params)
+    : CPU(config_file, output_dir), params_(params), cpu_clk_(0) {
+    if (params_.rob_size <= 0 || params_.mshrs <= 0 || params_.width <= 0 ||
+        params_.clock_ratio <= 0) {
+        std::cerr << "ROB size, MSHRs, width and clock ratio must be positive"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (trace_files.empty()) {
+        std::cerr << "No trace for the cores" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    for (const auto& trace_file : trace_files) {
+        Core core{};
+        // one background reader thread per core would be too many
+        core.trace_reader = MakeTraceReader(trace_file, false);
+        core.has_trans = false;
+        core.trace_done = false;
+        core.bubbles = 0;
+        core.last_cycle = 0;
+        core.rob.resize(params_.rob_size);
+        core.rob_head = 0;
+        core.rob_count = 0;
+        core.reads_in_flight = 0;
+        cores_.push_back(core);
+    }
+    ResetCoreStats();
+    memory_system_.RegisterCompletionCallback(
+        std::bind(&MultiCoreTraceCPU::ReadDone, this, std::placeholders::_1));
+}
+
+MultiCoreTraceCPU::~MultiCoreTraceCPU() {
+    for (auto& core : cores_) {
+        delete (core.trace_reader);
+    }
+}
+
+void MultiCoreTraceCPU::ClockTick() {
+    memory_system_.ClockTick();
+    clk_++;
+    uint64_t cpu_clk = static_cast<uint64_t>(clk_ * params_.clock_ratio);
+    while (cpu_clk_ < cpu_clk) {
+        for (size_t i = 0; i < cores_.size(); i++) {
+            TickCore(static_cast<int>(i));
+        }
+        cpu_clk_++;
+    }
+    return;
+}
+
+bool MultiCoreTraceCPU::Done() const {
+    for (const auto& core : cores_) {
+        if (!CoreDone(core)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MultiCoreTraceCPU::CoreDone(const Core& core) const {
+    return core.trace_done && !core.has_trans && core.bubbles == 0 &&
+           core.rob_count == 0;
+}
+
+void MultiCoreTraceCPU::TickCore(int core_id) {
+    Core& core = cores_[core_id];
+    if (CoreDone(core)) {
+        return;
+    }
+    core.cycles++;
+    for (int i = 0; i < params_.width && core.rob_count > 0; i++) {
+        if (!core.rob[core.rob_head].done) {
+            break;
+        }
+        core.rob_head = (core.rob_head + 1) % params_.rob_size;
+        core.rob_count--;
+        core.retired++;
+    }
+
+    for (int i = 0; i < params_.width; i++) {
+        if (!core.has_trans && core.bubbles == 0 && !core.trace_done) {
+            core.has_trans = core.trace_reader->Next(core.trans);
+            core.trace_done = !core.has_trans;
+            if (core.has_trans) {
+                if (core.trans.added_cycle > core.last_cycle) {
+                    core.bubbles = (core.trans.added_cycle - core.last_cycle) *
+                                   params_.width;
+                    core.last_cycle = core.trans.added_cycle;
+                }
+            }
+        }
+        if (!core.has_trans && core.bubbles == 0) {
+            break;
+        }
+        if (core.rob_count == params_.rob_size) {
+            core.rob_full_cycles++;
+            break;
+        }
+        int slot = (core.rob_head + core.rob_count) % params_.rob_size;
+        RobEntry& entry = core.rob[slot];
+        entry.dispatch_clk = cpu_clk_;
+        if (core.bubbles > 0) {
+            entry.done = true;
+            core.bubbles--;
+            core.rob_count++;
+            continue;
+        }
+        bool is_write = core.trans.is_write;
+        if (!is_write && core.reads_in_flight == params_.mshrs) {
+            core.mshr_full_cycles++;
+            break;
+        }
+        if (!memory_system_.WillAcceptTransaction(core.trans.addr, is_write)) {
+            core.queue_full_cycles++;
+            break;
+        }
+        // the window slot comes back with the read
+        uint64_t tag = static_cast<uint64_t>(core_id) * params_.rob_size + slot;
+        memory_system_.AddTransaction(core.trans.addr, is_write, tag, core_id);
+        entry.done = is_write;
+        core.rob_count++;
+        core.has_trans = false;
+        if (is_write) {
+            core.writes++;
+        } else {
+            core.reads++;
+            core.reads_in_flight++;
+        }
+    }
+    return;
+}
+
+void MultiCoreTraceCPU::ReadDone(const Completion& completion) {
+    if (completion.is_write) {
+        return;
+    }
+    Core& core = cores_[completion.req_id / params_.rob_size];
+    RobEntry& entry = core.rob[completion.req_id % params_.rob_size];
+    entry.done = true;
+    core.reads_done++;
+    core.read_latency += cpu_clk_ - entry.dispatch_clk;
+    core.reads_in_flight--;
+    return;
+}
+
+void MultiCoreTraceCPU::PrintStats() {
+    CPU::PrintStats();
+    auto print = [](const std::string& name, double value,
+                    const std::string& desc) {
+        std::cout << std::left << std::setw(30) << name << " = " << std::right
+                  << std::setw(12) << value << "   # " << desc << std::endl;
+    };
+    for (size_t i = 0; i < cores_.size(); i++) {
+        const Core& core = cores_[i];
+        std::string prefix = "core_" + std::to_string(i) + "_";
+        print(prefix + "cycles", core.cycles, "CPU cycles until done");
+        print(prefix + "retired", core.retired, "Instructions retired");
+        print(prefix + "ipc",
+              core.cycles > 0 ? static_cast<double>(core.retired) / core.cycles
+                              : 0.0,
+              "Instructions per CPU cycle");
+        print(prefix + "reads", core.reads, "Reads issued");
+        print(prefix + "writes", core.writes, "Writes issued");
+        print(prefix + "avg_read_latency",
+              core.reads_done > 0 ? static_cast<double>(core.read_latency) /
+                                        core.reads_done
+                                  : 0.0,
+              "Average read latency in CPU cycles");
+        print(prefix + "rob_full_cycles", core.rob_full_cycles,
+              "Cycles dispatch stalled on a full window");
+        print(prefix + "mshr_full_cycles", core.mshr_full_cycles,
+              "Cycles dispatch stalled on all MSHRs in use");
+        print(prefix + "queue_full_cycles", core.queue_full_cycles,
+              "Cycles dispatch stalled on the memory system queues");
+    }
+    return;
+}
+
+void MultiCoreTraceCPU::ResetStats() {
+    CPU::ResetStats();
+    ResetCoreStats();
+    return;
+}
+
+void MultiCoreTraceCPU::ResetCoreStats() {
+    for (auto& core : cores_) {
+        core.cycles = 0;
+        core.retired = 0;
+        core.reads = 0;
+        core.writes = 0;
+        core.reads_done = 0;
+        core.read_latency = 0;
+        core.rob_full_cycles = 0;
+        core.mshr_full_cycles = 0;
+        core.queue_full_cycles = 0;
+    }
+    return;
+}
+
 }  // namespace dramsim3
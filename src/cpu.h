@@ -1,11 +1,12 @@
 #ifndef __CPU_H
 #define __CPU_H
 
-#include <fstream>
 #include <functional>
 #include <random>
 #include <string>
+#include <vector>
 #include "memory_system.h"
+#include "trace_reader.h"
 
 namespace dramsim3 {
 
@@ -17,10 +18,30 @@ class CPU {
               std::bind(&CPU::ReadCallBack, this, std::placeholders::_1),
               std::bind(&CPU::WriteCallBack, this, std::placeholders::_1)),
           clk_(0) {}
+    // takes ownership of config
+    CPU(Config* config, const std::string& output_dir)
+        : memory_system_(
+              config, output_dir,
+              std::bind(&CPU::ReadCallBack, this, std::placeholders::_1),
+              std::bind(&CPU::WriteCallBack, this, std::placeholders::_1)),
+          clk_(0) {}
+    virtual ~CPU() {}
     virtual void ClockTick() = 0;
     void ReadCallBack(uint64_t addr) { return; }
     void WriteCallBack(uint64_t addr) { return; }
-    void PrintStats() { memory_system_.PrintStats(); }
+    virtual void PrintStats() { memory_system_.PrintStats(); }
+    virtual void ResetStats() { memory_system_.ResetStats(); }
+    // memory system state only, trace positions and address generators
+    // are not part of checkpoints
+    void SaveCheckpoint(const std::string& file_name) const {
+        memory_system_.SaveCheckpoint(file_name);
+    }
+    void RestoreCheckpoint(const std::string& file_name) {
+        memory_system_.RestoreCheckpoint(file_name);
+    }
+    void SetFastForward(bool fast_forward) {
+        memory_system_.SetFastForward(fast_forward);
+    }
 
    protected:
     MemorySystem memory_system_;
@@ -58,13 +79,87 @@ class TraceBasedCPU : public CPU {
    public:
     TraceBasedCPU(const std::string& config_file, const std::string& output_dir,
                   const std::string& trace_file);
-    ~TraceBasedCPU() { trace_file_.close(); }
+    // takes ownership of config and trace_reader
+    TraceBasedCPU(Config* config, const std::string& output_dir,
+                  TraceReader* trace_reader);
+    ~TraceBasedCPU() { delete (trace_reader_); }
     void ClockTick() override;
 
    private:
-    std::ifstream trace_file_;
+    TraceReader* trace_reader_;
     Transaction trans_;
     bool get_next_ = true;
+    bool trace_done_ = false;
+};
+
+struct CoreParams {
+    // instruction window and in flight reads of a core
+    int rob_size = 128;
+    int mshrs = 16;
+    // instructions dispatched and retired per CPU cycle
+    int width = 4;
+    // CPU cycles per memory cycle
+    double clock_ratio = 1.0;
+};
+
+// Out of order cores replaying one trace each, the cores are the request
+// sources (source_id) of the memory system. A core dispatches up to width
+// instructions per cycle into a window of rob_size instructions and retires
+// them in order. A read holds its window entry until the memory system
+// returns it and a core has at most mshrs reads in flight, writes retire
+// once the memory system accepts them. The cycle gap between two records of
+// a trace is replayed as that many cycles of non-memory instructions at full
+// width, so memory latency delays the requests that follow instead of the
+// trace being issued open loop.
+class MultiCoreTraceCPU : public CPU {
+   public:
+    MultiCoreTraceCPU(const std::string& config_file,
+                      const std::string& output_dir,
+                      const std::vector<std::string>& trace_files,
+                      const CoreParams& params);
+    ~MultiCoreTraceCPU();
+    void ClockTick() override;
+    void PrintStats() override;
+    void ResetStats() override;
+    // all traces replayed and all their reads returned
+    bool Done() const;
+
+   private:
+    struct RobEntry {
+        bool done;
+        uint64_t dispatch_clk;
+    };
+    struct Core {
+        TraceReader* trace_reader;
+        // the next memory record and the non-memory instructions before it
+        Transaction trans;
+        bool has_trans;
+        bool trace_done;
+        uint64_t bubbles;
+        uint64_t last_cycle;
+        // ring buffer of rob_size entries
+        std::vector<RobEntry> rob;
+        int rob_head;
+        int rob_count;
+        int reads_in_flight;
+        // stats
+        uint64_t cycles;
+        uint64_t retired;
+        uint64_t reads;
+        uint64_t writes;
+        uint64_t reads_done;
+        uint64_t read_latency;
+        uint64_t rob_full_cycles;
+        uint64_t mshr_full_cycles;
+        uint64_t queue_full_cycles;
+    };
+    CoreParams params_;
+    std::vector<Core> cores_;
+    uint64_t cpu_clk_;
+    bool CoreDone(const Core& core) const;
+    void TickCore(int core_id);
+    void ReadDone(const Completion& completion);
+    void ResetCoreStats();
 };
 
 }  // namespace dramsim3
@@ -1,88 +1,240 @@
 #include "dram_system.h"
 
 #include <assert.h>
+#include <algorithm>
+#include <iostream>
+#include <limits>
 
 namespace dramsim3 {
 
-// alternative way is to assign the id in constructor but this is less
-// destructive
-int BaseDRAMSystem::total_channels_ = 0;
+namespace {
 
-BaseDRAMSystem::BaseDRAMSystem(Config &config, const std::string &output_dir,
-                               std::function<void(uint64_t)> read_callback,
-                               std::function<void(uint64_t)> write_callback)
+// largest delay from command first to command second in a Timing list, 0 if
+// there is no constraint between them
+int TimingDelay(
+    const std::vector<std::vector<std::pair<CommandType, int>>> &list,
+    CommandType first, CommandType second) {
+    int delay = 0;
+    for (const auto &cmd_timing : list[static_cast<int>(first)]) {
+        if (cmd_timing.first == second) {
+            delay = std::max(delay, cmd_timing.second);
+        }
+    }
+    return delay;
+}
+
+}  // namespace
+
+BaseDRAMSystem::BaseDRAMSystem(
+    const Config &config, const std::string &output_dir,
+    std::function<void(uint64_t)> read_callback,
+    std::function<void(uint64_t)> write_callback)
     : read_callback_(read_callback),
       write_callback_(write_callback),
       last_req_clk_(0),
       config_(config),
+      output_files_(config.OutputFilesIn(output_dir)),
       timing_(config_),
 #ifdef THERMAL
-      thermal_calc_(config_),
+      thermal_calc_(config_, output_files_),
 #endif  // THERMAL
-      clk_(0) {
-    total_channels_ += config_.channels;
-
+      clk_(0),
+      epoch_writer_(nullptr),
+      completions_head_(0) {
 #ifdef ADDR_TRACE
-    std::string addr_trace_name = config_.output_prefix + "addr.trace";
+    std::string addr_trace_name = output_files_.prefix + "addr.trace";
     address_trace_.open(addr_trace_name);
 #endif
 }
 
+BaseDRAMSystem::~BaseDRAMSystem() { delete (epoch_writer_); }
+
+void BaseDRAMSystem::OpenEpochStats() {
+    if (config_.output_level >= 1) {
+        epoch_writer_ =
+            new EpochWriter(output_files_.epoch_stats, config_.epoch_format);
+    }
+    return;
+}
+
 int BaseDRAMSystem::GetChannel(uint64_t hex_addr) const {
-    hex_addr >>= config_.shift_bits;
-    return (hex_addr >> config_.ch_pos) & config_.ch_mask;
+    return config_.address_mapper.Channel(hex_addr);
 }
 
 void BaseDRAMSystem::PrintEpochStats() {
-    // first epoch, print bracket
-    if (clk_ - config_.epoch_period == 0) {
-        std::ofstream epoch_out(config_.json_epoch_name, std::ofstream::out);
-        epoch_out << "[";
-    }
+    PROFILE_SCOPE(profiler_, EPOCH_STATS);
     for (size_t i = 0; i < ctrls_.size(); i++) {
-        ctrls_[i]->PrintEpochStats();
-        std::ofstream epoch_out(config_.json_epoch_name, std::ofstream::app);
-        epoch_out << "," << std::endl;
+        ctrls_[i]->PrintEpochStats(epoch_writer_);
     }
 #ifdef THERMAL
-    thermal_calc_.PrintTransPT(clk_);
+    {
+        PROFILE_SCOPE(profiler_, THERMAL_SOLVER);
+        thermal_calc_.PrintTransPT(clk_);
+    }
 #endif  // THERMAL
     return;
 }
 
 void BaseDRAMSystem::PrintStats() {
-    // Finish epoch output, remove last comma and append ]
-    std::ofstream epoch_out(config_.json_epoch_name, std::ios_base::in |
-                                                         std::ios_base::out |
-                                                         std::ios_base::ate);
-    epoch_out.seekp(-2, std::ios_base::cur);
-    epoch_out.write("]", 1);
-    epoch_out.close();
-
-    std::ofstream json_out(config_.json_stats_name, std::ofstream::out);
-    json_out << "{";
-
-    // close it now so that each channel can handle it
-    json_out.close();
+    // make sure the epoch stats are complete once the final stats are out
+    if (epoch_writer_) {
+        epoch_writer_->Flush();
+    }
+
+    // the channels only compute their stats without a JSON file
+    bool json = config_.output_level >= 0;
+    std::ofstream json_out;
+    if (json) {
+        json_out.open(output_files_.json_stats, std::ofstream::out);
+        json_out << "{";
+        // close it now so that each channel can handle it
+        json_out.close();
+    }
     for (size_t i = 0; i < ctrls_.size(); i++) {
         ctrls_[i]->PrintFinalStats();
-        if (i != ctrls_.size() - 1) {
-            std::ofstream chan_out(config_.json_stats_name, std::ofstream::app);
+        if (json && i != ctrls_.size() - 1) {
+            std::ofstream chan_out(output_files_.json_stats,
+                                   std::ofstream::app);
             chan_out << "," << std::endl;
         }
     }
-    json_out.open(config_.json_stats_name, std::ofstream::app);
-    json_out << "}";
+    if (json) {
+        json_out.open(output_files_.json_stats, std::ofstream::app);
+        json_out << "}";
+    }
 
 #ifdef THERMAL
-    thermal_calc_.PrintFinalPT(clk_);
+    {
+        PROFILE_SCOPE(profiler_, THERMAL_SOLVER);
+        thermal_calc_.PrintFinalPT(clk_);
+    }
 #endif  // THERMAL
+
+#ifdef PROFILE
+    Profiler profile = profiler_;
+    for (auto ctrl : ctrls_) {
+        profile.Merge(ctrl->GetProfiler());
+    }
+    profile.Print(std::cout, clk_);
+#endif  // PROFILE
+}
+
+nlohmann::json BaseDRAMSystem::FinalStats() const {
+    nlohmann::json stats = nlohmann::json::object();
+    for (size_t i = 0; i < ctrls_.size(); i++) {
+        stats[std::to_string(i)] = ctrls_[i]->FinalStats();
+    }
+    return stats;
 }
 
 void BaseDRAMSystem::ResetStats() {
     for (size_t i = 0; i < ctrls_.size(); i++) {
         ctrls_[i]->ResetStats();
     }
+#ifdef PROFILE
+    profiler_.Reset(clk_);
+#endif  // PROFILE
+}
+
+size_t BaseDRAMSystem::DrainCompletions(Completion *out, size_t max_num) {
+    size_t num = std::min(max_num, completions_.size() - completions_head_);
+    std::copy(completions_.begin() + completions_head_,
+              completions_.begin() + completions_head_ + num, out);
+    completions_head_ += num;
+    if (completions_head_ == completions_.size()) {
+        completions_.clear();
+        completions_head_ = 0;
+    }
+    return num;
+}
+
+void BaseDRAMSystem::CompleteRequest(Completion completion) {
+    completion.complete_cycle = clk_;
+    if (completion_callback_) {
+        completion_callback_(completion);
+    } else if (completion.is_write && write_callback_) {
+        write_callback_(completion.addr);
+    } else if (!completion.is_write && read_callback_) {
+        read_callback_(completion.addr);
+    } else {
+        completions_.push_back(completion);
+    }
+    return;
+}
+
+void BaseDRAMSystem::CompleteRequest(const Transaction &trans) {
+    CompleteRequest({trans.addr, trans.is_write, trans.req_id, trans.source_id,
+                     trans.issue_cycle, 0});
+    return;
+}
+
+void BaseDRAMSystem::Save(CheckpointWriter &writer) {
+    writer.Section("dram_system");
+    writer.Put(last_req_clk_);
+    writer.Put(clk_);
+    writer.Put(completions_);
+    writer.Put(completions_head_);
+    for (auto ctrl : ctrls_) {
+        ctrl->Save(writer);
+    }
+    return;
+}
+
+void BaseDRAMSystem::Restore(CheckpointReader &reader) {
+    reader.Section("dram_system");
+    reader.Get(last_req_clk_);
+    reader.Get(clk_);
+    reader.Get(completions_);
+    reader.Get(completions_head_);
+    for (auto ctrl : ctrls_) {
+        ctrl->Restore(reader);
+    }
+    return;
+}
+
+bool BaseDRAMSystem::IsIdle() const {
+    for (auto ctrl : ctrls_) {
+        if (!ctrl->IsIdle()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BaseDRAMSystem::ForwardTo(uint64_t clk) {
+    if (clk <= clk_) {
+        return;
+    }
+    for (auto ctrl : ctrls_) {
+        ctrl->ForwardClock(clk - clk_);
+    }
+    clk_ = clk;
+    return;
+}
+
+void BaseDRAMSystem::ClockTickTo(uint64_t clk) {
+    while (clk_ < clk) {
+        ClockTick();
+    }
+    return;
+}
+
+std::vector<int> BaseDRAMSystem::OpenRows() const {
+    std::vector<int> rows;
+    for (auto ctrl : ctrls_) {
+        const auto &ctrl_rows = ctrl->OpenRows();
+        rows.insert(rows.end(), ctrl_rows.begin(), ctrl_rows.end());
+    }
+    return rows;
+}
+
+void BaseDRAMSystem::SetOpenRows(const std::vector<int> &rows) {
+    size_t num_banks = static_cast<size_t>(config_.ranks * config_.banks);
+    for (size_t i = 0; i < ctrls_.size(); i++) {
+        ctrls_[i]->SetOpenRows(std::vector<int>(
+            rows.begin() + i * num_banks, rows.begin() + (i + 1) * num_banks));
+    }
+    return;
 }
 
 void BaseDRAMSystem::RegisterCallbacks(
@@ -93,10 +245,19 @@ void BaseDRAMSystem::RegisterCallbacks(
     write_callback_ = write_callback;
 }
 
-JedecDRAMSystem::JedecDRAMSystem(Config &config, const std::string &output_dir,
-                                 std::function<void(uint64_t)> read_callback,
-                                 std::function<void(uint64_t)> write_callback)
-    : BaseDRAMSystem(config, output_dir, read_callback, write_callback) {
+void BaseDRAMSystem::RegisterCompletionCallback(
+    std::function<void(const Completion &)> completion_callback) {
+    completion_callback_ = completion_callback;
+}
+
+JedecDRAMSystem::JedecDRAMSystem(
+    const Config &config, const std::string &output_dir,
+    std::function<void(uint64_t)> read_callback,
+    std::function<void(uint64_t)> write_callback)
+    : BaseDRAMSystem(config, output_dir, read_callback, write_callback),
+      ctrl_clk_(0),
+      next_event_clk_(0),
+      workers_(nullptr) {
     if (config_.IsHMC()) {
         std::cerr << "Initialized a memory system with an HMC config file!"
                   << std::endl;
@@ -106,14 +267,24 @@ JedecDRAMSystem::JedecDRAMSystem(Config &config, const std::string &output_dir,
     ctrls_.reserve(config_.channels);
     for (auto i = 0; i < config_.channels; i++) {
 #ifdef THERMAL
-        ctrls_.push_back(new Controller(i, config_, timing_, thermal_calc_));
+        ctrls_.push_back(new Controller(i, config_, output_files_, timing_,
+                                        thermal_calc_));
 #else
-        ctrls_.push_back(new Controller(i, config_, timing_));
+        ctrls_.push_back(new Controller(i, config_, output_files_, timing_));
 #endif  // THERMAL
     }
+
+    int num_threads = std::min(config_.num_threads, config_.channels);
+    if (num_threads > 1) {
+        workers_ = new WorkerPool(num_threads);
+        returned_trans_.resize(ctrls_.size());
+        returned_pos_.resize(ctrls_.size(), 0);
+    }
+    OpenEpochStats();
 }
 
 JedecDRAMSystem::~JedecDRAMSystem() {
+    delete (workers_);
     for (auto it = ctrls_.begin(); it != ctrls_.end(); it++) {
         delete (*it);
     }
@@ -125,43 +296,66 @@ bool JedecDRAMSystem::WillAcceptTransaction(uint64_t hex_addr,
     return ctrls_[channel]->WillAcceptTransaction(hex_addr, is_write);
 }
 
-bool JedecDRAMSystem::AddTransaction(uint64_t hex_addr, bool is_write) {
+size_t JedecDRAMSystem::AddTransactions(const Request *reqs, size_t num) {
+    size_t added = 0;
+    for (; added < num; added++) {
+        const Request &req = reqs[added];
 // Record trace - Record address trace for debugging or other purposes
 #ifdef ADDR_TRACE
-    address_trace_ << std::hex << hex_addr << std::dec << " "
-                   << (is_write ? "WRITE " : "READ ") << clk_ << std::endl;
+        address_trace_ << std::hex << req.addr << std::dec << " "
+                       << (req.is_write ? "WRITE " : "READ ") << clk_
+                       << std::endl;
 #endif
-
-    int channel = GetChannel(hex_addr);
-    bool ok = ctrls_[channel]->WillAcceptTransaction(hex_addr, is_write);
-
-    assert(ok);
-    if (ok) {
-        Transaction trans = Transaction(hex_addr, is_write);
+        int channel = GetChannel(req.addr);
+        if (!ctrls_[channel]->WillAcceptTransaction(req.addr, req.is_write)) {
+            break;
+        }
+        if (added == 0) {
+            SyncControllers();
+        }
+        Transaction trans = Transaction(req.addr, req.is_write);
+        trans.req_id = req.req_id;
+        trans.source_id = req.source_id;
+        trans.priority = req.priority;
+        trans.issue_cycle = clk_;
         ctrls_[channel]->AddTransaction(trans);
     }
+    if (added > 0) {
+        next_event_clk_ = clk_;
+    }
     last_req_clk_ = clk_;
-    return ok;
+    return added;
 }
 
 void JedecDRAMSystem::ClockTick() {
-    for (size_t i = 0; i < ctrls_.size(); i++) {
-        // look ahead and return earlier
-        while (true) {
-            auto pair = ctrls_[i]->ReturnDoneTrans(clk_);
-            if (pair.second == 1) {
-                write_callback_(pair.first);
-            } else if (pair.second == 0) {
-                read_callback_(pair.first);
-            } else {
-                break;
+    if (ctrl_clk_ > clk_) {
+        // controllers already ran ahead, catch up with their returns
+        DeliverReturnedTrans();
+        clk_++;
+    } else if (config_.event_driven && clk_ < next_event_clk_) {
+        clk_++;
+        if (clk_ % config_.epoch_period == 0) {
+            SyncControllers();
+            PrintEpochStats();
+        }
+        return;
+    } else {
+        SyncControllers();
+        ReturnDoneTrans();
+        if (workers_) {
+            TickControllersParallel();
+        } else {
+            PROFILE_SCOPE(profiler_, CONTROLLERS);
+            for (size_t i = 0; i < ctrls_.size(); i++) {
+                ctrls_[i]->ClockTick();
             }
+            ctrl_clk_ = clk_ + 1;
         }
+        clk_++;
     }
-    for (size_t i = 0; i < ctrls_.size(); i++) {
-        ctrls_[i]->ClockTick();
+    if (config_.event_driven && ctrl_clk_ == clk_) {
+        UpdateNextEvent();
     }
-    clk_++;
 
     if (clk_ % config_.epoch_period == 0) {
         PrintEpochStats();
@@ -169,39 +363,375 @@ void JedecDRAMSystem::ClockTick() {
     return;
 }
 
-IdealDRAMSystem::IdealDRAMSystem(Config &config, const std::string &output_dir,
-                                 std::function<void(uint64_t)> read_callback,
-                                 std::function<void(uint64_t)> write_callback)
+void JedecDRAMSystem::ClockTickTo(uint64_t clk) {
+    while (clk_ < clk) {
+        if (config_.event_driven && ctrl_clk_ <= clk_ &&
+            clk_ < next_event_clk_) {
+            // the idle cycles of ClockTick at once, up to the next event or
+            // epoch boundary
+            uint64_t epoch = static_cast<uint64_t>(config_.epoch_period);
+            uint64_t next_epoch = (clk_ / epoch + 1) * epoch;
+            clk_ = std::min(std::min(clk, next_event_clk_), next_epoch);
+            if (clk_ % epoch == 0) {
+                SyncControllers();
+                PrintEpochStats();
+            }
+        } else {
+            ClockTick();
+        }
+    }
+    return;
+}
+
+void JedecDRAMSystem::ReturnDoneTrans() {
+    PROFILE_SCOPE(profiler_, RETURNS);
+    for (size_t i = 0; i < ctrls_.size(); i++) {
+        done_trans_.clear();
+        ctrls_[i]->ReturnDoneTrans(clk_, done_trans_);
+        for (const auto &trans : done_trans_) {
+            CompleteRequest(trans);
+        }
+    }
+    return;
+}
+
+void JedecDRAMSystem::TickControllersParallel() {
+    PROFILE_SCOPE(profiler_, CONTROLLERS);
+    // never run past an epoch boundary so that epoch stats stay aligned
+    uint64_t cycles = static_cast<uint64_t>(config_.parallel_quantum);
+    uint64_t epoch_left = config_.epoch_period - clk_ % config_.epoch_period;
+    cycles = std::min(cycles, epoch_left);
+    uint64_t start_clk = clk_;
+    for (size_t i = 0; i < ctrls_.size(); i++) {
+        returned_trans_[i].clear();
+        returned_pos_[i] = 0;
+    }
+
+    int num_workers = workers_->NumThreads();
+    workers_->Run([this, cycles, start_clk, num_workers](int worker_id) {
+        std::vector<Transaction> done;
+        for (size_t i = worker_id; i < ctrls_.size(); i += num_workers) {
+            ctrls_[i]->ClockTick();
+            for (uint64_t clk = start_clk + 1; clk < start_clk + cycles;
+                 clk++) {
+                done.clear();
+                ctrls_[i]->ReturnDoneTrans(clk, done);
+                for (const auto &trans : done) {
+                    returned_trans_[i].push_back({clk, trans});
+                }
+                ctrls_[i]->ClockTick();
+            }
+        }
+    });
+    ctrl_clk_ = start_clk + cycles;
+    return;
+}
+
+void JedecDRAMSystem::DeliverReturnedTrans() {
+    PROFILE_SCOPE(profiler_, RETURNS);
+    for (size_t i = 0; i < returned_trans_.size(); i++) {
+        auto &returned = returned_trans_[i];
+        auto &pos = returned_pos_[i];
+        while (pos < returned.size() && returned[pos].clk == clk_) {
+            const auto &trans = returned[pos].trans;
+            CompleteRequest(trans);
+            pos++;
+        }
+    }
+    return;
+}
+
+void JedecDRAMSystem::PrintStats() {
+    SyncControllers();
+    BaseDRAMSystem::PrintStats();
+}
+
+void JedecDRAMSystem::ResetStats() {
+    SyncControllers();
+    BaseDRAMSystem::ResetStats();
+}
+
+void JedecDRAMSystem::Save(CheckpointWriter &writer) {
+    // skipped cycles are accounted for first so that the controllers are
+    // saved at the system clock (or ahead of it in parallel mode)
+    SyncControllers();
+    BaseDRAMSystem::Save(writer);
+    writer.Put(ctrl_clk_);
+    writer.Put(next_event_clk_);
+    // transactions returned ahead of the system clock in parallel mode, a
+    // restored system delivers them whether it runs in parallel or not
+    writer.Put(static_cast<uint64_t>(returned_trans_.size()));
+    for (size_t i = 0; i < returned_trans_.size(); i++) {
+        writer.Put(static_cast<uint64_t>(returned_trans_[i].size()));
+        for (const auto &returned : returned_trans_[i]) {
+            writer.Put(returned.clk);
+            writer.Put(returned.trans);
+        }
+        writer.Put(returned_pos_[i]);
+    }
+    return;
+}
+
+void JedecDRAMSystem::Restore(CheckpointReader &reader) {
+    BaseDRAMSystem::Restore(reader);
+    reader.Get(ctrl_clk_);
+    reader.Get(next_event_clk_);
+    uint64_t num_channels;
+    reader.Get(num_channels);
+    for (auto &returned : returned_trans_) {
+        returned.clear();
+    }
+    std::fill(returned_pos_.begin(), returned_pos_.end(), 0);
+    if (num_channels > 0) {
+        returned_trans_.resize(ctrls_.size());
+        returned_pos_.resize(ctrls_.size(), 0);
+    }
+    for (uint64_t i = 0; i < num_channels; i++) {
+        uint64_t num_returned;
+        reader.Get(num_returned);
+        returned_trans_[i].resize(num_returned);
+        for (auto &returned : returned_trans_[i]) {
+            reader.Get(returned.clk);
+            reader.Get(returned.trans);
+        }
+        reader.Get(returned_pos_[i]);
+    }
+    return;
+}
+
+bool JedecDRAMSystem::IsIdle() const {
+    // with controllers ahead of the clock returns are still to be delivered
+    return ctrl_clk_ <= clk_ && BaseDRAMSystem::IsIdle();
+}
+
+void JedecDRAMSystem::ForwardTo(uint64_t clk) {
+    // cycles that were skipped in event driven mode did happen
+    SyncControllers();
+    BaseDRAMSystem::ForwardTo(clk);
+    ctrl_clk_ = clk_;
+    next_event_clk_ = clk_;
+    return;
+}
+
+void JedecDRAMSystem::SyncControllers() {
+    if (ctrl_clk_ < clk_) {
+        for (auto ctrl : ctrls_) {
+            ctrl->SkipCycles(clk_ - ctrl_clk_);
+        }
+        ctrl_clk_ = clk_;
+    }
+    return;
+}
+
+void JedecDRAMSystem::UpdateNextEvent() {
+    next_event_clk_ = std::numeric_limits<uint64_t>::max();
+    for (auto ctrl : ctrls_) {
+        next_event_clk_ = std::min(next_event_clk_, ctrl->NextEventCycle());
+        if (next_event_clk_ <= clk_) {
+            break;
+        }
+    }
+    return;
+}
+
+IdealDRAMSystem::IdealDRAMSystem(
+    const Config &config, const std::string &output_dir,
+    std::function<void(uint64_t)> read_callback,
+    std::function<void(uint64_t)> write_callback)
     : BaseDRAMSystem(config, output_dir, read_callback, write_callback),
-      latency_(config_.ideal_memory_latency) {}
+      latency_(config_.ideal_memory_latency) {
+    OpenEpochStats();
+}
 
 IdealDRAMSystem::~IdealDRAMSystem() {}
 
-bool IdealDRAMSystem::AddTransaction(uint64_t hex_addr, bool is_write) {
-    auto trans = Transaction(hex_addr, is_write);
-    trans.added_cycle = clk_;
-    infinite_buffer_q_.push_back(trans);
-    return true;
+size_t IdealDRAMSystem::AddTransactions(const Request *reqs, size_t num) {
+    for (size_t i = 0; i < num; i++) {
+        auto trans = Transaction(reqs[i].addr, reqs[i].is_write);
+        trans.req_id = reqs[i].req_id;
+        trans.source_id = reqs[i].source_id;
+        trans.priority = reqs[i].priority;
+        trans.added_cycle = clk_;
+        trans.issue_cycle = clk_;
+        infinite_buffer_q_.push_back(trans);
+    }
+    return num;
 }
 
 void IdealDRAMSystem::ClockTick() {
-    for (auto trans_it = infinite_buffer_q_.begin();
-         trans_it != infinite_buffer_q_.end();) {
-        if (clk_ - trans_it->added_cycle >= static_cast<uint64_t>(latency_)) {
-            if (trans_it->is_write) {
-                write_callback_(trans_it->addr);
-            } else {
-                read_callback_(trans_it->addr);
-            }
-            trans_it = infinite_buffer_q_.erase(trans_it++);
+    while (!infinite_buffer_q_.empty() &&
+           clk_ - infinite_buffer_q_.front().added_cycle >=
+               static_cast<uint64_t>(latency_)) {
+        CompleteRequest(infinite_buffer_q_.front());
+        infinite_buffer_q_.pop_front();
+    }
+
+    clk_++;
+    return;
+}
+
+void IdealDRAMSystem::Save(CheckpointWriter &writer) {
+    BaseDRAMSystem::Save(writer);
+    writer.Put(std::vector<Transaction>(infinite_buffer_q_.begin(),
+                                        infinite_buffer_q_.end()));
+    return;
+}
+
+void IdealDRAMSystem::Restore(CheckpointReader &reader) {
+    BaseDRAMSystem::Restore(reader);
+    std::vector<Transaction> buffer;
+    reader.Get(buffer);
+    infinite_buffer_q_.assign(buffer.begin(), buffer.end());
+    return;
+}
+
+FastForwardDRAMSystem::FastForwardDRAMSystem(
+    const Config &config, const std::string &output_dir,
+    std::function<void(uint64_t)> read_callback,
+    std::function<void(uint64_t)> write_callback)
+    : BaseDRAMSystem(config, output_dir, read_callback, write_callback),
+      close_page_(config.row_buf_policy == "CLOSE_PAGE"),
+      write_batch_(config.unified_queue ? 1 : config.write_buf_size),
+      next_seq_(0) {
+    const CommandType kRD = CommandType::READ;
+    const CommandType kWR = CommandType::WRITE;
+    const CommandType kACT = CommandType::ACTIVATE;
+    const CommandType kPRE = CommandType::PRECHARGE;
+    act_to_read_ = TimingDelay(timing_.same_bank, kACT, kRD);
+    act_to_write_ = TimingDelay(timing_.same_bank, kACT, kWR);
+    act_to_act_ = TimingDelay(timing_.same_bank, kACT, kACT);
+    act_to_pre_ = TimingDelay(timing_.same_bank, kACT, kPRE);
+    pre_to_act_ = TimingDelay(timing_.same_bank, kPRE, kACT);
+    read_to_pre_ = TimingDelay(timing_.same_bank, kRD, kPRE);
+    write_to_pre_ = TimingDelay(timing_.same_bank, kWR, kPRE);
+    // consecutive requests usually go to different banks, the spacing of
+    // column commands in other bankgroups is what the data bus allows
+    const auto &other_bgs = config_.bankgroups > 1
+                                ? timing_.other_bankgroups_same_rank
+                                : timing_.other_banks_same_bankgroup;
+    col_to_col_[0][0] = TimingDelay(other_bgs, kRD, kRD);
+    col_to_col_[0][1] = TimingDelay(other_bgs, kRD, kWR);
+    col_to_col_[1][0] = TimingDelay(other_bgs, kWR, kRD);
+    col_to_col_[1][1] = TimingDelay(other_bgs, kWR, kWR);
+
+    Channel channel;
+    channel.banks.resize(config_.ranks * config_.banks, Bank{-1, 0, 0, 0});
+    channel.last_col = 0;
+    channel.last_write = false;
+    channels_.resize(config_.channels, channel);
+}
+
+bool FastForwardDRAMSystem::WillAcceptTransaction(uint64_t hex_addr,
+                                                  bool is_write) const {
+    const Channel &channel = channels_[GetChannel(hex_addr)];
+    size_t reads = channel.col_cycles[0].size();
+    size_t writes = channel.col_cycles[1].size();
+    if (config_.unified_queue) {
+        return reads + writes < static_cast<size_t>(config_.trans_queue_size);
+    } else if (is_write) {
+        return writes < static_cast<size_t>(config_.write_buf_size);
+    }
+    return reads < static_cast<size_t>(config_.trans_queue_size);
+}
+
+size_t FastForwardDRAMSystem::AddTransactions(const Request *reqs,
+                                              size_t num) {
+    size_t added = 0;
+    for (; added < num; added++) {
+        const Request &req = reqs[added];
+        if (!WillAcceptTransaction(req.addr, req.is_write)) {
+            break;
         }
-        if (trans_it != infinite_buffer_q_.end()) {
-            ++trans_it;
+        Transaction trans(req.addr, req.is_write);
+        trans.req_id = req.req_id;
+        trans.source_id = req.source_id;
+        trans.priority = req.priority;
+        trans.added_cycle = clk_;
+        trans.issue_cycle = clk_;
+        trans.complete_cycle = Serve(trans);
+        returns_.push({trans.complete_cycle, next_seq_++, trans});
+    }
+    last_req_clk_ = clk_;
+    return added;
+}
+
+uint64_t FastForwardDRAMSystem::Serve(const Transaction &trans) {
+    Address addr = config_.AddressMapping(trans.addr);
+    Channel &channel = channels_[addr.channel];
+    Bank &bank = channel.banks[addr.rank * config_.banks +
+                               addr.bankgroup * config_.banks_per_group +
+                               addr.bank];
+    uint64_t col_ready = std::max(clk_, bank.col_ready);
+    if (bank.open_row != addr.row) {
+        uint64_t act = std::max(clk_, bank.act_ready);
+        if (bank.open_row >= 0) {  // conflict, precharge first
+            act = std::max(act, std::max(clk_, bank.pre_ready) + pre_to_act_);
         }
+        bank.open_row = addr.row;
+        bank.act_ready = act + act_to_act_;
+        bank.pre_ready = act + act_to_pre_;
+        col_ready = act + (trans.is_write ? act_to_write_ : act_to_read_);
     }
+    // the request takes the next slot on the data bus, a request that has
+    // to wait for its bank leaves the slots before it to later requests the
+    // way a reordering scheduler would
+    // way a reordering scheduler would. Separate write buffers are drained
+    // in batches, so read/write turnarounds are shared by a batch of writes
+    int spacing = col_to_col_[channel.last_write][trans.is_write];
+    if (channel.last_write != trans.is_write) {
+        int same = col_to_col_[trans.is_write][trans.is_write];
+        spacing = same + std::max(spacing - same, 0) / write_batch_;
+    }
+    uint64_t slot = std::max(clk_, channel.last_col + spacing);
+    uint64_t col = std::max(col_ready, slot);
+    channel.last_col = slot;
+    channel.last_write = trans.is_write;
+    channel.col_cycles[trans.is_write].push(col);
+    bank.col_ready = col;
+    bank.pre_ready = std::max(
+        bank.pre_ready, col + (trans.is_write ? write_to_pre_ : read_to_pre_));
+    if (close_page_) {
+        bank.act_ready = std::max(bank.act_ready, bank.pre_ready + pre_to_act_);
+        bank.open_row = -1;
+    }
+    // writes are done once they are buffered, as in the controllers
+    return trans.is_write ? clk_ + 1 : col + config_.read_delay;
+}
 
+void FastForwardDRAMSystem::ClockTick() {
+    while (!returns_.empty() && returns_.top().clk <= clk_) {
+        CompleteRequest(returns_.top().trans);
+        returns_.pop();
+    }
+    for (auto &channel : channels_) {
+        for (auto &col_cycles : channel.col_cycles) {
+            while (!col_cycles.empty() && col_cycles.top() <= clk_) {
+                col_cycles.pop();
+            }
+        }
+    }
     clk_++;
     return;
 }
 
+std::vector<int> FastForwardDRAMSystem::OpenRows() const {
+    std::vector<int> rows;
+    for (const auto &channel : channels_) {
+        for (const auto &bank : channel.banks) {
+            rows.push_back(bank.open_row);
+        }
+    }
+    return rows;
+}
+
+void FastForwardDRAMSystem::SetOpenRows(const std::vector<int> &rows) {
+    size_t i = 0;
+    for (auto &channel : channels_) {
+        for (auto &bank : channel.banks) {
+            bank.open_row = rows[i++];
+        }
+    }
+    return;
+}
+
 }  // namespace dramsim3
@@ -1,14 +1,20 @@
 #ifndef __DRAM_SYSTEM_H
 #define __DRAM_SYSTEM_H
 
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <queue>
 #include <string>
 #include <vector>
 
+#include "checkpoint.h"
 #include "common.h"
 #include "configuration.h"
 #include "controller.h"
+#include "request.h"
 #include "timing.h"
+#include "worker_pool.h"
 
 #ifdef THERMAL
 #include "thermal.h"
@@ -18,29 +24,70 @@ namespace dramsim3 {
 
 class BaseDRAMSystem {
    public:
-    BaseDRAMSystem(Config &config, const std::string &output_dir,
+    BaseDRAMSystem(const Config &config, const std::string &output_dir,
                    std::function<void(uint64_t)> read_callback,
                    std::function<void(uint64_t)> write_callback);
-    virtual ~BaseDRAMSystem() {}
+    virtual ~BaseDRAMSystem();
     void RegisterCallbacks(std::function<void(uint64_t)> read_callback,
                            std::function<void(uint64_t)> write_callback);
+    // called for every completed read and write instead of the address
+    // callbacks, an empty function switches back to them
+    void RegisterCompletionCallback(
+        std::function<void(const Completion &)> completion_callback);
     void PrintEpochStats();
-    void PrintStats();
-    void ResetStats();
+    virtual void PrintStats();
+    virtual void ResetStats();
+    // the final stats of the channels once they are printed, keyed by
+    // channel id as in the JSON stats file
+    nlohmann::json FinalStats() const;
 
     virtual bool WillAcceptTransaction(uint64_t hex_addr,
                                        bool is_write) const = 0;
-    virtual bool AddTransaction(uint64_t hex_addr, bool is_write) = 0;
+    // adds requests in order until one is not accepted, returns the number
+    // of requests added
+    virtual size_t AddTransactions(const Request *reqs, size_t num) = 0;
+    bool AddTransaction(uint64_t hex_addr, bool is_write) {
+        Request req(hex_addr, is_write, hex_addr);
+        return AddTransactions(&req, 1) == 1;
+    }
+    bool AddTransaction(uint64_t hex_addr, bool is_write, uint64_t tag,
+                        int source_id, int priority) {
+        Request req(hex_addr, is_write, tag, source_id, priority);
+        return AddTransactions(&req, 1) == 1;
+    }
+    // completions of the requests that have no callback, oldest first,
+    // returns the number of completions copied to out
+    size_t DrainCompletions(Completion *out, size_t max_num);
     virtual void ClockTick() = 0;
+    // ticks until the clock reaches clk, systems that know nothing happens
+    // for a while jump over it
+    virtual void ClockTickTo(uint64_t clk);
     int GetChannel(uint64_t hex_addr) const;
+    // the simulation state to/from a checkpoint, callbacks are not part of
+    // it and stay as they are registered
+    virtual void Save(CheckpointWriter &writer);
+    virtual void Restore(CheckpointReader &reader);
+
+    // Switching between memory systems (see MemorySystem::SetFastForward):
+    // whether requests are in flight, moving the clock of an idle system
+    // forward without simulating (or counting) the cycles in between, and
+    // the open row (-1 if closed) of every bank, channel by channel in
+    // (rank, bankgroup, bank) order
+    virtual bool IsIdle() const;
+    virtual void ForwardTo(uint64_t clk);
+    virtual std::vector<int> OpenRows() const;
+    virtual void SetOpenRows(const std::vector<int> &rows);
+    uint64_t Clock() const { return clk_; }
 
     std::function<void(uint64_t req_id)> read_callback_, write_callback_;
-    static int total_channels_;
+    std::function<void(const Completion &)> completion_callback_;
 
    protected:
     uint64_t id_;
     uint64_t last_req_clk_;
-    Config &config_;
+    const Config &config_;
+    // under output_dir, which need not be that of config_
+    OutputFiles output_files_;
     Timing timing_;
     uint64_t parallel_cycles_;
     uint64_t serial_cycles_;
@@ -49,8 +96,28 @@ class BaseDRAMSystem {
     ThermalCalculator thermal_calc_;
 #endif  // THERMAL
 
+#ifdef PROFILE
+    // system level phases, the controllers keep their own profiles
+    Profiler profiler_;
+#endif  // PROFILE
+
     uint64_t clk_;
     std::vector<Controller*> ctrls_;
+    // transactions returned by the controllers in a cycle, kept so that
+    // returning them does not allocate
+    std::vector<Transaction> done_trans_;
+    // shared by all channels, nullptr if epoch stats are off or the system
+    // has no channel stats
+    EpochWriter *epoch_writer_;
+    void OpenEpochStats();
+
+    // calls the completion callback or the callback of the request type if
+    // there is one, otherwise queues the completion to be drained, the
+    // complete cycle is filled in here
+    void CompleteRequest(Completion completion);
+    void CompleteRequest(const Transaction &trans);
+    std::vector<Completion> completions_;
+    size_t completions_head_;
 
 #ifdef ADDR_TRACE
     std::ofstream address_trace_;
@@ -60,13 +127,42 @@ class BaseDRAMSystem {
 // hmmm not sure this is the best naming...
 class JedecDRAMSystem : public BaseDRAMSystem {
    public:
-    JedecDRAMSystem(Config &config, const std::string &output_dir,
+    JedecDRAMSystem(const Config &config, const std::string &output_dir,
                     std::function<void(uint64_t)> read_callback,
                     std::function<void(uint64_t)> write_callback);
     ~JedecDRAMSystem();
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const override;
-    bool AddTransaction(uint64_t hex_addr, bool is_write) override;
+    size_t AddTransactions(const Request *reqs, size_t num) override;
     void ClockTick() override;
+    void ClockTickTo(uint64_t clk) override;
+    void PrintStats() override;
+    void ResetStats() override;
+    void Save(CheckpointWriter &writer) override;
+    void Restore(CheckpointReader &reader) override;
+    bool IsIdle() const override;
+    void ForwardTo(uint64_t clk) override;
+
+   private:
+    // event driven mode: controllers are only ticked when any of them is
+    // able to do something, skipped cycles are accounted for lazily
+    uint64_t ctrl_clk_;
+    uint64_t next_event_clk_;
+    void SyncControllers();
+    void UpdateNextEvent();
+
+    // parallel mode: workers tick channel subsets for a quantum of cycles,
+    // transactions finished within the quantum are buffered per channel and
+    // delivered in channel order once the system clock gets there
+    struct ReturnedTrans {
+        uint64_t clk;
+        Transaction trans;
+    };
+    WorkerPool *workers_;
+    std::vector<std::vector<ReturnedTrans>> returned_trans_;
+    std::vector<size_t> returned_pos_;
+    void TickControllersParallel();
+    void DeliverReturnedTrans();
+    void ReturnDoneTrans();
 };
 
 // Model a memorysystem with an infinite bandwidth and a fixed latency (possibly
@@ -74,7 +170,7 @@ class JedecDRAMSystem : public BaseDRAMSystem {
 // cannot do for a given application
 class IdealDRAMSystem : public BaseDRAMSystem {
    public:
-    IdealDRAMSystem(Config &config, const std::string &output_dir,
+    IdealDRAMSystem(const Config &config, const std::string &output_dir,
                     std::function<void(uint64_t)> read_callback,
                     std::function<void(uint64_t)> write_callback);
     ~IdealDRAMSystem();
@@ -82,12 +178,87 @@ class IdealDRAMSystem : public BaseDRAMSystem {
                                bool is_write) const override {
         return true;
     };
-    bool AddTransaction(uint64_t hex_addr, bool is_write) override;
+    size_t AddTransactions(const Request *reqs, size_t num) override;
     void ClockTick() override;
+    void Save(CheckpointWriter &writer) override;
+    void Restore(CheckpointReader &reader) override;
+    bool IsIdle() const override { return infinite_buffer_q_.empty(); }
 
    private:
     int latency_;
-    std::vector<Transaction> infinite_buffer_q_;
+    // in arrival order, which with a fixed latency is also completion order
+    std::deque<Transaction> infinite_buffer_q_;
+};
+
+// Analytical memory system for the parts of a run that need no cycle
+// accuracy, e.g. warm-up between sampled regions. Each request is charged
+// the latency of a row hit, miss or conflict given the ACT/PRE constraints
+// of its bank and the column command spacing of its channel (data bus
+// occupancy and read/write turnarounds), all taken from the Timing lists.
+// A channel takes as many requests as its transaction queue and write buffer
+// hold until their column commands issue. Refresh, power down and
+// activation windows are not modeled and no stats are kept.
+class FastForwardDRAMSystem : public BaseDRAMSystem {
+   public:
+    FastForwardDRAMSystem(const Config &config,
+                          const std::string &output_dir,
+                          std::function<void(uint64_t)> read_callback,
+                          std::function<void(uint64_t)> write_callback);
+    bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const override;
+    size_t AddTransactions(const Request *reqs, size_t num) override;
+    void ClockTick() override;
+    void PrintStats() override {}
+    bool IsIdle() const override { return returns_.empty(); }
+    std::vector<int> OpenRows() const override;
+    void SetOpenRows(const std::vector<int> &rows) override;
+
+   private:
+    struct Bank {
+        int open_row;
+        uint64_t act_ready;
+        uint64_t pre_ready;
+        uint64_t col_ready;
+    };
+
+    struct Channel {
+        std::vector<Bank> banks;
+        uint64_t last_col;
+        bool last_write;
+        // column command cycles of the reads [0] and writes [1] that still
+        // hold a transaction queue or write buffer entry
+        std::priority_queue<uint64_t, std::vector<uint64_t>,
+                            std::greater<uint64_t>>
+            col_cycles[2];
+    };
+
+    struct Return {
+        uint64_t clk;
+        uint64_t seq;
+        Transaction trans;
+        bool operator>(const Return &other) const {
+            return clk != other.clk ? clk > other.clk : seq > other.seq;
+        }
+    };
+
+    int act_to_read_;
+    int act_to_write_;
+    int act_to_act_;
+    int act_to_pre_;
+    int pre_to_act_;
+    int read_to_pre_;
+    int write_to_pre_;
+    // column to column command delays, [first is write][second is write]
+    int col_to_col_[2][2];
+    bool close_page_;
+    int write_batch_;
+
+    std::vector<Channel> channels_;
+    std::priority_queue<Return, std::vector<Return>, std::greater<Return>>
+        returns_;
+    uint64_t next_seq_;
+
+    // schedules the commands of trans and returns its complete cycle
+    uint64_t Serve(const Transaction &trans);
 };
 
 }  // namespace dramsim3
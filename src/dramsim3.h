@@ -2,20 +2,50 @@
 #define __MEMORY_SYSTEM__H
 
 #include <functional>
+#include <memory>
 #include <string>
 
+#include "request.h"
+
 namespace dramsim3 {
 
+class Config;
+
 // This should be the interface class that deals with CPU
+//
+// Threading: a memory system is not thread safe, calls to it have to come
+// from one thread at a time and its callbacks run on the thread that calls
+// ClockTick (or AdvanceTo). Memory systems share no state with each other,
+// so any number of them can run on different threads, also with one
+// shared config, as long as each one writes to an output directory of its
+// own.
 class MemorySystem {
    public:
     MemorySystem(const std::string &config_file, const std::string &output_dir,
                  std::function<void(uint64_t)> read_callback,
                  std::function<void(uint64_t)> write_callback);
+    // takes ownership of config, the output goes to its output_dir
+    MemorySystem(Config *config, const std::string &output_dir,
+                 std::function<void(uint64_t)> read_callback,
+                 std::function<void(uint64_t)> write_callback);
+    // config is only read and can be shared with other memory systems, e.g.
+    // one per socket or sweep point, without parsing it again for each
+    MemorySystem(std::shared_ptr<const Config> config,
+                 const std::string &output_dir,
+                 std::function<void(uint64_t)> read_callback,
+                 std::function<void(uint64_t)> write_callback);
     ~MemorySystem();
     void ClockTick();
+    // runs all memory cycles that end by time ps (picoseconds, cycle n ends
+    // at (n + 1) * tCK), for front ends with a clock of their own. Returns
+    // the number of memory cycles run
+    uint64_t AdvanceTo(uint64_t ps);
     void RegisterCallbacks(std::function<void(uint64_t)> read_callback,
                            std::function<void(uint64_t)> write_callback);
+    // when set it is called for every completed request instead of the
+    // address callbacks, with the tag, source and cycles of the request
+    void RegisterCompletionCallback(
+        std::function<void(const Completion &)> completion_callback);
     double GetTCK() const;
     int GetBusBits() const;
     int GetBurstLength() const;
@@ -25,6 +55,29 @@ class MemorySystem {
 
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const;
     bool AddTransaction(uint64_t hex_addr, bool is_write);
+    // tag is handed back in the Completion instead of the address
+    bool AddTransaction(uint64_t hex_addr, bool is_write, uint64_t tag,
+                        int source_id = 0, int priority = 0);
+
+    // Batch interface: adds requests in order until one of them is not
+    // accepted and returns the number of requests added. Completions of
+    // requests without a callback (register an empty std::function for
+    // reads and/or writes) are buffered until drained, oldest first.
+    size_t AddTransactions(const Request *reqs, size_t num);
+    size_t DrainCompletions(Completion *completions, size_t max_num);
+
+    // the complete simulation state goes to a binary file, a memory system
+    // built from a config with the same layout and restored from it
+    // continues exactly like the saved one would have, e.g. to fork short
+    // detailed runs off one warm-up. Callbacks are not saved
+    void SaveCheckpoint(const std::string &file_name) const;
+    void RestoreCheckpoint(const std::string &file_name);
+
+    // requests go to an analytical model that is much faster than the
+    // cycle accurate system while set, e.g. to warm up before a detailed
+    // region. Stats only count detailed cycles
+    void SetFastForward(bool fast_forward);
+    bool IsFastForward() const;
 };
 
 MemorySystem* GetMemorySystem(const std::string &config_file, const std::string &output_dir,
@@ -0,0 +1,130 @@
+#include "epoch_writer.h"
+
+#include <iostream>
+#include <map>
+
+#include "common.h"
+
+namespace dramsim3 {
+
+namespace {
+
+// nested objects (vector stats) become "name.key" columns
+void FlattenRecord(const nlohmann::json& j, const std::string& prefix,
+                   std::map<std::string, std::string>& flat) {
+    for (auto it = j.begin(); it != j.end(); ++it) {
+        std::string name = prefix.empty() ? it.key() : prefix + "." + it.key();
+        if (it->is_object()) {
+            FlattenRecord(*it, name, flat);
+        } else {
+            flat[name] = it->dump();
+        }
+    }
+}
+
+}  // namespace
+
+EpochWriter::EpochWriter(const std::string& file_name,
+                         const std::string& format)
+    : busy_(false), stop_(false) {
+    if (format == "ndjson") {
+        format_ = Format::NDJSON;
+    } else if (format == "csv") {
+        format_ = Format::CSV;
+    } else if (format == "msgpack") {
+        format_ = Format::MSGPACK;
+    } else {
+        std::cerr << "Unknown epoch_format " << format << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    file_.open(file_name, std::ofstream::out | std::ofstream::binary);
+    if (!file_) {
+        std::cerr << "Cannot open " << file_name << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    thread_ = std::thread(&EpochWriter::WriterLoop, this);
+}
+
+EpochWriter::~EpochWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    write_cv_.notify_one();
+    thread_.join();
+}
+
+void EpochWriter::Write(nlohmann::json&& record) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(std::move(record));
+    }
+    write_cv_.notify_one();
+}
+
+void EpochWriter::Flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    flush_cv_.wait(lock, [this] { return pending_.empty() && !busy_; });
+}
+
+void EpochWriter::WriterLoop() {
+    std::vector<nlohmann::json> records;
+    std::string out;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        write_cv_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+        if (pending_.empty()) {
+            break;
+        }
+        records.swap(pending_);
+        busy_ = true;
+        lock.unlock();
+
+        out.clear();
+        for (const auto& record : records) {
+            FormatRecord(record, out);
+        }
+        records.clear();
+        file_.write(out.data(), out.size());
+        file_.flush();
+
+        lock.lock();
+        busy_ = false;
+        flush_cv_.notify_all();
+    }
+}
+
+void EpochWriter::FormatRecord(const nlohmann::json& record,
+                               std::string& out) {
+    if (format_ == Format::NDJSON) {
+        out += record.dump();
+        out += '\n';
+    } else if (format_ == Format::MSGPACK) {
+        auto bytes = nlohmann::json::to_msgpack(record);
+        out.append(bytes.begin(), bytes.end());
+    } else {
+        std::map<std::string, std::string> flat;
+        FlattenRecord(record, "", flat);
+        if (csv_columns_.empty()) {
+            for (const auto& it : flat) {
+                csv_columns_.push_back(it.first);
+            }
+            for (size_t i = 0; i < csv_columns_.size(); i++) {
+                out += (i == 0 ? "" : ",") + csv_columns_[i];
+            }
+            out += '\n';
+        }
+        for (size_t i = 0; i < csv_columns_.size(); i++) {
+            if (i > 0) {
+                out += ',';
+            }
+            auto it = flat.find(csv_columns_[i]);
+            if (it != flat.end()) {
+                out += it->second;
+            }
+        }
+        out += '\n';
+    }
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,52 @@
+#ifndef __EPOCH_WRITER_H
+#define __EPOCH_WRITER_H
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "configuration.h"
+#include "json.hpp"
+
+namespace dramsim3 {
+
+// Epoch stats sink shared by all channels of a memory system. The file stays
+// open for the whole run and records are formatted and written on a
+// background thread, so small epoch periods do not stall the simulation on
+// file I/O.
+//
+// Formats ([other] epoch_format):
+//   ndjson   one JSON object per line
+//   csv      one row per record, columns are taken from the first record
+//   msgpack  concatenated MessagePack objects
+class EpochWriter {
+   public:
+    EpochWriter(const std::string& file_name, const std::string& format);
+    ~EpochWriter();
+    void Write(nlohmann::json&& record);
+    // blocks until all records written so far are in the file
+    void Flush();
+
+   private:
+    enum class Format { NDJSON, CSV, MSGPACK };
+    void WriterLoop();
+    void FormatRecord(const nlohmann::json& record, std::string& out);
+
+    Format format_;
+    std::ofstream file_;
+    std::vector<std::string> csv_columns_;
+
+    std::mutex mutex_;
+    std::condition_variable write_cv_;
+    std::condition_variable flush_cv_;
+    std::vector<nlohmann::json> pending_;
+    bool busy_;
+    bool stop_;
+    std::thread thread_;
+};
+
+}  // namespace dramsim3
+#endif
@@ -3,8 +3,18 @@
 namespace dramsim3 {
 
 HMCRequest::HMCRequest(HMCReqType req_type, uint64_t hex_addr, int vault)
-    : type(req_type), mem_operand(hex_addr), vault(vault) {
+    : type(req_type),
+      mem_operand(hex_addr),
+      req_id(hex_addr),
+      source_id(0),
+      priority(0),
+      issue_cycle(0),
+      resp_slot(-1),
+      vault(vault) {
     is_write = type >= HMCReqType::WR0 && type <= HMCReqType::P_WR256;
+    is_atomic = type >= HMCReqType::ADD8 && type < HMCReqType::SIZE;
+    writes_back = is_atomic && type != HMCReqType::EQ8 &&
+                  type != HMCReqType::EQ16;
     // given that vaults could be 16 (Gen1) or 32(Gen2), using % 4
     // to partition vaults to quads
     quad = vault % 4;
@@ -111,7 +121,16 @@ HMCRequest::HMCRequest(HMCReqType req_type, uint64_t hex_addr, int vault)
 
 HMCResponse::HMCResponse(uint64_t id, HMCReqType req_type, int dest_link,
                          int src_quad)
-    : resp_id(id), link(dest_link), quad(src_quad) {
+    : resp_id(id),
+      req_id(id),
+      source_id(0),
+      issue_cycle(0),
+      link(dest_link),
+      quad(src_quad),
+      vault(-1),
+      is_atomic(false),
+      writes_back(false),
+      flits_saved(0) {
     switch (req_type) {
         case HMCReqType::RD0:
             type = HMCRespType::RD_RS;
@@ -240,14 +259,21 @@ HMCResponse::HMCResponse(uint64_t id, HMCReqType req_type, int dest_link,
     return;
 }
 
-HMCMemorySystem::HMCMemorySystem(Config &config, const std::string &output_dir,
-                                 std::function<void(uint64_t)> read_callback,
-                                 std::function<void(uint64_t)> write_callback)
+HMCMemorySystem::HMCMemorySystem(
+    const Config &config, const std::string &output_dir,
+    std::function<void(uint64_t)> read_callback,
+    std::function<void(uint64_t)> write_callback)
     : BaseDRAMSystem(config, output_dir, read_callback, write_callback),
       logic_clk_(0),
       logic_ps_(0),
       dram_ps_(0),
-      next_link_(0) {
+      next_link_(0),
+      xbar_bandwidth_(config.xbar_bandwidth),
+      link_flow_control_(config.link_flow_control),
+      // requests sit in link and quad queues, responses in vaults as well
+      req_pool_((config.num_links + 4) * config.xbar_queue_depth),
+      resp_pool_((config.num_links + 4) * config.xbar_queue_depth +
+                 config.channels * config.trans_queue_size) {
     // sanity check, this constructor should only be intialized using HMC
     if (!config_.IsHMC()) {
         std::cerr << "Initialzed an HMC system without an HMC config file!"
@@ -261,9 +287,10 @@ HMCMemorySystem::HMCMemorySystem(Config &config, const std::string &output_dir,
     ctrls_.reserve(config_.channels);
     for (int i = 0; i < config_.channels; i++) {
 #ifdef THERMAL
-        ctrls_.push_back(new Controller(i, config_, timing_, thermal_calc_));
+        ctrls_.push_back(new Controller(i, config_, output_files_, timing_,
+                                        thermal_calc_));
 #else
-        ctrls_.push_back(new Controller(i, config_, timing_));
+        ctrls_.push_back(new Controller(i, config_, output_files_, timing_));
 #endif  // THERMAL
     }
     // initialize vaults and crossbar
@@ -276,17 +303,19 @@ HMCMemorySystem::HMCMemorySystem(Config &config, const std::string &output_dir,
     link_req_queues_.reserve(links_);
     link_resp_queues_.reserve(links_);
     for (int i = 0; i < links_; i++) {
-        link_req_queues_.push_back(std::vector<HMCRequest *>());
-        link_resp_queues_.push_back(std::vector<HMCResponse *>());
+        link_req_queues_.push_back(PacketQueue(queue_depth_));
+        link_resp_queues_.push_back(PacketQueue(queue_depth_));
     }
 
     // don't want to hard coding it but there are 4 quads so it's kind of fixed
+    // quad response queues take whatever the vaults return so they may grow
     quad_req_queues_.reserve(4);
     quad_resp_queues_.reserve(4);
     for (int i = 0; i < 4; i++) {
-        quad_req_queues_.push_back(std::vector<HMCRequest *>());
-        quad_resp_queues_.push_back(std::vector<HMCResponse *>());
+        quad_req_queues_.push_back(PacketQueue(queue_depth_));
+        quad_resp_queues_.push_back(PacketQueue(queue_depth_));
     }
+    age_queue_.reserve(std::max(links_, 4));
 
     link_busy_.reserve(links_);
     link_age_counter_.reserve(links_);
@@ -294,6 +323,9 @@ HMCMemorySystem::HMCMemorySystem(Config &config, const std::string &output_dir,
         link_busy_.push_back(0);
         link_age_counter_.push_back(0);
     }
+    vault_writebacks_.resize(config_.channels);
+    link_credits_.resize(links_, link_flits_per_cycle_);
+    OpenEpochStats();
 }
 
 HMCMemorySystem::~HMCMemorySystem() {
@@ -302,6 +334,56 @@ HMCMemorySystem::~HMCMemorySystem() {
     }
 }
 
+void HMCMemorySystem::Save(CheckpointWriter &writer) {
+    BaseDRAMSystem::Save(writer);
+    writer.Section("hmc");
+    writer.Put(logic_clk_);
+    writer.Put(logic_ps_);
+    writer.Put(dram_ps_);
+    writer.Put(next_link_);
+    writer.Put(link_credits_);
+    req_pool_.Save(writer);
+    resp_pool_.Save(writer);
+    for (auto queues : {&link_req_queues_, &link_resp_queues_,
+                        &quad_req_queues_, &quad_resp_queues_}) {
+        for (const auto &queue : *queues) {
+            queue.Save(writer);
+        }
+    }
+    writer.Put(age_queue_);
+    writer.Put(vault_writebacks_);
+    writer.Put(link_busy_);
+    writer.Put(quad_busy_);
+    writer.Put(link_age_counter_);
+    writer.Put(quad_age_counter_);
+    return;
+}
+
+void HMCMemorySystem::Restore(CheckpointReader &reader) {
+    BaseDRAMSystem::Restore(reader);
+    reader.Section("hmc");
+    reader.Get(logic_clk_);
+    reader.Get(logic_ps_);
+    reader.Get(dram_ps_);
+    reader.Get(next_link_);
+    reader.Get(link_credits_);
+    req_pool_.Restore(reader);
+    resp_pool_.Restore(reader);
+    for (auto queues : {&link_req_queues_, &link_resp_queues_,
+                        &quad_req_queues_, &quad_resp_queues_}) {
+        for (auto &queue : *queues) {
+            queue.Restore(reader);
+        }
+    }
+    reader.Get(age_queue_);
+    reader.Get(vault_writebacks_);
+    reader.Get(link_busy_);
+    reader.Get(quad_busy_);
+    reader.Get(link_age_counter_);
+    reader.Get(quad_age_counter_);
+    return;
+}
+
 void HMCMemorySystem::SetClockRatio() {
     // There are 3 clock domains here, Link (super fast), logic (fast), DRAM
     // (slow) We assume the logic process 1 flit per logic cycle and since the
@@ -315,6 +397,10 @@ void HMCMemorySystem::SetClockRatio() {
     if (ps_per_logic_ > ps_per_dram_) {
         ps_per_logic_ = ps_per_dram_;
     }
+    // link_speed is per lane in Mbps, i.e. bits per us
+    link_flits_per_cycle_ = static_cast<double>(ps_per_dram_) *
+                            config_.link_width * config_.link_speed / 1e6 /
+                            128;
     return;
 }
 
@@ -327,12 +413,24 @@ inline void HMCMemorySystem::IterateNextLink() {
     return;
 }
 
-bool HMCMemorySystem::WillAcceptTransaction(uint64_t hex_addr,
-                                            bool is_write) const {
+void HMCMemorySystem::ReplenishLinkCredits() {
+    if (!link_flow_control_) {
+        return;
+    }
+    for (auto &&credits : link_credits_) {
+        credits = std::min(credits + link_flits_per_cycle_,
+                           link_flits_per_cycle_);
+    }
+    return;
+}
+
+bool HMCMemorySystem::WillAcceptTransaction(uint64_t, bool) const {
     bool insertable = false;
     for (auto link_queue = link_req_queues_.begin();
          link_queue != link_req_queues_.end(); link_queue++) {
-        if ((*link_queue).size() < queue_depth_) {
+        int link = static_cast<int>(link_queue - link_req_queues_.begin());
+        if ((*link_queue).size() < queue_depth_ &&
+            (!link_flow_control_ || link_credits_[link] > 0)) {
             insertable = true;
             break;
         }
@@ -340,73 +438,88 @@ bool HMCMemorySystem::WillAcceptTransaction(uint64_t hex_addr,
     return insertable;
 }
 
-bool HMCMemorySystem::AddTransaction(uint64_t hex_addr, bool is_write) {
+size_t HMCMemorySystem::AddTransactions(const Request *reqs, size_t num) {
     // to be compatible with other protocol we have this interface
     // when using this intreface the size of each transaction will be block_size
-    HMCReqType req_type;
-    if (is_write) {
-        switch (config_.block_size) {
-            case 0:
-                req_type = HMCReqType::WR0;
-                break;
-            case 32:
-                req_type = HMCReqType::WR32;
-                break;
-            case 64:
-                req_type = HMCReqType::WR64;
-                break;
-            case 128:
-                req_type = HMCReqType::WR128;
-                break;
-            case 256:
-                req_type = HMCReqType::WR256;
-                break;
-            default:
-                req_type = HMCReqType::SIZE;
-                AbruptExit(__FILE__, __LINE__);
-                break;
-        }
-    } else {
-        switch (config_.block_size) {
-            case 0:
-                req_type = HMCReqType::RD0;
-                break;
-            case 32:
-                req_type = HMCReqType::RD32;
-                break;
-            case 64:
-                req_type = HMCReqType::RD64;
-                break;
-            case 128:
-                req_type = HMCReqType::RD128;
-                break;
-            case 256:
-                req_type = HMCReqType::RD256;
-                break;
-            default:
-                req_type = HMCReqType::SIZE;
-                AbruptExit(__FILE__, __LINE__);
-                break;
+    HMCReqType rd_type, wr_type;
+    switch (config_.block_size) {
+        case 0:
+            rd_type = HMCReqType::RD0;
+            wr_type = HMCReqType::WR0;
+            break;
+        case 32:
+            rd_type = HMCReqType::RD32;
+            wr_type = HMCReqType::WR32;
+            break;
+        case 64:
+            rd_type = HMCReqType::RD64;
+            wr_type = HMCReqType::WR64;
+            break;
+        case 128:
+            rd_type = HMCReqType::RD128;
+            wr_type = HMCReqType::WR128;
+            break;
+        case 256:
+            rd_type = HMCReqType::RD256;
+            wr_type = HMCReqType::WR256;
+            break;
+        default:
+            rd_type = HMCReqType::SIZE;
+            wr_type = HMCReqType::SIZE;
+            AbruptExit(__FILE__, __LINE__);
+            break;
+    }
+    size_t added = 0;
+    for (; added < num; added++) {
+        const Request &trans = reqs[added];
+        int vault = GetChannel(trans.addr);
+        HMCRequest req(trans.is_write ? wr_type : rd_type, trans.addr, vault);
+        req.req_id = trans.req_id;
+        req.source_id = trans.source_id;
+        req.priority = trans.priority;
+        req.issue_cycle = clk_;
+        if (!InsertHMCReq(req)) {
+            break;
         }
     }
-    int vault = GetChannel(hex_addr);
-    HMCRequest *req = new HMCRequest(req_type, hex_addr, vault);
-    return InsertHMCReq(req);
+    return added;
 }
 
-bool HMCMemorySystem::InsertReqToLink(HMCRequest *req, int link) {
+bool HMCMemorySystem::InsertReqToLink(const HMCRequest &req, int link) {
     // These things need to happen when an HMC request is inserted to a link:
-    // 1. check if link queue full
+    // 1. check if link queue full or out of credits
     // 2. set link field in the request packet
     // 3. create corresponding response
     // 4. increment link_age_counter_ so that arbitrate logic works
+    if (link_flow_control_ && link_credits_[link] <= 0) {
+        return false;
+    }
     if (link_req_queues_[link].size() < queue_depth_) {
-        req->link = link;
-        link_req_queues_[link].push_back(req);
-        HMCResponse *resp =
-            new HMCResponse(req->mem_operand, req->type, link, req->quad);
-        resp_lookup_table_.insert(
-            std::pair<uint64_t, HMCResponse *>(resp->resp_id, resp));
+        if (link_flow_control_) {
+            link_credits_[link] -= req.flits;
+        }
+        int resp_slot = resp_pool_.Alloc(
+            HMCResponse(req.mem_operand, req.type, link, req.quad));
+        HMCResponse &resp = resp_pool_[resp_slot];
+        resp.req_id = req.req_id;
+        resp.source_id = req.source_id;
+        resp.issue_cycle = req.issue_cycle;
+        resp.vault = req.vault;
+        if (req.is_atomic) {
+            // the host would read 16B (1 + 2 flits) and, if memory is
+            // modified, write 16B (2 flits + 1 unless posted)
+            int host_flits = 3;
+            if (req.writes_back) {
+                host_flits += resp.type == HMCRespType::NONE ? 2 : 3;
+            }
+            resp.is_atomic = true;
+            resp.writes_back = req.writes_back;
+            resp.flits_saved = host_flits - req.flits - resp.flits;
+        }
+        int req_slot = req_pool_.Alloc(req);
+        req_pool_[req_slot].link = link;
+        req_pool_[req_slot].resp_slot = resp_slot;
+        link_req_queues_[link].push_back(req_slot);
         link_age_counter_[link] = 1;
         // stats_.interarrival_latency.AddValue(clk_ - last_req_clk_);
         last_req_clk_ = clk_;
@@ -416,12 +529,12 @@ bool HMCMemorySystem::InsertReqToLink(HMCRequest *req, int link) {
     }
 }
 
-bool HMCMemorySystem::InsertHMCReq(HMCRequest *req) {
+bool HMCMemorySystem::InsertHMCReq(const HMCRequest &req) {
     // most CPU models does not support simultaneous insertions
     // if you want to actually simulate the multi-link feature
-    // then you have to call this function multiple times in 1 cycle
-    // TODO put a cap limit on how many times you can call this function per
-    // cycle
+    // then you have to call this function multiple times in 1 cycle, or use
+    // InsertLinkReqs. Set link_flow_control to cap each link at what its
+    // lanes can carry per cycle
     bool is_inserted = InsertReqToLink(req, next_link_);
     if (!is_inserted) {
         int start_link = next_link_;
@@ -441,18 +554,31 @@ bool HMCMemorySystem::InsertHMCReq(HMCRequest *req) {
     }
 }
 
+size_t HMCMemorySystem::InsertLinkReqs(int link, const HMCRequest *reqs,
+                                       size_t num) {
+    size_t added = 0;
+    for (; added < num; added++) {
+        if (!InsertReqToLink(reqs[added], link)) {
+            break;
+        }
+    }
+    return added;
+}
+
 void HMCMemorySystem::DrainRequests() {
+    PROFILE_SCOPE(profiler_, HMC_XBAR);
     // drain quad request queue to vaults
     for (int i = 0; i < 4; i++) {
         if (!quad_req_queues_[i].empty() &&
             quad_resp_queues_[i].size() < queue_depth_) {
-            HMCRequest *req = quad_req_queues_[i].front();
-            if (req->exit_time <= logic_clk_) {
-                if (ctrls_[req->vault]->WillAcceptTransaction(req->mem_operand,
-                                                              req->is_write)) {
+            int req_slot = quad_req_queues_[i].front();
+            const HMCRequest &req = req_pool_[req_slot];
+            if (req.exit_time <= logic_clk_) {
+                if (ctrls_[req.vault]->WillAcceptTransaction(req.mem_operand,
+                                                             req.is_write)) {
                     InsertReqToDRAM(req);
-                    delete (req);
-                    quad_req_queues_[i].erase(quad_req_queues_[i].begin());
+                    req_pool_.Free(req_slot);
+                    quad_req_queues_[i].pop_front();
                 }
             }
         }
@@ -461,23 +587,22 @@ void HMCMemorySystem::DrainRequests() {
     // drain xbar
     for (auto &&i : quad_busy_) {
         if (i > 0) {
-            i -= 2;
+            i -= xbar_bandwidth_;
         }
     }
 
     // drain requests from link to quad buffers
-    std::vector<int> age_queue = BuildAgeQueue(link_age_counter_);
-    while (!age_queue.empty()) {
-        int src_link = age_queue.front();
-        int dest_quad = link_req_queues_[src_link].front()->quad;
+    BuildAgeQueue(link_age_counter_, age_queue_);
+    for (int src_link : age_queue_) {
+        int req_slot = link_req_queues_[src_link].front();
+        HMCRequest &req = req_pool_[req_slot];
+        int dest_quad = req.quad;
         if (quad_req_queues_[dest_quad].size() < queue_depth_ &&
             quad_busy_[dest_quad] <= 0) {
-            HMCRequest *req = link_req_queues_[src_link].front();
-            link_req_queues_[src_link].erase(
-                link_req_queues_[src_link].begin());
-            quad_req_queues_[dest_quad].push_back(req);
-            quad_busy_[dest_quad] = req->flits;
-            req->exit_time = logic_clk_ + req->flits;
+            link_req_queues_[src_link].pop_front();
+            quad_req_queues_[dest_quad].push_back(req_slot);
+            quad_busy_[dest_quad] = req.flits;
+            req.exit_time = logic_clk_ + req.flits;
             if (link_req_queues_[src_link].empty()) {
                 link_age_counter_[src_link] = 0;
             } else {
@@ -486,24 +611,22 @@ void HMCMemorySystem::DrainRequests() {
         } else {  // stalled this cycle, update age counter
             link_age_counter_[src_link]++;
         }
-        age_queue.erase(age_queue.begin());
     }
-    age_queue.clear();
 }
 
 void HMCMemorySystem::DrainResponses() {
+    PROFILE_SCOPE(profiler_, HMC_XBAR);
     // Link resp to CPU
     for (int i = 0; i < links_; i++) {
         if (!link_resp_queues_[i].empty()) {
-            HMCResponse *resp = link_resp_queues_[i].front();
-            if (resp->exit_time <= logic_clk_) {
-                if (resp->type == HMCRespType::RD_RS) {
-                    read_callback_(resp->resp_id);
-                } else {
-                    write_callback_(resp->resp_id);
-                }
-                delete (resp);
-                link_resp_queues_[i].erase(link_resp_queues_[i].begin());
+            int resp_slot = link_resp_queues_[i].front();
+            const HMCResponse &resp = resp_pool_[resp_slot];
+            if (resp.exit_time <= logic_clk_) {
+                CompleteRequest({resp.resp_id,
+                                 resp.type != HMCRespType::RD_RS, resp.req_id,
+                                 resp.source_id, resp.issue_cycle, 0});
+                resp_pool_.Free(resp_slot);
+                link_resp_queues_[i].pop_front();
             }
         }
     }
@@ -511,23 +634,22 @@ void HMCMemorySystem::DrainResponses() {
     // drain xbar
     for (auto &&i : link_busy_) {
         if (i > 0) {
-            i -= 2;
+            i -= xbar_bandwidth_;
         }
     }
 
     // drain responses from quad to link buffers
-    auto age_queue = BuildAgeQueue(quad_age_counter_);
-    while (!age_queue.empty()) {
-        int src_quad = age_queue.front();
-        int dest_link = quad_resp_queues_[src_quad].front()->link;
+    BuildAgeQueue(quad_age_counter_, age_queue_);
+    for (int src_quad : age_queue_) {
+        int resp_slot = quad_resp_queues_[src_quad].front();
+        HMCResponse &resp = resp_pool_[resp_slot];
+        int dest_link = resp.link;
         if (link_resp_queues_[dest_link].size() < queue_depth_ &&
             link_busy_[dest_link] <= 0) {
-            HMCResponse *resp = quad_resp_queues_[src_quad].front();
-            quad_resp_queues_[src_quad].erase(
-                quad_resp_queues_[src_quad].begin());
-            link_resp_queues_[dest_link].push_back(resp);
-            link_busy_[dest_link] = resp->flits;
-            resp->exit_time = logic_clk_ + resp->flits;
+            quad_resp_queues_[src_quad].pop_front();
+            link_resp_queues_[dest_link].push_back(resp_slot);
+            link_busy_[dest_link] = resp.flits;
+            resp.exit_time = logic_clk_ + resp.flits;
             if (quad_resp_queues_[src_quad].size() == 0) {
                 quad_age_counter_[src_quad] = 0;
             } else {
@@ -536,27 +658,28 @@ void HMCMemorySystem::DrainResponses() {
         } else {  // stalled this cycle, update age counter
             quad_age_counter_[src_quad]++;
         }
-        age_queue.erase(age_queue.begin());
     }
-    age_queue.clear();
 }
 
 void HMCMemorySystem::DRAMClockTick() {
-    for (size_t i = 0; i < ctrls_.size(); i++) {
-        // look ahead and return earlier
-        while (true) {
-            auto pair = ctrls_[i]->ReturnDoneTrans(clk_);
-            if (pair.second == 1) {  // write
-                VaultCallback(pair.first);
-            } else if (pair.second == 0) {  // read
-                VaultCallback(pair.first);
-            } else {
-                break;
+    {
+        PROFILE_SCOPE(profiler_, RETURNS);
+        for (size_t i = 0; i < ctrls_.size(); i++) {
+            done_trans_.clear();
+            ctrls_[i]->ReturnDoneTrans(clk_, done_trans_);
+            for (const auto &trans : done_trans_) {
+                if (trans.req_id != writeback_id_) {
+                    VaultCallback(trans.req_id);
+                }
             }
         }
     }
-    for (size_t i = 0; i < ctrls_.size(); i++) {
-        ctrls_[i]->ClockTick();
+    {
+        PROFILE_SCOPE(profiler_, CONTROLLERS);
+        IssueWritebacks();
+        for (size_t i = 0; i < ctrls_.size(); i++) {
+            ctrls_[i]->ClockTick();
+        }
     }
     clk_++;
 
@@ -583,15 +706,55 @@ void HMCMemorySystem::ClockTick() {
         logic_clk_ += 1;
     }
     dram_ps_ += ps_per_dram_;
+    ReplenishLinkCredits();
     return;
 }
 
-std::vector<int> HMCMemorySystem::BuildAgeQueue(std::vector<int> &age_counter) {
-    // return a vector of indices sorted in decending order
+bool HMCMemorySystem::IsIdle() const {
+    for (const auto &queues :
+         {&link_req_queues_, &link_resp_queues_, &quad_req_queues_,
+          &quad_resp_queues_}) {
+        for (const auto &queue : *queues) {
+            if (!queue.empty()) {
+                return false;
+            }
+        }
+    }
+    for (const auto &writebacks : vault_writebacks_) {
+        if (!writebacks.empty()) {
+            return false;
+        }
+    }
+    return BaseDRAMSystem::IsIdle();
+}
+
+void HMCMemorySystem::ForwardTo(uint64_t clk) {
+    if (clk <= clk_) {
+        return;
+    }
+    dram_ps_ += (clk - clk_) * ps_per_dram_;
+    if (logic_ps_ < dram_ps_) {
+        uint64_t logic_cycles =
+            (dram_ps_ - logic_ps_ + ps_per_logic_ - 1) / ps_per_logic_;
+        logic_ps_ += logic_cycles * ps_per_logic_;
+        logic_clk_ += logic_cycles;
+    }
+    std::fill(link_busy_.begin(), link_busy_.end(), 0);
+    std::fill(quad_busy_.begin(), quad_busy_.end(), 0);
+    std::fill(link_age_counter_.begin(), link_age_counter_.end(), 0);
+    std::fill(quad_age_counter_.begin(), quad_age_counter_.end(), 0);
+    std::fill(link_credits_.begin(), link_credits_.end(),
+              link_flits_per_cycle_);
+    BaseDRAMSystem::ForwardTo(clk);
+    return;
+}
+
+void HMCMemorySystem::BuildAgeQueue(const std::vector<int> &age_counter,
+                                    std::vector<int> &age_queue) const {
+    // fill age_queue with indices sorted in decending order
     // meaning that the oldest age link/quad should be processed first
-    std::vector<int> age_queue;
+    age_queue.clear();
     int queue_len = age_counter.size();
-    age_queue.reserve(queue_len);
     int start_pos = logic_clk_ % queue_len;  // round robin start pos
     for (int i = 0; i < queue_len; i++) {
         int pos = (i + start_pos) % queue_len;
@@ -609,28 +772,53 @@ std::vector<int> HMCMemorySystem::BuildAgeQueue(std::vector<int> &age_counter) {
             }
         }
     }
-    return age_queue;
+    return;
 }
 
-void HMCMemorySystem::InsertReqToDRAM(HMCRequest *req) {
-    Transaction trans(req->mem_operand, req->is_write);
-    ctrls_[req->vault]->AddTransaction(trans);
+void HMCMemorySystem::InsertReqToDRAM(const HMCRequest &req) {
+    Transaction trans(req.mem_operand, req.is_write);
+    trans.req_id = static_cast<uint64_t>(req.resp_slot);
+    trans.source_id = req.source_id;
+    trans.priority = req.priority;
+    trans.issue_cycle = req.issue_cycle;
+    ctrls_[req.vault]->AddTransaction(trans);
     return;
 }
 
-void HMCMemorySystem::VaultCallback(uint64_t req_id) {
-    // we will use hex addr as the req_id and use a multimap to lookup the
-    // requests the vaults cannot directly talk to the CPU so this callback will
-    // be passed to the vaults and is responsible to put the responses back to
-    // response queues
+void HMCMemorySystem::IssueWritebacks() {
+    // write backs go ahead of new requests from the xbar
+    for (size_t i = 0; i < vault_writebacks_.size(); i++) {
+        auto &writebacks = vault_writebacks_[i];
+        auto it = writebacks.begin();
+        while (it != writebacks.end() &&
+               ctrls_[i]->WillAcceptTransaction(*it, true)) {
+            Transaction trans(*it, true);
+            trans.req_id = writeback_id_;
+            ctrls_[i]->AddTransaction(trans);
+            it++;
+        }
+        writebacks.erase(writebacks.begin(), it);
+    }
+    return;
+}
 
-    auto it = resp_lookup_table_.find(req_id);
-    HMCResponse *resp = it->second;
+void HMCMemorySystem::VaultCallback(uint64_t resp_slot) {
+    // the vaults cannot directly talk to the CPU so this callback is
+    // responsible to put the responses back to response queues, vault
+    // transactions carry the slot of their response as id
+    const HMCResponse &resp = resp_pool_[static_cast<int>(resp_slot)];
+    int quad = resp.quad;
+    if (resp.is_atomic) {
+        // read half of the atomic is done, the result is computed in the
+        // vault logic and written back with a separate DRAM write
+        if (resp.writes_back) {
+            vault_writebacks_[resp.vault].push_back(resp.resp_id);
+        }
+        ctrls_[resp.vault]->RecordAtomic(resp.flits_saved * 16);
+    }
     // all data from dram received, put packet in xbar and return
-    resp_lookup_table_.erase(it);
-    // put it in xbar
-    quad_resp_queues_[resp->quad].push_back(resp);
-    quad_age_counter_[resp->quad] = 1;
+    quad_resp_queues_[quad].push_back(static_cast<int>(resp_slot));
+    quad_age_counter_[quad] = 1;
     return;
 }
 
@@ -2,7 +2,6 @@
 #define __HMC_H
 
 #include <functional>
-#include <map>
 #include <vector>
 
 #include "dram_system.h"
@@ -39,7 +38,7 @@ enum class HMCReqType {
     P_WR112,
     P_WR128,
     P_WR256,
-    // TODO haven't properly implement the following atomic operations
+    // atomics, executed in the vault as a read followed by a write back
     ADD8,  // 2ADD8, cannot name it like that in c++...
     ADD16,
     P_2ADD8,  // 2 8Byte imm operands + 8 8Byte mem operands read then write
@@ -81,11 +80,21 @@ class HMCRequest {
     HMCRequest(HMCReqType req_type, uint64_t hex_addr, int vault);
     HMCReqType type;
     uint64_t mem_operand;
+    // handed back with the response, the address unless given
+    uint64_t req_id;
+    int source_id;
+    int priority;
+    uint64_t issue_cycle;
+    // pool slot of the response, also the id of the vault transaction
+    int resp_slot;
     int link;
     int quad;
     int vault;
     int flits;
     bool is_write;
+    bool is_atomic;
+    // atomic that modifies memory, i.e. all but the EQ compares
+    bool writes_back;
     // this exit_time is the time to exit xbar to vaults
     uint64_t exit_time;
 };
@@ -94,17 +103,112 @@ class HMCResponse {
    public:
     HMCResponse(uint64_t id, HMCReqType reqtype, int dest_link, int src_quad);
     uint64_t resp_id;
+    uint64_t req_id;
+    int source_id;
+    uint64_t issue_cycle;
     HMCRespType type;
     int link;
     int quad;
+    int vault;
     int flits;
+    // atomics are read in the vault first and written back (if they
+    // modify memory) once the read is done, the response goes out then
+    bool is_atomic;
+    bool writes_back;
+    // link flits saved compared to the host doing the read-modify-write
+    int flits_saved;
     // this exit_time is the time to exit xbar to cpu
     uint64_t exit_time;
 };
 
+// Packet slots referred to by index, freed slots are reused so that the
+// steady state does not allocate
+template <typename T>
+class SlabPool {
+   public:
+    SlabPool(size_t capacity) {
+        slots_.reserve(capacity);
+        free_.reserve(capacity);
+    }
+    int Alloc(const T& item) {
+        if (free_.empty()) {
+            slots_.push_back(item);
+            return static_cast<int>(slots_.size()) - 1;
+        }
+        int slot = free_.back();
+        free_.pop_back();
+        slots_[slot] = item;
+        return slot;
+    }
+    void Free(int slot) { free_.push_back(slot); }
+    T& operator[](int slot) { return slots_[slot]; }
+    void Save(CheckpointWriter& writer) const {
+        writer.Put(slots_);
+        writer.Put(free_);
+    }
+    void Restore(CheckpointReader& reader) {
+        reader.Get(slots_);
+        reader.Get(free_);
+    }
+
+   private:
+    std::vector<T> slots_;
+    std::vector<int> free_;
+};
+
+// FIFO ring of packet slots, the capacity only grows if a queue is pushed
+// beyond the depth it was built with
+class PacketQueue {
+   public:
+    PacketQueue(size_t capacity) : mask_(0), head_(0), tail_(0) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+    bool empty() const { return head_ == tail_; }
+    size_t size() const { return tail_ - head_; }
+    int front() const { return slots_[head_ & mask_]; }
+    void pop_front() { head_++; }
+    void push_back(int slot) {
+        if (size() == slots_.size()) {
+            std::vector<int> slots(slots_.size() * 2);
+            for (size_t i = 0; i < size(); i++) {
+                slots[i] = slots_[(head_ + i) & mask_];
+            }
+            tail_ = size();
+            head_ = 0;
+            slots_.swap(slots);
+            mask_ = slots_.size() - 1;
+        }
+        slots_[tail_ & mask_] = slot;
+        tail_++;
+    }
+    void Save(CheckpointWriter& writer) const {
+        writer.Put(slots_);
+        writer.Put(mask_);
+        writer.Put(head_);
+        writer.Put(tail_);
+    }
+    void Restore(CheckpointReader& reader) {
+        reader.Get(slots_);
+        reader.Get(mask_);
+        reader.Get(head_);
+        reader.Get(tail_);
+    }
+
+   private:
+    std::vector<int> slots_;
+    size_t mask_;
+    size_t head_;
+    size_t tail_;
+};
+
 class HMCMemorySystem : public BaseDRAMSystem {
    public:
-    HMCMemorySystem(Config& config, const std::string& output_dir,
+    HMCMemorySystem(const Config& config, const std::string& output_dir,
                     std::function<void(uint64_t)> read_callback,
                     std::function<void(uint64_t)> write_callback);
     ~HMCMemorySystem();
@@ -115,9 +219,22 @@ class HMCMemorySystem : public BaseDRAMSystem {
 
     // had to have 3 insert interfaces cuz HMC is so different...
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const override;
-    bool AddTransaction(uint64_t hex_addr, bool is_write) override;
-    bool InsertReqToLink(HMCRequest* req, int link);
-    bool InsertHMCReq(HMCRequest* req);
+    size_t AddTransactions(const Request* reqs, size_t num) override;
+    // requests are copied into the packet pool
+    bool InsertReqToLink(const HMCRequest& req, int link);
+    bool InsertHMCReq(const HMCRequest& req);
+    // inject requests into one link in order, stops at the first request
+    // the link cannot take this cycle and returns the number injected.
+    // Links are independent so a host can call this for every link in the
+    // same cycle
+    size_t InsertLinkReqs(int link, const HMCRequest* reqs, size_t num);
+    // the vaults, link and quad queues and the packets in flight
+    void Save(CheckpointWriter& writer) override;
+    void Restore(CheckpointReader& reader) override;
+    // no packets in the links, quads or vault write back queues either
+    bool IsIdle() const override;
+    // both clock domains move forward, the xbar and links come out idle
+    void ForwardTo(uint64_t clk) override;
 
    private:
     uint64_t logic_clk_, ps_per_dram_, ps_per_logic_, logic_ps_, dram_ps_;
@@ -126,27 +243,45 @@ class HMCMemorySystem : public BaseDRAMSystem {
     void DRAMClockTick();
     void DrainRequests();
     void DrainResponses();
-    void InsertReqToDRAM(HMCRequest* req);
-    void VaultCallback(uint64_t req_id);
-    std::vector<int> BuildAgeQueue(std::vector<int>& age_counter);
+    void InsertReqToDRAM(const HMCRequest& req);
+    void VaultCallback(uint64_t resp_slot);
+    void IssueWritebacks();
+    void BuildAgeQueue(const std::vector<int>& age_counter,
+                       std::vector<int>& age_queue) const;
     void XbarArbitrate();
     inline void IterateNextLink();
+    void ReplenishLinkCredits();
 
     int next_link_;
     int links_;
     size_t queue_depth_;
 
     // number of flits xbar can process per logic cycle
-    const int xbar_bandwidth_ = 2;
+    int xbar_bandwidth_;
+
+    // with link_flow_control each link may only take as many request flits
+    // as its lanes transfer in a memory cycle. A packet is sent as long as
+    // the link has credits left and longer packets borrow from the next
+    // cycles, so the credits may go negative
+    bool link_flow_control_;
+    double link_flits_per_cycle_;
+    std::vector<double> link_credits_;
 
-    // had to use a multimap because the controller callback return hex addr
-    // instead of unique id
-    std::multimap<uint64_t, HMCResponse*> resp_lookup_table_;
+    // packets in flight, the queues hold their pool slots. Vault
+    // transactions carry the response slot as their id so that responses
+    // find their way back even if several requests share an address
+    SlabPool<HMCRequest> req_pool_;
+    SlabPool<HMCResponse> resp_pool_;
     // these are essentially input/output buffers for xbars
-    std::vector<std::vector<HMCRequest*>> link_req_queues_;
-    std::vector<std::vector<HMCResponse*>> link_resp_queues_;
-    std::vector<std::vector<HMCRequest*>> quad_req_queues_;
-    std::vector<std::vector<HMCResponse*>> quad_resp_queues_;
+    std::vector<PacketQueue> link_req_queues_;
+    std::vector<PacketQueue> link_resp_queues_;
+    std::vector<PacketQueue> quad_req_queues_;
+    std::vector<PacketQueue> quad_resp_queues_;
+    std::vector<int> age_queue_;
+    // atomic write backs waiting for room in the vault write queues
+    std::vector<std::vector<uint64_t>> vault_writebacks_;
+    // id of write back transactions, they have no response
+    const uint64_t writeback_id_ = UINT64_MAX;
 
     // input/output busy indicators, since each packet could be several
     // flits, as long as this != 0 then they're busy
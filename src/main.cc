@@ -1,6 +1,8 @@
 #include <iostream>
 #include "./../ext/headers/args.hxx"
 #include "cpu.h"
+#include "mapping_tuner.h"
+#include "sweep.h"
 
 using namespace dramsim3;
 
@@ -10,7 +12,20 @@ int main(int argc, const char **argv) {
         "Examples: \n."
         "./build/dramsim3main configs/DDR4_8Gb_x8_3200.ini -c 100 -t "
         "sample_trace.txt\n"
-        "./build/dramsim3main configs/DDR4_8Gb_x8_3200.ini -s random -c 100");
+        "./build/dramsim3main configs/DDR4_8Gb_x8_3200.ini -s random -c 100\n"
+        "./build/dramsim3main configs/DDR4_8Gb_x8_3200.ini -c 100 -t "
+        "sample_trace.txt -p system.cmd_queue_size=8,16 -p "
+        "system.row_buf_policy=OPEN_PAGE,CLOSE_PAGE -j 4\n"
+        "./build/dramsim3main configs/DDR4_8Gb_x8_3200.ini -c 1000000 -t "
+        "warmup_trace.txt --save-checkpoint warm.ckpt\n"
+        "./build/dramsim3main configs/DDR4_8Gb_x8_3200.ini -c 10000 -t "
+        "sample_trace.txt --restore-checkpoint warm.ckpt\n"
+        "./build/dramsim3main configs/DDR4_8Gb_x8_3200.ini -c 10000 -t "
+        "sample_trace.txt --fast-forward 1000000\n"
+        "./build/dramsim3main configs/DDR4_8Gb_x8_3200.ini -c 100000 --ooo "
+        "-t core0.trace -t core1.trace --mshrs 8 --cpu-clock-ratio 2.5\n"
+        "./build/dramsim3main configs/DDR4_8Gb_x8_3200.ini -c 1000000 -t "
+        "sample_trace.txt --tune-mapping 4 -j 4");
     args::HelpFlag help(parser, "help", "Display the help menu", {'h', "help"});
     args::ValueFlag<uint64_t> num_cycles_arg(parser, "num_cycles",
                                              "Number of cycles to simulate",
@@ -21,10 +36,55 @@ int main(int argc, const char **argv) {
     args::ValueFlag<std::string> stream_arg(
         parser, "stream_type", "address stream generator - (random), stream",
         {'s', "stream"}, "");
-    args::ValueFlag<std::string> trace_file_arg(
+    args::ValueFlagList<std::string> trace_file_arg(
         parser, "trace",
-        "Trace file, setting this option will ignore -s option",
+        "Trace file, setting this option will ignore -s option. With --ooo "
+        "one per core",
         {'t', "trace"});
+    args::Flag ooo_arg(
+        parser, "ooo",
+        "Replay the traces on out of order cores that wait for their reads "
+        "instead of open loop",
+        {"ooo"});
+    args::ValueFlag<int> rob_arg(parser, "rob_size",
+                                 "Instruction window of an --ooo core",
+                                 {"rob"}, 128);
+    args::ValueFlag<int> mshrs_arg(parser, "mshrs",
+                                   "Reads in flight per --ooo core",
+                                   {"mshrs"}, 16);
+    args::ValueFlag<int> width_arg(
+        parser, "width", "Instructions per CPU cycle of an --ooo core",
+        {"width"}, 4);
+    args::ValueFlag<double> clock_ratio_arg(
+        parser, "cpu_clock_ratio", "CPU cycles per memory cycle with --ooo",
+        {"cpu-clock-ratio"}, 1.0);
+    args::ValueFlagList<std::string> sweep_arg(
+        parser, "param",
+        "Sweep section.key over comma separated values, every combination "
+        "of the given parameters is simulated",
+        {'p', "param"});
+    args::ValueFlag<int> jobs_arg(
+        parser, "jobs", "Parallel sweep runs (0: one per hardware thread)",
+        {'j', "jobs"}, 0);
+    args::ValueFlag<int> tune_mapping_arg(
+        parser, "top_k",
+        "Rank address mappings for the trace in one pass and simulate the "
+        "top_k of them in parallel (-j) for at most -c cycles each",
+        {"tune-mapping"}, 0);
+    args::ValueFlag<std::string> save_checkpoint_arg(
+        parser, "save_checkpoint",
+        "Save the memory system state to this file after the run",
+        {"save-checkpoint"});
+    args::ValueFlag<std::string> restore_checkpoint_arg(
+        parser, "restore_checkpoint",
+        "Start from the memory system state in this file, stats only cover "
+        "the cycles simulated after it",
+        {"restore-checkpoint"});
+    args::ValueFlag<uint64_t> fast_forward_arg(
+        parser, "fast_forward",
+        "Cycles to run on the analytical model before the detailed cycles, "
+        "stats only cover the detailed cycles",
+        {"fast-forward"}, 0);
     args::Positional<std::string> config_arg(
         parser, "config", "The config file name (mandatory)");
 
@@ -47,11 +107,48 @@ int main(int argc, const char **argv) {
 
     uint64_t cycles = args::get(num_cycles_arg);
     std::string output_dir = args::get(output_dir_arg);
-    std::string trace_file = args::get(trace_file_arg);
+    std::vector<std::string> trace_files = args::get(trace_file_arg);
+    std::string trace_file = trace_files.empty() ? "" : trace_files[0];
     std::string stream_type = args::get(stream_arg);
+    bool ooo = args::get(ooo_arg);
+    if ((trace_files.size() > 1 && !ooo) || (ooo && trace_files.empty())) {
+        std::cerr << "Give one trace, or one trace per core with --ooo"
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> sweep_params = args::get(sweep_arg);
+    if (!sweep_params.empty()) {
+        if (ooo) {
+            std::cerr << "Sweeps replay a single trace open loop" << std::endl;
+            return 1;
+        }
+        Sweep sweep(config_file, output_dir, sweep_params);
+        sweep.Run(cycles, trace_file, stream_type, args::get(jobs_arg));
+        return 0;
+    }
+
+    int top_k = args::get(tune_mapping_arg);
+    if (top_k > 0) {
+        if (ooo || trace_file.empty()) {
+            std::cerr << "Mappings are tuned on a single trace" << std::endl;
+            return 1;
+        }
+        MappingTuner tuner(config_file, output_dir);
+        tuner.Run(trace_file, top_k, cycles, args::get(jobs_arg));
+        return 0;
+    }
 
     CPU *cpu;
-    if (!trace_file.empty()) {
+    if (ooo) {
+        CoreParams params;
+        params.rob_size = args::get(rob_arg);
+        params.mshrs = args::get(mshrs_arg);
+        params.width = args::get(width_arg);
+        params.clock_ratio = args::get(clock_ratio_arg);
+        cpu = new MultiCoreTraceCPU(config_file, output_dir, trace_files,
+                                    params);
+    } else if (!trace_file.empty()) {
         cpu = new TraceBasedCPU(config_file, output_dir, trace_file);
     } else {
         if (stream_type == "stream" || stream_type == "s") {
@@ -61,11 +158,32 @@ int main(int argc, const char **argv) {
         }
     }
 
+    std::string restore_checkpoint = args::get(restore_checkpoint_arg);
+    if (!restore_checkpoint.empty()) {
+        cpu->RestoreCheckpoint(restore_checkpoint);
+        cpu->ResetStats();
+    }
+
+    uint64_t fast_forward = args::get(fast_forward_arg);
+    if (fast_forward > 0) {
+        cpu->SetFastForward(true);
+        for (uint64_t clk = 0; clk < fast_forward; clk++) {
+            cpu->ClockTick();
+        }
+        cpu->SetFastForward(false);
+        cpu->ResetStats();
+    }
+
     for (uint64_t clk = 0; clk < cycles; clk++) {
         cpu->ClockTick();
     }
     cpu->PrintStats();
 
+    std::string save_checkpoint = args::get(save_checkpoint_arg);
+    if (!save_checkpoint.empty()) {
+        cpu->SaveCheckpoint(save_checkpoint);
+    }
+
     delete cpu;
 
     return 0;
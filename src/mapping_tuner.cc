@@ -0,0 +1,370 @@
+#include "mapping_tuner.h"
+
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <thread>
+#include "memory_system.h"
+#include "trace_reader.h"
+#include "worker_pool.h"
+
+namespace dramsim3 {
+
+namespace {
+
+const char* kFieldTokens[] = {"ch", "ra", "bg", "ba", "ro", "co"};
+const char* kFieldKeys[] = {"channel", "rank", "bankgroup",
+                            "bank",    "row",  "column"};
+
+// fields whose bits spread requests over banks and channels
+const int kHashedFields[] = {AddressMapper::CH, AddressMapper::RA,
+                             AddressMapper::BG, AddressMapper::BA};
+
+std::string XorString(const std::vector<uint64_t>& masks) {
+    std::ostringstream os;
+    for (size_t i = 0; i < masks.size(); i++) {
+        os << (i == 0 ? "" : ",") << "0x" << std::hex << masks[i];
+    }
+    return os.str();
+}
+
+}  // namespace
+
+MappingTuner::MappingTuner(const std::string& config_file,
+                           const std::string& output_dir)
+    : base_(config_file),
+      config_(config_file, output_dir),
+      output_dir_(output_dir) {
+    if (config_.IsHMC()) {
+        std::cerr << "HMC address mappings cannot be tuned" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    output_prefix_ = base_.Get("other", "output_prefix", "dramsim3");
+    field_widths_[AddressMapper::CH] = LogBase2(config_.channels);
+    field_widths_[AddressMapper::RA] = LogBase2(config_.ranks);
+    field_widths_[AddressMapper::BG] = LogBase2(config_.bankgroups);
+    field_widths_[AddressMapper::BA] = LogBase2(config_.banks_per_group);
+    field_widths_[AddressMapper::RO] = LogBase2(config_.rows);
+    field_widths_[AddressMapper::CO] =
+        LogBase2(config_.columns) - LogBase2(config_.BL);
+}
+
+std::vector<uint64_t> MappingTuner::FieldMasks(
+    const std::vector<int>& order) const {
+    // as in Config::SetAddressMapping, the last field is the lowest
+    std::vector<uint64_t> masks(AddressMapper::NUM_FIELDS, 0);
+    int pos = config_.shift_bits;
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        int width = field_widths_[*it];
+        masks[*it] = ((1ULL << width) - 1) << pos;
+        pos += width;
+    }
+    return masks;
+}
+
+std::vector<AddressBitStats> MappingTuner::BitStats(
+    const std::vector<Transaction>& trace) const {
+    int num_bits = config_.shift_bits;
+    for (int width : field_widths_) {
+        num_bits += width;
+    }
+    std::vector<uint64_t> ones(num_bits, 0), toggles(num_bits, 0);
+    uint64_t last_addr = trace.empty() ? 0 : trace.front().addr;
+    for (const auto& trans : trace) {
+        uint64_t toggled = trans.addr ^ last_addr;
+        for (int bit = 0; bit < num_bits; bit++) {
+            ones[bit] += (trans.addr >> bit) & 1;
+            toggles[bit] += (toggled >> bit) & 1;
+        }
+        last_addr = trans.addr;
+    }
+
+    std::vector<AddressBitStats> stats;
+    double num_trans = std::max(trace.size(), static_cast<size_t>(1));
+    for (int bit = config_.shift_bits; bit < num_bits; bit++) {
+        double p = ones[bit] / num_trans;
+        double entropy = 0.0;
+        if (p > 0.0 && p < 1.0) {
+            entropy = -(p * log2(p) + (1.0 - p) * log2(1.0 - p));
+        }
+        stats.push_back({bit, p, entropy, toggles[bit] / num_trans});
+    }
+    return stats;
+}
+
+std::vector<MappingCandidate> MappingTuner::Candidates(
+    const std::vector<AddressBitStats>& bit_stats) const {
+    std::vector<double> toggle_rates(64, 0.0);
+    for (const auto& stats : bit_stats) {
+        toggle_rates[stats.bit] = stats.toggle_rate;
+    }
+
+    std::vector<MappingCandidate> candidates;
+    // orders that only move empty fields around decode the same
+    std::set<std::vector<uint64_t>> seen;
+    std::vector<int> order = {AddressMapper::CH, AddressMapper::RA,
+                              AddressMapper::BG, AddressMapper::BA,
+                              AddressMapper::RO, AddressMapper::CO};
+    do {
+        std::vector<uint64_t> masks = FieldMasks(order);
+        if (!seen.insert(masks).second) {
+            continue;
+        }
+        MappingCandidate candidate;
+        for (int field : order) {
+            candidate.address_mapping += kFieldTokens[field];
+        }
+        candidate.field_masks = masks;
+        candidate.xor_masks.resize(AddressMapper::NUM_FIELDS);
+        candidates.push_back(candidate);
+
+        // row bits that toggle most first, ties go to the lower bit
+        std::vector<int> row_bits;
+        for (int bit = 0; bit < 64; bit++) {
+            if ((masks[AddressMapper::RO] >> bit) & 1) {
+                row_bits.push_back(bit);
+            }
+        }
+        std::stable_sort(row_bits.begin(), row_bits.end(),
+                         [&toggle_rates](int a, int b) {
+                             return toggle_rates[a] > toggle_rates[b];
+                         });
+        size_t next_row_bit = 0;
+        for (int field : kHashedFields) {
+            for (int i = 0; i < field_widths_[field] && !row_bits.empty();
+                 i++) {
+                int row_bit = row_bits[next_row_bit++ % row_bits.size()];
+                candidate.xor_masks[field].push_back(1ULL << row_bit);
+            }
+        }
+        if (next_row_bit > 0) {
+            candidates.push_back(candidate);
+        }
+    } while (std::next_permutation(order.begin(), order.end()));
+    return candidates;
+}
+
+MappingScore MappingTuner::Score(const MappingCandidate& candidate,
+                                 const std::vector<Transaction>& trace) const {
+    AddressMapper mapper;
+    mapper.Init(candidate.field_masks, candidate.xor_masks);
+    int banks_per_channel = config_.ranks * config_.banks;
+    std::vector<int> open_rows(config_.channels * banks_per_channel, -1);
+    std::vector<uint64_t> bank_busy(open_rows.size(), 0);
+    std::vector<uint64_t> bus_busy(config_.channels, 0);
+    std::vector<int> touched;
+    size_t window = static_cast<size_t>(config_.trans_queue_size) *
+                    static_cast<size_t>(config_.channels);
+    uint64_t hit_cycles = config_.tCCD_L;
+    uint64_t miss_cycles = hit_cycles + config_.tRCD;
+    uint64_t conflict_cycles = miss_cycles + config_.tRP;
+
+    uint64_t hits = 0, conflicts = 0, cycles = 0;
+    auto end_window = [&]() {
+        uint64_t window_cycles = 0;
+        for (int bank : touched) {
+            window_cycles = std::max(window_cycles, bank_busy[bank]);
+            bank_busy[bank] = 0;
+        }
+        for (auto& busy : bus_busy) {
+            window_cycles = std::max(window_cycles, busy);
+            busy = 0;
+        }
+        cycles += window_cycles;
+        touched.clear();
+    };
+    for (size_t i = 0; i < trace.size(); i++) {
+        Address addr = mapper.Decode(trace[i].addr);
+        int bank = addr.channel * banks_per_channel +
+                   addr.rank * config_.banks +
+                   addr.bankgroup * config_.banks_per_group + addr.bank;
+        if (bank_busy[bank] == 0) {
+            touched.push_back(bank);
+        }
+        if (open_rows[bank] == addr.row) {
+            hits++;
+            bank_busy[bank] += hit_cycles;
+        } else if (open_rows[bank] < 0) {
+            bank_busy[bank] += miss_cycles;
+        } else {
+            conflicts++;
+            bank_busy[bank] += conflict_cycles;
+        }
+        open_rows[bank] = addr.row;
+        bus_busy[addr.channel] += config_.burst_cycle;
+        if ((i + 1) % window == 0) {
+            end_window();
+        }
+    }
+    end_window();
+
+    double num_trans = std::max(trace.size(), static_cast<size_t>(1));
+    return {hits / num_trans, conflicts / num_trans, cycles};
+}
+
+MappingTuner::SimResult MappingTuner::Simulate(
+    const MappingCandidate& candidate, int rank,
+    const std::vector<Transaction>& trace, uint64_t cycles) const {
+    SweepReader reader(base_);
+    reader.Set("system", "address_mapping", candidate.address_mapping);
+    for (int i = 0; i < AddressMapper::NUM_FIELDS; i++) {
+        // empty values are the defaults of the mapping string
+        reader.Set("system", std::string(kFieldKeys[i]) + "_bits", "");
+        reader.Set("system", std::string(kFieldKeys[i]) + "_xor",
+                   XorString(candidate.xor_masks[i]));
+    }
+    reader.Set("other", "output_prefix",
+               output_prefix_ + "_mapping_" + std::to_string(rank));
+    Config* config = new Config(reader, output_dir_);
+    uint64_t request_bytes = config->request_size_bytes;
+    double tCK = config->tCK;
+
+    MemorySystem memory_system(config, output_dir_, nullptr, nullptr);
+    uint64_t clk = 0, num_done = 0, last_done = 0, total_latency = 0;
+    memory_system.RegisterCompletionCallback(
+        [&](const Completion& completion) {
+            num_done++;
+            last_done = completion.complete_cycle;
+            total_latency += completion.complete_cycle - completion.issue_cycle;
+        });
+    // open loop as TraceBasedCPU, until the trace is done or out of cycles
+    size_t next = 0;
+    while (num_done < trace.size() && clk < cycles) {
+        memory_system.ClockTick();
+        if (next < trace.size() && trace[next].added_cycle <= clk &&
+            memory_system.AddTransaction(trace[next].addr,
+                                         trace[next].is_write)) {
+            next++;
+        }
+        clk++;
+    }
+    memory_system.PrintStats();
+
+    SimResult result;
+    result.cycles = num_done == trace.size() ? last_done + 1 : clk;
+    result.num_done = num_done;
+    result.bandwidth =
+        result.cycles > 0
+            ? num_done * request_bytes / (result.cycles * tCK)
+            : 0.0;
+    result.avg_latency =
+        num_done > 0 ? static_cast<double>(total_latency) / num_done : 0.0;
+    return result;
+}
+
+void MappingTuner::Run(const std::string& trace_file, int top_k,
+                       uint64_t cycles, int num_threads) const {
+    std::vector<Transaction> trace = DecodeTrace(trace_file);
+    if (trace.empty()) {
+        std::cerr << "Trace " << trace_file << " is empty" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    std::vector<AddressBitStats> bit_stats = BitStats(trace);
+    std::vector<MappingCandidate> candidates = Candidates(bit_stats);
+    if (num_threads <= 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    WorkerPool workers(static_cast<int>(
+        std::min(static_cast<size_t>(num_threads), candidates.size())));
+
+    std::vector<MappingScore> scores(candidates.size());
+    std::atomic<size_t> next_candidate(0);
+    workers.Run([&](int) {
+        size_t i;
+        while ((i = next_candidate.fetch_add(1)) < candidates.size()) {
+            scores[i] = Score(candidates[i], trace);
+        }
+    });
+    std::vector<size_t> ranking(candidates.size());
+    for (size_t i = 0; i < ranking.size(); i++) {
+        ranking[i] = i;
+    }
+    std::stable_sort(ranking.begin(), ranking.end(),
+                     [&scores](size_t a, size_t b) {
+                         if (scores[a].cycles != scores[b].cycles) {
+                             return scores[a].cycles < scores[b].cycles;
+                         }
+                         if (scores[a].conflict_rate !=
+                             scores[b].conflict_rate) {
+                             return scores[a].conflict_rate <
+                                    scores[b].conflict_rate;
+                         }
+                         return scores[a].row_hit_rate >
+                                scores[b].row_hit_rate;
+                     });
+
+    size_t num_sims =
+        std::min(static_cast<size_t>(std::max(top_k, 0)), ranking.size());
+    std::vector<SimResult> results(num_sims);
+    std::atomic<size_t> next_sim(0);
+    workers.Run([&](int) {
+        size_t i;
+        while ((i = next_sim.fetch_add(1)) < num_sims) {
+            results[i] = Simulate(candidates[ranking[i]], static_cast<int>(i),
+                                  trace, cycles);
+        }
+    });
+
+    std::ofstream bits_csv(output_dir_ + "/" + output_prefix_ +
+                           "_mapping_bits.csv");
+    bits_csv << "bit,one_rate,entropy,toggle_rate" << std::endl;
+    for (const auto& stats : bit_stats) {
+        bits_csv << stats.bit << "," << stats.one_rate << "," << stats.entropy
+                 << "," << stats.toggle_rate << std::endl;
+    }
+
+    std::ofstream csv(output_dir_ + "/" + output_prefix_ + "_mapping.csv");
+    csv << "rank,address_mapping,channel_xor,rank_xor,bankgroup_xor,bank_xor,"
+           "predicted_row_hit_rate,predicted_conflict_rate,predicted_cycles,"
+           "cycles,requests_done,bandwidth_gbps,avg_latency"
+        << std::endl;
+    for (size_t i = 0; i < ranking.size(); i++) {
+        const MappingCandidate& candidate = candidates[ranking[i]];
+        const MappingScore& score = scores[ranking[i]];
+        csv << i << "," << candidate.address_mapping;
+        for (int field : kHashedFields) {
+            csv << ",\"" << XorString(candidate.xor_masks[field]) << "\"";
+        }
+        csv << "," << score.row_hit_rate << "," << score.conflict_rate << ","
+            << score.cycles;
+        if (i < num_sims) {
+            csv << "," << results[i].cycles << "," << results[i].num_done
+                << "," << results[i].bandwidth << ","
+                << results[i].avg_latency;
+        } else {
+            csv << ",,,,";
+        }
+        csv << std::endl;
+    }
+
+    std::cout << candidates.size() << " candidate mappings, simulated "
+              << num_sims << " of them" << std::endl;
+    if (num_sims == 0) {
+        return;
+    }
+    size_t best = 0;
+    for (size_t i = 1; i < num_sims; i++) {
+        if (results[i].bandwidth > results[best].bandwidth) {
+            best = i;
+        }
+    }
+    const MappingCandidate& candidate = candidates[ranking[best]];
+    std::cout << "Best mapping (" << results[best].bandwidth << " GB/s, "
+              << results[best].avg_latency << " cycles latency):" << std::endl;
+    std::cout << "address_mapping = " << candidate.address_mapping
+              << std::endl;
+    for (int field : kHashedFields) {
+        if (!candidate.xor_masks[field].empty()) {
+            std::cout << kFieldKeys[field]
+                      << "_xor = " << XorString(candidate.xor_masks[field])
+                      << std::endl;
+        }
+    }
+    return;
+}
+
+}  // namespace dramsim3
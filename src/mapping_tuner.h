@@ -0,0 +1,93 @@
+#ifndef __MAPPING_TUNER_H
+#define __MAPPING_TUNER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "configuration.h"
+#include "sweep.h"
+
+namespace dramsim3 {
+
+// an address_mapping string, optionally with the channel, rank, bankgroup
+// and bank bits XOR-ed with row bits ([system] <field>_xor)
+struct MappingCandidate {
+    std::string address_mapping;
+    // AddressMapper::NUM_FIELDS entries each
+    std::vector<uint64_t> field_masks;
+    // empty for the fields that are not hashed
+    std::vector<std::vector<uint64_t>> xor_masks;
+};
+
+// what a single pass over the trace predicts for a candidate
+struct MappingScore {
+    double row_hit_rate;
+    double conflict_rate;
+    // cycles to serve the trace back to back
+    uint64_t cycles;
+};
+
+// per physical address bit over the whole trace
+struct AddressBitStats {
+    int bit;
+    double one_rate;
+    double entropy;
+    // how often the bit differs from the previous request
+    double toggle_rate;
+};
+
+// Finds an address mapping for a trace without simulating every option.
+// Every distinct order of the address_mapping fields is a candidate, and
+// so is a hashed variant of it that XORs the channel, rank, bankgroup and
+// bank bits with the row bits that toggle most in the trace. One pass over
+// the trace scores all candidates with an open page model: requests are
+// cut into windows of what the transaction queues hold, a window takes as
+// long as its busiest bank or data bus, a bank spends tCCD_L on a row hit,
+// tRCD more on an empty bank and tRP more on a conflict. Only the top_k
+// candidates are simulated, in parallel, replaying the trace as
+// dramsim3main does. <output_prefix>_mapping_bits.csv gets the per bit
+// entropy and toggle rates, <output_prefix>_mapping.csv the candidates in
+// predicted order with the simulated results of the top_k.
+class MappingTuner {
+   public:
+    MappingTuner(const std::string& config_file,
+                 const std::string& output_dir);
+    // toggle rates of the trace pick the row bits the hashed candidates
+    // use, without them the lowest row bits are used
+    std::vector<MappingCandidate> Candidates(
+        const std::vector<AddressBitStats>& bit_stats) const;
+    std::vector<AddressBitStats> BitStats(
+        const std::vector<Transaction>& trace) const;
+    MappingScore Score(const MappingCandidate& candidate,
+                       const std::vector<Transaction>& trace) const;
+    // scores all candidates and simulates the top_k of them for at most
+    // cycles cycles each on num_threads threads (0: one per hardware
+    // thread)
+    void Run(const std::string& trace_file, int top_k, uint64_t cycles,
+             int num_threads) const;
+
+   private:
+    struct SimResult {
+        uint64_t cycles;
+        uint64_t num_done;
+        double bandwidth;
+        double avg_latency;
+    };
+
+    SweepReader base_;
+    Config config_;
+    std::string output_dir_;
+    std::string output_prefix_;
+    int field_widths_[AddressMapper::NUM_FIELDS];
+
+    // the field masks an address_mapping string decodes to, fields in
+    // AddressMapper order from high to low
+    std::vector<uint64_t> FieldMasks(const std::vector<int>& order) const;
+    SimResult Simulate(const MappingCandidate& candidate, int rank,
+                       const std::vector<Transaction>& trace,
+                       uint64_t cycles) const;
+};
+
+}  // namespace dramsim3
+#endif
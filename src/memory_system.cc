@@ -1,27 +1,114 @@
 #include "memory_system.h"
 
+#include <iostream>
+
 namespace dramsim3 {
 MemorySystem::MemorySystem(const std::string &config_file,
                            const std::string &output_dir,
                            std::function<void(uint64_t)> read_callback,
                            std::function<void(uint64_t)> write_callback)
-    : config_(new Config(config_file, output_dir)) {
+    : MemorySystem(new Config(config_file, output_dir), output_dir,
+                   read_callback, write_callback) {}
+
+MemorySystem::MemorySystem(Config *config, const std::string &,
+                           std::function<void(uint64_t)> read_callback,
+                           std::function<void(uint64_t)> write_callback)
+    : MemorySystem(std::shared_ptr<const Config>(config), config->output_dir,
+                   read_callback, write_callback) {}
+
+MemorySystem::MemorySystem(std::shared_ptr<const Config> config,
+                           const std::string &output_dir,
+                           std::function<void(uint64_t)> read_callback,
+                           std::function<void(uint64_t)> write_callback)
+    : config_(config),
+      output_dir_(output_dir),
+      fast_forward_(nullptr),
+      fast_forwarding_(false),
+      rows_pending_(false) {
     // TODO: ideal memory type?
     if (config_->IsHMC()) {
-        dram_system_ = new HMCMemorySystem(*config_, output_dir, read_callback,
+        dram_system_ = new HMCMemorySystem(*config_, output_dir_, read_callback,
                                            write_callback);
     } else {
-        dram_system_ = new JedecDRAMSystem(*config_, output_dir, read_callback,
-                                           write_callback);
+        dram_system_ = new JedecDRAMSystem(*config_, output_dir_,
+                                           read_callback, write_callback);
     }
 }
 
 MemorySystem::~MemorySystem() {
     delete (dram_system_);
-    delete (config_);
+    delete (fast_forward_);
+}
+
+void MemorySystem::ClockTick() {
+    BaseDRAMSystem *inactive = Inactive();
+    // the outgoing system keeps running until it returned everything
+    if (inactive && !inactive->IsIdle()) {
+        inactive->ClockTick();
+    }
+    BaseDRAMSystem *active = Active();
+    if (rows_pending_ && dram_system_->IsIdle()) {
+        dram_system_->ForwardTo(fast_forward_->Clock());
+        dram_system_->SetOpenRows(fast_forward_->OpenRows());
+        rows_pending_ = false;
+    }
+    active->ClockTick();
+    return;
 }
 
-void MemorySystem::ClockTick() { dram_system_->ClockTick(); }
+uint64_t MemorySystem::AdvanceTo(uint64_t ps) {
+    uint64_t start_clk = Active()->Clock();
+    // a cycle that ends right at ps must not get lost to rounding
+    uint64_t clk =
+        static_cast<uint64_t>(ps / (config_->tCK * 1000.0) * (1 + 1e-12));
+    // switches have to be ticked through cycle by cycle
+    while (Active()->Clock() < clk &&
+           (rows_pending_ || (Inactive() && !Inactive()->IsIdle()))) {
+        ClockTick();
+    }
+    if (Active()->Clock() < clk) {
+        Active()->ClockTickTo(clk);
+    }
+    return Active()->Clock() - start_clk;
+}
+
+void MemorySystem::SetFastForward(bool fast_forward) {
+    if (fast_forward == fast_forwarding_) {
+        return;
+    }
+#ifdef THERMAL
+    // a second thermal model would write over the output of the first one
+    std::cerr << "Fast forward is not supported with the thermal model"
+              << std::endl;
+    AbruptExit(__FILE__, __LINE__);
+#endif  // THERMAL
+    if (!fast_forward_) {
+        fast_forward_ = new FastForwardDRAMSystem(
+            *config_, output_dir_, dram_system_->read_callback_,
+            dram_system_->write_callback_);
+        fast_forward_->completion_callback_ =
+            dram_system_->completion_callback_;
+    }
+    BaseDRAMSystem *outgoing = Active();
+    fast_forwarding_ = fast_forward;
+    BaseDRAMSystem *incoming = Active();
+    // a busy system was ticked along with the other one
+    if (incoming->IsIdle()) {
+        incoming->ForwardTo(outgoing->Clock());
+    }
+    if (fast_forwarding_) {
+        // the model has nothing in flight, the detailed rows are final once
+        // the detailed system is idle but near enough right away
+        incoming->SetOpenRows(outgoing->OpenRows());
+        rows_pending_ = false;
+    } else {
+        // banks may not be opened or closed under the controllers' feet
+        rows_pending_ = true;
+    }
+    return;
+}
+
+bool MemorySystem::IsFastForward() const { return fast_forwarding_; }
 
 double MemorySystem::GetTCK() const { return config_->tCK; }
 
@@ -35,19 +122,73 @@ void MemorySystem::RegisterCallbacks(
     std::function<void(uint64_t)> read_callback,
     std::function<void(uint64_t)> write_callback) {
     dram_system_->RegisterCallbacks(read_callback, write_callback);
+    if (fast_forward_) {
+        fast_forward_->RegisterCallbacks(read_callback, write_callback);
+    }
+}
+
+void MemorySystem::RegisterCompletionCallback(
+    std::function<void(const Completion &)> completion_callback) {
+    dram_system_->RegisterCompletionCallback(completion_callback);
+    if (fast_forward_) {
+        fast_forward_->RegisterCompletionCallback(completion_callback);
+    }
 }
 
 bool MemorySystem::WillAcceptTransaction(uint64_t hex_addr,
                                          bool is_write) const {
-    return dram_system_->WillAcceptTransaction(hex_addr, is_write);
+    return Active()->WillAcceptTransaction(hex_addr, is_write);
 }
 
 bool MemorySystem::AddTransaction(uint64_t hex_addr, bool is_write) {
-    return dram_system_->AddTransaction(hex_addr, is_write);
+    return Active()->AddTransaction(hex_addr, is_write);
+}
+
+bool MemorySystem::AddTransaction(uint64_t hex_addr, bool is_write,
+                                  uint64_t tag, int source_id, int priority) {
+    return Active()->AddTransaction(hex_addr, is_write, tag, source_id,
+                                    priority);
+}
+
+size_t MemorySystem::AddTransactions(const Request *reqs, size_t num) {
+    return Active()->AddTransactions(reqs, num);
+}
+
+size_t MemorySystem::DrainCompletions(Completion *completions,
+                                      size_t max_num) {
+    size_t num = dram_system_->DrainCompletions(completions, max_num);
+    if (fast_forward_) {
+        num += fast_forward_->DrainCompletions(completions + num,
+                                               max_num - num);
+    }
+    return num;
+}
+
+void MemorySystem::SaveCheckpoint(const std::string &file_name) const {
+    if (fast_forwarding_ || rows_pending_) {
+        std::cerr << "Cannot checkpoint while fast forwarding" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    CheckpointWriter writer(file_name, CheckpointLayout(*config_));
+    dram_system_->Save(writer);
+}
+
+void MemorySystem::RestoreCheckpoint(const std::string &file_name) {
+    if (fast_forwarding_ || rows_pending_) {
+        std::cerr << "Cannot restore a checkpoint while fast forwarding"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    CheckpointReader reader(file_name, CheckpointLayout(*config_));
+    dram_system_->Restore(reader);
 }
 
 void MemorySystem::PrintStats() const { dram_system_->PrintStats(); }
 
+nlohmann::json MemorySystem::FinalStats() const {
+    return dram_system_->FinalStats();
+}
+
 void MemorySystem::ResetStats() { dram_system_->ResetStats(); }
 
 MemorySystem* GetMemorySystem(const std::string &config_file, const std::string &output_dir,
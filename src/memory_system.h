@@ -2,40 +2,117 @@
 #define __MEMORY_SYSTEM__H
 
 #include <functional>
+#include <memory>
 #include <string>
 
 #include "configuration.h"
 #include "dram_system.h"
 #include "hmc.h"
+#include "request.h"
 
 namespace dramsim3 {
 
 // This should be the interface class that deals with CPU
+//
+// Threading: a memory system is not thread safe, calls to it have to come
+// from one thread at a time and its callbacks run on the thread that calls
+// ClockTick (or AdvanceTo). Memory systems share no state with each other, so any number of them can
+// run on different threads, also with one shared config. Each one writes
+// the files of its output directory, memory systems that run at the same
+// time need directories of their own. Errors still end the whole process.
 class MemorySystem {
    public:
     MemorySystem(const std::string &config_file, const std::string &output_dir,
                  std::function<void(uint64_t)> read_callback,
                  std::function<void(uint64_t)> write_callback);
+    // takes ownership of config, the output goes to its output_dir
+    MemorySystem(Config *config, const std::string &output_dir,
+                 std::function<void(uint64_t)> read_callback,
+                 std::function<void(uint64_t)> write_callback);
+    // config is only read and can be shared with other memory systems, e.g.
+    // one per socket or sweep point, without parsing it again for each
+    MemorySystem(std::shared_ptr<const Config> config,
+                 const std::string &output_dir,
+                 std::function<void(uint64_t)> read_callback,
+                 std::function<void(uint64_t)> write_callback);
     ~MemorySystem();
     void ClockTick();
+    // Clock domain crossing for front ends with a clock of their own: runs
+    // all memory cycles that end by time ps (picoseconds, cycle n ends at
+    // (n + 1) * tCK) in one call, e.g. once per CPU cycle or per request,
+    // instead of the front end counting memory cycles. With event_driven =
+    // true the idle stretches in between are jumped over at once. Returns
+    // the number of memory cycles run.
+    uint64_t AdvanceTo(uint64_t ps);
     void RegisterCallbacks(std::function<void(uint64_t)> read_callback,
                            std::function<void(uint64_t)> write_callback);
+    // when set it is called for every completed request instead of the
+    // address callbacks, with the tag, source and cycles of the request
+    void RegisterCompletionCallback(
+        std::function<void(const Completion &)> completion_callback);
     double GetTCK() const;
     int GetBusBits() const;
     int GetBurstLength() const;
     int GetQueueSize() const;
     void PrintStats() const;
+    // the stats PrintStats put out, also with output_level = -1 which
+    // writes no stats files
+    nlohmann::json FinalStats() const;
     void ResetStats();
 
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const;
     bool AddTransaction(uint64_t hex_addr, bool is_write);
+    // tag is handed back in the Completion instead of the address
+    bool AddTransaction(uint64_t hex_addr, bool is_write, uint64_t tag,
+                        int source_id = 0, int priority = 0);
+
+    // Batch interface: adds requests in order until one of them is not
+    // accepted and returns the number of requests added. Completions of
+    // requests without a callback (register an empty std::function for
+    // reads and/or writes) are buffered until drained, oldest first.
+    size_t AddTransactions(const Request *reqs, size_t num);
+    size_t DrainCompletions(Completion *completions, size_t max_num);
+
+    // Checkpoints: the complete simulation state (bank states and timings,
+    // queued transactions and commands, refresh and policy state, HMC link
+    // and quad queues, stats) goes to a binary file. A memory system built
+    // from a config with the same layout (see CheckpointLayout) and restored
+    // from it continues exactly like the saved one would have, e.g. to fork
+    // short detailed runs off one warm-up. Callbacks are not saved, nor is
+    // the thermal model state.
+    void SaveCheckpoint(const std::string &file_name) const;
+    void RestoreCheckpoint(const std::string &file_name);
+
+    // Fast forward: requests go to an analytical model (see
+    // FastForwardDRAMSystem) that is much faster than the cycle accurate
+    // system, e.g. to warm up caches and row buffers before a detailed
+    // region. Either system finishes the requests it holds when the other
+    // one takes over, the incoming one picks up the clock and, once idle,
+    // the open rows of the outgoing one. Stats only count detailed cycles,
+    // call ResetStats to start them over after a switch. Checkpoints can
+    // only be taken and restored in detailed mode.
+    void SetFastForward(bool fast_forward);
+    bool IsFastForward() const;
 
    private:
     // These have to be pointers because Gem5 will try to push this object
     // into container which will invoke a copy constructor, using pointers
     // here is safe
-    Config *config_;
+    std::shared_ptr<const Config> config_;
+    std::string output_dir_;
     BaseDRAMSystem *dram_system_;
+    // created on the first switch to fast forward
+    BaseDRAMSystem *fast_forward_;
+    bool fast_forwarding_;
+    // open rows still to be handed to the detailed system once it is idle
+    bool rows_pending_;
+
+    BaseDRAMSystem *Active() const {
+        return fast_forwarding_ ? fast_forward_ : dram_system_;
+    }
+    BaseDRAMSystem *Inactive() const {
+        return fast_forwarding_ ? dram_system_ : fast_forward_;
+    }
 };
 
 MemorySystem* GetMemorySystem(const std::string &config_file, const std::string &output_dir,
@@ -0,0 +1,169 @@
+#include "pending_table.h"
+
+namespace dramsim3 {
+
+PendingTable::PendingTable(int capacity)
+    : free_head_(-1), num_keys_(0), num_entries_(0) {
+    if (capacity < 1) {
+        capacity = 1;
+    }
+    // keep the load factor of the open addressing part at or below 1/2
+    uint64_t num_slots = 2;
+    while (num_slots < 2 * static_cast<uint64_t>(capacity)) {
+        num_slots <<= 1;
+    }
+    slots_.resize(num_slots, Slot{0, -1, -1, 0});
+    slot_mask_ = num_slots - 1;
+
+    entries_.resize(capacity);
+    for (int i = 0; i < capacity; i++) {
+        entries_[i].next = i + 1 < capacity ? i + 1 : -1;
+    }
+    free_head_ = 0;
+}
+
+uint64_t PendingTable::Hash(uint64_t addr) const {
+    // addresses are usually burst aligned, fibonacci hashing spreads the
+    // upper bits over all slots
+    uint64_t hash = addr * 0x9E3779B97F4A7C15ull;
+    return (hash ^ (hash >> 32)) & slot_mask_;
+}
+
+uint64_t PendingTable::Probe(uint64_t addr) const {
+    uint64_t slot = Hash(addr);
+    while (slots_[slot].head >= 0 && slots_[slot].addr != addr) {
+        slot = (slot + 1) & slot_mask_;
+    }
+    return slot;
+}
+
+int PendingTable::AllocEntry() {
+    if (free_head_ < 0) {
+        GrowEntries();
+    }
+    int idx = free_head_;
+    free_head_ = entries_[idx].next;
+    entries_[idx].next = -1;
+    return idx;
+}
+
+void PendingTable::GrowEntries() {
+    int old_size = static_cast<int>(entries_.size());
+    int new_size = old_size * 2;
+    entries_.resize(new_size);
+    for (int i = old_size; i < new_size; i++) {
+        entries_[i].next = i + 1 < new_size ? i + 1 : -1;
+    }
+    free_head_ = old_size;
+}
+
+void PendingTable::GrowSlots() {
+    std::vector<Slot> old_slots;
+    old_slots.swap(slots_);
+    slots_.resize(old_slots.size() * 2, Slot{0, -1, -1, 0});
+    slot_mask_ = slots_.size() - 1;
+    for (const auto& slot : old_slots) {
+        if (slot.head >= 0) {
+            slots_[Probe(slot.addr)] = slot;
+        }
+    }
+}
+
+void PendingTable::Insert(const Transaction& trans) {
+    if (2 * (num_keys_ + 1) > static_cast<int>(slots_.size())) {
+        GrowSlots();
+    }
+    int idx = AllocEntry();
+    entries_[idx].trans = trans;
+    num_entries_++;
+
+    Slot& slot = slots_[Probe(trans.addr)];
+    if (slot.head < 0) {
+        slot.addr = trans.addr;
+        slot.head = idx;
+        slot.tail = idx;
+        slot.count = 1;
+        num_keys_++;
+    } else {
+        entries_[slot.tail].next = idx;
+        slot.tail = idx;
+        slot.count++;
+    }
+}
+
+int PendingTable::Count(uint64_t addr) const {
+    const Slot& slot = slots_[Probe(addr)];
+    return slot.head < 0 ? 0 : slot.count;
+}
+
+Transaction* PendingTable::Find(uint64_t addr) {
+    const Slot& slot = slots_[Probe(addr)];
+    return slot.head < 0 ? nullptr : &entries_[slot.head].trans;
+}
+
+void PendingTable::Erase(uint64_t addr) {
+    uint64_t slot_idx = Probe(addr);
+    Slot& slot = slots_[slot_idx];
+    if (slot.head < 0) {
+        return;
+    }
+    int idx = slot.head;
+    slot.head = entries_[idx].next;
+    slot.count--;
+    entries_[idx].next = free_head_;
+    free_head_ = idx;
+    num_entries_--;
+    if (slot.count == 0) {
+        EraseSlot(slot_idx);
+        num_keys_--;
+    }
+}
+
+void PendingTable::EraseSlot(uint64_t slot) {
+    // backward shift deletion, moves later entries of the probe sequence up
+    // so that lookups never have to skip over tombstones
+    uint64_t hole = slot;
+    uint64_t next = (hole + 1) & slot_mask_;
+    while (slots_[next].head >= 0) {
+        uint64_t home = Hash(slots_[next].addr);
+        // distance from home must not become negative after the move
+        if (((next - home) & slot_mask_) >= ((next - hole) & slot_mask_)) {
+            slots_[hole] = slots_[next];
+            hole = next;
+        }
+        next = (next + 1) & slot_mask_;
+    }
+    slots_[hole].head = -1;
+}
+
+void PendingTable::Save(CheckpointWriter& writer) const {
+    writer.Put(static_cast<uint64_t>(entries_.size()));
+    for (const auto& entry : entries_) {
+        writer.Put(entry.trans);
+        writer.Put(entry.next);
+    }
+    writer.Put(slots_);
+    writer.Put(slot_mask_);
+    writer.Put(free_head_);
+    writer.Put(num_keys_);
+    writer.Put(num_entries_);
+    return;
+}
+
+void PendingTable::Restore(CheckpointReader& reader) {
+    uint64_t num_entries;
+    reader.Get(num_entries);
+    entries_.resize(num_entries);
+    for (auto& entry : entries_) {
+        reader.Get(entry.trans);
+        reader.Get(entry.next);
+    }
+    reader.Get(slots_);
+    reader.Get(slot_mask_);
+    reader.Get(free_head_);
+    reader.Get(num_keys_);
+    reader.Get(num_entries_);
+    return;
+}
+
+}  // namespace dramsim3
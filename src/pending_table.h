@@ -0,0 +1,60 @@
+#ifndef __PENDING_TABLE_H
+#define __PENDING_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+#include "checkpoint.h"
+#include "common.h"
+
+namespace dramsim3 {
+
+// Transactions that are not completed, keyed by address. An open addressing
+// hash table over a fixed pool of entries, transactions to the same address
+// (e.g. merged reads) are chained in arrival order. The table is sized at
+// construction and only grows if the expected capacity is exceeded, so
+// there are no allocations in steady state.
+class PendingTable {
+   public:
+    PendingTable(int capacity);
+    void Insert(const Transaction& trans);
+    // number of transactions pending on addr
+    int Count(uint64_t addr) const;
+    // oldest transaction pending on addr, nullptr if there is none
+    Transaction* Find(uint64_t addr);
+    // remove the oldest transaction pending on addr
+    void Erase(uint64_t addr);
+    bool Empty() const { return num_entries_ == 0; }
+    void Save(CheckpointWriter& writer) const;
+    void Restore(CheckpointReader& reader);
+
+   private:
+    struct Entry {
+        Transaction trans;
+        int next;
+    };
+
+    struct Slot {
+        uint64_t addr;
+        int head;  // -1 if the slot is empty
+        int tail;
+        int count;
+    };
+
+    std::vector<Entry> entries_;
+    std::vector<Slot> slots_;
+    uint64_t slot_mask_;
+    int free_head_;
+    int num_keys_;
+    int num_entries_;
+
+    // slot holding addr, or the empty slot where it would be inserted
+    uint64_t Probe(uint64_t addr) const;
+    uint64_t Hash(uint64_t addr) const;
+    int AllocEntry();
+    void GrowEntries();
+    void GrowSlots();
+    void EraseSlot(uint64_t slot);
+};
+
+}  // namespace dramsim3
+#endif
@@ -0,0 +1,83 @@
+#include "power_policy.h"
+#include <limits>
+
+namespace dramsim3 {
+
+PowerPolicy::PowerPolicy(const Config& config)
+    : config_(config),
+      last_cmd_clk_(config.ranks, 0),
+      last_rw_clk_(config.ranks, 0),
+      predicted_idle_(config.ranks, 0) {}
+
+bool PowerPolicy::PredictsSelfRefresh(int rank, uint64_t clk) const {
+    if (!config_.enable_self_refresh) {
+        return false;
+    }
+    uint64_t threshold = static_cast<uint64_t>(config_.sref_threshold);
+    return predicted_idle_[rank] >= threshold ||
+           clk - last_rw_clk_[rank] >= threshold;
+}
+
+CommandType PowerPolicy::LowPowerCommand(int rank, bool powered_down,
+                                         uint64_t clk) const {
+    if (powered_down) {
+        // self refresh can only be entered from precharge standby
+        return PredictsSelfRefresh(rank, clk) ? CommandType::PD_EXIT
+                                              : CommandType::SIZE;
+    } else if (clk < last_cmd_clk_[rank] + config_.pd_threshold) {
+        return CommandType::SIZE;
+    }
+    return PredictsSelfRefresh(rank, clk) ? CommandType::SREF_ENTER
+                                          : CommandType::PD_ENTER;
+}
+
+uint64_t PowerPolicy::NextLowPowerCycle(int rank, bool powered_down) const {
+    if (!powered_down) {
+        return last_cmd_clk_[rank] + config_.pd_threshold;
+    } else if (config_.enable_self_refresh) {
+        return last_rw_clk_[rank] + config_.sref_threshold;
+    }
+    return std::numeric_limits<uint64_t>::max();
+}
+
+void PowerPolicy::CommandIssued(const Command& cmd, uint64_t clk,
+                                bool woken_up) {
+    int rank = cmd.Rank();
+    switch (cmd.cmd_type) {
+        case CommandType::PD_EXIT:
+        case CommandType::SREF_EXIT:
+            if (woken_up) {
+                uint64_t idle = clk - last_rw_clk_[rank];
+                predicted_idle_[rank] = (3 * predicted_idle_[rank] + idle) / 4;
+            }
+            break;
+        case CommandType::PD_ENTER:
+        case CommandType::SREF_ENTER:
+            break;
+        default:
+            last_cmd_clk_[rank] = clk;
+            if (cmd.IsReadWrite()) {
+                last_rw_clk_[rank] = clk;
+            }
+            break;
+    }
+    return;
+}
+
+void PowerPolicy::Save(CheckpointWriter& writer) const {
+    writer.Section("power_policy");
+    writer.Put(last_cmd_clk_);
+    writer.Put(last_rw_clk_);
+    writer.Put(predicted_idle_);
+    return;
+}
+
+void PowerPolicy::Restore(CheckpointReader& reader) {
+    reader.Section("power_policy");
+    reader.Get(last_cmd_clk_);
+    reader.Get(last_rw_clk_);
+    reader.Get(predicted_idle_);
+    return;
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,53 @@
+#ifndef __POWER_POLICY_H
+#define __POWER_POLICY_H
+
+#include <stdint.h>
+#include <vector>
+#include "checkpoint.h"
+#include "common.h"
+#include "configuration.h"
+
+namespace dramsim3 {
+
+// Low power mode selection for the ranks of a channel ([system]
+// enable_power_down). A rank without queued commands powers down once no
+// command went to it for pd_threshold cycles. With enable_self_refresh it
+// goes into self refresh instead if its idle periods, as predicted from the
+// past ones, last sref_threshold cycles or more, and a powered down rank
+// that stays idle that long leaves power down to enter self refresh. Queued
+// commands and refreshes wake a rank up through the command they need
+// first (PD_EXIT/SREF_EXIT).
+class PowerPolicy {
+   public:
+    PowerPolicy(const Config& config);
+    // command that moves an idle rank further into low power at clk:
+    // PD_ENTER, SREF_ENTER, PD_EXIT (on the way to SREF_ENTER) or SIZE if
+    // the rank should stay as it is
+    CommandType LowPowerCommand(int rank, bool powered_down,
+                                uint64_t clk) const;
+    // earliest cycle LowPowerCommand may return a command for a rank that
+    // stays idle
+    uint64_t NextLowPowerCycle(int rank, bool powered_down) const;
+    // woken_up tells if the rank leaves low power because commands are
+    // waiting for it, which ends an idle period
+    void CommandIssued(const Command& cmd, uint64_t clk, bool woken_up);
+    uint64_t PredictedIdleCycles(int rank) const {
+        return predicted_idle_[rank];
+    }
+    void Save(CheckpointWriter& writer) const;
+    void Restore(CheckpointReader& reader);
+
+   private:
+    const Config& config_;
+    // per rank: cycle of the last command other than power mode changes,
+    // cycle of the last READ/WRITE (start of the idle period, refreshes
+    // don't end it) and the moving average of the idle period lengths
+    std::vector<uint64_t> last_cmd_clk_;
+    std::vector<uint64_t> last_rw_clk_;
+    std::vector<uint64_t> predicted_idle_;
+
+    bool PredictsSelfRefresh(int rank, uint64_t clk) const;
+};
+
+}  // namespace dramsim3
+#endif
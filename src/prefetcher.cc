@@ -0,0 +1,174 @@
+#include "prefetcher.h"
+#include <algorithm>
+
+namespace dramsim3 {
+
+Prefetcher::Prefetcher(const Config& config)
+    : config_(config),
+      line_size_(static_cast<uint64_t>(config.request_size_bytes)),
+      next_seq_(0) {
+    if (config_.prefetcher == "NONE") {
+        policy_ = PrefetchPolicy::NONE;
+    } else if (config_.prefetcher == "NEXT_LINE") {
+        policy_ = PrefetchPolicy::NEXT_LINE;
+    } else if (config_.prefetcher == "STRIDE") {
+        policy_ = PrefetchPolicy::STRIDE;
+    } else {
+        std::cerr << "Unknown prefetcher " << config_.prefetcher << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (Enabled()) {
+        Line free_line = {0, 0, 0, PrefetchLine::NONE, false};
+        lines_.resize(config_.prefetch_buffer_size, free_line);
+        Stream stream = {0, 0};
+        streams_.resize(config_.ranks * config_.banks, stream);
+    }
+}
+
+void Prefetcher::Train(uint64_t addr, int bank) {
+    addr -= addr % line_size_;
+    if (policy_ == PrefetchPolicy::NEXT_LINE) {
+        for (int i = 1; i <= config_.prefetch_degree; i++) {
+            AddCandidate(addr + i * line_size_);
+        }
+    } else if (policy_ == PrefetchPolicy::STRIDE) {
+        Stream& stream = streams_[bank];
+        int64_t stride = static_cast<int64_t>(addr - stream.last_addr);
+        if (stride != 0 && stride == stream.stride) {
+            for (int i = 1; i <= config_.prefetch_degree; i++) {
+                AddCandidate(addr + static_cast<uint64_t>(i * stride));
+            }
+        }
+        stream.stride = stride;
+        stream.last_addr = addr;
+    }
+    return;
+}
+
+PrefetchLine Prefetcher::Lookup(uint64_t addr, uint64_t& ready_cycle) {
+    int idx = FindLine(addr - addr % line_size_);
+    if (idx < 0) {
+        return PrefetchLine::NONE;
+    }
+    Line& line = lines_[idx];
+    // the READ only returns the reads pending on its own address
+    if (line.state == PrefetchLine::QUEUED && line.addr != addr) {
+        return PrefetchLine::NONE;
+    }
+    PrefetchLine state = line.state;
+    ready_cycle = line.ready_cycle;
+    if (state == PrefetchLine::FILLED) {
+        line.state = PrefetchLine::NONE;
+    }
+    return state;
+}
+
+void Prefetcher::Write(uint64_t addr) {
+    int idx = FindLine(addr - addr % line_size_);
+    if (idx < 0) {
+        return;
+    }
+    if (lines_[idx].state == PrefetchLine::QUEUED) {
+        lines_[idx].drop = true;
+    } else {
+        lines_[idx].state = PrefetchLine::NONE;
+    }
+    return;
+}
+
+bool Prefetcher::Contains(uint64_t addr) const {
+    if (FindLine(addr) >= 0) {
+        return true;
+    }
+    return std::find(candidates_.begin(), candidates_.end(), addr) !=
+           candidates_.end();
+}
+
+void Prefetcher::RemoveCandidate(size_t i) {
+    candidates_.erase(candidates_.begin() + i);
+    return;
+}
+
+bool Prefetcher::CanQueue() const {
+    for (const auto& line : lines_) {
+        if (line.state != PrefetchLine::QUEUED) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Prefetcher::Queue(uint64_t addr) {
+    // a free line, otherwise the oldest filled one
+    Line* victim = nullptr;
+    for (auto& line : lines_) {
+        if (line.state == PrefetchLine::NONE) {
+            victim = &line;
+            break;
+        } else if (line.state == PrefetchLine::FILLED &&
+                   (victim == nullptr || line.seq < victim->seq)) {
+            victim = &line;
+        }
+    }
+    if (victim == nullptr) {
+        AbruptExit(__FILE__, __LINE__);
+    }
+    victim->addr = addr;
+    victim->ready_cycle = 0;
+    victim->seq = next_seq_++;
+    victim->state = PrefetchLine::QUEUED;
+    victim->drop = false;
+    return;
+}
+
+bool Prefetcher::Fill(uint64_t addr, uint64_t ready_cycle) {
+    int idx = FindLine(addr);
+    if (idx < 0 || lines_[idx].state != PrefetchLine::QUEUED) {
+        return false;
+    }
+    Line& line = lines_[idx];
+    line.state = line.drop ? PrefetchLine::NONE : PrefetchLine::FILLED;
+    line.ready_cycle = ready_cycle;
+    return true;
+}
+
+void Prefetcher::AddCandidate(uint64_t addr) {
+    if (Contains(addr)) {
+        return;
+    }
+    // fresh candidates are the more useful ones
+    if (candidates_.size() >= lines_.size()) {
+        candidates_.erase(candidates_.begin());
+    }
+    candidates_.push_back(addr);
+    return;
+}
+
+int Prefetcher::FindLine(uint64_t addr) const {
+    for (size_t i = 0; i < lines_.size(); i++) {
+        if (lines_[i].state != PrefetchLine::NONE && lines_[i].addr == addr) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void Prefetcher::Save(CheckpointWriter& writer) const {
+    writer.Section("prefetcher");
+    writer.Put(lines_);
+    writer.Put(candidates_);
+    writer.Put(streams_);
+    writer.Put(next_seq_);
+    return;
+}
+
+void Prefetcher::Restore(CheckpointReader& reader) {
+    reader.Section("prefetcher");
+    reader.Get(lines_);
+    reader.Get(candidates_);
+    reader.Get(streams_);
+    reader.Get(next_seq_);
+    return;
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,96 @@
+#ifndef __PREFETCHER_H
+#define __PREFETCHER_H
+
+#include <stdint.h>
+#include <vector>
+#include "checkpoint.h"
+#include "common.h"
+#include "configuration.h"
+
+namespace dramsim3 {
+
+// Memory side prefetching of a channel. Demand reads train the prefetcher,
+// which asks for the lines it expects next. The controller only turns such
+// a candidate into a READ while no demand transactions wait and the row of
+// the line is open in a bank without queued commands, so prefetches are row
+// hits that do not delay demand traffic. Prefetched lines land in a buffer
+// of prefetch_buffer_size lines that demand reads are checked against
+// before they become transactions, a write to a line drops it.
+//
+// Available prefetchers ([system] prefetcher):
+//   NONE       no prefetching (default)
+//   NEXT_LINE  a demand read asks for the prefetch_degree lines after it
+//   STRIDE     a demand read with the same address stride as the previous
+//              one to its bank asks for prefetch_degree lines along it
+enum class PrefetchPolicy { NONE, NEXT_LINE, STRIDE, SIZE };
+
+// where the line of a demand read is in the prefetch buffer
+enum class PrefetchLine {
+    NONE,    // not prefetched
+    QUEUED,  // prefetch READ in the command queues, the read waits for it
+    FILLED   // data is (or will be at the ready cycle) in the buffer
+};
+
+class Prefetcher {
+   public:
+    Prefetcher(const Config& config);
+    bool Enabled() const { return policy_ != PrefetchPolicy::NONE; }
+    // a demand read of the channel, bank is its (rank, bankgroup, bank)
+    // index
+    void Train(uint64_t addr, int bank);
+    // buffer lookup of a demand read, a filled line is used up by it. Reads
+    // only wait for a queued line of their exact address
+    PrefetchLine Lookup(uint64_t addr, uint64_t& ready_cycle);
+    // a demand write, the line of addr (if any) is out of date
+    void Write(uint64_t addr);
+    bool Contains(uint64_t addr) const;
+
+    // prefetch candidates oldest first, the controller takes them out as it
+    // issues or drops them
+    size_t NumCandidates() const { return candidates_.size(); }
+    uint64_t Candidate(size_t i) const { return candidates_[i]; }
+    void RemoveCandidate(size_t i);
+
+    // whether a line can be allocated, evicting a filled one if need be
+    bool CanQueue() const;
+    // the READ of a prefetch goes to the command queues
+    void Queue(uint64_t addr);
+    // a READ of addr issues with its data back at ready_cycle, false if it
+    // is no prefetch
+    bool Fill(uint64_t addr, uint64_t ready_cycle);
+
+    void Save(CheckpointWriter& writer) const;
+    void Restore(CheckpointReader& reader);
+
+   private:
+    struct Line {
+        uint64_t addr;
+        uint64_t ready_cycle;
+        // order of allocation, the oldest filled line is evicted first
+        uint64_t seq;
+        PrefetchLine state;
+        // a write arrived while the READ was queued, the data it brings is
+        // only good for the reads waiting for it
+        bool drop;
+    };
+
+    struct Stream {
+        uint64_t last_addr;
+        int64_t stride;
+    };
+
+    const Config& config_;
+    PrefetchPolicy policy_;
+    uint64_t line_size_;
+    std::vector<Line> lines_;
+    std::vector<uint64_t> candidates_;
+    // per bank, in (rank, bankgroup, bank) order
+    std::vector<Stream> streams_;
+    uint64_t next_seq_;
+
+    void AddCandidate(uint64_t addr);
+    int FindLine(uint64_t addr) const;
+};
+
+}  // namespace dramsim3
+#endif
@@ -0,0 +1,79 @@
+#include "profiler.h"
+
+#ifdef PROFILE
+
+#include <iomanip>
+
+namespace dramsim3 {
+
+namespace {
+
+const char* const kPhaseNames[] = {
+    "returns",
+    "controllers",
+    "controller.refresh",
+    "controller.command_issue",
+    "controller.command_stats",
+    "controller.low_power",
+    "controller.schedule_transaction",
+    "thermal.power_update",
+    "hmc.xbar",
+    "epoch_stats",
+    "thermal.solver",
+};
+
+static_assert(sizeof(kPhaseNames) / sizeof(kPhaseNames[0]) ==
+                  static_cast<size_t>(ProfilePhase::SIZE),
+              "a profile phase has no name");
+
+double Seconds(Profiler::Clock::duration time) {
+    return std::chrono::duration<double>(time).count();
+}
+
+}  // namespace
+
+void Profiler::Merge(const Profiler& other) {
+    for (int i = 0; i < static_cast<int>(ProfilePhase::SIZE); i++) {
+        time_[i] += other.time_[i];
+        calls_[i] += other.calls_[i];
+    }
+    return;
+}
+
+void Profiler::Reset(uint64_t clk) {
+    start_ = Clock::now();
+    start_clk_ = clk;
+    for (int i = 0; i < static_cast<int>(ProfilePhase::SIZE); i++) {
+        time_[i] = Clock::duration::zero();
+        calls_[i] = 0;
+    }
+    return;
+}
+
+void Profiler::Print(std::ostream& out, uint64_t clk) const {
+    double wall = Seconds(Clock::now() - start_);
+    uint64_t cycles = clk - start_clk_;
+    out << "Simulation speed: " << cycles << " cycles in " << wall << " s, "
+        << (wall > 0 ? cycles / wall : 0) << " cycles/s" << std::endl;
+    // controller phases add up over controllers, they may exceed the wall
+    // time when controllers are ticked in parallel
+    out << std::left << std::setw(34) << "phase" << std::right
+        << std::setw(12) << "time (s)" << std::setw(10) << "% wall"
+        << std::setw(14) << "calls" << std::endl;
+    for (int i = 0; i < static_cast<int>(ProfilePhase::SIZE); i++) {
+        if (calls_[i] == 0) {
+            continue;
+        }
+        double time = Seconds(time_[i]);
+        out << std::left << std::setw(34) << kPhaseNames[i] << std::right
+            << std::fixed << std::setprecision(4) << std::setw(12) << time
+            << std::setprecision(1) << std::setw(10)
+            << (wall > 0 ? 100 * time / wall : 0) << std::setw(14)
+            << calls_[i] << std::defaultfloat << std::endl;
+    }
+    return;
+}
+
+}  // namespace dramsim3
+
+#endif  // PROFILE
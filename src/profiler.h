@@ -0,0 +1,82 @@
+#ifndef __PROFILER_H
+#define __PROFILER_H
+
+// Wall clock profile of the simulation phases, compiled in with -DPROFILE
+// (cmake -DPROFILE=1) and reported after the final stats. Without PROFILE
+// there is no Profiler and PROFILE_SCOPE expands to nothing.
+#ifdef PROFILE
+
+#include <stdint.h>
+#include <chrono>
+#include <ostream>
+
+namespace dramsim3 {
+
+// phases nest: the controller and thermal power phases are part of
+// controllers, thermal solver is part of epoch stats unless it is the final
+// solve
+enum class ProfilePhase {
+    RETURNS,
+    CONTROLLERS,
+    CTRL_REFRESH,
+    CTRL_COMMAND_ISSUE,
+    CTRL_COMMAND_STATS,
+    CTRL_LOW_POWER,
+    CTRL_SCHEDULE,
+    THERMAL_POWER,
+    HMC_XBAR,
+    EPOCH_STATS,
+    THERMAL_SOLVER,
+    SIZE
+};
+
+// Time spent per phase since the last Reset. Every controller has its own
+// profiler so that controllers ticked in parallel don't share one, the
+// memory system merges them for the report
+class Profiler {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    Profiler() { Reset(0); }
+    void Add(ProfilePhase phase, Clock::duration time) {
+        int i = static_cast<int>(phase);
+        time_[i] += time;
+        calls_[i]++;
+    }
+    void Merge(const Profiler& other);
+    void Reset(uint64_t clk);
+    // simulated cycles per second of wall time since the reset (clk is the
+    // current cycle) and the time of each phase that was entered
+    void Print(std::ostream& out, uint64_t clk) const;
+
+   private:
+    Clock::time_point start_;
+    uint64_t start_clk_;
+    Clock::duration time_[static_cast<int>(ProfilePhase::SIZE)];
+    uint64_t calls_[static_cast<int>(ProfilePhase::SIZE)];
+};
+
+class ProfileTimer {
+   public:
+    ProfileTimer(Profiler& profiler, ProfilePhase phase)
+        : profiler_(profiler), phase_(phase), start_(Profiler::Clock::now()) {}
+    ~ProfileTimer() { profiler_.Add(phase_, Profiler::Clock::now() - start_); }
+
+   private:
+    Profiler& profiler_;
+    ProfilePhase phase_;
+    Profiler::Clock::time_point start_;
+};
+
+}  // namespace dramsim3
+
+// times the rest of the enclosing scope as phase
+#define PROFILE_SCOPE(profiler, phase) \
+    ProfileTimer profile_timer_(profiler, ProfilePhase::phase)
+
+#else
+
+#define PROFILE_SCOPE(profiler, phase)
+
+#endif  // PROFILE
+#endif
@@ -0,0 +1,399 @@
+// Python bindings of MemorySystem, built with -DPYTHON=1:
+//
+//   import numpy as np, dramsim3
+//   mem = dramsim3.MemorySystem("configs/DDR4_8Gb_x8_2400.ini")
+//   done = np.zeros(len(addrs), dtype=np.uint64)
+//   mem.run(addrs, writes, cycles, done)
+//   stats = mem.stats()
+//
+// Requests come as buffers (NumPy arrays, array.array, memoryview, ...)
+// that are read in place: addresses and arrival cycles as 64 bit integers,
+// the write flags as one byte each. The simulation loop runs natively with
+// the GIL released, so memory systems can run on Python threads. Stats are
+// converted from the memory system, without files unless write_stats.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "memory_system.h"
+
+namespace {
+
+using dramsim3::Completion;
+using dramsim3::Config;
+using dramsim3::MemorySystem;
+
+typedef struct {
+    PyObject_HEAD
+    MemorySystem* memory_system;
+    uint64_t clk;
+    // the requests of the running run() call are tagged from tag_base on,
+    // completions of earlier calls still come back with smaller tags
+    uint64_t tag_base;
+    uint64_t next_tag;
+    uint64_t* done;
+    uint64_t num_requests;
+    uint64_t num_done;
+    bool stats_printed;
+    PyObject* stats;
+} PyMemorySystem;
+
+// the format of a buffer without its byte order prefix
+char BufferFormat(const Py_buffer& view) {
+    const char* format = view.format == nullptr ? "B" : view.format;
+    if (strchr("@=<>!", format[0]) != nullptr) {
+        format++;
+    }
+    return format[1] == '\0' ? format[0] : '\0';
+}
+
+// a one dimensional C contiguous buffer of itemsize byte integers, false
+// with a Python exception set otherwise
+bool GetBuffer(PyObject* obj, Py_buffer* view, Py_ssize_t itemsize,
+               bool writable, const char* name) {
+    int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT;
+    if (writable) {
+        flags |= PyBUF_WRITABLE;
+    }
+    if (PyObject_GetBuffer(obj, view, flags) < 0) {
+        return false;
+    }
+    const char* formats = itemsize == 1 ? "?bBc" : "qQlLnN";
+    char format = BufferFormat(*view);
+    if (view->ndim != 1 || view->itemsize != itemsize || format == '\0' ||
+        strchr(formats, format) == nullptr) {
+        PyErr_Format(PyExc_TypeError,
+                     "%s must be a 1-d array of %zd byte integers", name,
+                     itemsize);
+        PyBuffer_Release(view);
+        return false;
+    }
+    return true;
+}
+
+PyObject* ToPython(const nlohmann::json& value);
+
+// objects keyed by 0..n-1 (per rank and per bank stats, the channels)
+// become lists, other integer keys (histogram buckets) int keyed dicts
+PyObject* ObjectToPython(const nlohmann::json& object) {
+    bool int_keys = !object.empty();
+    std::vector<std::pair<long, const nlohmann::json*>> items;
+    for (auto it = object.begin(); it != object.end() && int_keys; ++it) {
+        char* end;
+        long key = strtol(it.key().c_str(), &end, 10);
+        int_keys = !it.key().empty() && *end == '\0';
+        items.emplace_back(key, &it.value());
+    }
+    if (int_keys) {
+        std::sort(items.begin(), items.end(),
+                  [](const std::pair<long, const nlohmann::json*>& a,
+                     const std::pair<long, const nlohmann::json*>& b) {
+                      return a.first < b.first;
+                  });
+        bool is_list = true;
+        for (size_t i = 0; i < items.size(); i++) {
+            is_list = is_list && items[i].first == static_cast<long>(i);
+        }
+        PyObject* result = is_list ? PyList_New(items.size()) : PyDict_New();
+        for (size_t i = 0; result != nullptr && i < items.size(); i++) {
+            PyObject* item = ToPython(*items[i].second);
+            if (item == nullptr) {
+                Py_CLEAR(result);
+            } else if (is_list) {
+                PyList_SET_ITEM(result, i, item);
+            } else {
+                PyObject* key = PyLong_FromLong(items[i].first);
+                if (key == nullptr || PyDict_SetItem(result, key, item) < 0) {
+                    Py_CLEAR(result);
+                }
+                Py_XDECREF(key);
+                Py_DECREF(item);
+            }
+        }
+        return result;
+    }
+    PyObject* result = PyDict_New();
+    for (auto it = object.begin(); result != nullptr && it != object.end();
+         ++it) {
+        PyObject* item = ToPython(it.value());
+        if (item == nullptr ||
+            PyDict_SetItemString(result, it.key().c_str(), item) < 0) {
+            Py_CLEAR(result);
+        }
+        Py_XDECREF(item);
+    }
+    return result;
+}
+
+PyObject* ToPython(const nlohmann::json& value) {
+    if (value.is_object()) {
+        return ObjectToPython(value);
+    } else if (value.is_array()) {
+        PyObject* result = PyList_New(value.size());
+        for (size_t i = 0; result != nullptr && i < value.size(); i++) {
+            PyObject* item = ToPython(value[i]);
+            if (item == nullptr) {
+                Py_CLEAR(result);
+            } else {
+                PyList_SET_ITEM(result, i, item);
+            }
+        }
+        return result;
+    } else if (value.is_boolean()) {
+        return PyBool_FromLong(value.get<bool>());
+    } else if (value.is_number_unsigned()) {
+        return PyLong_FromUnsignedLongLong(value.get<uint64_t>());
+    } else if (value.is_number_integer()) {
+        return PyLong_FromLongLong(value.get<int64_t>());
+    } else if (value.is_number_float()) {
+        return PyFloat_FromDouble(value.get<double>());
+    } else if (value.is_string()) {
+        return PyUnicode_FromString(value.get<std::string>().c_str());
+    }
+    Py_RETURN_NONE;
+}
+
+int MemorySystemInit(PyMemorySystem* self, PyObject* args, PyObject* kwds) {
+    static const char* kwlist[] = {"config_file", "output_dir", "write_stats",
+                                   nullptr};
+    const char* config_file;
+    const char* output_dir = ".";
+    int write_stats = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|sp",
+                                     const_cast<char**>(kwlist), &config_file,
+                                     &output_dir, &write_stats)) {
+        return -1;
+    }
+    Config* config = new Config(config_file, output_dir);
+    if (!write_stats) {
+        config->output_level = -1;
+    }
+    delete self->memory_system;
+    self->memory_system =
+        new MemorySystem(config, output_dir, nullptr, nullptr);
+    self->clk = 0;
+    self->tag_base = 0;
+    self->next_tag = 0;
+    self->done = nullptr;
+    self->num_requests = 0;
+    self->num_done = 0;
+    self->stats_printed = false;
+    Py_CLEAR(self->stats);
+    self->memory_system->RegisterCompletionCallback(
+        [self](const Completion& completion) {
+            if (completion.req_id < self->tag_base) {
+                return;
+            }
+            uint64_t i = completion.req_id - self->tag_base;
+            if (self->done != nullptr) {
+                self->done[i] = completion.complete_cycle;
+            }
+            self->num_done++;
+        });
+    return 0;
+}
+
+void MemorySystemDealloc(PyMemorySystem* self) {
+    delete self->memory_system;
+    Py_CLEAR(self->stats);
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+bool CheckInit(PyMemorySystem* self) {
+    if (self->memory_system == nullptr) {
+        PyErr_SetString(PyExc_RuntimeError, "MemorySystem is not initialized");
+        return false;
+    }
+    return true;
+}
+
+PyObject* MemorySystemRun(PyMemorySystem* self, PyObject* args,
+                          PyObject* kwds) {
+    static const char* kwlist[] = {"addrs", "writes",     "cycles",
+                                   "done",  "max_cycles", nullptr};
+    PyObject *addrs_obj, *writes_obj, *cycles_obj, *done_obj = Py_None;
+    unsigned long long max_cycles = 0;
+    if (!CheckInit(self) ||
+        !PyArg_ParseTupleAndKeywords(args, kwds, "OOO|OK",
+                                     const_cast<char**>(kwlist), &addrs_obj,
+                                     &writes_obj, &cycles_obj, &done_obj,
+                                     &max_cycles)) {
+        return nullptr;
+    }
+    Py_buffer addrs, writes, cycles, done;
+    if (!GetBuffer(addrs_obj, &addrs, 8, false, "addrs")) {
+        return nullptr;
+    }
+    if (!GetBuffer(writes_obj, &writes, 1, false, "writes")) {
+        PyBuffer_Release(&addrs);
+        return nullptr;
+    }
+    if (!GetBuffer(cycles_obj, &cycles, 8, false, "cycles")) {
+        PyBuffer_Release(&addrs);
+        PyBuffer_Release(&writes);
+        return nullptr;
+    }
+    bool has_done = done_obj != Py_None;
+    if (has_done && !GetBuffer(done_obj, &done, 8, true, "done")) {
+        PyBuffer_Release(&addrs);
+        PyBuffer_Release(&writes);
+        PyBuffer_Release(&cycles);
+        return nullptr;
+    }
+    Py_ssize_t num = addrs.shape[0];
+    if (writes.shape[0] != num || cycles.shape[0] != num ||
+        (has_done && done.shape[0] != num)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "addrs, writes, cycles and done differ in length");
+        PyBuffer_Release(&addrs);
+        PyBuffer_Release(&writes);
+        PyBuffer_Release(&cycles);
+        if (has_done) {
+            PyBuffer_Release(&done);
+        }
+        return nullptr;
+    }
+
+    const uint64_t* addr_data = static_cast<const uint64_t*>(addrs.buf);
+    const uint8_t* write_data = static_cast<const uint8_t*>(writes.buf);
+    const uint64_t* cycle_data = static_cast<const uint64_t*>(cycles.buf);
+    self->tag_base = self->next_tag;
+    self->next_tag += num;
+    self->done = has_done ? static_cast<uint64_t*>(done.buf) : nullptr;
+    self->num_requests = num;
+    self->num_done = 0;
+    uint64_t start_clk = self->clk;
+
+    Py_BEGIN_ALLOW_THREADS
+    // open loop as the trace CPU, a request goes in at its cycle or as soon
+    // as it is accepted after that
+    MemorySystem* memory_system = self->memory_system;
+    uint64_t next = 0;
+    while (self->num_done < self->num_requests &&
+           (max_cycles == 0 || self->clk - start_clk < max_cycles)) {
+        memory_system->ClockTick();
+        if (next < self->num_requests && cycle_data[next] <= self->clk &&
+            memory_system->AddTransaction(addr_data[next],
+                                          write_data[next] != 0,
+                                          self->tag_base + next)) {
+            next++;
+        }
+        self->clk++;
+    }
+    Py_END_ALLOW_THREADS
+
+    // later completions of this call no longer have a buffer to go to
+    self->done = nullptr;
+    self->tag_base = self->next_tag;
+    PyBuffer_Release(&addrs);
+    PyBuffer_Release(&writes);
+    PyBuffer_Release(&cycles);
+    if (has_done) {
+        PyBuffer_Release(&done);
+    }
+    return Py_BuildValue("KK", static_cast<unsigned long long>(self->num_done),
+                         static_cast<unsigned long long>(self->clk - start_clk));
+}
+
+PyObject* MemorySystemStats(PyMemorySystem* self, PyObject*) {
+    if (!CheckInit(self)) {
+        return nullptr;
+    }
+    // final stats add up the counters, they can only be printed once
+    if (!self->stats_printed) {
+        self->memory_system->PrintStats();
+        self->stats_printed = true;
+        self->stats = ToPython(self->memory_system->FinalStats());
+    }
+    Py_XINCREF(self->stats);
+    return self->stats;
+}
+
+PyObject* MemorySystemResetStats(PyMemorySystem* self, PyObject*) {
+    if (!CheckInit(self)) {
+        return nullptr;
+    }
+    self->memory_system->ResetStats();
+    self->stats_printed = false;
+    Py_CLEAR(self->stats);
+    Py_RETURN_NONE;
+}
+
+PyObject* MemorySystemGetClk(PyMemorySystem* self, void*) {
+    return PyLong_FromUnsignedLongLong(self->clk);
+}
+
+PyObject* MemorySystemGetTCK(PyMemorySystem* self, void*) {
+    if (!CheckInit(self)) {
+        return nullptr;
+    }
+    return PyFloat_FromDouble(self->memory_system->GetTCK());
+}
+
+PyMethodDef kMemorySystemMethods[] = {
+    {"run", reinterpret_cast<PyCFunction>(MemorySystemRun),
+     METH_VARARGS | METH_KEYWORDS,
+     "run(addrs, writes, cycles, done=None, max_cycles=0) -> (num_done, "
+     "cycles)\n\n"
+     "Simulates the requests, addrs and cycles (the memory cycle a request\n"
+     "arrives at, in order) are 64 bit integer arrays, writes one byte per\n"
+     "request. done, a 64 bit integer array if given, gets the cycle each\n"
+     "request completed. Runs until all of them completed or for at most\n"
+     "max_cycles cycles (0: no limit) and returns the number of completed\n"
+     "requests and the cycles simulated."},
+    {"stats", reinterpret_cast<PyCFunction>(MemorySystemStats), METH_NOARGS,
+     "stats() -> list\n\n"
+     "Final stats of every channel as dicts, per rank and per bank stats\n"
+     "as lists and histograms as dicts from bucket to count. Computed once,\n"
+     "until reset_stats(), and written to the stats files with "
+     "write_stats."},
+    {"reset_stats", reinterpret_cast<PyCFunction>(MemorySystemResetStats),
+     METH_NOARGS, "reset_stats()\n\nStarts the stats over."},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyGetSetDef kMemorySystemGetSet[] = {
+    {"clk", reinterpret_cast<getter>(MemorySystemGetClk), nullptr,
+     "Memory cycles simulated so far", nullptr},
+    {"tck", reinterpret_cast<getter>(MemorySystemGetTCK), nullptr,
+     "Memory clock period in ns", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+PyTypeObject kMemorySystemType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+PyModuleDef kModule = {PyModuleDef_HEAD_INIT, "dramsim3",
+                       "DRAMSim3 memory systems", -1, nullptr};
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit_dramsim3() {
+    kMemorySystemType.tp_name = "dramsim3.MemorySystem";
+    kMemorySystemType.tp_basicsize = sizeof(PyMemorySystem);
+    kMemorySystemType.tp_flags = Py_TPFLAGS_DEFAULT;
+    kMemorySystemType.tp_doc =
+        "MemorySystem(config_file, output_dir='.', write_stats=False)";
+    kMemorySystemType.tp_new = PyType_GenericNew;
+    kMemorySystemType.tp_init = reinterpret_cast<initproc>(MemorySystemInit);
+    kMemorySystemType.tp_dealloc =
+        reinterpret_cast<destructor>(MemorySystemDealloc);
+    kMemorySystemType.tp_methods = kMemorySystemMethods;
+    kMemorySystemType.tp_getset = kMemorySystemGetSet;
+    if (PyType_Ready(&kMemorySystemType) < 0) {
+        return nullptr;
+    }
+    PyObject* module = PyModule_Create(&kModule);
+    if (module == nullptr) {
+        return nullptr;
+    }
+    Py_INCREF(&kMemorySystemType);
+    if (PyModule_AddObject(module, "MemorySystem",
+                           reinterpret_cast<PyObject*>(&kMemorySystemType)) <
+        0) {
+        Py_DECREF(&kMemorySystemType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
@@ -1,38 +1,103 @@
 #include "refresh.h"
+#include <algorithm>
 
 namespace dramsim3 {
-Refresh::Refresh(const Config &config, ChannelState &channel_state)
+Refresh::Refresh(const Config &config, ChannelState &channel_state,
+                 const CommandQueue &cmd_queue, SimpleStats &simple_stats)
     : clk_(0),
       config_(config),
       channel_state_(channel_state),
+      cmd_queue_(cmd_queue),
+      simple_stats_(simple_stats),
       refresh_policy_(config.refresh_policy),
       next_rank_(0),
       next_bg_(0),
-      next_bank_(0) {
+      next_bank_(0),
+      num_refs_postponed_(simple_stats.GetCounterId("num_refs_postponed")),
+      num_refs_pulled_in_(simple_stats.GetCounterId("num_refs_pulled_in")) {
     if (refresh_policy_ == RefreshPolicy::RANK_LEVEL_SIMULTANEOUS) {
         refresh_interval_ = config_.tREFI;
+        num_targets_ = config_.ranks;
     } else if (refresh_policy_ == RefreshPolicy::BANK_LEVEL_STAGGERED) {
         refresh_interval_ = config_.tREFIb;
+        num_targets_ = config_.ranks * config_.banks;
+    } else if (refresh_policy_ == RefreshPolicy::SAME_BANK_STAGGERED) {
+        // every bank index once per tREFI in each rank
+        refresh_interval_ = std::max(
+            config_.tREFI / (config_.banks_per_group * config_.ranks), 1);
+        num_targets_ = config_.ranks * config_.banks_per_group;
     } else {  // default refresh scheme: RANK STAGGERED
         refresh_interval_ = config_.tREFI / config_.ranks;
+        num_targets_ = config_.ranks;
     }
+    postponed_.resize(num_targets_, 0);
+    pulled_in_.resize(num_targets_, 0);
+    idle_since_.resize(num_targets_, 0);
+    // a short gap between bursts is no chance to pull a refresh in
+    pullin_delay_ = static_cast<uint64_t>(
+        refresh_policy_ == RefreshPolicy::BANK_LEVEL_STAGGERED
+            ? config_.tRFCb
+            : (refresh_policy_ == RefreshPolicy::SAME_BANK_STAGGERED
+                   ? config_.tRFCsb
+                   : config_.tRFC));
 }
 
 void Refresh::ClockTick() {
     if (clk_ % refresh_interval_ == 0 && clk_ > 0) {
         InsertRefresh();
     }
+    if (config_.refresh_pullin_max > 0) {
+        for (int i = 0; i < num_targets_; i++) {
+            if (TargetBusy(i)) {
+                idle_since_[i] = clk_ + 1;
+            }
+        }
+    }
+    int target = CatchUpTarget();
+    if (target >= 0) {
+        if (postponed_[target] > 0) {
+            postponed_[target]--;
+        } else {
+            pulled_in_[target]++;
+            simple_stats_.Increment(num_refs_pulled_in_);
+        }
+        int rank, bankgroup, bank;
+        TargetAddress(target, rank, bankgroup, bank);
+        RaiseRefresh(rank, bankgroup, bank);
+    }
     clk_++;
     return;
 }
 
+uint64_t Refresh::NextRefreshCycle() const {
+    if (CatchUpTarget() >= 0) {
+        return clk_;
+    }
+    uint64_t interval = static_cast<uint64_t>(refresh_interval_);
+    uint64_t next_cycle = (clk_ + interval - 1) / interval * interval;
+    if (next_cycle == 0) {
+        next_cycle = interval;
+    }
+    // targets that become idle long enough to pull a refresh in
+    if (config_.refresh_pullin_max > 0 && !channel_state_.IsRefreshWaiting()) {
+        for (int i = 0; i < num_targets_; i++) {
+            uint64_t pullin_cycle = idle_since_[i] + pullin_delay_;
+            if (pullin_cycle > clk_ && pullin_cycle < next_cycle &&
+                pulled_in_[i] < config_.refresh_pullin_max) {
+                next_cycle = pullin_cycle;
+            }
+        }
+    }
+    return next_cycle;
+}
+
 void Refresh::InsertRefresh() {
     switch (refresh_policy_) {
         // Simultaneous all rank refresh
         case RefreshPolicy::RANK_LEVEL_SIMULTANEOUS:
             for (auto i = 0; i < config_.ranks; i++) {
                 if (!channel_state_.IsRankSelfRefreshing(i)) {
-                    channel_state_.RankNeedRefresh(i, true);
+                    RefreshDue(i, -1, -1);
                     break;
                 }
             }
@@ -40,15 +105,16 @@ void Refresh::InsertRefresh() {
         // Staggered all rank refresh
         case RefreshPolicy::RANK_LEVEL_STAGGERED:
             if (!channel_state_.IsRankSelfRefreshing(next_rank_)) {
-                channel_state_.RankNeedRefresh(next_rank_, true);
+                RefreshDue(next_rank_, -1, -1);
             }
             IterateNext();
             break;
         // Fully staggered per bank refresh
         case RefreshPolicy::BANK_LEVEL_STAGGERED:
+        // Staggered same bank refresh, one bank in all bankgroups at a time
+        case RefreshPolicy::SAME_BANK_STAGGERED:
             if (!channel_state_.IsRankSelfRefreshing(next_rank_)) {
-                channel_state_.BankNeedRefresh(next_rank_, next_bg_, next_bank_,
-                                               true);
+                RefreshDue(next_rank_, next_bg_, next_bank_);
             }
             IterateNext();
             break;
@@ -59,6 +125,105 @@ void Refresh::InsertRefresh() {
     return;
 }
 
+void Refresh::RefreshDue(int rank, int bankgroup, int bank) {
+    int target = TargetIndex(rank, bankgroup, bank);
+    if (pulled_in_[target] > 0) {
+        pulled_in_[target]--;
+        return;
+    }
+    if (postponed_[target] < config_.refresh_postpone_max &&
+        TargetBusy(target)) {
+        postponed_[target]++;
+        simple_stats_.Increment(num_refs_postponed_);
+        return;
+    }
+    RaiseRefresh(rank, bankgroup, bank);
+    return;
+}
+
+void Refresh::RaiseRefresh(int rank, int bankgroup, int bank) {
+    if (refresh_policy_ == RefreshPolicy::BANK_LEVEL_STAGGERED) {
+        channel_state_.BankNeedRefresh(rank, bankgroup, bank, true);
+    } else if (refresh_policy_ == RefreshPolicy::SAME_BANK_STAGGERED) {
+        channel_state_.SameBankNeedRefresh(rank, bank, true);
+    } else {
+        channel_state_.RankNeedRefresh(rank, true);
+    }
+    return;
+}
+
+int Refresh::TargetIndex(int rank, int bankgroup, int bank) const {
+    if (refresh_policy_ == RefreshPolicy::BANK_LEVEL_STAGGERED) {
+        return rank * config_.banks + bankgroup * config_.banks_per_group +
+               bank;
+    } else if (refresh_policy_ == RefreshPolicy::SAME_BANK_STAGGERED) {
+        return rank * config_.banks_per_group + bank;
+    }
+    return rank;
+}
+
+void Refresh::TargetAddress(int target, int &rank, int &bankgroup,
+                            int &bank) const {
+    if (refresh_policy_ == RefreshPolicy::BANK_LEVEL_STAGGERED) {
+        rank = target / config_.banks;
+        bankgroup = target % config_.banks / config_.banks_per_group;
+        bank = target % config_.banks_per_group;
+    } else if (refresh_policy_ == RefreshPolicy::SAME_BANK_STAGGERED) {
+        rank = target / config_.banks_per_group;
+        bankgroup = -1;
+        bank = target % config_.banks_per_group;
+    } else {
+        rank = target;
+        bankgroup = -1;
+        bank = -1;
+    }
+    return;
+}
+
+bool Refresh::TargetBusy(int target) const {
+    int rank, bankgroup, bank;
+    TargetAddress(target, rank, bankgroup, bank);
+    if (refresh_policy_ == RefreshPolicy::BANK_LEVEL_STAGGERED) {
+        return cmd_queue_.HasCommandsToBank(rank, bankgroup, bank);
+    } else if (refresh_policy_ == RefreshPolicy::SAME_BANK_STAGGERED) {
+        for (int g = 0; g < config_.bankgroups; g++) {
+            if (cmd_queue_.HasCommandsToBank(rank, g, bank)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return cmd_queue_.HasCommandsToRank(rank);
+}
+
+int Refresh::CatchUpTarget() const {
+    if ((config_.refresh_postpone_max == 0 &&
+         config_.refresh_pullin_max == 0) ||
+        channel_state_.IsRefreshWaiting()) {
+        return -1;
+    }
+    for (int target = 0; target < num_targets_; target++) {
+        int rank, bankgroup, bank;
+        TargetAddress(target, rank, bankgroup, bank);
+        if (channel_state_.IsRankSelfRefreshing(rank) || TargetBusy(target)) {
+            continue;
+        }
+        if (postponed_[target] > 0 || CanPullIn(target)) {
+            return target;
+        }
+    }
+    return -1;
+}
+
+bool Refresh::CanPullIn(int target) const {
+    int rank, bankgroup, bank;
+    TargetAddress(target, rank, bankgroup, bank);
+    // pulling in would wake up a powered down rank for nothing
+    return pulled_in_[target] < config_.refresh_pullin_max &&
+           clk_ >= idle_since_[target] + pullin_delay_ &&
+           !channel_state_.IsRankPoweredDown(rank);
+}
+
 void Refresh::IterateNext() {
     switch (refresh_policy_) {
         case RefreshPolicy::RANK_LEVEL_STAGGERED:
@@ -75,10 +240,40 @@ void Refresh::IterateNext() {
                 }
             }
             return;
+        case RefreshPolicy::SAME_BANK_STAGGERED:
+            next_bank_ = (next_bank_ + 1) % config_.banks_per_group;
+            if (next_bank_ == 0) {
+                next_rank_ = (next_rank_ + 1) % config_.ranks;
+            }
+            return;
         default:
             AbruptExit(__FILE__, __LINE__);
             return;
     }
 }
 
+void Refresh::Save(CheckpointWriter &writer) const {
+    writer.Section("refresh");
+    writer.Put(clk_);
+    writer.Put(next_rank_);
+    writer.Put(next_bg_);
+    writer.Put(next_bank_);
+    writer.Put(postponed_);
+    writer.Put(pulled_in_);
+    writer.Put(idle_since_);
+    return;
+}
+
+void Refresh::Restore(CheckpointReader &reader) {
+    reader.Section("refresh");
+    reader.Get(clk_);
+    reader.Get(next_rank_);
+    reader.Get(next_bg_);
+    reader.Get(next_bank_);
+    reader.Get(postponed_);
+    reader.Get(pulled_in_);
+    reader.Get(idle_since_);
+    return;
+}
+
 }  // namespace dramsim3
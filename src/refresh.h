@@ -3,30 +3,71 @@
 
 #include <vector>
 #include "channel_state.h"
+#include "command_queue.h"
 #include "common.h"
 #include "configuration.h"
+#include "simple_stats.h"
 
 namespace dramsim3 {
 
+// Raises a refresh request for the next rank, bank or same bank group every
+// refresh interval. With refresh_postpone_max a due refresh is held back
+// while commands are queued for the banks it covers and raised once they
+// are gone, or when too many are held back; with refresh_pullin_max
+// refreshes of banks that stayed idle for a refresh cycle time are raised
+// ahead of time and skipped when due.
 class Refresh {
    public:
-    Refresh(const Config& config, ChannelState& channel_state);
+    Refresh(const Config& config, ChannelState& channel_state,
+            const CommandQueue& cmd_queue, SimpleStats& simple_stats);
     void ClockTick();
+    void SkipCycles(uint64_t cycles) { clk_ += cycles; }
+    // the cycle at which the next refresh will be inserted
+    uint64_t NextRefreshCycle() const;
+    // refresh counters to/from a checkpoint
+    void Save(CheckpointWriter& writer) const;
+    void Restore(CheckpointReader& reader);
 
    private:
     uint64_t clk_;
     int refresh_interval_;
     const Config& config_;
     ChannelState& channel_state_;
+    const CommandQueue& cmd_queue_;
+    SimpleStats& simple_stats_;
     RefreshPolicy refresh_policy_;
 
     int next_rank_, next_bg_, next_bank_;
 
+    // per refresh target (rank, bank or same bank group, see TargetIndex),
+    // refreshes that were postponed and refreshes that were pulled in
+    int num_targets_;
+    std::vector<int> postponed_;
+    std::vector<int> pulled_in_;
+    // cycle since which no commands have been queued for the target
+    std::vector<uint64_t> idle_since_;
+    uint64_t pullin_delay_;
+    CounterId num_refs_postponed_;
+    CounterId num_refs_pulled_in_;
+
     void InsertRefresh();
+    // a refresh of the target is due, it may be postponed or have been
+    // pulled in already
+    void RefreshDue(int rank, int bankgroup, int bank);
+    void RaiseRefresh(int rank, int bankgroup, int bank);
+    int TargetIndex(int rank, int bankgroup, int bank) const;
+    void TargetAddress(int target, int& rank, int& bankgroup,
+                       int& bank) const;
+    // whether commands are queued for the banks the target covers
+    bool TargetBusy(int target) const;
+    // target whose postponed refresh is paid back or whose next refresh is
+    // pulled in now, -1 if none
+    int CatchUpTarget() const;
+    bool CanPullIn(int target) const;
 
     void IterateNext();
 };
 
 }  // namespace dramsim3
 
-#endif
\ No newline at end of file
+#endif
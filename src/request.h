@@ -0,0 +1,42 @@
+#ifndef __REQUEST_H
+#define __REQUEST_H
+
+#include <stdint.h>
+
+namespace dramsim3 {
+
+// Batch interface records, see MemorySystem::AddTransactions and
+// MemorySystem::DrainCompletions. The request id (tag) is handed back
+// unchanged with the completion of the request, requests are never merged
+// into each other from the caller's point of view.
+struct Request {
+    Request()
+        : addr(0), is_write(false), req_id(0), source_id(0), priority(0) {}
+    Request(uint64_t addr, bool is_write, uint64_t req_id, int source_id = 0,
+            int priority = 0)
+        : addr(addr),
+          is_write(is_write),
+          req_id(req_id),
+          source_id(source_id),
+          priority(priority) {}
+    uint64_t addr;
+    bool is_write;
+    uint64_t req_id;
+    // requester (e.g. core) and priority class, kept with the request for
+    // schedulers and per source stats
+    int source_id;
+    int priority;
+};
+
+struct Completion {
+    uint64_t addr;
+    bool is_write;
+    uint64_t req_id;
+    int source_id;
+    // memory clock cycles the request was added and completed in
+    uint64_t issue_cycle;
+    uint64_t complete_cycle;
+};
+
+}  // namespace dramsim3
+#endif
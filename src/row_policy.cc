@@ -0,0 +1,83 @@
+#include "row_policy.h"
+#include <algorithm>
+
+namespace dramsim3 {
+
+RowPolicy::RowPolicy(const Config& config)
+    : config_(config),
+      last_access_(config.ranks * config.banks, 0),
+      last_rows_(config.ranks * config.banks, -1),
+      hit_counters_(config.ranks * config.banks, 2) {
+    if (config_.row_buf_policy == "OPEN_PAGE") {
+        policy_ = config_.aggressive_precharging_enabled
+                      ? RowBufPolicy::TIMEOUT
+                      : RowBufPolicy::OPEN_PAGE;
+    } else if (config_.row_buf_policy == "CLOSE_PAGE") {
+        policy_ = RowBufPolicy::CLOSE_PAGE;
+    } else if (config_.row_buf_policy == "TIMEOUT") {
+        policy_ = RowBufPolicy::TIMEOUT;
+    } else if (config_.row_buf_policy == "PREDICTIVE") {
+        policy_ = RowBufPolicy::PREDICTIVE;
+    } else if (config_.row_buf_policy == "MINIMALIST") {
+        policy_ = RowBufPolicy::MINIMALIST;
+    } else {
+        std::cerr << "Unknown row buffer policy " << config_.row_buf_policy
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+}
+
+CommandType RowPolicy::ColumnCommand(bool is_write) const {
+    if (policy_ == RowBufPolicy::CLOSE_PAGE) {
+        return is_write ? CommandType::WRITE_PRECHARGE
+                        : CommandType::READ_PRECHARGE;
+    }
+    return is_write ? CommandType::WRITE : CommandType::READ;
+}
+
+bool RowPolicy::ClosesRow(const Command& cmd, bool queued_hits,
+                          int row_hits) const {
+    if (policy_ == RowBufPolicy::PREDICTIVE) {
+        int idx = BankIndex(cmd.Rank(), cmd.Bankgroup(), cmd.Bank());
+        return !queued_hits && hit_counters_[idx] < 2;
+    } else if (policy_ == RowBufPolicy::MINIMALIST) {
+        // row_hits does not count this access yet
+        return !queued_hits || row_hits + 1 >= config_.minimalist_hits;
+    }
+    return false;
+}
+
+void RowPolicy::CommandIssued(const Command& cmd, uint64_t clk) {
+    if (cmd.IsReadWrite()) {
+        int idx = BankIndex(cmd.Rank(), cmd.Bankgroup(), cmd.Bank());
+        int& counter = hit_counters_[idx];
+        if (cmd.Row() == last_rows_[idx]) {
+            counter = std::min(counter + 1, 3);
+        } else {
+            counter = std::max(counter - 1, 0);
+        }
+        last_rows_[idx] = cmd.Row();
+        last_access_[idx] = clk;
+    } else if (cmd.cmd_type == CommandType::ACTIVATE) {
+        last_access_[BankIndex(cmd.Rank(), cmd.Bankgroup(), cmd.Bank())] = clk;
+    }
+    return;
+}
+
+void RowPolicy::Save(CheckpointWriter& writer) const {
+    writer.Section("row_policy");
+    writer.Put(last_access_);
+    writer.Put(last_rows_);
+    writer.Put(hit_counters_);
+    return;
+}
+
+void RowPolicy::Restore(CheckpointReader& reader) {
+    reader.Section("row_policy");
+    reader.Get(last_access_);
+    reader.Get(last_rows_);
+    reader.Get(hit_counters_);
+    return;
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,74 @@
+#ifndef __ROW_POLICY_H
+#define __ROW_POLICY_H
+
+#include <stdint.h>
+#include <vector>
+#include "checkpoint.h"
+#include "common.h"
+#include "configuration.h"
+
+namespace dramsim3 {
+
+// Row buffer management of a channel. Static policies pick the column
+// command type when a transaction becomes a command, adaptive ones decide
+// whether a READ/WRITE closes its row (auto-precharge) when it issues, or
+// close rows that have not been accessed for a while.
+//
+// Available policies ([system] row_buf_policy):
+//   OPEN_PAGE    rows stay open until a miss needs the bank (default)
+//   CLOSE_PAGE   every access auto-precharges
+//   TIMEOUT      open page, but rows with no queued accesses are closed
+//                after row_timeout idle cycles, OPEN_PAGE with
+//                aggressive_precharging_enabled is the same
+//   PREDICTIVE   an access with no queued hits behind it closes the row
+//                unless the 2-bit row hit predictor of the bank expects the
+//                next access to hit
+//   MINIMALIST   rows stay open for at most minimalist_hits accesses and
+//                only while more hits are queued, see Kaseridis et al.,
+//                MICRO 2011
+enum class RowBufPolicy {
+    OPEN_PAGE,
+    CLOSE_PAGE,
+    TIMEOUT,
+    PREDICTIVE,
+    MINIMALIST,
+    SIZE
+};
+
+class RowPolicy {
+   public:
+    RowPolicy(const Config& config);
+    RowBufPolicy Policy() const { return policy_; }
+    // column command of a transaction that moves to the command queues
+    CommandType ColumnCommand(bool is_write) const;
+    // whether a READ/WRITE that is about to issue should close its row,
+    // queued_hits tells if more accesses to the row are queued
+    bool ClosesRow(const Command& cmd, bool queued_hits, int row_hits) const;
+    bool ClosesIdleRows() const { return policy_ == RowBufPolicy::TIMEOUT; }
+    // cycle from which the open row of the bank counts as idle
+    uint64_t TimeoutCycle(int rank, int bankgroup, int bank) const {
+        return last_access_[BankIndex(rank, bankgroup, bank)] +
+               config_.row_timeout;
+    }
+    void CommandIssued(const Command& cmd, uint64_t clk);
+    void Save(CheckpointWriter& writer) const;
+    void Restore(CheckpointReader& reader);
+
+   private:
+    const Config& config_;
+    RowBufPolicy policy_;
+    // per bank, in (rank, bankgroup, bank) order: cycle of the last ACT or
+    // READ/WRITE, row of the last READ/WRITE and the saturating row hit
+    // counter, hits are predicted from 2 up
+    std::vector<uint64_t> last_access_;
+    std::vector<int> last_rows_;
+    std::vector<int> hit_counters_;
+
+    int BankIndex(int rank, int bankgroup, int bank) const {
+        return rank * config_.banks + bankgroup * config_.banks_per_group +
+               bank;
+    }
+};
+
+}  // namespace dramsim3
+#endif
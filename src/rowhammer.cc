@@ -0,0 +1,266 @@
+#include "rowhammer.h"
+#include <algorithm>
+
+namespace dramsim3 {
+
+namespace {
+
+// odd multipliers of the count-min hashes, a hash takes the high bits of
+// the product
+const uint64_t kHashMuls[] = {0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL,
+                              0x165667b19e3779f9ULL, 0xd6e8feb86659fd93ULL,
+                              0xff51afd7ed558ccdULL, 0xc4ceb9fe1a85ec53ULL,
+                              0x27d4eb2f165667c5ULL, 0x94d049bb133111ebULL};
+const int kNumHashMuls = sizeof(kHashMuls) / sizeof(kHashMuls[0]);
+
+}  // namespace
+
+RowHammer::RowHammer(int channel, const Config& config,
+                     ChannelState& channel_state, SimpleStats& simple_stats)
+    : config_(config),
+      channel_state_(channel_state),
+      simple_stats_(simple_stats),
+      tracker_(RowHammerTracker::MISRA_GRIES),
+      num_banks_(config.ranks * config.banks),
+      num_entries_(config.rh_table_entries),
+      num_hashes_(config.rh_cms_hashes),
+      rng_state_(kHashMuls[0] ^ static_cast<uint64_t>(channel + 1)),
+      window_(static_cast<uint64_t>(64 * 1e6 / config.tCK)),
+      next_reset_(window_) {
+    if (config_.rowhammer_mitigation == "NONE") {
+        policy_ = RowHammerPolicy::NONE;
+    } else if (config_.rowhammer_mitigation == "PARA") {
+        policy_ = RowHammerPolicy::PARA;
+    } else if (config_.rowhammer_mitigation == "TRR") {
+        policy_ = RowHammerPolicy::TRR;
+    } else if (config_.rowhammer_mitigation == "RFM") {
+        policy_ = RowHammerPolicy::RFM;
+    } else {
+        std::cerr << "Unknown rowhammer_mitigation "
+                  << config_.rowhammer_mitigation << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (config_.rh_tracker == "MISRA_GRIES") {
+        tracker_ = RowHammerTracker::MISRA_GRIES;
+    } else if (config_.rh_tracker == "COUNT_MIN") {
+        tracker_ = RowHammerTracker::COUNT_MIN;
+    } else {
+        std::cerr << "Unknown rh_tracker " << config_.rh_tracker << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (!Enabled()) {
+        return;
+    }
+    rfm_pending_.resize(num_banks_, false);
+    if (policy_ == RowHammerPolicy::TRR) {
+        if (tracker_ == RowHammerTracker::MISRA_GRIES) {
+            Entry free_entry = {-1, 0};
+            entries_.resize(num_banks_ * num_entries_, free_entry);
+            spillover_.resize(num_banks_, 0);
+        } else {
+            if (num_hashes_ > kNumHashMuls) {
+                std::cerr << "rh_cms_hashes can be at most " << kNumHashMuls
+                          << std::endl;
+                AbruptExit(__FILE__, __LINE__);
+            }
+            sketch_.resize(num_banks_ * num_hashes_ * num_entries_, 0);
+        }
+    } else if (policy_ == RowHammerPolicy::RFM) {
+        raa_counts_.resize(num_banks_, 0);
+    }
+    num_rh_triggers_ = simple_stats_.GetCounterId("num_rh_triggers");
+    rfm_stall_cycles_ = simple_stats_.GetCounterId("rfm_stall_cycles");
+}
+
+void RowHammer::CommandIssued(const Command& cmd, uint64_t clk) {
+    switch (cmd.cmd_type) {
+        case CommandType::ACTIVATE:
+            Activate(cmd, clk);
+            break;
+        case CommandType::REFRESH_MANAGEMENT:
+            rfm_pending_[BankIndex(cmd.Rank(), cmd.Bankgroup(), cmd.Bank())] =
+                false;
+            PayBack(BankIndex(cmd.Rank(), cmd.Bankgroup(), cmd.Bank()));
+            break;
+        case CommandType::REFRESH_BANK:
+            PayBack(BankIndex(cmd.Rank(), cmd.Bankgroup(), cmd.Bank()));
+            break;
+        case CommandType::REFRESH_SAME_BANK:
+            for (int g = 0; g < config_.bankgroups; g++) {
+                PayBack(BankIndex(cmd.Rank(), g, cmd.Bank()));
+            }
+            break;
+        case CommandType::REFRESH:
+            for (int b = 0; b < config_.banks; b++) {
+                PayBack(BankIndex(cmd.Rank(), 0, 0) + b);
+            }
+            break;
+        default:
+            break;
+    }
+    return;
+}
+
+void RowHammer::ClockTick() {
+    if (channel_state_.IsRefreshWaiting() &&
+        channel_state_.PendingRefCommand().cmd_type ==
+            CommandType::REFRESH_MANAGEMENT) {
+        simple_stats_.Increment(rfm_stall_cycles_);
+    }
+    return;
+}
+
+uint32_t RowHammer::Estimate(int rank, int bankgroup, int bank,
+                             int row) const {
+    int b = BankIndex(rank, bankgroup, bank);
+    if (tracker_ == RowHammerTracker::MISRA_GRIES) {
+        const Entry* entries = &entries_[b * num_entries_];
+        for (int i = 0; i < num_entries_; i++) {
+            if (entries[i].row == row) {
+                return entries[i].count;
+            }
+        }
+        return spillover_[b];
+    }
+    uint32_t estimate = UINT32_MAX;
+    for (int h = 0; h < num_hashes_; h++) {
+        estimate = std::min(estimate, sketch_[SketchIndex(b, h, row)]);
+    }
+    return estimate;
+}
+
+void RowHammer::Activate(const Command& cmd, uint64_t clk) {
+    int b = BankIndex(cmd.Rank(), cmd.Bankgroup(), cmd.Bank());
+    if (policy_ == RowHammerPolicy::PARA) {
+        if (NextRandom() < config_.para_probability) {
+            Trigger(cmd);
+        }
+    } else if (policy_ == RowHammerPolicy::TRR) {
+        if (clk >= next_reset_) {
+            Entry free_entry = {-1, 0};
+            std::fill(entries_.begin(), entries_.end(), free_entry);
+            std::fill(spillover_.begin(), spillover_.end(), 0);
+            std::fill(sketch_.begin(), sketch_.end(), 0);
+            next_reset_ = (clk / window_ + 1) * window_;
+        }
+        uint32_t before, after;
+        Track(b, cmd.Row(), before, after);
+        uint32_t threshold = static_cast<uint32_t>(config_.rh_threshold);
+        if (after / threshold > before / threshold) {
+            Trigger(cmd);
+        }
+    } else if (policy_ == RowHammerPolicy::RFM) {
+        raa_counts_[b]++;
+        if (raa_counts_[b] >= config_.rfm_raaimt) {
+            Trigger(cmd);
+        }
+    }
+    return;
+}
+
+void RowHammer::Track(int bank, int row, uint32_t& before, uint32_t& after) {
+    if (tracker_ == RowHammerTracker::MISRA_GRIES) {
+        Entry* entries = &entries_[bank * num_entries_];
+        Entry* victim = nullptr;
+        for (int i = 0; i < num_entries_; i++) {
+            if (entries[i].row == row) {
+                before = entries[i].count++;
+                after = entries[i].count;
+                return;
+            }
+            // a free entry first, otherwise the lowest count
+            if (victim == nullptr ||
+                (victim->row >= 0 && (entries[i].row < 0 ||
+                                      entries[i].count < victim->count))) {
+                victim = &entries[i];
+            }
+        }
+        // tracked counts never go below the spillover count, a row at it
+        // is no more likely an aggressor than the untracked one
+        uint32_t& spillover = spillover_[bank];
+        before = spillover;
+        if (victim->row < 0 || victim->count == spillover) {
+            victim->row = row;
+            victim->count = spillover + 1;
+            after = victim->count;
+        } else {
+            spillover++;
+            after = spillover;
+        }
+        return;
+    }
+    uint32_t* counters[kNumHashMuls];
+    uint32_t estimate = UINT32_MAX;
+    for (int h = 0; h < num_hashes_; h++) {
+        counters[h] = &sketch_[SketchIndex(bank, h, row)];
+        estimate = std::min(estimate, *counters[h]);
+    }
+    // conservative update, only the counters at the estimate go up
+    for (int h = 0; h < num_hashes_; h++) {
+        if (*counters[h] == estimate) {
+            (*counters[h])++;
+        }
+    }
+    before = estimate;
+    after = estimate + 1;
+    return;
+}
+
+int RowHammer::SketchIndex(int bank, int hash, int row) const {
+    uint64_t key = static_cast<uint64_t>(row) + 1;
+    uint64_t slot = ((key * kHashMuls[hash]) >> 32) %
+                    static_cast<uint64_t>(num_entries_);
+    return (bank * num_hashes_ + hash) * num_entries_ + static_cast<int>(slot);
+}
+
+void RowHammer::PayBack(int bank) {
+    if (policy_ == RowHammerPolicy::RFM) {
+        raa_counts_[bank] = std::max(raa_counts_[bank] - config_.rfm_raaimt, 0);
+    }
+    return;
+}
+
+void RowHammer::Trigger(const Command& cmd) {
+    simple_stats_.Increment(num_rh_triggers_);
+    int b = BankIndex(cmd.Rank(), cmd.Bankgroup(), cmd.Bank());
+    if (!rfm_pending_[b]) {
+        rfm_pending_[b] = true;
+        channel_state_.BankNeedRFM(cmd.Rank(), cmd.Bankgroup(), cmd.Bank(),
+                                   true);
+    }
+    return;
+}
+
+double RowHammer::NextRandom() {
+    rng_state_ ^= rng_state_ >> 12;
+    rng_state_ ^= rng_state_ << 25;
+    rng_state_ ^= rng_state_ >> 27;
+    uint64_t val = rng_state_ * 0x2545f4914f6cdd1dULL;
+    return static_cast<double>(val >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void RowHammer::Save(CheckpointWriter& writer) const {
+    writer.Section("rowhammer");
+    writer.Put(entries_);
+    writer.Put(spillover_);
+    writer.Put(sketch_);
+    writer.Put(raa_counts_);
+    writer.Put(rfm_pending_);
+    writer.Put(rng_state_);
+    writer.Put(next_reset_);
+    return;
+}
+
+void RowHammer::Restore(CheckpointReader& reader) {
+    reader.Section("rowhammer");
+    reader.Get(entries_);
+    reader.Get(spillover_);
+    reader.Get(sketch_);
+    reader.Get(raa_counts_);
+    reader.Get(rfm_pending_);
+    reader.Get(rng_state_);
+    reader.Get(next_reset_);
+    return;
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,105 @@
+#ifndef __ROWHAMMER_H
+#define __ROWHAMMER_H
+
+#include <stdint.h>
+#include <vector>
+#include "channel_state.h"
+#include "checkpoint.h"
+#include "common.h"
+#include "configuration.h"
+#include "simple_stats.h"
+
+namespace dramsim3 {
+
+// RowHammer mitigation of a channel. Every ACT is seen by the mitigation,
+// which asks for a REFRESH_MANAGEMENT (RFM) of the bank when it thinks the
+// neighbours of a row need a refresh. RFMs go through the refresh queue of
+// ChannelState like any other refresh, take the bank for tRFM and hold
+// back the ACTs of its rank while they wait, at most one is pending per
+// bank and triggers in the meantime are covered by it.
+//
+// Available mitigations ([system] rowhammer_mitigation):
+//   NONE  no mitigation (default)
+//   PARA  an ACT asks for an RFM with probability para_probability
+//   TRR   per bank activation tracker (rh_tracker), a row asks for an RFM
+//         every rh_threshold ACTs it is counted at. Trackers start over
+//         every 64ms refresh window
+//   RFM   DDR5 refresh management: per bank rolling accumulated ACT (RAA)
+//         counters ask for an RFM at rfm_raaimt, an RFM and every refresh
+//         of the bank take the count down by rfm_raaimt
+//
+// Trackers ([system] rh_tracker), both count every row at least as often
+// as it was activated:
+//   MISRA_GRIES  rh_table_entries rows per bank and a spillover count, an
+//                untracked row replaces a row at the spillover count or
+//                raises it (as in Graphene)
+//   COUNT_MIN    rh_cms_hashes rows of rh_table_entries counters per bank
+//                with conservative update
+enum class RowHammerPolicy { NONE, PARA, TRR, RFM, SIZE };
+
+enum class RowHammerTracker { MISRA_GRIES, COUNT_MIN, SIZE };
+
+class RowHammer {
+   public:
+    RowHammer(int channel, const Config& config, ChannelState& channel_state,
+              SimpleStats& simple_stats);
+    bool Enabled() const { return policy_ != RowHammerPolicy::NONE; }
+    // ACTs train the mitigation, refreshes and RFMs pay RAA counts back
+    void CommandIssued(const Command& cmd, uint64_t clk);
+    // counts the cycles an RFM holds up the refresh queue
+    void ClockTick();
+    // activations a TRR tracker counts for a row of a bank, at least the
+    // ACTs of the row since the tracker started over
+    uint32_t Estimate(int rank, int bankgroup, int bank, int row) const;
+
+    void Save(CheckpointWriter& writer) const;
+    void Restore(CheckpointReader& reader);
+
+   private:
+    struct Entry {
+        int row;  // -1 if free
+        uint32_t count;
+    };
+
+    const Config& config_;
+    ChannelState& channel_state_;
+    SimpleStats& simple_stats_;
+    RowHammerPolicy policy_;
+    RowHammerTracker tracker_;
+    int num_banks_;
+    int num_entries_;
+    int num_hashes_;
+
+    // MISRA_GRIES, num_entries_ per bank
+    std::vector<Entry> entries_;
+    std::vector<uint32_t> spillover_;
+    // COUNT_MIN, num_hashes_ * num_entries_ per bank
+    std::vector<uint32_t> sketch_;
+    // RFM
+    std::vector<int> raa_counts_;
+    std::vector<bool> rfm_pending_;
+    // PARA, xorshift64*
+    uint64_t rng_state_;
+    // TRR tracker reset
+    uint64_t window_;
+    uint64_t next_reset_;
+
+    CounterId num_rh_triggers_;
+    CounterId rfm_stall_cycles_;
+
+    int BankIndex(int rank, int bankgroup, int bank) const {
+        return rank * config_.banks + bankgroup * config_.banks_per_group +
+               bank;
+    }
+    void Activate(const Command& cmd, uint64_t clk);
+    // counts an ACT of row in the tracker of bank, returns the estimate
+    // before and after it
+    void Track(int bank, int row, uint32_t& before, uint32_t& after);
+    int SketchIndex(int bank, int hash, int row) const;
+    void PayBack(int bank);
+    void Trigger(const Command& cmd);
+    double NextRandom();
+};
+
+}  // namespace dramsim3
+#endif
@@ -0,0 +1,349 @@
+#include "scheduler.h"
+#include <algorithm>
+#include "command_queue.h"
+
+namespace dramsim3 {
+
+Scheduler::Scheduler(const Config& config) : config_(config) {}
+
+int Scheduler::WritesToDrain(size_t, size_t num_writes,
+                             size_t capacity, bool cmd_queue_empty) const {
+    // we basically have a upper and lower threshold for write buffer
+    if (num_writes >= capacity || (num_writes > 8 && cmd_queue_empty)) {
+        return static_cast<int>(num_writes);
+    }
+    return 0;
+}
+
+const Transaction* Scheduler::PickTransaction(
+    const TransactionQueue& queue, const CommandQueue& cmd_queue) const {
+    // oldest first
+    return queue.Oldest([&cmd_queue](int queue_idx) {
+        return cmd_queue.WillAcceptCommand(queue_idx);
+    });
+}
+
+bool Scheduler::RowHitCapReached(int row_hits) const {
+    return config_.row_hit_cap > 0 && row_hits >= config_.row_hit_cap;
+}
+
+BLISSScheduler::BLISSScheduler(const Config& config)
+    : Scheduler(config),
+      last_source_(-1),
+      streak_(0),
+      next_clear_clk_(config.bliss_clear_interval) {
+    if (config_.bliss_threshold < 1 || config_.bliss_clear_interval < 1) {
+        std::cerr << "bliss_threshold and bliss_clear_interval must be positive"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+}
+
+void BLISSScheduler::Update(const std::vector<std::vector<Command>>&,
+                            uint64_t clk) {
+    if (clk >= next_clear_clk_) {
+        std::fill(blacklist_.begin(), blacklist_.end(), false);
+        uint64_t interval = config_.bliss_clear_interval;
+        next_clear_clk_ = clk - clk % interval + interval;
+    }
+    return;
+}
+
+bool BLISSScheduler::IsBlacklisted(int source_id) const {
+    return source_id >= 0 && source_id < static_cast<int>(blacklist_.size()) &&
+           blacklist_[source_id];
+}
+
+int BLISSScheduler::CommandRank(const Command& queued,
+                                const Command& ready) const {
+    // non-blacklisted > row hit > older
+    return (IsBlacklisted(queued.source_id) ? 2 : 0) +
+           (ready.IsReadWrite() ? 0 : 1);
+}
+
+void BLISSScheduler::CommandIssued(const Command& cmd, uint64_t) {
+    if (!cmd.IsReadWrite()) {
+        return;
+    }
+    if (cmd.source_id == last_source_) {
+        streak_++;
+    } else {
+        last_source_ = cmd.source_id;
+        streak_ = 1;
+    }
+    if (streak_ >= config_.bliss_threshold && cmd.source_id >= 0) {
+        if (cmd.source_id >= static_cast<int>(blacklist_.size())) {
+            blacklist_.resize(cmd.source_id + 1, false);
+        }
+        blacklist_[cmd.source_id] = true;
+        streak_ = 0;
+    }
+    return;
+}
+
+PARBSScheduler::PARBSScheduler(const Config& config)
+    : Scheduler(config), num_banks_(config.ranks * config.banks) {
+    if (config_.parbs_marking_cap < 1) {
+        std::cerr << "parbs_marking_cap must be positive" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+}
+
+uint64_t PARBSScheduler::BatchKey(const Command& cmd) const {
+    return (cmd.hex_addr << 1) | (cmd.IsWrite() ? 1 : 0);
+}
+
+bool PARBSScheduler::IsMarked(const Command& cmd) const {
+    return std::binary_search(batch_.begin(), batch_.end(), BatchKey(cmd));
+}
+
+void PARBSScheduler::Update(const std::vector<std::vector<Command>>& queues,
+                            uint64_t) {
+    if (batch_.empty()) {
+        FormBatch(queues);
+    }
+    return;
+}
+
+void PARBSScheduler::FormBatch(
+    const std::vector<std::vector<Command>>& queues) {
+    // mark the oldest marking_cap requests of every source to every bank,
+    // queues are in arrival order
+    for (const auto& queue : queues) {
+        for (const auto& cmd : queue) {
+            int source = std::max(cmd.source_id, 0);
+            if (source >= static_cast<int>(max_load_.size())) {
+                bank_load_.resize((source + 1) * num_banks_, 0);
+                max_load_.resize(source + 1, 0);
+                total_load_.resize(source + 1, 0);
+                source_rank_.resize(source + 1, 0);
+            }
+            int bank = cmd.Rank() * config_.banks +
+                       cmd.Bankgroup() * config_.banks_per_group + cmd.Bank();
+            int& load = bank_load_[source * num_banks_ + bank];
+            if (load >= config_.parbs_marking_cap) {
+                continue;
+            }
+            load++;
+            if (total_load_[source] == 0) {
+                sources_.push_back(source);
+            }
+            total_load_[source]++;
+            max_load_[source] = std::max(max_load_[source], load);
+            batch_.push_back(BatchKey(cmd));
+        }
+    }
+    std::sort(batch_.begin(), batch_.end());
+
+    // shortest job first: sources with the lightest max bank load go first
+    std::sort(sources_.begin(), sources_.end(), [this](int a, int b) {
+        if (max_load_[a] != max_load_[b]) {
+            return max_load_[a] < max_load_[b];
+        }
+        if (total_load_[a] != total_load_[b]) {
+            return total_load_[a] < total_load_[b];
+        }
+        return a < b;
+    });
+    for (size_t i = 0; i < sources_.size(); i++) {
+        int source = sources_[i];
+        source_rank_[source] = static_cast<int>(i);
+        max_load_[source] = 0;
+        total_load_[source] = 0;
+        std::fill(bank_load_.begin() + source * num_banks_,
+                  bank_load_.begin() + (source + 1) * num_banks_, 0);
+    }
+    sources_.clear();
+    return;
+}
+
+int PARBSScheduler::CommandRank(const Command& queued,
+                                const Command& ready) const {
+    // marked > row hit > source rank > older
+    int source = std::max(queued.source_id, 0);
+    int source_rank = source < static_cast<int>(source_rank_.size())
+                          ? source_rank_[source]
+                          : static_cast<int>(source_rank_.size());
+    return (IsMarked(queued) ? 0 : 2 << 24) +
+           (ready.IsReadWrite() ? 0 : 1 << 24) + source_rank;
+}
+
+void PARBSScheduler::CommandIssued(const Command& cmd, uint64_t) {
+    if (!cmd.IsReadWrite()) {
+        return;
+    }
+    auto it = std::lower_bound(batch_.begin(), batch_.end(), BatchKey(cmd));
+    if (it != batch_.end() && *it == BatchKey(cmd)) {
+        batch_.erase(it);
+    }
+    return;
+}
+
+int ReadPriorityScheduler::WritesToDrain(size_t num_reads, size_t num_writes,
+                                         size_t capacity,
+                                         bool cmd_queue_empty) const {
+    // drain down to half of the buffer once it is full, or everything if
+    // there is nothing else to do
+    if (num_writes >= capacity) {
+        return static_cast<int>(num_writes - capacity / 2);
+    } else if (num_writes > 0 && num_reads == 0 && cmd_queue_empty) {
+        return static_cast<int>(num_writes);
+    }
+    return 0;
+}
+
+int ReadPriorityScheduler::CommandRank(const Command& queued,
+                                       const Command& ready) const {
+    // read > row hit > older
+    return (queued.IsWrite() ? 2 : 0) + (ready.IsReadWrite() ? 0 : 1);
+}
+
+const int QoSScheduler::kMaxClass;
+
+QoSScheduler::QoSScheduler(const Config& config)
+    : Scheduler(config),
+      served_(config.qos_sources, 0),
+      next_window_clk_(config.qos_window) {}
+
+int QoSScheduler::PriorityClass(int source_id, int priority) const {
+    if (IsTracked(source_id)) {
+        priority = std::max(priority, config_.qos_priorities[source_id]);
+    }
+    return std::min(std::max(priority, 0), kMaxClass);
+}
+
+bool QoSScheduler::OverCap(int source_id) const {
+    return IsTracked(source_id) && config_.qos_bw_caps[source_id] > 0 &&
+           served_[source_id] >=
+               static_cast<uint64_t>(config_.qos_bw_caps[source_id]);
+}
+
+bool QoSScheduler::LessServed(int a, int b) const {
+    // untracked sources count as never served
+    uint64_t served_a = IsTracked(a) ? served_[a] : 0;
+    uint64_t served_b = IsTracked(b) ? served_[b] : 0;
+    uint64_t weight_a = IsTracked(a) ? config_.qos_weights[a] : 1;
+    uint64_t weight_b = IsTracked(b) ? config_.qos_weights[b] : 1;
+    return served_a * weight_b < served_b * weight_a;
+}
+
+const Transaction* QoSScheduler::PickTransaction(
+    const TransactionQueue& queue, const CommandQueue& cmd_queue) const {
+    // uncapped > higher class > smaller share of the bandwidth > older,
+    // sources over their cap wait for the next window
+    auto trans = queue.Best(
+        [&cmd_queue](int queue_idx) {
+            return cmd_queue.WillAcceptCommand(queue_idx);
+        },
+        [this](const Transaction& a, const Transaction& b) {
+            bool capped_a = OverCap(a.source_id);
+            bool capped_b = OverCap(b.source_id);
+            if (capped_a != capped_b) {
+                return capped_b;
+            }
+            int class_a = PriorityClass(a.source_id, a.priority);
+            int class_b = PriorityClass(b.source_id, b.priority);
+            if (class_a != class_b) {
+                return class_a > class_b;
+            }
+            return LessServed(a.source_id, b.source_id);
+        });
+    if (trans != nullptr && OverCap(trans->source_id)) {
+        return nullptr;
+    }
+    return trans;
+}
+
+void QoSScheduler::Update(const std::vector<std::vector<Command>>&,
+                          uint64_t clk) {
+    if (clk >= next_window_clk_) {
+        std::fill(served_.begin(), served_.end(), 0);
+        uint64_t window = config_.qos_window;
+        next_window_clk_ = clk - clk % window + window;
+    }
+    return;
+}
+
+int QoSScheduler::CommandRank(const Command& queued,
+                              const Command& ready) const {
+    // uncapped > higher class > row hit > older, commands that made it to
+    // the command queues still issue after their source hit the cap
+    int class_rank = kMaxClass - PriorityClass(queued.source_id,
+                                               queued.priority);
+    return (OverCap(queued.source_id) ? 2 * (kMaxClass + 1) : 0) +
+           2 * class_rank + (ready.IsReadWrite() ? 0 : 1);
+}
+
+void QoSScheduler::CommandIssued(const Command& cmd, uint64_t) {
+    if (cmd.IsReadWrite() && IsTracked(cmd.source_id)) {
+        served_[cmd.source_id]++;
+    }
+    return;
+}
+
+Scheduler* MakeScheduler(const Config& config) {
+    if (config.scheduler == "FRFCFS") {
+        return new Scheduler(config);
+    } else if (config.scheduler == "BLISS") {
+        return new BLISSScheduler(config);
+    } else if (config.scheduler == "PARBS") {
+        return new PARBSScheduler(config);
+    } else if (config.scheduler == "READ_PRIORITY") {
+        return new ReadPriorityScheduler(config);
+    } else if (config.scheduler == "QOS") {
+        return new QoSScheduler(config);
+    }
+    std::cerr << "Unknown scheduler " << config.scheduler << std::endl;
+    AbruptExit(__FILE__, __LINE__);
+    return nullptr;
+}
+
+void BLISSScheduler::Save(CheckpointWriter& writer) const {
+    writer.Put(blacklist_);
+    writer.Put(last_source_);
+    writer.Put(streak_);
+    writer.Put(next_clear_clk_);
+    return;
+}
+
+void BLISSScheduler::Restore(CheckpointReader& reader) {
+    reader.Get(blacklist_);
+    reader.Get(last_source_);
+    reader.Get(streak_);
+    reader.Get(next_clear_clk_);
+    return;
+}
+
+void PARBSScheduler::Save(CheckpointWriter& writer) const {
+    writer.Put(batch_);
+    writer.Put(bank_load_);
+    writer.Put(max_load_);
+    writer.Put(total_load_);
+    writer.Put(source_rank_);
+    writer.Put(sources_);
+    return;
+}
+
+void PARBSScheduler::Restore(CheckpointReader& reader) {
+    reader.Get(batch_);
+    reader.Get(bank_load_);
+    reader.Get(max_load_);
+    reader.Get(total_load_);
+    reader.Get(source_rank_);
+    reader.Get(sources_);
+    return;
+}
+
+void QoSScheduler::Save(CheckpointWriter& writer) const {
+    writer.Put(served_);
+    writer.Put(next_window_clk_);
+    return;
+}
+
+void QoSScheduler::Restore(CheckpointReader& reader) {
+    reader.Get(served_);
+    reader.Get(next_window_clk_);
+    return;
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,142 @@
+#ifndef __SCHEDULER_H
+#define __SCHEDULER_H
+
+#include <vector>
+#include "checkpoint.h"
+#include "common.h"
+#include "configuration.h"
+#include "transaction_queue.h"
+
+namespace dramsim3 {
+
+class CommandQueue;
+
+// Scheduling policy of a channel controller. The controller asks it which
+// transaction moves into the command queues next and when to drain writes,
+// the command queues ask it to rank the commands that are ready to issue.
+// The base class is FR-FCFS with a row hit cap, which is also the default.
+//
+// Available policies ([system] scheduler):
+//   FRFCFS         first ready, first come first serve
+//   BLISS          blacklists sources that were served too many times in a
+//                  row, see Subramanian et al., ICCD 2014
+//   PARBS          parallelism-aware batch scheduling, see Mutlu and
+//                  Moscibroda, ISCA 2008
+//   READ_PRIORITY  reads before writes, writes drain with hysteresis
+//   QOS            per source priority classes, bandwidth weights and caps
+//                  (qos_* in [system])
+class Scheduler {
+   public:
+    Scheduler(const Config& config);
+    virtual ~Scheduler() {}
+
+    // number of buffered writes to drain now, 0 to keep serving reads
+    virtual int WritesToDrain(size_t num_reads, size_t num_writes,
+                              size_t capacity, bool cmd_queue_empty) const;
+    // transaction that is moved to the command queues next, or nullptr if
+    // none of them has room in its command queue
+    virtual const Transaction* PickTransaction(
+        const TransactionQueue& queue, const CommandQueue& cmd_queue) const;
+
+    // called every cycle before commands are picked
+    virtual void Update(const std::vector<std::vector<Command>>& /* queues */,
+                        uint64_t /* clk */) {}
+    // rank of ready, the command issuable for queued, lower ranks issue
+    // first and ties go to the older command, 0 ends the search early
+    virtual int CommandRank(const Command& /* queued */,
+                            const Command& /* ready */) const {
+        return 0;
+    }
+    virtual void CommandIssued(const Command& /* cmd */, uint64_t /* clk */) {}
+    // whether a row miss may close a row that still has pending hits
+    virtual bool RowHitCapReached(int row_hits) const;
+    // policy state to/from a checkpoint
+    virtual void Save(CheckpointWriter& /* writer */) const {}
+    virtual void Restore(CheckpointReader& /* reader */) {}
+
+   protected:
+    const Config& config_;
+};
+
+class BLISSScheduler : public Scheduler {
+   public:
+    BLISSScheduler(const Config& config);
+    void Update(const std::vector<std::vector<Command>>& queues,
+                uint64_t clk) override;
+    int CommandRank(const Command& queued, const Command& ready) const override;
+    void CommandIssued(const Command& cmd, uint64_t clk) override;
+    void Save(CheckpointWriter& writer) const override;
+    void Restore(CheckpointReader& reader) override;
+
+   private:
+    std::vector<bool> blacklist_;
+    int last_source_;
+    int streak_;
+    uint64_t next_clear_clk_;
+    bool IsBlacklisted(int source_id) const;
+};
+
+class PARBSScheduler : public Scheduler {
+   public:
+    PARBSScheduler(const Config& config);
+    void Update(const std::vector<std::vector<Command>>& queues,
+                uint64_t clk) override;
+    int CommandRank(const Command& queued, const Command& ready) const override;
+    void CommandIssued(const Command& cmd, uint64_t clk) override;
+    void Save(CheckpointWriter& writer) const override;
+    void Restore(CheckpointReader& reader) override;
+
+   private:
+    // commands of the current batch, sorted by BatchKey
+    std::vector<uint64_t> batch_;
+    // per source marked commands per bank, and the resulting source ranking
+    std::vector<int> bank_load_;
+    std::vector<int> max_load_;
+    std::vector<int> total_load_;
+    std::vector<int> source_rank_;
+    std::vector<int> sources_;
+    int num_banks_;
+    uint64_t BatchKey(const Command& cmd) const;
+    bool IsMarked(const Command& cmd) const;
+    void FormBatch(const std::vector<std::vector<Command>>& queues);
+};
+
+class ReadPriorityScheduler : public Scheduler {
+   public:
+    ReadPriorityScheduler(const Config& config) : Scheduler(config) {}
+    int WritesToDrain(size_t num_reads, size_t num_writes, size_t capacity,
+                      bool cmd_queue_empty) const override;
+    int CommandRank(const Command& queued, const Command& ready) const override;
+};
+
+class QoSScheduler : public Scheduler {
+   public:
+    QoSScheduler(const Config& config);
+    const Transaction* PickTransaction(
+        const TransactionQueue& queue,
+        const CommandQueue& cmd_queue) const override;
+    void Update(const std::vector<std::vector<Command>>& queues,
+                uint64_t clk) override;
+    int CommandRank(const Command& queued, const Command& ready) const override;
+    void CommandIssued(const Command& cmd, uint64_t clk) override;
+    void Save(CheckpointWriter& writer) const override;
+    void Restore(CheckpointReader& reader) override;
+
+   private:
+    static const int kMaxClass = 7;
+    // READ/WRITE commands issued per source in the current window
+    std::vector<uint64_t> served_;
+    uint64_t next_window_clk_;
+    bool IsTracked(int source_id) const {
+        return source_id >= 0 && source_id < config_.qos_sources;
+    }
+    int PriorityClass(int source_id, int priority) const;
+    bool OverCap(int source_id) const;
+    // whether source a got less than its share compared to source b
+    bool LessServed(int a, int b) const;
+};
+
+Scheduler* MakeScheduler(const Config& config);
+
+}  // namespace dramsim3
+#endif
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 
 #include "fmt/format.h"
@@ -5,6 +6,22 @@
 
 namespace dramsim3 {
 
+namespace {
+
+struct Percentile {
+    const char* name;
+    const char* desc;
+    double fraction;
+};
+
+// latency percentiles reported for reads and writes
+const Percentile kPercentiles[] = {{"p50", "Median", 0.5},
+                                   {"p90", "90th percentile", 0.9},
+                                   {"p99", "99th percentile", 0.99},
+                                   {"p999", "99.9th percentile", 0.999}};
+
+}  // namespace
+
 template <class T>
 void PrintStatText(std::ostream& where, std::string name, T value,
                    std::string description) {
@@ -16,27 +33,102 @@ void PrintStatText(std::ostream& where, std::string name, T value,
     return;
 }
 
-SimpleStats::SimpleStats(const Config& config, int channel_id)
-    : config_(config), channel_id_(channel_id) {
+SimpleStats::SimpleStats(const Config& config,
+                         const OutputFiles& output_files, int channel_id)
+    : config_(config), output_files_(output_files), channel_id_(channel_id) {
     // counter stats
-    InitStat("num_cycles", "counter", "Number of DRAM cycles");
-    InitStat("epoch_num", "counter", "Number of epochs");
-    InitStat("num_reads_done", "counter", "Number of read requests issued");
-    InitStat("num_writes_done", "counter", "Number of read requests issued");
+    num_cycles_ = InitStat("num_cycles", "counter", "Number of DRAM cycles");
+    epoch_num_ = InitStat("epoch_num", "counter", "Number of epochs");
+    num_reads_done_ = InitStat("num_reads_done", "counter",
+                               "Number of read requests issued");
+    num_writes_done_ = InitStat("num_writes_done", "counter",
+                                "Number of read requests issued");
     InitStat("num_write_buf_hits", "counter", "Number of write buffer hits");
     InitStat("num_read_row_hits", "counter", "Number of read row buffer hits");
     InitStat("num_write_row_hits", "counter",
              "Number of write row buffer hits");
-    InitStat("num_read_cmds", "counter", "Number of READ/READP commands");
-    InitStat("num_write_cmds", "counter", "Number of WRITE/WRITEP commands");
-    InitStat("num_act_cmds", "counter", "Number of ACT commands");
+    num_read_cmds_ = InitStat("num_read_cmds", "counter",
+                              "Number of READ/READP commands");
+    num_write_cmds_ = InitStat("num_write_cmds", "counter",
+                               "Number of WRITE/WRITEP commands");
+    num_act_cmds_ =
+        InitStat("num_act_cmds", "counter", "Number of ACT commands");
     InitStat("num_pre_cmds", "counter", "Number of PRE commands");
     InitStat("num_ondemand_pres", "counter", "Number of ondemend PRE commands");
-    InitStat("num_ref_cmds", "counter", "Number of REF commands");
-    InitStat("num_refb_cmds", "counter", "Number of REFb commands");
+    InitStat("num_policy_closes", "counter",
+             "Number of rows closed early by the row buffer policy");
+    num_ref_cmds_ =
+        InitStat("num_ref_cmds", "counter", "Number of REF commands");
+    num_refb_cmds_ =
+        InitStat("num_refb_cmds", "counter", "Number of REFb commands");
+    num_refsb_cmds_ =
+        InitStat("num_refsb_cmds", "counter", "Number of REFsb commands");
+    num_rfm_cmds_ =
+        InitStat("num_rfm_cmds", "counter", "Number of RFM commands");
+    InitStat("num_refs_postponed", "counter",
+             "Number of refreshes postponed for queued commands");
+    InitStat("num_refs_pulled_in", "counter",
+             "Number of refreshes issued ahead of time");
     InitStat("num_srefe_cmds", "counter", "Number of SREFE commands");
     InitStat("num_srefx_cmds", "counter", "Number of SREFX commands");
+    InitStat("num_pde_cmds", "counter", "Number of PDE commands");
+    InitStat("num_pdx_cmds", "counter", "Number of PDX commands");
     InitStat("hbm_dual_cmds", "counter", "Number of cycles dual cmds issued");
+    num_rw_turnarounds_ = InitStat("num_rw_turnarounds", "counter",
+                                   "Number of READ to WRITE bus turnarounds");
+    num_wr_turnarounds_ = InitStat("num_wr_turnarounds", "counter",
+                                   "Number of WRITE to READ bus turnarounds");
+    InitStat("num_write_drains", "counter", "Number of write buffer drains");
+    // every cycle without a command goes to one stall reason
+    InitStat("stall_refresh_cycles", "counter",
+             "Cycles without a command, refresh pending or tRFC");
+    InitStat("stall_empty_cycles", "counter",
+             "Cycles without a command, command queues empty");
+    InitStat("stall_trcd_cycles", "counter",
+             "Cycles without a command, ACT to READ/WRITE");
+    InitStat("stall_trp_cycles", "counter",
+             "Cycles without a command, PRE to ACT");
+    InitStat("stall_tras_cycles", "counter",
+             "Cycles without a command, ACT/READ/WRITE to PRE or tRC");
+    InitStat("stall_tccd_cycles", "counter",
+             "Cycles without a command, READ to READ or WRITE to WRITE");
+    InitStat("stall_twtr_cycles", "counter",
+             "Cycles without a command, READ/WRITE turnaround");
+    InitStat("stall_tfaw_cycles", "counter",
+             "Cycles without a command, tRRD or tFAW");
+    InitStat("stall_power_cycles", "counter",
+             "Cycles without a command, power down or self refresh");
+    InitStat("stall_rw_dependency_cycles", "counter",
+             "Cycles without a command, WRITE behind a READ of its address");
+    InitStat("stall_other_cycles", "counter",
+             "Cycles without a command, commands held back by the scheduler");
+    InitStat("stall_queue_full_cycles", "counter",
+             "Cycles without a command and transactions waiting for full "
+             "command queues");
+    if (config_.IsHMC()) {
+        InitStat("num_atomic_reqs", "counter",
+                 "Number of atomic requests executed in vault");
+        InitStat("atomic_link_bytes_saved", "counter",
+                 "Link bytes saved over host read-modify-write");
+    }
+    if (config_.rowhammer_mitigation != "NONE") {
+        InitStat("num_rh_triggers", "counter",
+                 "Number of RFMs asked for by the RowHammer mitigation");
+        InitStat("rfm_stall_cycles", "counter",
+                 "Cycles an RFM held up the refresh queue");
+    }
+    if (config_.prefetcher != "NONE") {
+        num_prefetches_ =
+            InitStat("num_prefetches", "counter", "Number of prefetch READs");
+        num_prefetch_hits_ =
+            InitStat("num_prefetch_hits", "counter",
+                     "Number of demand reads served by prefetches");
+        InitStat("num_late_prefetch_hits", "counter",
+                 "Number of demand reads waiting for a queued prefetch");
+        num_prefetch_misses_ =
+            InitStat("num_prefetch_misses", "counter",
+                     "Number of demand reads not covered by prefetches");
+    }
 
     // double stats
     InitStat("act_energy", "double", "Activation energy");
@@ -44,14 +136,27 @@ SimpleStats::SimpleStats(const Config& config, int channel_id)
     InitStat("write_energy", "double", "Write energy");
     InitStat("ref_energy", "double", "Refresh energy");
     InitStat("refb_energy", "double", "Refresh-bank energy");
+    InitStat("refsb_energy", "double", "Same-bank refresh energy");
+    InitStat("rfm_energy", "double", "Refresh management energy");
 
     // Vector counter stats
-    InitVecStat("all_bank_idle_cycles", "vec_counter",
-                "Cyles of all bank idle in rank", "rank", config_.ranks);
-    InitVecStat("rank_active_cycles", "vec_counter", "Cyles of rank active",
-                "rank", config_.ranks);
-    InitVecStat("sref_cycles", "vec_counter", "Cyles of rank in SREF mode",
-                "rank", config_.ranks);
+    all_bank_idle_cycles_ =
+        InitVecStat("all_bank_idle_cycles", "vec_counter",
+                    "Cyles of all bank idle in rank", "rank", config_.ranks);
+    rank_active_cycles_ =
+        InitVecStat("rank_active_cycles", "vec_counter",
+                    "Cyles of rank active", "rank", config_.ranks);
+    sref_cycles_ =
+        InitVecStat("sref_cycles", "vec_counter", "Cyles of rank in SREF mode",
+                    "rank", config_.ranks);
+    act_pd_cycles_ =
+        InitVecStat("act_pd_cycles", "vec_counter",
+                    "Cyles of rank in active power down", "rank",
+                    config_.ranks);
+    pre_pd_cycles_ =
+        InitVecStat("pre_pd_cycles", "vec_counter",
+                    "Cyles of rank in precharge power down", "rank",
+                    config_.ranks);
 
     // Vector of double stats
     InitVecStat("act_stb_energy", "vec_double", "Active standby energy", "rank",
@@ -60,30 +165,110 @@ SimpleStats::SimpleStats(const Config& config, int channel_id)
                 "rank", config_.ranks);
     InitVecStat("sref_energy", "vec_double", "SREF energy", "rank",
                 config_.ranks);
+    InitVecStat("act_pd_energy", "vec_double", "Active power down energy",
+                "rank", config_.ranks);
+    InitVecStat("pre_pd_energy", "vec_double", "Precharge power down energy",
+                "rank", config_.ranks);
 
     // Histogram stats
-    InitHistoStat("read_latency", "Read request latency (cycles)", 0, 200, 10);
-    InitHistoStat("write_latency", "Write cmd latency (cycles)", 0, 200, 10);
-    InitHistoStat("interarrival_latency",
-                  "Request interarrival latency (cycles)", 0, 100, 10);
+    read_latency_ = InitHistoStat(
+        "read_latency", "Read request latency (cycles)", 0, 200, 10);
+    write_latency_ = InitHistoStat("write_latency",
+                                   "Write cmd latency (cycles)", 0, 200, 10);
+    interarrival_latency_ =
+        InitHistoStat("interarrival_latency",
+                      "Request interarrival latency (cycles)", 0, 100, 10);
+    InitHistoStat("write_drain_length", "Writes scheduled per write drain", 0,
+                  64, 8);
+
+    // per source stats
+    if (config_.qos_sources > 0) {
+        source_reads_done_ =
+            InitVecStat("source_reads_done", "vec_counter",
+                        "Number of read requests issued", "source",
+                        config_.qos_sources);
+        source_writes_done_ =
+            InitVecStat("source_writes_done", "vec_counter",
+                        "Number of write requests issued", "source",
+                        config_.qos_sources);
+        InitVecStat("source_bandwidth", "vec_double", "Average bandwidth",
+                    "source", config_.qos_sources);
+        InitVecStat("source_average_read_latency", "vec_double",
+                    "Average read request latency (cycles)", "source",
+                    config_.qos_sources);
+        InitVecStat("source_p99_read_latency", "vec_double",
+                    "99th percentile read request latency (cycles)",
+                    "source", config_.qos_sources);
+        for (int i = 0; i < config_.qos_sources; i++) {
+            std::string source = "source_" + std::to_string(i);
+            source_read_latency_.push_back(InitHistoStat(
+                source + "_read_latency",
+                "Read request latency of " + source + " (cycles)", 0, 200,
+                10));
+        }
+    }
 
     // some irregular stats
     InitStat("average_bandwidth", "calculated", "Average bandwidth");
+    InitStat("bandwidth_per_pin", "calculated",
+             "Average bandwidth per data pin (Gbps)");
     InitStat("total_energy", "calculated", "Total energy (pJ)");
+    for (const auto& pct : kPercentiles) {
+        InitStat(std::string(pct.name) + "_read_latency", "calculated",
+                 std::string(pct.desc) + " read request latency (cycles)");
+        InitStat(std::string(pct.name) + "_write_latency", "calculated",
+                 std::string(pct.desc) + " write cmd latency (cycles)");
+    }
     InitStat("average_power", "calculated", "Average power (mW)");
+    if (config_.rowhammer_mitigation != "NONE") {
+        InitStat("rfm_bw_loss", "calculated",
+                 "Fraction of bank cycles taken by RFMs");
+    }
+    if (config_.prefetcher != "NONE") {
+        InitStat("prefetch_accuracy", "calculated",
+                 "Fraction of prefetches used by demand reads");
+        InitStat("prefetch_coverage", "calculated",
+                 "Fraction of demand reads served by prefetches");
+        InitStat("prefetch_bw_overhead", "calculated",
+                 "Unused prefetch READs per demand READ");
+    }
+    InitStat("energy_per_bit", "calculated",
+             "Total energy per bit of requested data (pJ/bit)");
     InitStat("average_read_latency", "calculated",
              "Average read request latency (cycles)");
     InitStat("average_interarrival", "calculated",
              "Average request interarrival latency (cycles)");
+    InitStat("turnarounds_avoided", "calculated",
+             "Bus turnarounds saved over alternating READs and WRITEs");
+    InitStat("data_bus_utilization", "calculated",
+             "Fraction of cycles the data bus transfers data");
 }
 
-void SimpleStats::AddValue(const std::string name, const int value) {
-    auto& epoch_counts = epoch_histo_counts_[name];
-    if (epoch_counts.count(value) <= 0) {
-        epoch_counts[value] = 1;
-    } else {
-        epoch_counts[value] += 1;
+CounterId SimpleStats::GetCounterId(const std::string& name) const {
+    auto it = counter_idx_.find(name);
+    if (it == counter_idx_.end()) {
+        std::cerr << "Unknown counter stat " << name << std::endl;
+        AbruptExit(__FILE__, __LINE__);
     }
+    return CounterId{it->second};
+}
+
+VecCounterId SimpleStats::GetVecCounterId(const std::string& name) const {
+    auto it = vec_counter_idx_.find(name);
+    if (it == vec_counter_idx_.end()) {
+        std::cerr << "Unknown vector counter stat " << name << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    return VecCounterId{it->second.first};
+}
+
+HistoId SimpleStats::GetHistoId(const std::string& name) const {
+    auto it = histo_idx_.find(name);
+    if (it == histo_idx_.end()) {
+        std::cerr << "Unknown histogram stat " << name << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    return HistoId{it->second};
 }
 
 std::string SimpleStats::GetTextHeader(bool is_final) const {
@@ -92,23 +277,25 @@ std::string SimpleStats::GetTextHeader(bool is_final) const {
         "Channel " +
         std::to_string(channel_id_);
     if (!is_final) {
-        header += " of epoch " + std::to_string(counters_.at("epoch_num"));
+        header += " of epoch " + std::to_string(counters_[epoch_num_.idx]);
     }
     header += "\n###########################################\n";
     return header;
 }
-
 double SimpleStats::RankBackgroundEnergy(const int rank) const{
     return vec_doubles_.at("act_stb_energy")[rank] +
            vec_doubles_.at("pre_stb_energy")[rank] +
-           vec_doubles_.at("sref_energy")[rank];
+           vec_doubles_.at("sref_energy")[rank] +
+           vec_doubles_.at("act_pd_energy")[rank] +
+           vec_doubles_.at("pre_pd_energy")[rank];
 }
 
-void SimpleStats::PrintEpochStats() {
+void SimpleStats::PrintEpochStats(EpochWriter* epoch_writer) {
     UpdateEpochStats();
-    if (config_.output_level >= 1) {
-        std::ofstream j_out(config_.json_epoch_name, std::ofstream::app);
-        j_out << j_data_;
+    if (epoch_writer != nullptr) {
+        // every key is set again by the next update
+        epoch_writer->Write(std::move(j_data_));
+        j_data_ = Json();
     }
     if (config_.output_level >= 2) {
         std::cout << GetTextHeader(false);
@@ -124,7 +311,7 @@ void SimpleStats::PrintFinalStats() {
     UpdateFinalStats();
 
     if (config_.output_level >= 0) {
-        std::ofstream j_out(config_.json_stats_name, std::ofstream::app);
+        std::ofstream j_out(output_files_.json_stats, std::ofstream::app);
         j_out << "\"" << std::to_string(channel_id_) << "\":";
         j_out << j_data_;
     }
@@ -132,7 +319,7 @@ void SimpleStats::PrintFinalStats() {
     if (config_.output_level >= 1) {
         // HACK: overwrite existing file if this is first channel
         auto perm = channel_id_ == 0 ? std::ofstream::out : std::ofstream::app;
-        std::ofstream txt_out(config_.txt_stats_name, perm);
+        std::ofstream txt_out(output_files_.txt_stats, perm);
         txt_out << GetTextHeader(true);
         for (const auto& it : print_pairs_) {
             PrintStatText(txt_out, it.first, it.second,
@@ -144,18 +331,10 @@ void SimpleStats::PrintFinalStats() {
 }
 
 void SimpleStats::Reset() {
-    for (auto& it : counters_) {
-        it.second = 0;
-    }
-    for (auto& it : epoch_counters_) {
-        it.second = 0;
-    }
-    for (auto& vec : vec_counters_) {
-        std::fill(vec.second.begin(), vec.second.end(), 0);
-    }
-    for (auto& vec : epoch_vec_counters_) {
-        std::fill(vec.second.begin(), vec.second.end(), 0);
-    }
+    std::fill(counters_.begin(), counters_.end(), 0);
+    std::fill(epoch_counters_.begin(), epoch_counters_.end(), 0);
+    std::fill(vec_counters_.begin(), vec_counters_.end(), 0);
+    std::fill(epoch_vec_counters_.begin(), epoch_vec_counters_.end(), 0);
     for (auto& it : doubles_) {
         it.second = 0.0;
     }
@@ -165,165 +344,212 @@ void SimpleStats::Reset() {
     for (auto& it : calculated_) {
         it.second = 0.0;
     }
-    for (auto& it : histo_counts_) {
-        it.second.clear();
-    }
-    for (auto& it : epoch_histo_counts_) {
-        it.second.clear();
+    for (auto& histo : histos_) {
+        std::fill(histo.counts.begin(), histo.counts.end(), 0);
+        std::fill(histo.epoch_counts.begin(), histo.epoch_counts.end(), 0);
+        histo.sum = 0;
+        histo.epoch_sum = 0;
+        std::fill(histo.bins.begin(), histo.bins.end(), 0);
+        std::fill(histo.epoch_bins.begin(), histo.epoch_bins.end(), 0);
     }
 }
 
-void SimpleStats::InitStat(std::string name, std::string stat_type,
-                           std::string description) {
+CounterId SimpleStats::InitStat(std::string name, std::string stat_type,
+                                std::string description) {
     header_descs_.emplace(name, description);
+    int idx = -1;
     if (stat_type == "counter") {
-        counters_.emplace(name, 0);
-        epoch_counters_.emplace(name, 0);
+        idx = static_cast<int>(counters_.size());
+        counter_idx_.emplace(name, idx);
+        counters_.push_back(0);
+        epoch_counters_.push_back(0);
     } else if (stat_type == "double") {
         doubles_.emplace(name, 0.0);
     } else if (stat_type == "calculated") {
         calculated_.emplace(name, 0.0);
     }
+    return CounterId{idx};
 }
 
-void SimpleStats::InitVecStat(std::string name, std::string stat_type,
-                              std::string description, std::string part_name,
-                              int vec_len) {
+VecCounterId SimpleStats::InitVecStat(std::string name, std::string stat_type,
+                                      std::string description,
+                                      std::string part_name, int vec_len) {
     for (int i = 0; i < vec_len; i++) {
         std::string trailing = "." + std::to_string(i);
         std::string actual_name = name + trailing;
         std::string actual_desc = description + " " + part_name + trailing;
         header_descs_.emplace(actual_name, actual_desc);
     }
+    int offset = -1;
     if (stat_type == "vec_counter") {
-        vec_counters_.emplace(name, std::vector<uint64_t>(vec_len, 0));
-        epoch_vec_counters_.emplace(name, std::vector<uint64_t>(vec_len, 0));
+        offset = static_cast<int>(vec_counters_.size());
+        vec_counter_idx_.emplace(name, std::make_pair(offset, vec_len));
+        vec_counters_.resize(offset + vec_len, 0);
+        epoch_vec_counters_.resize(offset + vec_len, 0);
     } else if (stat_type == "vec_double") {
         vec_doubles_.emplace(name, std::vector<double>(vec_len, 0));
     }
+    return VecCounterId{offset};
 }
 
-void SimpleStats::InitHistoStat(std::string name, std::string description,
-                                int start_val, int end_val, int num_bins) {
-    int bin_width = (end_val - start_val) / num_bins;
-    bin_widths_.emplace(name, bin_width);
-    histo_bounds_.emplace(name, std::make_pair(start_val, end_val));
-    histo_counts_.emplace(name, std::unordered_map<int, uint64_t>());
-    epoch_histo_counts_.emplace(name, std::unordered_map<int, uint64_t>());
+HistoId SimpleStats::InitHistoStat(std::string name, std::string description,
+                                   int start_val, int end_val, int num_bins) {
+    Histogram histo;
+    histo.start_val = start_val;
+    histo.end_val = end_val;
+    histo.bin_width = (end_val - start_val) / num_bins;
+    histo.epoch_counts.resize(kHistoBuckets, 0);
+    histo.counts.resize(kHistoBuckets, 0);
+    histo.epoch_sum = 0;
+    histo.sum = 0;
 
     // initialize headers, descriptions
-    std::vector<std::string> headers;
     auto header = fmt::format("{}[-{}]", name, start_val);
-    headers.push_back(header);
+    histo.headers.push_back(header);
     header_descs_.emplace(header, description);
     for (int i = 1; i < num_bins + 1; i++) {
-        int bucket_start = start_val + (i - 1) * bin_width;
-        int bucket_end = start_val + i * bin_width - 1;
+        int bucket_start = start_val + (i - 1) * histo.bin_width;
+        int bucket_end = start_val + i * histo.bin_width - 1;
         header = fmt::format("{}[{}-{}]", name, bucket_start, bucket_end);
-        headers.push_back(header);
+        histo.headers.push_back(header);
         header_descs_.emplace(header, description);
     }
     header = fmt::format("{}[{}-]", name, end_val);
-    headers.push_back(header);
+    histo.headers.push_back(header);
     header_descs_.emplace(header, description);
 
-    histo_headers_.emplace(name, headers);
-
     // +2 for front and end
-    histo_bins_.emplace(name, std::vector<uint64_t>(num_bins + 2, 0));
-    epoch_histo_bins_.emplace(name, std::vector<uint64_t>(num_bins + 2, 0));
+    histo.bins.resize(num_bins + 2, 0);
+    histo.epoch_bins.resize(num_bins + 2, 0);
+
+    int idx = static_cast<int>(histos_.size());
+    histo_idx_.emplace(name, idx);
+    histos_.push_back(histo);
+    return HistoId{idx};
 }
 
 void SimpleStats::UpdateCounters() {
-    for (const auto& it : epoch_counters_) {
-        counters_[it.first] += it.second;
+    for (size_t i = 0; i < counters_.size(); i++) {
+        counters_[i] += epoch_counters_[i];
     }
-    for (const auto& vec : epoch_vec_counters_) {
-        for (size_t i = 0; i < vec.second.size(); i++) {
-            vec_counters_[vec.first][i] += vec.second[i];
-        }
+    for (size_t i = 0; i < vec_counters_.size(); i++) {
+        vec_counters_[i] += epoch_vec_counters_[i];
+    }
+}
+
+int SimpleStats::HistoBucketLow(int bucket) {
+    if (bucket < 2 * kHistoSubBuckets) {
+        return bucket;
+    }
+    int shift = bucket / kHistoSubBuckets - 1;
+    return (bucket % kHistoSubBuckets + kHistoSubBuckets) << shift;
+}
+
+int SimpleStats::HistoBucketHigh(int bucket) {
+    if (bucket < 2 * kHistoSubBuckets) {
+        return bucket;
     }
+    int shift = bucket / kHistoSubBuckets - 1;
+    int64_t low = HistoBucketLow(bucket);
+    return static_cast<int>(low + (int64_t(1) << shift) - 1);
 }
 
 void SimpleStats::UpdateHistoBins() {
-    for (auto& name_bins : epoch_histo_bins_) {
-        const auto& name = name_bins.first;
-        auto& bins = name_bins.second;
+    for (auto& histo : histos_) {
+        auto& bins = histo.epoch_bins;
         std::fill(bins.begin(), bins.end(), 0);
-        for (const auto it : epoch_histo_counts_[name]) {
-            int value = it.first;
-            uint64_t count = it.second;
+        // the printed ranges are far below where buckets get wider than one
+        for (int b = 0; b < kHistoBuckets; b++) {
+            uint64_t count = histo.epoch_counts[b];
+            if (count == 0) {
+                continue;
+            }
+            int value = HistoBucketLow(b);
             int bin_idx = 0;
-            if (value < histo_bounds_[name].first) {
+            if (value < histo.start_val) {
                 bin_idx = 0;
-            } else if (value > histo_bounds_[name].second) {
+            } else if (value > histo.end_val) {
                 bin_idx = bins.size() - 1;
             } else {
-                bin_idx =
-                    (value - histo_bounds_[name].first) / bin_widths_[name] + 1;
+                bin_idx = (value - histo.start_val) / histo.bin_width + 1;
             }
             bins[bin_idx] += count;
+            // update overall histogram counts based on epoch histo counts
+            histo.counts[b] += count;
         }
-    }
-
-    // update overall histogram counts based on epoch histo counts
-    for (auto& name_counts : epoch_histo_counts_) {
-        const auto& name = name_counts.first;
-        auto& epoch_counts = name_counts.second;
-        auto& final_counts = histo_counts_[name];
-        for (const auto& val_cnt : epoch_counts) {
-            if (final_counts.count(val_cnt.first) <= 0) {
-                final_counts[val_cnt.first] = val_cnt.second;
-            } else {
-                final_counts[val_cnt.first] += val_cnt.second;
-            }
-        }
-        auto& final_bins = histo_bins_[name];
-        for (size_t i = 0; i < final_bins.size(); i++) {
-            final_bins[i] += epoch_histo_bins_[name][i];
+        histo.sum += histo.epoch_sum;
+        for (size_t i = 0; i < histo.bins.size(); i++) {
+            histo.bins[i] += bins[i];
         }
     }
 }
 
-double SimpleStats::GetHistoAvg(const HistoCount& hist_counts) const {
-    uint64_t accu_sum = 0;
+double SimpleStats::GetHistoAvg(const Histogram& histo, bool epoch) const {
+    const auto& counts = epoch ? histo.epoch_counts : histo.counts;
     uint64_t count = 0;
-    for (auto i = hist_counts.begin(); i != hist_counts.end(); i++) {
-        accu_sum += i->first * i->second;
-        count += i->second;
+    for (auto c : counts) {
+        count += c;
     }
+    int64_t accu_sum = epoch ? histo.epoch_sum : histo.sum;
     return count == 0
                ? 0.0
                : static_cast<double>(accu_sum) / static_cast<double>(count);
 }
 
+std::vector<int> SimpleStats::HistoPercentiles(
+    const std::vector<uint64_t>& counts, const std::vector<double>& fractions) {
+    uint64_t total = 0;
+    for (auto c : counts) {
+        total += c;
+    }
+    // one pass over the buckets
+    std::vector<int> values(fractions.size(), 0);
+    size_t f = 0;
+    uint64_t accu = 0;
+    for (int b = 0; b < kHistoBuckets && f < fractions.size() && total > 0;
+         b++) {
+        accu += counts[b];
+        while (f < fractions.size() && counts[b] > 0 &&
+               accu >= fractions[f] * total) {
+            values[f] = HistoBucketHigh(b);
+            f++;
+        }
+    }
+    return values;
+}
+
 void SimpleStats::UpdatePrints(bool epoch) {
     j_data_["channel"] = channel_id_;
 
-    std::unordered_map<std::string, uint64_t>& ref_counters =
+    const std::vector<uint64_t>& ref_counters =
         epoch ? epoch_counters_ : counters_;
-    for (const auto& it : ref_counters) {
-        print_pairs_.emplace_back(it.first, std::to_string(it.second));
-        j_data_[it.first] = it.second;
+    for (const auto& it : counter_idx_) {
+        uint64_t value = ref_counters[it.second];
+        print_pairs_.emplace_back(it.first, std::to_string(value));
+        j_data_[it.first] = value;
     }
-    j_data_["epoch_num"] = counters_["epoch_num"];
+    j_data_["epoch_num"] = counters_[epoch_num_.idx];
 
-    VecStat& ref_vcounter = epoch ? epoch_vec_counters_ : vec_counters_;
-    for (const auto& it : ref_vcounter) {
+    const std::vector<uint64_t>& ref_vcounter =
+        epoch ? epoch_vec_counters_ : vec_counters_;
+    for (const auto& it : vec_counter_idx_) {
         Json j_list;
-        for (size_t i = 0; i < it.second.size(); i++) {
+        int offset = it.second.first;
+        for (int i = 0; i < it.second.second; i++) {
             std::string name = it.first + "." + std::to_string(i);
-            print_pairs_.emplace_back(name, std::to_string(it.second[i]));
-            j_list[std::to_string(i)] = it.second[i];
+            uint64_t value = ref_vcounter[offset + i];
+            print_pairs_.emplace_back(name, std::to_string(value));
+            j_list[std::to_string(i)] = value;
         }
         j_data_[it.first] = j_list;
     }
-    VecStat& ref_hbins = epoch ? epoch_histo_bins_ : histo_bins_;
-    for (const auto& it : ref_hbins) {
-        const auto& names = histo_headers_[it.first];
-        for (size_t i = 0; i < it.second.size(); i++) {
-            print_pairs_.emplace_back(names[i], std::to_string(it.second[i]));
-            j_data_[names[i]] = it.second[i];
+    for (const auto& it : histo_idx_) {
+        const auto& histo = histos_[it.second];
+        const auto& names = histo.headers;
+        const auto& bins = epoch ? histo.epoch_bins : histo.bins;
+        for (size_t i = 0; i < bins.size(); i++) {
+            print_pairs_.emplace_back(names[i], std::to_string(bins[i]));
+            j_data_[names[i]] = bins[i];
         }
     }
 
@@ -331,12 +557,16 @@ void SimpleStats::UpdatePrints(bool epoch) {
     // huge therefore we only put aggregated histo in each epoch but
     // complete data at the end
     if (!epoch) {
-        for (const auto& name_hist : histo_counts_) {
+        for (const auto& it : histo_idx_) {
+            // bucket counts by the smallest value of the bucket
             Json j_list;
-            for (const auto& it : name_hist.second) {
-                j_list[std::to_string(it.first)] = it.second;
+            const auto& counts = histos_[it.second].counts;
+            for (int b = 0; b < kHistoBuckets; b++) {
+                if (counts[b] > 0) {
+                    j_list[std::to_string(HistoBucketLow(b))] = counts[b];
+                }
             }
-            j_data_[name_hist.first] = j_list;
+            j_data_[it.first] = j_list;
         }
     }
 
@@ -360,120 +590,203 @@ void SimpleStats::UpdatePrints(bool epoch) {
     }
 }
 
-void SimpleStats::UpdateEpochStats() {
-    // push counter values as is
-    UpdateCounters();
+void SimpleStats::UpdateComputedStats(bool epoch) {
+    const std::vector<uint64_t>& counters = epoch ? epoch_counters_ : counters_;
+    const std::vector<uint64_t>& vec_counters =
+        epoch ? epoch_vec_counters_ : vec_counters_;
 
     // update computed stats
     doubles_["act_energy"] =
-        epoch_counters_["num_act_cmds"] * config_.act_energy_inc;
+        counters[num_act_cmds_.idx] * config_.act_energy_inc;
     doubles_["read_energy"] =
-        epoch_counters_["num_read_cmds"] * config_.read_energy_inc;
+        counters[num_read_cmds_.idx] * config_.read_energy_inc;
     doubles_["write_energy"] =
-        epoch_counters_["num_write_cmds"] * config_.write_energy_inc;
+        counters[num_write_cmds_.idx] * config_.write_energy_inc;
     doubles_["ref_energy"] =
-        epoch_counters_["num_ref_cmds"] * config_.ref_energy_inc;
+        counters[num_ref_cmds_.idx] * config_.ref_energy_inc;
     doubles_["refb_energy"] =
-        epoch_counters_["num_refb_cmds"] * config_.refb_energy_inc;
+        counters[num_refb_cmds_.idx] * config_.refb_energy_inc;
+    doubles_["refsb_energy"] =
+        counters[num_refsb_cmds_.idx] * config_.refsb_energy_inc;
+    doubles_["rfm_energy"] =
+        counters[num_rfm_cmds_.idx] * config_.rfm_energy_inc;
 
     // vector doubles, update first, then push
     double background_energy = 0.0;
     for (int i = 0; i < config_.ranks; i++) {
-        double act_stb = epoch_vec_counters_["rank_active_cycles"][i] *
+        double act_stb = vec_counters[rank_active_cycles_.offset + i] *
                          config_.act_stb_energy_inc;
-        double pre_stb = epoch_vec_counters_["all_bank_idle_cycles"][i] *
+        double pre_stb = vec_counters[all_bank_idle_cycles_.offset + i] *
                          config_.pre_stb_energy_inc;
         double sref_energy =
-            epoch_vec_counters_["sref_cycles"][i] * config_.sref_energy_inc;
+            vec_counters[sref_cycles_.offset + i] * config_.sref_energy_inc;
         vec_doubles_["act_stb_energy"][i] = act_stb;
         vec_doubles_["pre_stb_energy"][i] = pre_stb;
+        double act_pd = vec_counters[act_pd_cycles_.offset + i] *
+                        config_.act_pd_energy_inc;
+        double pre_pd = vec_counters[pre_pd_cycles_.offset + i] *
+                        config_.pre_pd_energy_inc;
         vec_doubles_["sref_energy"][i] = sref_energy;
-        background_energy += act_stb + pre_stb + sref_energy;
+        vec_doubles_["act_pd_energy"][i] = act_pd;
+        vec_doubles_["pre_pd_energy"][i] = pre_pd;
+        background_energy += act_stb + pre_stb + sref_energy + act_pd + pre_pd;
     }
 
+    // epoch histogram counts are still there for the averages
     UpdateHistoBins();
 
     // calculated stats
     uint64_t total_reqs =
-        epoch_counters_["num_reads_done"] + epoch_counters_["num_writes_done"];
-    double total_time = epoch_counters_["num_cycles"] * config_.tCK;
+        counters[num_reads_done_.idx] + counters[num_writes_done_.idx];
+    double total_time = counters[num_cycles_.idx] * config_.tCK;
     double avg_bw = total_reqs * config_.request_size_bytes / total_time;
     calculated_["average_bandwidth"] = avg_bw;
+    calculated_["bandwidth_per_pin"] = avg_bw * 8 / config_.bus_width;
 
     double total_energy = doubles_["act_energy"] + doubles_["read_energy"] +
                           doubles_["write_energy"] + doubles_["ref_energy"] +
-                          doubles_["refb_energy"] + background_energy;
+                          doubles_["refb_energy"] + doubles_["refsb_energy"] +
+                          doubles_["rfm_energy"] + background_energy;
     calculated_["total_energy"] = total_energy;
-    calculated_["average_power"] = total_energy / epoch_counters_["num_cycles"];
+    calculated_["average_power"] = total_energy / counters[num_cycles_.idx];
+    double total_bits = total_reqs * config_.request_size_bytes * 8.0;
+    calculated_["energy_per_bit"] =
+        total_bits > 0 ? total_energy / total_bits : 0.0;
     calculated_["average_read_latency"] =
-        GetHistoAvg(epoch_histo_counts_.at("read_latency"));
+        GetHistoAvg(histos_[read_latency_.idx], epoch);
     calculated_["average_interarrival"] =
-        GetHistoAvg(epoch_histo_counts_.at("interarrival_latency"));
+        GetHistoAvg(histos_[interarrival_latency_.idx], epoch);
+    std::vector<double> fractions;
+    for (const auto& pct : kPercentiles) {
+        fractions.push_back(pct.fraction);
+    }
+    auto read_pcts =
+        GetHistoPercentiles(histos_[read_latency_.idx], epoch, fractions);
+    auto write_pcts =
+        GetHistoPercentiles(histos_[write_latency_.idx], epoch, fractions);
+    for (size_t i = 0; i < fractions.size(); i++) {
+        std::string name(kPercentiles[i].name);
+        calculated_[name + "_read_latency"] = read_pcts[i];
+        calculated_[name + "_write_latency"] = write_pcts[i];
+    }
+    // alternating as long as there are both takes two turnarounds per pair
+    uint64_t alternating = 2 * std::min(counters[num_read_cmds_.idx],
+                                        counters[num_write_cmds_.idx]);
+    uint64_t turnarounds =
+        counters[num_rw_turnarounds_.idx] + counters[num_wr_turnarounds_.idx];
+    calculated_["turnarounds_avoided"] =
+        static_cast<double>(alternating) - static_cast<double>(turnarounds);
+    uint64_t bursts =
+        counters[num_read_cmds_.idx] + counters[num_write_cmds_.idx];
+    calculated_["data_bus_utilization"] =
+        counters[num_cycles_.idx] > 0
+            ? static_cast<double>(bursts) * config_.burst_cycle /
+                  counters[num_cycles_.idx]
+            : 0.0;
+
+    if (config_.rowhammer_mitigation != "NONE") {
+        double bank_cycles = static_cast<double>(counters[num_cycles_.idx]) *
+                             config_.ranks * config_.banks;
+        calculated_["rfm_bw_loss"] =
+            bank_cycles > 0
+                ? counters[num_rfm_cmds_.idx] * config_.tRFM / bank_cycles
+                : 0.0;
+    }
+
+    if (config_.prefetcher != "NONE") {
+        double prefetches = counters[num_prefetches_.idx];
+        double hits = counters[num_prefetch_hits_.idx];
+        double demands = hits + counters[num_prefetch_misses_.idx];
+        // epochs may use lines prefetched in earlier ones
+        double unused = std::max(prefetches - hits, 0.0);
+        double demand_cmds = counters[num_read_cmds_.idx] - prefetches;
+        calculated_["prefetch_accuracy"] =
+            prefetches > 0 ? std::min(hits / prefetches, 1.0) : 0.0;
+        calculated_["prefetch_coverage"] = demands > 0 ? hits / demands : 0.0;
+        calculated_["prefetch_bw_overhead"] =
+            demand_cmds > 0 ? unused / demand_cmds : 0.0;
+    }
+
+    for (int i = 0; i < config_.qos_sources; i++) {
+        uint64_t source_reqs = vec_counters[source_reads_done_.offset + i] +
+                               vec_counters[source_writes_done_.offset + i];
+        vec_doubles_["source_bandwidth"][i] =
+            source_reqs * config_.request_size_bytes / total_time;
+        const auto& histo = histos_[source_read_latency_[i].idx];
+        vec_doubles_["source_average_read_latency"][i] =
+            GetHistoAvg(histo, epoch);
+        vec_doubles_["source_p99_read_latency"][i] =
+            GetHistoPercentiles(histo, epoch, {0.99})[0];
+    }
+}
 
+void SimpleStats::UpdateEpochStats() {
+    // push counter values as is
+    UpdateCounters();
+    UpdateComputedStats(true);
     UpdatePrints(true);
-    for (auto& it : epoch_counters_) {
-        it.second = 0;
-    }
-    for (auto& vec : epoch_vec_counters_) {
-        std::fill(vec.second.begin(), vec.second.end(), 0);
-    }
-    for (auto& it : epoch_histo_counts_) {
-        it.second.clear();
+    std::fill(epoch_counters_.begin(), epoch_counters_.end(), 0);
+    std::fill(epoch_vec_counters_.begin(), epoch_vec_counters_.end(), 0);
+    for (auto& histo : histos_) {
+        std::fill(histo.epoch_counts.begin(), histo.epoch_counts.end(), 0);
+        histo.epoch_sum = 0;
     }
     return;
 }
 
 void SimpleStats::UpdateFinalStats() {
     UpdateCounters();
+    UpdateComputedStats(false);
+    UpdatePrints(false);
+    return;
+}
 
-    // update computed stats
-    doubles_["act_energy"] = counters_["num_act_cmds"] * config_.act_energy_inc;
-    doubles_["read_energy"] =
-        counters_["num_read_cmds"] * config_.read_energy_inc;
-    doubles_["write_energy"] =
-        counters_["num_write_cmds"] * config_.write_energy_inc;
-    doubles_["ref_energy"] = counters_["num_ref_cmds"] * config_.ref_energy_inc;
-    doubles_["refb_energy"] =
-        counters_["num_refb_cmds"] * config_.refb_energy_inc;
-
-    // vector doubles, update first, then push
-    double background_energy = 0.0;
-    for (int i = 0; i < config_.ranks; i++) {
-        double act_stb =
-            vec_counters_["rank_active_cycles"][i] * config_.act_stb_energy_inc;
-        double pre_stb = vec_counters_["all_bank_idle_cycles"][i] *
-                         config_.pre_stb_energy_inc;
-        double sref_energy =
-            vec_counters_["sref_cycles"][i] * config_.sref_energy_inc;
-        vec_doubles_["act_stb_energy"][i] = act_stb;
-        vec_doubles_["pre_stb_energy"][i] = pre_stb;
-        vec_doubles_["sref_energy"][i] = sref_energy;
-        background_energy += act_stb + pre_stb + sref_energy;
+void SimpleStats::Save(CheckpointWriter& writer) const {
+    writer.Section("stats");
+    writer.Put(counters_);
+    writer.Put(epoch_counters_);
+    writer.Put(vec_counters_);
+    writer.Put(epoch_vec_counters_);
+    writer.Put(doubles_);
+    writer.Put(vec_doubles_);
+    writer.Put(calculated_);
+    writer.Put(static_cast<uint64_t>(histos_.size()));
+    for (const auto& histo : histos_) {
+        writer.Put(histo.epoch_counts);
+        writer.Put(histo.counts);
+        writer.Put(histo.epoch_sum);
+        writer.Put(histo.sum);
+        writer.Put(histo.bins);
+        writer.Put(histo.epoch_bins);
     }
+    return;
+}
 
-    // histograms
-    UpdateHistoBins();
-
-    // calculated stats
-    uint64_t total_reqs =
-        counters_["num_reads_done"] + counters_["num_writes_done"];
-    double total_time = counters_["num_cycles"] * config_.tCK;
-    double avg_bw = total_reqs * config_.request_size_bytes / total_time;
-    calculated_["average_bandwidth"] = avg_bw;
-
-    double total_energy = doubles_["act_energy"] + doubles_["read_energy"] +
-                          doubles_["write_energy"] + doubles_["ref_energy"] +
-                          doubles_["refb_energy"] + background_energy;
-    calculated_["total_energy"] = total_energy;
-    calculated_["average_power"] = total_energy / counters_["num_cycles"];
-    // calculated_["average_read_latency"] = GetHistoAvg("read_latency");
-    calculated_["average_read_latency"] =
-        GetHistoAvg(histo_counts_.at("read_latency"));
-    calculated_["average_interarrival"] =
-        GetHistoAvg(histo_counts_.at("interarrival_latency"));
-
-    UpdatePrints(false);
+void SimpleStats::Restore(CheckpointReader& reader) {
+    reader.Section("stats");
+    reader.Get(counters_);
+    reader.Get(epoch_counters_);
+    reader.Get(vec_counters_);
+    reader.Get(epoch_vec_counters_);
+    reader.Get(doubles_);
+    reader.Get(vec_doubles_);
+    reader.Get(calculated_);
+    uint64_t num_histos;
+    reader.Get(num_histos);
+    if (num_histos != histos_.size()) {
+        std::cerr << "Checkpoint has " << num_histos << " histograms, "
+                  << histos_.size() << " expected" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    for (auto& histo : histos_) {
+        reader.Get(histo.epoch_counts);
+        reader.Get(histo.counts);
+        reader.Get(histo.epoch_sum);
+        reader.Get(histo.sum);
+        reader.Get(histo.bins);
+        reader.Get(histo.epoch_bins);
+    }
     return;
 }
 
-}  // namespace dramsim3
\ No newline at end of file
+}  // namespace dramsim3
@@ -6,75 +6,165 @@
 #include <unordered_map>
 #include <vector>
 
+#include "checkpoint.h"
 #include "configuration.h"
+#include "epoch_writer.h"
 #include "json.hpp"
 
 namespace dramsim3 {
 
+// Handles to registered stats, the hot path updates index contiguous arrays
+// with them instead of hashing stat names
+struct CounterId {
+    int idx;
+};
+
+struct VecCounterId {
+    int offset;
+};
+
+struct HistoId {
+    int idx;
+};
+
 class SimpleStats {
    public:
-    SimpleStats(const Config& config, int channel_id);
+    SimpleStats(const Config& config, const OutputFiles& output_files,
+                int channel_id);
+
+    // name lookups of registered stats, exits on unknown names
+    CounterId GetCounterId(const std::string& name) const;
+    VecCounterId GetVecCounterId(const std::string& name) const;
+    HistoId GetHistoId(const std::string& name) const;
+
     // incrementing counter
-    void Increment(const std::string name) { epoch_counters_[name] += 1; }
+    void Increment(CounterId id) { epoch_counters_[id.idx] += 1; }
+
+    // increment counter by number
+    void IncrementBy(CounterId id, uint64_t num) {
+        epoch_counters_[id.idx] += num;
+    }
 
     // incrementing for vec counter
-    void IncrementVec(const std::string name, int pos) {
-        epoch_vec_counters_[name][pos] += 1;
+    void IncrementVec(VecCounterId id, int pos) {
+        epoch_vec_counters_[id.offset + pos] += 1;
     }
 
     // increment vec counter by number
-    void IncrementVecBy(const std::string name, int pos, int num) {
-        epoch_vec_counters_[name][pos] += num;
+    void IncrementVecBy(VecCounterId id, int pos, uint64_t num) {
+        epoch_vec_counters_[id.offset + pos] += num;
     }
 
     // add historgram value
-    void AddValue(const std::string name, const int value);
+    void AddValue(HistoId id, const int value) {
+        auto& histo = histos_[id.idx];
+        histo.epoch_counts[HistoBucket(value)] += 1;
+        histo.epoch_sum += value;
+    }
 
     // return per rank background energy
     double RankBackgroundEnergy(const int r) const;
 
-    // Epoch update
-    void PrintEpochStats();
+    // Epoch update, the JSON record goes to epoch_writer if there is one
+    void PrintEpochStats(EpochWriter* epoch_writer);
 
     // Final statas output
     void PrintFinalStats();
 
+    // the stats of the last epoch or final print, as they are written to
+    // the JSON stats
+    const nlohmann::json& Values() const { return j_data_; }
+
     // Reset (usually after one phase of simulation)
     void Reset();
 
+    // stat values to/from a checkpoint, the registered stats have to match
+    void Save(CheckpointWriter& writer) const;
+    void Restore(CheckpointReader& reader);
+
+    // Histogram values are counted in log-linear (HDR style) buckets: values
+    // below 2 * kHistoSubBuckets have a bucket each, above that every power
+    // of two is split into kHistoSubBuckets buckets, so a bucket is within
+    // 1/kHistoSubBuckets of its values for the whole int range
+    static constexpr int kHistoSubBits = 7;
+    static constexpr int kHistoSubBuckets = 1 << kHistoSubBits;
+    static constexpr int kHistoBuckets =
+        kHistoSubBuckets * (32 - kHistoSubBits);
+
+    static int HistoBucket(int value) {
+        if (value < 2 * kHistoSubBuckets) {
+            return value < 0 ? 0 : value;
+        }
+        int shift = 31 - __builtin_clz(value) - kHistoSubBits;
+        return kHistoSubBuckets * shift + (value >> shift);
+    }
+    // smallest and largest value of a bucket
+    static int HistoBucketLow(int bucket);
+    static int HistoBucketHigh(int bucket);
+    // smallest value at or above each of the given fractions (in increasing
+    // order) of the bucket counts, as the largest value of its bucket
+    static std::vector<int> HistoPercentiles(
+        const std::vector<uint64_t>& counts,
+        const std::vector<double>& fractions);
+
    private:
-    using VecStat = std::unordered_map<std::string, std::vector<uint64_t> >;
-    using HistoCount = std::unordered_map<int, uint64_t>;
     using Json = nlohmann::json;
-    void InitStat(std::string name, std::string stat_type,
-                  std::string description);
-    void InitVecStat(std::string name, std::string stat_type,
-                     std::string description, std::string part_name,
-                     int vec_len);
-    void InitHistoStat(std::string name, std::string description, int start_val,
-                       int end_val, int num_bins);
+
+    struct Histogram {
+        int start_val;
+        int end_val;
+        int bin_width;
+        std::vector<std::string> headers;
+        // bucket counts and value sums, of the epoch and up to the last epoch
+        std::vector<uint64_t> epoch_counts;
+        std::vector<uint64_t> counts;
+        int64_t epoch_sum;
+        int64_t sum;
+        // the printed histogram, fixed width bins from start_val to end_val
+        std::vector<uint64_t> bins;
+        std::vector<uint64_t> epoch_bins;
+    };
+
+    CounterId InitStat(std::string name, std::string stat_type,
+                       std::string description);
+    VecCounterId InitVecStat(std::string name, std::string stat_type,
+                             std::string description, std::string part_name,
+                             int vec_len);
+    HistoId InitHistoStat(std::string name, std::string description,
+                          int start_val, int end_val, int num_bins);
 
     void UpdateCounters();
     void UpdateHistoBins();
     void UpdatePrints(bool epoch);
-    double GetHistoAvg(const HistoCount& histo_counts) const;
+    double GetHistoAvg(const Histogram& histo, bool epoch) const;
+    std::vector<int> GetHistoPercentiles(
+        const Histogram& histo, bool epoch,
+        const std::vector<double>& fractions) const {
+        return HistoPercentiles(epoch ? histo.epoch_counts : histo.counts,
+                                fractions);
+    }
     std::string GetTextHeader(bool is_final) const;
     void UpdateEpochStats();
     void UpdateFinalStats();
+    void UpdateComputedStats(bool epoch);
 
     const Config& config_;
+    OutputFiles output_files_;
     int channel_id_;
 
     // map names to descriptions
     std::unordered_map<std::string, std::string> header_descs_;
 
-    // counter stats, indexed by their name
-    std::unordered_map<std::string, uint64_t> counters_;
-    std::unordered_map<std::string, uint64_t> epoch_counters_;
+    // counter stats, names map to indices into the counter arrays
+    std::unordered_map<std::string, int> counter_idx_;
+    std::vector<uint64_t> counters_;
+    std::vector<uint64_t> epoch_counters_;
 
-    // vectored counter stats, first indexed by name then by index
-    VecStat vec_counters_;
-    VecStat epoch_vec_counters_;
+    // vectored counter stats are stored back to back, names map to the
+    // offset and length of their elements
+    std::unordered_map<std::string, std::pair<int, int> > vec_counter_idx_;
+    std::vector<uint64_t> vec_counters_;
+    std::vector<uint64_t> epoch_vec_counters_;
 
     // NOTE: doubles_ vec_doubles_ and calculated_ are basically one time
     // placeholders after each epoch they store the value for that epoch
@@ -87,14 +177,39 @@ class SimpleStats {
     std::unordered_map<std::string, double> calculated_;
 
     // histogram stats
-    std::unordered_map<std::string, std::vector<std::string> > histo_headers_;
-
-    std::unordered_map<std::string, std::pair<int, int> > histo_bounds_;
-    std::unordered_map<std::string, int> bin_widths_;
-    std::unordered_map<std::string, HistoCount> histo_counts_;
-    std::unordered_map<std::string, HistoCount> epoch_histo_counts_;
-    VecStat histo_bins_;
-    VecStat epoch_histo_bins_;
+    std::unordered_map<std::string, int> histo_idx_;
+    std::vector<Histogram> histos_;
+
+    // stats used to calculate energy and bandwidth
+    CounterId num_cycles_;
+    CounterId epoch_num_;
+    CounterId num_reads_done_;
+    CounterId num_writes_done_;
+    CounterId num_read_cmds_;
+    CounterId num_write_cmds_;
+    CounterId num_act_cmds_;
+    CounterId num_ref_cmds_;
+    CounterId num_refb_cmds_;
+    CounterId num_refsb_cmds_;
+    CounterId num_rfm_cmds_;
+    CounterId num_rw_turnarounds_;
+    CounterId num_wr_turnarounds_;
+    // only with a prefetcher
+    CounterId num_prefetches_;
+    CounterId num_prefetch_hits_;
+    CounterId num_prefetch_misses_;
+    VecCounterId all_bank_idle_cycles_;
+    VecCounterId rank_active_cycles_;
+    VecCounterId sref_cycles_;
+    VecCounterId act_pd_cycles_;
+    VecCounterId pre_pd_cycles_;
+    HistoId read_latency_;
+    HistoId write_latency_;
+    HistoId interarrival_latency_;
+    // per source stats, only with qos_sources
+    VecCounterId source_reads_done_;
+    VecCounterId source_writes_done_;
+    std::vector<HistoId> source_read_latency_;
 
     // outputs
     Json j_data_;
@@ -0,0 +1,132 @@
+#include "sweep.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include "cpu.h"
+#include "worker_pool.h"
+
+namespace dramsim3 {
+
+void SweepReader::Set(const std::string& section, const std::string& name,
+                      const std::string& value) {
+    _values[MakeKey(section, name)] = value;
+    _sections.insert(section);
+    return;
+}
+
+Sweep::Sweep(const std::string& config_file, const std::string& output_dir,
+             const std::vector<std::string>& params)
+    : base_(config_file), output_dir_(output_dir), num_variants_(1) {
+    if (base_.ParseError() < 0) {
+        std::cerr << "Can't load config file - " << config_file << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    output_prefix_ = base_.Get("other", "output_prefix", "dramsim3");
+    for (const auto& param : params) {
+        size_t eq = param.find('=');
+        size_t dot = param.find('.');
+        if (eq == std::string::npos || dot == std::string::npos || dot > eq) {
+            std::cerr << "Sweep parameter " << param
+                      << " is not section.key=v1,v2,..." << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        Param p;
+        p.section = param.substr(0, dot);
+        p.name = param.substr(dot + 1, eq - dot - 1);
+        p.values = StringSplit(param.substr(eq + 1), ',');
+        if (p.values.empty()) {
+            std::cerr << "Sweep parameter " << param << " has no values"
+                      << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        num_variants_ *= p.values.size();
+        params_.push_back(p);
+    }
+}
+
+std::vector<size_t> Sweep::ValueIndices(size_t variant) const {
+    std::vector<size_t> indices(params_.size());
+    for (size_t i = params_.size(); i-- > 0;) {
+        indices[i] = variant % params_[i].values.size();
+        variant /= params_[i].values.size();
+    }
+    return indices;
+}
+
+Config* Sweep::MakeConfig(size_t variant) const {
+    SweepReader reader(base_);
+    auto indices = ValueIndices(variant);
+    for (size_t i = 0; i < params_.size(); i++) {
+        reader.Set(params_[i].section, params_[i].name,
+                   params_[i].values[indices[i]]);
+    }
+    reader.Set("other", "output_prefix",
+               output_prefix_ + "_" + std::to_string(variant));
+    return new Config(reader, output_dir_);
+}
+
+void Sweep::WriteIndex() const {
+    std::ofstream index(output_dir_ + "/" + output_prefix_ + "_sweep.csv");
+    index << "variant";
+    for (const auto& param : params_) {
+        index << "," << param.section << "." << param.name;
+    }
+    index << std::endl;
+    for (size_t v = 0; v < num_variants_; v++) {
+        index << v;
+        auto indices = ValueIndices(v);
+        for (size_t i = 0; i < params_.size(); i++) {
+            index << "," << params_[i].values[indices[i]];
+        }
+        index << std::endl;
+    }
+    return;
+}
+
+void Sweep::Run(uint64_t cycles, const std::string& trace_file,
+                const std::string& stream_type, int num_threads) const {
+    WriteIndex();
+    std::vector<Transaction> trace;
+    if (!trace_file.empty()) {
+        trace = DecodeTrace(trace_file);
+    }
+    if (num_threads <= 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    num_threads = static_cast<int>(
+        std::min(static_cast<size_t>(num_threads), num_variants_));
+
+    std::atomic<size_t> next_variant(0);
+    std::mutex print_mutex;
+    WorkerPool workers(num_threads);
+    workers.Run([&](int) {
+        size_t v;
+        while ((v = next_variant.fetch_add(1)) < num_variants_) {
+            Config* config = MakeConfig(v);
+            CPU* cpu;
+            if (!trace_file.empty()) {
+                cpu = new TraceBasedCPU(config, output_dir_,
+                                        new VectorTraceReader(trace));
+            } else if (stream_type == "stream" || stream_type == "s") {
+                cpu = new StreamCPU(config, output_dir_);
+            } else {
+                cpu = new RandomCPU(config, output_dir_);
+            }
+            for (uint64_t clk = 0; clk < cycles; clk++) {
+                cpu->ClockTick();
+            }
+            cpu->PrintStats();
+            delete cpu;
+            std::lock_guard<std::mutex> lock(print_mutex);
+            std::cout << "Variant " << v + 1 << "/" << num_variants_
+                      << " done" << std::endl;
+        }
+    });
+    return;
+}
+
+}  // namespace dramsim3
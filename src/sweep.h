@@ -0,0 +1,59 @@
+#ifndef __SWEEP_H
+#define __SWEEP_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "configuration.h"
+
+namespace dramsim3 {
+
+// INIReader that values can be set on after parsing
+class SweepReader : public INIReader {
+   public:
+    SweepReader(const std::string& file_name) : INIReader(file_name) {}
+    void Set(const std::string& section, const std::string& name,
+             const std::string& value);
+};
+
+// A grid of overrides of a base config, given as "section.key=v1,v2,..."
+// per parameter. Every combination of the values is a variant with a
+// MemorySystem of its own writing stats to <output_prefix>_<variant>, the
+// variants run in parallel on a shared copy of the parsed base config and,
+// for trace runs, of the decoded trace. <output_prefix>_sweep.csv lists the
+// parameter values of each variant.
+class Sweep {
+   public:
+    Sweep(const std::string& config_file, const std::string& output_dir,
+          const std::vector<std::string>& params);
+    size_t NumVariants() const { return num_variants_; }
+    // config of a variant with its overrides and output prefix applied
+    Config* MakeConfig(size_t variant) const;
+    // runs every variant for cycles cycles on num_threads threads
+    // (0: one per hardware thread), with the trace or stream_type as in
+    // dramsim3main
+    void Run(uint64_t cycles, const std::string& trace_file,
+             const std::string& stream_type, int num_threads) const;
+
+   private:
+    struct Param {
+        std::string section;
+        std::string name;
+        std::vector<std::string> values;
+    };
+
+    SweepReader base_;
+    std::string output_dir_;
+    std::string output_prefix_;
+    std::vector<Param> params_;
+    size_t num_variants_;
+
+    // index of the value of each param in a variant, the last param changes
+    // fastest
+    std::vector<size_t> ValueIndices(size_t variant) const;
+    void WriteIndex() const;
+};
+
+}  // namespace dramsim3
+#endif
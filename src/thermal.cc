@@ -1,15 +1,21 @@
 #include "thermal.h"
 
-extern "C" double *steady_thermal_solver(double ***powerM, double W, double Lc,
-                                         int numP, int dimX, int dimZ,
-                                         double **Midx, int count,
-                                         double Tamb_);
-extern "C" double *transient_thermal_solver(double ***powerM, double W,
-                                            double L, int numP, int dimX,
-                                            int dimZ, double **Midx,
-                                            int MidxSize, double *Cap,
-                                            int CapSize, double time, int iter,
-                                            double *T_trans, double Tamb_);
+#ifdef _OPENMP
+#include <omp.h>
+#endif  // _OPENMP
+
+extern "C" double *steady_thermal_solver(const double *powerM, double W,
+                                         double Lc, int numP, int dimX,
+                                         int dimZ, double **Midx, int count,
+                                         double Tamb_, int max_procs);
+extern "C" TransientSolver *create_transient_solver(
+    double W, double Lc, int numP, int dimX, int dimZ, double **Midx,
+    int MidxSize, double *Cap, double time, int iter, double Tamb_);
+extern "C" int transient_solver_work_size(const TransientSolver *solver);
+extern "C" void transient_thermal_solver(const TransientSolver *solver,
+                                         const double *powerM, double *T_trans,
+                                         double *work);
+extern "C" void free_transient_solver(TransientSolver *solver);
 extern "C" double **calculate_Midx_array(double W, double Lc, int numP,
                                          int dimX, int dimZ, int *MidxSize,
                                          double Tamb_);
@@ -20,10 +26,10 @@ extern "C" double *initialize_Temperature(double W, double Lc, int numP,
 
 namespace dramsim3 {
 
-std::function<Address(const Address &addr)> GetPhyAddress;
-
-ThermalCalculator::ThermalCalculator(const Config &config)
+ThermalCalculator::ThermalCalculator(const Config &config,
+                                     const OutputFiles &output_files)
     : config_(config),
+      output_files_(output_files),
       time_iter0(10),
       sample_id(0),
       background_energy_(config_.channels,
@@ -70,6 +76,14 @@ ThermalCalculator::ThermalCalculator(const Config &config)
 
     Tamb = config_.amb_temp + T0;
 
+    // cases are independent thermal problems
+    case_threads_ = 1;
+#ifdef _OPENMP
+    case_threads_ = config_.case_threads > 0 ? config_.case_threads
+                                             : omp_get_max_threads();
+#endif  // _OPENMP
+    case_threads_ = std::max(1, std::min(case_threads_, num_case));
+
     std::cout << "bank aspect ratio = " << config_.bank_asr << std::endl;
     // std::cout << "#rows = " << config_.rows << "; #columns = " <<
     // config_.rows / config_.bank_asr << std::endl;
@@ -90,6 +104,10 @@ ThermalCalculator::ThermalCalculator(const Config &config)
         num_case, std::vector<double>(numP * dimX * dimY, 0));
     cur_Pmap = std::vector<std::vector<double>>(
         num_case, std::vector<double>(numP * dimX * dimY, 0));
+    accu_uniform_P = std::vector<std::vector<double>>(
+        num_case, std::vector<double>(numP, 0));
+    cur_uniform_P = std::vector<std::vector<double>>(
+        num_case, std::vector<double>(numP, 0));
     T_size = (numP * 3 + 1) * (dimX + num_dummy) * (dimY + num_dummy);
     T_trans = new double *[num_case];
     T_final = new double *[num_case];
@@ -104,37 +122,39 @@ ThermalCalculator::ThermalCalculator(const Config &config)
 
     if (config_.output_level >= 0) {
         // Initialize the output file
-        final_temperature_file_csv_.open(config_.output_prefix +
+        final_temperature_file_csv_.open(output_files_.prefix +
                                          "final_temp.csv");
         PrintCSVHeader_final(final_temperature_file_csv_);
 
         // print bank position
-        bank_position_csv_.open(config_.output_prefix + "bank_pos.csv");
+        bank_position_csv_.open(output_files_.prefix + "bank_pos.csv");
         PrintCSV_bank(bank_position_csv_);
 
         // a quick preview of max temperature for each layer of each epoch
-        epoch_max_temp_file_csv_.open(config_.output_prefix +
+        epoch_max_temp_file_csv_.open(output_files_.prefix +
                                       "epoch_max_temp.csv");
         epoch_max_temp_file_csv_ << "layer,max_temp,epoch_time" << std::endl;
     }
 
     // print header to csv files
     if (config_.output_level >= 2) {
-        epoch_temperature_file_csv_.open(config_.output_prefix +
+        epoch_temperature_file_csv_.open(output_files_.prefix +
                                          "epoch_temp.csv");
         epoch_temperature_file_csv_
             << "rank_channel_index,x,y,z,power,temperature,epoch" << std::endl;
     }
 }
 
-ThermalCalculator::~ThermalCalculator() {}
+ThermalCalculator::~ThermalCalculator() {
+    free_transient_solver(trans_solver_);
+}
 
 void ThermalCalculator::SetPhyAddressMapping() {
     std::string mapping_string = config_.loc_mapping;
     if (mapping_string.empty()) {
         // if no location mapping specified, then do not map and use default
         // mapping...
-        GetPhyAddress = [](const Address &addr) { return Address(addr); };
+        phy_address_ = [](const Address &addr) { return Address(addr); };
         return;
     }
     std::vector<std::string> bit_fields = StringSplit(mapping_string, ',');
@@ -187,7 +207,7 @@ void ThermalCalculator::SetPhyAddressMapping() {
 
     int column_offset = LogBase2(config_.BL);
 
-    GetPhyAddress = [mapped_pos, column_offset](const Address &addr) {
+    phy_address_ = [mapped_pos, column_offset](const Address &addr) {
         uint64_t new_hex = 0;
         // ch - ra - bg - ba - ro - co
         int origin_pos[] = {addr.channel, addr.rank, addr.bankgroup,
@@ -315,37 +335,17 @@ int ThermalCalculator::MapToZ(int channel_id, int bank_id) {
     return z;
 }
 
-std::pair<std::vector<int>, std::vector<int>> ThermalCalculator::MapToXY(
-    const Command &cmd, int vault_id_x, int vault_id_y, int bank_id_x,
-    int bank_id_y) {
-    std::vector<int> x;
-    std::vector<int> y;
-
-    int row_id = cmd.Row();
-    int col_tile_id = row_id / config_.tile_row_num;
-    int grid_id_x = row_id / config_.mat_dim_x / config_.row_tile;
-
-    Address temp_addr = Address(cmd.addr);
-    for (int i = 0; i < config_.BL; i++) {
-        Address phy_loc = GetPhyAddress(temp_addr);
-        int col_id = phy_loc.column * config_.device_width;
-        int bank_x_offset = bank_x * config_.num_x_grids;
-        int bank_y_offset = bank_y * config_.num_y_grids;
-        for (int j = 0; j < config_.device_width; j++) {
-            int grid_id_y =
-                col_id / config_.mat_dim_y +
-                col_tile_id * (config_.num_y_grids / config_.row_tile);
-            int temp_x = vault_id_x * bank_x_offset +
-                         bank_id_x * config_.num_x_grids + grid_id_x;
-            x.push_back(temp_x);
-            int temp_y = vault_id_y * bank_y_offset +
-                         bank_id_y * config_.num_y_grids + grid_id_y;
-            y.push_back(temp_y);
-            col_id++;
-        }
-        temp_addr.column++;
+void ThermalCalculator::AddColumnEnergy(double *column_cells, int col_id,
+                                        int num_cols, double energy) {
+    // column_cells points to the first y grid of the bank in the x column,
+    // a run of bit columns usually falls into a single grid
+    int end_col = col_id + num_cols;
+    while (col_id < end_col) {
+        int grid_id_y = col_id / config_.mat_dim_y;
+        int run_end = std::min(end_col, (grid_id_y + 1) * config_.mat_dim_y);
+        column_cells[grid_id_y * dimX] += energy * (run_end - col_id);
+        col_id = run_end;
     }
-    return std::make_pair(x, y);
 }
 
 void ThermalCalculator::LocationMappingANDaddEnergy(const int channel,
@@ -361,21 +361,34 @@ void ThermalCalculator::LocationMappingANDaddEnergy(const int channel,
     int bank_id_x, bank_id_y;
     std::tie(bank_id_x, bank_id_y) = MapToBank(cmd.Bankgroup(), cmd.Bank());
 
-    // calculate x y z
-    auto xy = MapToXY(cmd, vault_id_x, vault_id_y, bank_id_x, bank_id_y);
-    auto &x = xy.first;
-    auto &y = xy.second;
+    // calculate x y z, the whole burst is in the same row so x is fixed
+    int row_id = cmd.Row();
+    int col_tile_id = row_id / config_.tile_row_num;
+    int grid_id_x = row_id / config_.mat_dim_x / config_.row_tile;
+    int x = vault_id_x * (bank_x * config_.num_x_grids) +
+            bank_id_x * config_.num_x_grids + grid_id_x;
+    int y = vault_id_y * (bank_y * config_.num_y_grids) +
+            bank_id_y * config_.num_y_grids +
+            col_tile_id * (config_.num_y_grids / config_.row_tile);
     int z = MapToZ(channel, cmd.Bank());
 
-    int z_offset = z * dimX * dimY;
+    double *column_cells =
+        &cur_Pmap[caseID_][z * dimX * dimY + y * dimX + x];
     double energy = add_energy / config_.device_width;
-    // add energy to engergy map
-    // iterate x y (they have same size)
-    for (size_t i = 0; i < x.size(); i++) {
-        int y_offset = y[i] * dimX;
-        int idx = z_offset + y_offset + x[i];
-        accu_Pmap[caseID_][idx] += energy;
-        cur_Pmap[caseID_][idx] += energy;
+    // add energy of each bit of the burst to energy map
+    if (config_.loc_mapping.empty()) {
+        int col_id = cmd.Column() * config_.device_width;
+        AddColumnEnergy(column_cells, col_id,
+                        config_.BL * config_.device_width, energy);
+    } else {
+        Address temp_addr = Address(cmd.addr);
+        for (int i = 0; i < config_.BL; i++) {
+            Address phy_loc = phy_address_(temp_addr);
+            int col_id = phy_loc.column * config_.device_width;
+            AddColumnEnergy(column_cells, col_id, config_.device_width,
+                            energy);
+            temp_addr.column++;
+        }
     }
 }
 
@@ -404,7 +417,7 @@ void ThermalCalculator::LocationMappingANDaddEnergy_RF(const int channel,
 
     int z = MapToZ(channel, bank_id);
 
-    Address phy_addr = GetPhyAddress(new_addr);  // actual row after mapping
+    Address phy_addr = phy_address_(new_addr);  // actual row after mapping
     // calculate x y z
     int row_id = phy_addr.row;
     int col_id = 0;  // refresh all units
@@ -421,7 +434,6 @@ void ThermalCalculator::LocationMappingANDaddEnergy_RF(const int channel,
     for (int i = 0; i < config_.num_y_grids; i++) {
         int y_offset = y * dimX;
         int idx = z_offset + y_offset + x;
-        accu_Pmap[caseID_][idx] += add_energy;
         cur_Pmap[caseID_][idx] += add_energy;
         y++;
     }
@@ -429,19 +441,25 @@ void ThermalCalculator::LocationMappingANDaddEnergy_RF(const int channel,
 
 void ThermalCalculator::UpdatePowerMaps(double add_energy, bool trans,
                                         uint64_t clk) {
-    auto &p_map = trans ? cur_Pmap : accu_Pmap;
+    auto &uniform_P = trans ? cur_uniform_P : accu_uniform_P;
     double period = trans ? static_cast<double>(config_.epoch_period)
                           : static_cast<double>(clk);
     for (int j = 0; j < num_case; j++) {
         // universally update power map
-        for (int i = 0; i < dimX * dimY * (numP - 1); i++) {
-            p_map[j][i] += add_energy;
+        for (int l = 0; l < numP - 1; l++) {
+            uniform_P[j][l] += add_energy;
         }
         // update logic power map
-        // UpdateLogicPower();
-        for (int i = dimX * dimY * (numP - 1); i < dimX * dimY * numP; i++) {
-            p_map[j][i] += avg_logic_power_ / dimX / dimY * period;
+        uniform_P[j][numP - 1] += avg_logic_power_ / dimX / dimY * period;
+    }
+}
+
+void ThermalCalculator::FoldEpochPower() {
+    for (int j = 0; j < num_case; j++) {
+        for (int i = 0; i < numP * dimX * dimY; i++) {
+            accu_Pmap[j][i] += cur_Pmap[j][i];
         }
+        std::fill(cur_Pmap[j].begin(), cur_Pmap[j].end(), 0.0);
     }
 }
 
@@ -489,6 +507,34 @@ void ThermalCalculator::UpdateCMDPower(const int channel, const Command &cmd,
             LocationMappingANDaddEnergy_RF(channel, cmd, ib, ir, case_id,
                                            energy / 1000.0 / device_scale);
         }
+    } else if (cmd.cmd_type == CommandType::REFRESH_MANAGEMENT) {
+        // the rows it refreshes are up to the device, spread it over the
+        // rows the next REFb of the bank covers
+        int ib = cmd.Bank();
+        int rank_idx = channel * config_.ranks + rank;
+        int row_s = refresh_count[rank_idx][ib] * config_.num_row_refresh;
+        energy = config_.rfm_energy_inc / config_.num_row_refresh /
+                 config_.num_y_grids;
+        for (int ir = row_s; ir < row_s + config_.num_row_refresh; ir++) {
+            LocationMappingANDaddEnergy_RF(channel, cmd, ib, ir, case_id,
+                                           energy / 1000.0 / device_scale);
+        }
+    } else if (cmd.cmd_type == CommandType::REFRESH_SAME_BANK) {
+        int rank_idx = channel * config_.ranks + rank;
+        energy = config_.refsb_energy_inc / config_.num_row_refresh /
+                 config_.bankgroups / config_.num_y_grids;
+        for (int g = 0; g < config_.bankgroups; g++) {
+            int ib = g * config_.banks_per_group + cmd.Bank();
+            int row_s = refresh_count[rank_idx][ib] * config_.num_row_refresh;
+            refresh_count[rank_idx][ib]++;
+            if (refresh_count[rank_idx][ib] * config_.num_row_refresh ==
+                config_.rows)
+                refresh_count[rank_idx][ib] = 0;
+            for (int ir = row_s; ir < row_s + config_.num_row_refresh; ir++) {
+                LocationMappingANDaddEnergy_RF(channel, cmd, ib, ir, case_id,
+                                               energy / 1000.0 / device_scale);
+            }
+        }
     } else {
         switch (cmd.cmd_type) {
             case CommandType::ACTIVATE:
@@ -538,8 +584,8 @@ void ThermalCalculator::UpdateEpoch(uint64_t clk) {
                 int case_id = i * config_.ranks + j;
                 double bg_energy =
                     background_energy_[i][j] / (dimX * dimY * numP);
-                for (int k = 0; k < dimX * dimY * numP; i++) {
-                    cur_Pmap[case_id][k] += bg_energy / 1000 / num_devices;
+                for (int l = 0; l < numP; l++) {
+                    cur_uniform_P[case_id][l] += bg_energy / 1000 / num_devices;
                 }
             }
         }
@@ -554,8 +600,13 @@ void ThermalCalculator::SetLogicPower(double logic_power) {
 void ThermalCalculator::PrintTransPT(uint64_t clk) {
     UpdateEpoch(clk);
     double ms = clk * config_.tCK * 1e-6;
+#pragma omp parallel for num_threads(case_threads_) schedule(dynamic)
     for (int ir = 0; ir < num_case; ir++) {
         CalcTransT(ir);
+    }
+    for (int ir = 0; ir < num_case; ir++) {
+        std::cout << "total trans power is " << case_power_[ir] * 1000
+                  << " [mW]" << std::endl;
         double maxT = 0;
         for (int layer = 0; layer < numP; layer++) {
             double maxT_layer = GetMaxTofCaseLayer(T_trans, ir, layer);
@@ -571,17 +622,20 @@ void ThermalCalculator::PrintTransPT(uint64_t clk) {
                   << " ms\n";
         // only outputs full file when output level >= 2
         if (config_.output_level >= 2) {
-            PrintCSV_trans(epoch_temperature_file_csv_, cur_Pmap, T_trans, ir,
-                           config_.epoch_period);
+            PrintCSV_trans(epoch_temperature_file_csv_, cur_Pmap,
+                           cur_uniform_P, T_trans, ir, config_.epoch_period);
         }
     }
-    for (size_t i = 0; i < cur_Pmap.size(); i++) {
-        std::fill_n(cur_Pmap[i].begin(), numP * dimX * dimY, 0.0);
+    FoldEpochPower();
+    for (size_t i = 0; i < cur_uniform_P.size(); i++) {
+        std::fill(cur_uniform_P[i].begin(), cur_uniform_P[i].end(), 0.0);
     }
     sample_id += 1;
 }
 
 void ThermalCalculator::PrintFinalPT(uint64_t clk) {
+    // commands since the last epoch
+    FoldEpochPower();
     if (config_.IsHBM() || config_.IsHMC()) {
         double bg_energy = 0;
         for (const auto &vec_rank_energy : background_energy_) {
@@ -598,20 +652,26 @@ void ThermalCalculator::PrintFinalPT(uint64_t clk) {
                 int case_id = i * config_.ranks + j;
                 double bg_energy =
                     background_energy_[i][j] / (dimX * dimY * numP);
-                for (int k = 0; k < dimX * dimY * numP; i++) {
-                    accu_Pmap[case_id][i] += bg_energy / 1000 / num_devices;
+                for (int l = 0; l < numP; l++) {
+                    accu_uniform_P[case_id][l] +=
+                        bg_energy / 1000 / num_devices;
                 }
             }
         }
     }
     // calculate the final temperature for each case
+#pragma omp parallel for num_threads(case_threads_) schedule(dynamic)
     for (int ir = 0; ir < num_case; ir++) {
         CalcFinalT(ir, clk);
+    }
+    for (int ir = 0; ir < num_case; ir++) {
+        std::cout << "total final power is " << case_power_[ir] * 1000
+                  << " [mW]" << std::endl;
         double maxT = GetMaxTofCase(T_final, ir);
         std::cout << "MaxT of case " << ir << " is " << maxT << " [C]\n";
         // print to file
-        PrintCSV_final(final_temperature_file_csv_, accu_Pmap, T_final, ir,
-                       clk);
+        PrintCSV_final(final_temperature_file_csv_, accu_Pmap, accu_uniform_P,
+                       T_final, ir, clk);
     }
 
     // close all the csv files
@@ -622,65 +682,52 @@ void ThermalCalculator::PrintFinalPT(uint64_t clk) {
     }
 }
 
+// these may run concurrently for different cases
 void ThermalCalculator::CalcTransT(int case_id) {
-    double time = config_.epoch_period * config_.tCK * 1e-9;
-    double ***powerM = InitPowerM(case_id, 0);
-    double totP = GetTotalPower(powerM);
-    std::cout << "total trans power is " << totP * 1000 << " [mW]" << std::endl;
-    T_trans[case_id] = transient_thermal_solver(
-        powerM, config_.chip_dim_x, config_.chip_dim_y, numP, dimX + num_dummy,
-        dimY + num_dummy, Midx, MidxSize, Cap, CapSize, time, time_iter,
-        T_trans[case_id], Tamb);
+    InitPowerM(case_id, 0);
+    case_power_[case_id] = GetTotalPower(case_id);
+    transient_thermal_solver(trans_solver_, powerM[case_id].data(),
+                             T_trans[case_id], trans_work_[case_id].data());
 }
 
 void ThermalCalculator::CalcFinalT(int case_id, uint64_t clk) {
-    double ***powerM = InitPowerM(case_id, clk);
-    double totP = GetTotalPower(powerM);
-    std::cout << "total final power is " << totP * 1000 << " [mW]" << std::endl;
+    InitPowerM(case_id, clk);
+    case_power_[case_id] = GetTotalPower(case_id);
+    // leave the cores to the other cases if they are solved concurrently
+    int max_procs = case_threads_ > 1 ? 1 : 0;
     double *T = steady_thermal_solver(
-        powerM, config_.chip_dim_x, config_.chip_dim_y, numP, dimX + num_dummy,
-        dimY + num_dummy, Midx, MidxSize, Tamb);
+        powerM[case_id].data(), config_.chip_dim_x, config_.chip_dim_y, numP,
+        dimX + num_dummy, dimY + num_dummy, Midx, MidxSize, Tamb, max_procs);
     T_final[case_id] = T;
 }
 
-double ***ThermalCalculator::InitPowerM(int case_id, uint64_t clk) {
-    double ***powerM;
-    // assert in powerM
-    powerM = new double **[dimX + num_dummy];
-    for (int i = 0; i < dimX + num_dummy; i++) {
-        powerM[i] = new double *[dimY + num_dummy];
-        for (int j = 0; j < dimY + num_dummy; j++) {
-            powerM[i][j] = new double[numP];
-        }
-    }
-    // initialize powerM
-    for (int i = 0; i < dimX + num_dummy; i++)
-        for (int j = 0; j < dimY + num_dummy; j++)
-            std::fill_n(powerM[i][j], numP, 0.0);
-
+void ThermalCalculator::InitPowerM(int case_id, uint64_t clk) {
+    // powerM is [layer][x][y] including the dummy cells, which stay 0
+    int dim_y = dimY + num_dummy;
+    int layer_dim = (dimX + num_dummy) * dim_y;
     // when clk is 0 then it's trans otherwise it's final
     double div = clk == 0 ? (double)config_.epoch_period : (double)clk;
     auto &power_map = clk == 0 ? cur_Pmap : accu_Pmap;
+    auto &uniform_P = clk == 0 ? cur_uniform_P : accu_uniform_P;
     // fill in powerM
     for (int i = 0; i < dimX; i++) {
         for (int j = 0; j < dimY; j++) {
             for (int l = 0; l < numP; l++) {
-                powerM[i + num_dummy / 2][j + num_dummy / 2][l] =
-                    power_map[case_id][l * (dimX * dimY) + j * dimX + i] / div;
+                powerM[case_id][l * layer_dim + (i + num_dummy / 2) * dim_y +
+                                j + num_dummy / 2] =
+                    (power_map[case_id][l * (dimX * dimY) + j * dimX + i] +
+                     uniform_P[case_id][l]) /
+                    div;
             }
         }
     }
-    return powerM;
 }
 
-double ThermalCalculator::GetTotalPower(double ***powerM) {
+double ThermalCalculator::GetTotalPower(int case_id) {
+    // dummy cells are 0
     double total_power = 0.0;
-    for (int i = 0; i < dimX; i++) {
-        for (int j = 0; j < dimY; j++) {
-            for (int l = 0; l < numP; l++) {
-                total_power += powerM[i + num_dummy / 2][j + num_dummy / 2][l];
-            }
-        }
+    for (size_t i = 0; i < powerM[case_id].size(); i++) {
+        total_power += powerM[case_id][i];
     }
     return total_power;
 }
@@ -694,6 +741,18 @@ void ThermalCalculator::InitialParameters() {
     Cap = calculate_Cap_array(config_.chip_dim_x, config_.chip_dim_y, numP,
                               dimX + num_dummy, dimY + num_dummy, &CapSize);
     calculate_time_step();
+    // the transient model only changes with the power from now on
+    trans_solver_ = create_transient_solver(
+        config_.chip_dim_x, config_.chip_dim_y, numP, dimX + num_dummy,
+        dimY + num_dummy, Midx, MidxSize, Cap,
+        config_.epoch_period * config_.tCK * 1e-9, time_iter, Tamb);
+    powerM = std::vector<std::vector<double>>(
+        num_case,
+        std::vector<double>(numP * (dimX + num_dummy) * (dimY + num_dummy), 0));
+    trans_work_ = std::vector<std::vector<double>>(
+        num_case,
+        std::vector<double>(transient_solver_work_size(trans_solver_), 0));
+    case_power_ = std::vector<double>(num_case, 0);
 
     for (int ir = 0; ir < num_case; ir++) {
         double *T =
@@ -785,15 +844,18 @@ double ThermalCalculator::GetMaxTofCaseLayer(double **temp_map, int case_id,
     return maxT;
 }
 
-void ThermalCalculator::PrintCSV_trans(std::ofstream &csvfile,
-                                       std::vector<std::vector<double>> P_,
-                                       double **T_, int id, uint64_t scale) {
+void ThermalCalculator::PrintCSV_trans(
+    std::ofstream &csvfile, const std::vector<std::vector<double>> &P_,
+    const std::vector<std::vector<double>> &uniform_P_, double **T_, int id,
+    uint64_t scale) {
     for (int l = 0; l < numP; l++) {
         for (int j = num_dummy / 2; j < dimY + num_dummy / 2; j++) {
             for (int i = num_dummy / 2; i < dimX + num_dummy / 2; i++) {
                 double pw =
-                    P_[id][l * ((dimX) * (dimY)) +
-                           (j - num_dummy / 2) * (dimX) + (i - num_dummy / 2)] /
+                    (P_[id][l * ((dimX) * (dimY)) +
+                            (j - num_dummy / 2) * (dimX) +
+                            (i - num_dummy / 2)] +
+                     uniform_P_[id][l]) /
                     (double)scale;
                 double tm = T_[id][(layerP[l] + 1) * ((dimX + num_dummy) *
                                                       (dimY + num_dummy)) +
@@ -807,15 +869,17 @@ void ThermalCalculator::PrintCSV_trans(std::ofstream &csvfile,
     }
 }
 
-void ThermalCalculator::PrintCSV_final(std::ofstream &csvfile,
-                                       std::vector<std::vector<double>> P_,
-                                       double **T_, int id, uint64_t scale) {
+void ThermalCalculator::PrintCSV_final(
+    std::ofstream &csvfile, const std::vector<std::vector<double>> &P_,
+    const std::vector<std::vector<double>> &uniform_P_, double **T_, int id,
+    uint64_t scale) {
     for (int l = 0; l < numP; l++) {
         for (int j = num_dummy / 2; j < dimY + num_dummy / 2; j++) {
             for (int i = num_dummy / 2; i < dimX + num_dummy / 2; i++) {
                 double pw =
-                    P_[id][l * (dimX * dimY) + (j - num_dummy / 2) * dimX +
-                           (i - num_dummy / 2)] /
+                    (P_[id][l * (dimX * dimY) + (j - num_dummy / 2) * dimX +
+                            (i - num_dummy / 2)] +
+                     uniform_P_[id][l]) /
                     (double)scale;
                 double tm = T_[id][(layerP[l] + 1) * ((dimX + num_dummy) *
                                                       (dimY + num_dummy)) +
@@ -2,6 +2,7 @@
 #define __THERMAL_H
 
 #include <time.h>
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <functional>
@@ -12,13 +13,14 @@
 #include "configuration.h"
 #include "thermal_config.h"
 
-namespace dramsim3 {
+// precomputed transient model, see thermal_solver.c
+struct TransientSolver;
 
-extern std::function<Address(const Address &addr)> GetPhyAddress;
+namespace dramsim3 {
 
 class ThermalCalculator {
    public:
-    ThermalCalculator(const Config &config);
+    ThermalCalculator(const Config &config, const OutputFiles &output_files);
     ~ThermalCalculator();
     void UpdateCMDPower(const int channel, const Command &cmd,
                         const uint64_t clk);
@@ -33,7 +35,7 @@ class ThermalCalculator {
 
    private:
     // Initialization
-    double ***InitPowerM(int case_id, uint64_t clk);
+    void InitPowerM(int case_id, uint64_t clk);
     void InitialParameters();
 
     // location mapping functions
@@ -41,11 +43,8 @@ class ThermalCalculator {
     std::pair<int, int> MapToVault(int channel_id);
     std::pair<int, int> MapToBank(int bankgroup_id, int bank_id);
     int MapToZ(int channel_id, int bank_id);
-    std::pair<std::vector<int>, std::vector<int>> MapToXY(const Command &cmd,
-                                                          int vault_id_x,
-                                                          int vault_id_y,
-                                                          int bank_id_x,
-                                                          int bank_id_y);
+    void AddColumnEnergy(double *column_cells, int col_id, int num_cols,
+                         double energy);
     void LocationMappingANDaddEnergy_RF(const int channel, const Command &cmd,
                                         int bank0, int row0, int caseID_,
                                         double add_energy);
@@ -53,11 +52,12 @@ class ThermalCalculator {
                                      int bank0, int row0, int caseID_,
                                      double add_energy);
     void UpdatePowerMaps(double add_energy, bool trans, uint64_t clk);
+    void FoldEpochPower();
 
     // calculations
     void CalcTransT(int case_id);
     void CalcFinalT(int case_id, uint64_t clk);
-    double GetTotalPower(double ***powerM);
+    double GetTotalPower(int case_id);
     int square_array(int total_grids_);
     int determineXY(double xd, double yd, int total_grids_);
     double GetMaxTofCase(double **temp_map, int case_id);
@@ -66,16 +66,21 @@ class ThermalCalculator {
 
     // print to csv-files
     void PrintCSV_trans(std::ofstream &csvfile,
-                        std::vector<std::vector<double>> P_, double **T_,
-                        int id, uint64_t scale);
+                        const std::vector<std::vector<double>> &P_,
+                        const std::vector<std::vector<double>> &uniform_P_,
+                        double **T_, int id, uint64_t scale);
     void PrintCSV_final(std::ofstream &csvfile,
-                        std::vector<std::vector<double>> P_, double **T_,
-                        int id, uint64_t scale);
+                        const std::vector<std::vector<double>> &P_,
+                        const std::vector<std::vector<double>> &uniform_P_,
+                        double **T_, int id, uint64_t scale);
     void PrintCSVHeader_final(std::ofstream &csvfile);
     void PrintCSV_bank(std::ofstream &csvfile);
 
 
     const Config &config_;
+    OutputFiles output_files_;
+    // location mapping of SetPhyAddressMapping
+    std::function<Address(const Address &addr)> phy_address_;
 
     int time_iter0, time_iter;
     double Tamb;  // The ambient temperature in Kelvin
@@ -87,11 +92,25 @@ class ThermalCalculator {
     int MidxSize, CapSize;  // first dimension size of Midx and Cap
     int T_size;
     double **T_trans, **T_final;
+    TransientSolver *trans_solver_;
+    // per case so that cases can be solved concurrently: flat solver power
+    // input ([layer][x][y] with dummy cells), solver scratch space and the
+    // total power of the last solve
+    std::vector<std::vector<double>> powerM;
+    std::vector<std::vector<double>> trans_work_;
+    std::vector<double> case_power_;
+    int case_threads_;
 
     int sample_id;  // index of the sampling power
 
+    // Command energy only goes to the current (epoch) map and is folded
+    // into the accumulative map once per epoch. Background and logic power
+    // are uniform over a layer, so they are kept per case and layer and
+    // only added when the solver input or the csv files are written
     std::vector<std::vector<double>> accu_Pmap;  // accumulative power map
     std::vector<std::vector<double>> cur_Pmap;   // current power map
+    std::vector<std::vector<double>> accu_uniform_P;
+    std::vector<std::vector<double>> cur_uniform_P;
 
     std::vector<std::vector<int>> refresh_count;
 
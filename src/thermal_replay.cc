@@ -1,18 +1,44 @@
 #include "thermal_replay.h"
+#include <algorithm>
+#include <thread>
 #include "./../ext/headers/args.hxx"
+#include "worker_pool.h"
 
 // this will not be used in a library file so it's ok to do this
 using namespace dramsim3;
 
 ThermalReplay::ThermalReplay(std::string trace_name, std::string config_file,
-                             std::string output_dir, uint64_t repeat)
-    : config_(config_file, output_dir),
-      thermal_calc_(config_),
+                             std::string output_dir, uint64_t repeat,
+                             int num_threads, uint64_t cache_limit)
+    : trace_name_(trace_name),
+      binary_trace_(CommandTraceReader::IsCommandTrace(trace_name)),
+      num_threads_(num_threads),
+      cache_limit_(cache_limit),
+      caching_(cache_limit > 0),
+      cache_complete_(false),
+      config_(config_file, output_dir),
+      thermal_calc_(config_, config_.output_files),
       repeat_(repeat),
       last_clk_(0) {
     for (int i = 0; i < config_.channels; i++) {
-        channel_stats_.emplace_back(config_, i);
+        channel_stats_.emplace_back(config_, config_.output_files, i);
     }
+    num_read_cmds_ = channel_stats_[0].GetCounterId("num_read_cmds");
+    num_write_cmds_ = channel_stats_[0].GetCounterId("num_write_cmds");
+    num_act_cmds_ = channel_stats_[0].GetCounterId("num_act_cmds");
+    num_pre_cmds_ = channel_stats_[0].GetCounterId("num_pre_cmds");
+    num_ref_cmds_ = channel_stats_[0].GetCounterId("num_ref_cmds");
+    num_refb_cmds_ = channel_stats_[0].GetCounterId("num_refb_cmds");
+    num_srefe_cmds_ = channel_stats_[0].GetCounterId("num_srefe_cmds");
+    num_srefx_cmds_ = channel_stats_[0].GetCounterId("num_srefx_cmds");
+    num_refsb_cmds_ = channel_stats_[0].GetCounterId("num_refsb_cmds");
+    num_rfm_cmds_ = channel_stats_[0].GetCounterId("num_rfm_cmds");
+    num_pde_cmds_ = channel_stats_[0].GetCounterId("num_pde_cmds");
+    num_pdx_cmds_ = channel_stats_[0].GetCounterId("num_pdx_cmds");
+    all_bank_idle_cycles_ =
+        channel_stats_[0].GetVecCounterId("all_bank_idle_cycles");
+    rank_active_cycles_ =
+        channel_stats_[0].GetVecCounterId("rank_active_cycles");
 
     // Initialize bank states, for power calculation we only need to know
     // if it's active
@@ -29,21 +55,14 @@ ThermalReplay::ThermalReplay(std::string trace_name, std::string config_file,
         bank_active_.push_back(chan_vec);
     }
 
-    // read commands into memory
     std::ifstream trace_file(trace_name);
     if (!trace_file) {
         std::cout << "cannot open trace file " << trace_name << std::endl;
         std::exit(1);
     }
-
-    std::string line;
-    uint64_t clk = 0;
-    while (std::getline(trace_file, line)) {
-        Command cmd;
-        ParseLine(line, clk, cmd);
-        timed_commands_.push_back(std::pair<uint64_t, Command>(clk, cmd));
+    if (num_threads_ <= 0) {
+        num_threads_ = std::max(1u, std::thread::hardware_concurrency());
     }
-    trace_file.close();
 }
 
 ThermalReplay::~ThermalReplay() {}
@@ -52,14 +71,13 @@ void ThermalReplay::Run() {
     uint64_t clk = 0;
     for (uint64_t i = 0; i < repeat_; i++) {
         uint64_t clk_offset = 0;
-        for (size_t j = 0; j < timed_commands_.size(); j++) {
-            // for (int j = 0; j < cmds_.size(); j++) {
-            // Command &cmd = cmds_[j];
-            // clk_offset = clks_[j];
-            clk_offset = timed_commands_[j].first;
-            Command &cmd = timed_commands_[j].second;
-            ProcessCMD(cmd, clk + clk_offset);
-            thermal_calc_.UpdateCMDPower(0, cmd, clk + clk_offset);
+        if (cache_complete_) {
+            for (const auto &timed_cmd : timed_commands_) {
+                ReplayCommand(timed_cmd, clk);
+                clk_offset = timed_cmd.clk;
+            }
+        } else {
+            clk_offset = StreamTrace(clk);
         }
         clk += clk_offset;
 
@@ -81,9 +99,108 @@ void ThermalReplay::Run() {
     thermal_calc_.PrintFinalPT(clk);
 }
 
+uint64_t ThermalReplay::StreamTrace(uint64_t clk) {
+    uint64_t clk_offset =
+        binary_trace_ ? StreamBinaryTrace(clk) : StreamTextTrace(clk);
+    if (caching_) {
+        // the whole trace fits, the repeats don't need to read it again
+        caching_ = false;
+        cache_complete_ = true;
+    }
+    return clk_offset;
+}
+
+uint64_t ThermalReplay::StreamBinaryTrace(uint64_t clk) {
+    CommandTraceReader reader(trace_name_);
+    // with more than one thread, worker 0 replays a batch of blocks while
+    // the others decode the next one
+    int num_decoders = std::max(num_threads_ - 1, 1);
+    std::vector<CommandTraceBlock> blocks(num_decoders);
+    std::vector<std::vector<TimedCommand>> decoding(num_decoders);
+    std::vector<std::vector<TimedCommand>> replaying(num_decoders);
+    int num_replaying = 0;
+    uint64_t clk_offset = 0;
+    auto replay = [&](const std::vector<std::vector<TimedCommand>> &batch,
+                      int num_blocks) {
+        for (int b = 0; b < num_blocks; b++) {
+            for (const auto &timed_cmd : batch[b]) {
+                CacheCommand(timed_cmd);
+                ReplayCommand(timed_cmd, clk);
+                clk_offset = timed_cmd.clk;
+            }
+        }
+    };
+    WorkerPool workers(num_threads_);
+    while (true) {
+        int num_blocks = 0;
+        while (num_blocks < num_decoders &&
+               reader.NextBlock(blocks[num_blocks])) {
+            num_blocks++;
+        }
+        if (num_blocks == 0 && num_replaying == 0) {
+            break;
+        }
+        if (num_threads_ == 1) {
+            for (int b = 0; b < num_blocks; b++) {
+                DecodeCommandBlock(blocks[b], reader.Compressed(),
+                                   decoding[b]);
+            }
+            replay(decoding, num_blocks);
+            continue;
+        }
+        workers.Run([&](int worker_id) {
+            if (worker_id == 0) {
+                replay(replaying, num_replaying);
+            } else if (worker_id - 1 < num_blocks) {
+                DecodeCommandBlock(blocks[worker_id - 1], reader.Compressed(),
+                                   decoding[worker_id - 1]);
+            }
+        });
+        std::swap(decoding, replaying);
+        num_replaying = num_blocks;
+    }
+    return clk_offset;
+}
+
+uint64_t ThermalReplay::StreamTextTrace(uint64_t clk) {
+    std::ifstream trace_file(trace_name_);
+    std::string line;
+    TimedCommand timed_cmd;
+    uint64_t clk_offset = 0;
+    while (std::getline(trace_file, line)) {
+        ParseLine(line, timed_cmd.clk, timed_cmd.cmd);
+        CacheCommand(timed_cmd);
+        ReplayCommand(timed_cmd, clk);
+        clk_offset = timed_cmd.clk;
+    }
+    return clk_offset;
+}
+
+void ThermalReplay::CacheCommand(const TimedCommand &timed_cmd) {
+    if (!caching_) {
+        return;
+    }
+    if (timed_commands_.size() == cache_limit_) {
+        // too long to keep, stream it for every repeat instead
+        caching_ = false;
+        std::vector<TimedCommand>().swap(timed_commands_);
+        return;
+    }
+    timed_commands_.push_back(timed_cmd);
+    return;
+}
+
+void ThermalReplay::ReplayCommand(const TimedCommand &timed_cmd,
+                                  uint64_t clk) {
+    Command cmd = timed_cmd.cmd;
+    ProcessCMD(cmd, clk + timed_cmd.clk);
+    thermal_calc_.UpdateCMDPower(0, cmd, clk + timed_cmd.clk);
+    return;
+}
+
 // parsing line from trace file into a command
 void ThermalReplay::ParseLine(std::string line, uint64_t &clk, Command &cmd) {
-    std::map<std::string, CommandType> cmd_map = {
+    static const std::map<std::string, CommandType> cmd_map = {
         {"read", CommandType::READ},
         {"read_p", CommandType::READ_PRECHARGE},
         {"write", CommandType::WRITE},
@@ -96,6 +213,10 @@ void ThermalReplay::ParseLine(std::string line, uint64_t &clk, Command &cmd) {
         {"refresh", CommandType::REFRESH},
         {"self_refresh_enter", CommandType::SREF_ENTER},
         {"self_refresh_exit", CommandType::SREF_EXIT},
+        {"power_down_enter", CommandType::PD_ENTER},
+        {"power_down_exit", CommandType::PD_EXIT},
+        {"refresh_same_bank", CommandType::REFRESH_SAME_BANK},
+        {"refresh_management", CommandType::REFRESH_MANAGEMENT},
     };
     std::vector<std::string> tokens = StringSplit(line, ' ');
 
@@ -109,13 +230,20 @@ void ThermalReplay::ParseLine(std::string line, uint64_t &clk, Command &cmd) {
     clk = stoull(tokens[0]);
 
     // converting address
+    // rows and columns are hex
     Address addr(std::stoi(tokens[2]), std::stoi(tokens[3]),
                  std::stoi(tokens[4]), std::stoi(tokens[5]),
-                 std::stoi(tokens[6]), std::stoi(tokens[7]));
+                 std::stoi(tokens[6], nullptr, 0),
+                 std::stoi(tokens[7], nullptr, 0));
 
+    auto it = cmd_map.find(tokens[1]);
+    if (it == cmd_map.end()) {
+        std::cerr << "Unknown command " << tokens[1] << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
     // reassign cmd
     cmd.addr = addr;
-    cmd.cmd_type = cmd_map[tokens[1]];
+    cmd.cmd_type = it->second;
     return;
 }
 
@@ -126,10 +254,10 @@ void ThermalReplay::ProcessCMD(Command &cmd, uint64_t clk) {
     for (int i = 0; i < config_.channels; i++) {
         for (int j = 0; j < config_.ranks; j++) {
             if (IsRankActive(i, j)) {
-                channel_stats_[i].IncrementVecBy("rank_active_cycles", j,
+                channel_stats_[i].IncrementVecBy(rank_active_cycles_, j,
                                                  past_clks);
             } else {
-                channel_stats_[i].IncrementVecBy("all_bank_idle_cycles", j,
+                channel_stats_[i].IncrementVecBy(all_bank_idle_cycles_, j,
                                                  past_clks);
             }
         }
@@ -140,29 +268,41 @@ void ThermalReplay::ProcessCMD(Command &cmd, uint64_t clk) {
     switch (cmd.cmd_type) {
         case CommandType::READ:
         case CommandType::READ_PRECHARGE:
-            channel_stats_[channel].Increment("num_read_cmds");
+            channel_stats_[channel].Increment(num_read_cmds_);
             break;
         case CommandType::WRITE:
         case CommandType::WRITE_PRECHARGE:
-            channel_stats_[channel].Increment("num_write_cmds");
+            channel_stats_[channel].Increment(num_write_cmds_);
             break;
         case CommandType::ACTIVATE:
-            channel_stats_[channel].Increment("num_act_cmds");
+            channel_stats_[channel].Increment(num_act_cmds_);
             break;
         case CommandType::PRECHARGE:
-            channel_stats_[channel].Increment("num_pre_cmds");
+            channel_stats_[channel].Increment(num_pre_cmds_);
             break;
         case CommandType::REFRESH:
-            channel_stats_[channel].Increment("num_ref_cmds");
+            channel_stats_[channel].Increment(num_ref_cmds_);
             break;
         case CommandType::REFRESH_BANK:
-            channel_stats_[channel].Increment("num_refb_cmds");
+            channel_stats_[channel].Increment(num_refb_cmds_);
             break;
         case CommandType::SREF_ENTER:
-            channel_stats_[channel].Increment("num_srefe_cmds");
+            channel_stats_[channel].Increment(num_srefe_cmds_);
             break;
         case CommandType::SREF_EXIT:
-            channel_stats_[channel].Increment("num_srefx_cmds");
+            channel_stats_[channel].Increment(num_srefx_cmds_);
+            break;
+        case CommandType::REFRESH_SAME_BANK:
+            channel_stats_[channel].Increment(num_refsb_cmds_);
+            break;
+        case CommandType::REFRESH_MANAGEMENT:
+            channel_stats_[channel].Increment(num_rfm_cmds_);
+            break;
+        case CommandType::PD_ENTER:
+            channel_stats_[channel].Increment(num_pde_cmds_);
+            break;
+        case CommandType::PD_EXIT:
+            channel_stats_[channel].Increment(num_pdx_cmds_);
             break;
         default:
             AbruptExit(__FILE__, __LINE__);
@@ -188,7 +328,7 @@ void ThermalReplay::ProcessCMD(Command &cmd, uint64_t clk) {
         for (int c = 0; c < config_.channels; c++) {
             // where to print isn't important here what we really need is the
             // updated stats
-            channel_stats_[c].PrintEpochStats();
+            channel_stats_[c].PrintEpochStats(nullptr);
             for (int r = 0; r < config_.ranks; r++) {
                 double bg_energy = channel_stats_[c].RankBackgroundEnergy(r);
                 thermal_calc_.UpdateBackgroundEnergy(c, r, bg_energy);
@@ -226,7 +366,17 @@ int main(int argc, const char **argv) {
         parser, "memory_type", "Type of memory system - default, hmc, ideal",
         {"memory-type"}, "default");
     args::ValueFlag<std::string> trace_file_arg(
-        parser, "trace", "The trace file", {'t', "trace-file"});
+        parser, "trace", "The text or binary (cmd_trace) command trace",
+        {'t', "trace-file"});
+    args::ValueFlag<int> threads_arg(
+        parser, "threads",
+        "Threads decoding binary traces (0: one per hardware thread)",
+        {'j', "threads"}, 0);
+    args::ValueFlag<uint64_t> cache_arg(
+        parser, "cache_commands",
+        "Commands kept in memory for the repeats, longer traces are read "
+        "again for every repeat",
+        {"cache-commands"}, 1 << 22);
 
     try {
         parser.ParseCLI(argc, argv);
@@ -246,7 +396,8 @@ int main(int argc, const char **argv) {
     trace_file = args::get(trace_file_arg);
     memory_system_type = args::get(memory_type_arg);
 
-    ThermalReplay thermal_replay(trace_file, config_file, output_dir, repeats);
+    ThermalReplay thermal_replay(trace_file, config_file, output_dir, repeats,
+                                 args::get(threads_arg), args::get(cache_arg));
 
     thermal_replay.Run();
 
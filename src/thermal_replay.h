@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 
+#include "cmd_trace.h"
 #include "common.h"
 #include "configuration.h"
 #include "simple_stats.h"
@@ -14,20 +15,53 @@ namespace dramsim3 {
 
 class ThermalReplay {
    public:
+    // binary command traces are decoded on num_threads threads, up to
+    // cache_limit commands are kept in memory to replay the repeats from
     ThermalReplay(std::string trace_name, std::string config_file,
-                  std::string output_dir, uint64_t repeat);
+                  std::string output_dir, uint64_t repeat, int num_threads,
+                  uint64_t cache_limit);
     ~ThermalReplay();
     void Run();
 
    private:
-    std::vector<std::pair<uint64_t, Command>> timed_commands_;
+    std::string trace_name_;
+    bool binary_trace_;
+    int num_threads_;
+    uint64_t cache_limit_;
+    // all commands of the trace once it has been read through and fits in
+    // the cache, otherwise every repeat streams the trace again
+    std::vector<TimedCommand> timed_commands_;
+    bool caching_;
+    bool cache_complete_;
     Config config_;
     ThermalCalculator thermal_calc_;
     uint64_t repeat_;
     uint64_t last_clk_;
     std::vector<SimpleStats> channel_stats_;
+    // stat handles, the same for all channels
+    CounterId num_read_cmds_;
+    CounterId num_write_cmds_;
+    CounterId num_act_cmds_;
+    CounterId num_pre_cmds_;
+    CounterId num_ref_cmds_;
+    CounterId num_refb_cmds_;
+    CounterId num_srefe_cmds_;
+    CounterId num_srefx_cmds_;
+    CounterId num_refsb_cmds_;
+    CounterId num_rfm_cmds_;
+    CounterId num_pde_cmds_;
+    CounterId num_pdx_cmds_;
+    VecCounterId all_bank_idle_cycles_;
+    VecCounterId rank_active_cycles_;
     std::vector<std::vector<std::vector<std::vector<bool>>>> bank_active_;
     void ParseLine(std::string line, uint64_t &clk, Command &cmd);
+    // replays the trace once starting at clk, returns the clk of its last
+    // command relative to the start
+    uint64_t StreamTrace(uint64_t clk);
+    uint64_t StreamBinaryTrace(uint64_t clk);
+    uint64_t StreamTextTrace(uint64_t clk);
+    void CacheCommand(const TimedCommand &timed_cmd);
+    void ReplayCommand(const TimedCommand &timed_cmd, uint64_t clk);
     void ProcessCMD(Command &cmd, uint64_t clk);
     bool IsRankActive(int channel, int rank);
 };
@@ -6,6 +6,7 @@
 #include <omp.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include "../ext/SuperLU_MT_3.1/SRC/slu_mt_ddefs.h"
 #include "thermal_config.h"
@@ -420,9 +421,9 @@ double **calculate_Midx_array(double W, double Lc, int numP, int dimX, int dimZ,
     return Midx;
 }
 
-double *steady_thermal_solver(double ***powerM, double W, double Lc, int numP,
-                              int dimX, int dimZ, double **Midx, int count,
-                              double Tamb) {
+double *steady_thermal_solver(const double *powerM, double W, double Lc,
+                              int numP, int dimX, int dimZ, double **Midx,
+                              int count, double Tamb, int max_procs) {
     int numLayer = numP * 3;
     int_t *layerP;
     // define the active layer array
@@ -456,7 +457,7 @@ double *steady_thermal_solver(double ***powerM, double W, double Lc, int numP,
 
     nrhs = 1;
     trans = NOTRANS;
-    nprocs = omp_get_max_threads();
+    nprocs = max_procs > 0 ? max_procs : omp_get_max_threads();
     b = 1;
     panel_size = sp_ienv(1);
     relax = sp_ienv(2);
@@ -504,20 +505,9 @@ double *steady_thermal_solver(double ***powerM, double W, double Lc, int numP,
         for (int i = 0; i < dimX; i++)
             for (int j = 0; j < dimZ; j++) {
                 rhs[dimX * dimZ * (layerP[l] + 1) + j * dimX + i] =
-                    powerM[i][j][l];
-                // rhs[dimX*dimZ*(layerP[l]+1) + i*dimZ + j] = powerM[i][j][l];
-                // printf("%.6f\n", powerM[i][j][l]);
+                    powerM[(l * dimX + i) * dimZ + j];
             }
 
-    // free the space
-    for (int i = 0; i < dimX; i++) {
-        for (int j = 0; j < dimZ; j++) {
-            free(powerM[i][j]);
-        }
-        free(powerM[i]);
-    }
-    free(powerM);
-
     dCreate_Dense_Matrix(&B, m, nrhs, rhs, m, SLU_DN, SLU_D, SLU_GE);
 
     // dPrint_Dense_Matrix("B", &B);
@@ -607,17 +597,46 @@ double *steady_thermal_solver(double ***powerM, double W, double Lc, int numP,
     return Tt;
 }
 
-double *transient_thermal_solver(double ***powerM, double W, double Lc,
-                                 int numP, int dimX, int dimZ, double **Midx,
-                                 int MidxSize, double *Cap, int CapSize,
-                                 double time, int iter, double *T_trans,
-                                 double Tamb) {
+/* The transient model is stepped explicitly. Everything except the power
+ * of the active layers is fixed for a configuration, so the conductance
+ * entries are turned into per-step update coefficients (row-compressed)
+ * once, and an epoch only runs the iterations with the new power */
+struct TransientSolver {
+    int numP, dimX, dimZ;
+    int T_size;
+    int iter;
+    int *row_start; /* entries of row r are [row_start[r], row_start[r+1]) */
+    int *col;
+    double *coef;
+    double *src;    /* dt / Cap of each node, scales its power */
+    double *sink_P; /* power vector with only the heat sink, Tamb / Ramb */
+};
+
+struct TransientSolver *create_transient_solver(double W, double Lc, int numP,
+                                                int dimX, int dimZ,
+                                                double **Midx, int MidxSize,
+                                                double *Cap, double time,
+                                                int iter, double Tamb) {
     int numLayer = numP * 3;
-
-    // define the active layer array
-    int_t *layerP;
-    if (!(layerP = intMalloc(numP))) SUPERLU_ABORT("Malloc fails for numP[].");
-    for (int l = 0; l < numP; l++) layerP[l] = l * 3;
+    int layer_dim = dimX * dimZ;
+    struct TransientSolver *solver;
+    if (!(solver = (struct TransientSolver *)malloc(sizeof(*solver))))
+        SUPERLU_ABORT("Malloc fails for solver.");
+    solver->numP = numP;
+    solver->dimX = dimX;
+    solver->dimZ = dimZ;
+    solver->T_size = layer_dim * (numLayer + 1);
+    solver->iter = iter;
+    int T_size = solver->T_size;
+
+    // int_t may be 64 bits, these are plain ints
+    if (!(solver->row_start = (int *)malloc((T_size + 1) * sizeof(int))) ||
+        !(solver->col = (int *)malloc(MidxSize * sizeof(int))))
+        SUPERLU_ABORT("Malloc fails for solver index.");
+    if (!(solver->coef = doubleMalloc(MidxSize)) ||
+        !(solver->src = doubleMalloc(T_size)) ||
+        !(solver->sink_P = doubleMalloc(T_size)))
+        SUPERLU_ABORT("Malloc fails for solver arrays.");
 
     double Wsink = W;
     double Lsink = Lc;
@@ -628,79 +647,78 @@ double *transient_thermal_solver(double ***powerM, double W, double Lc,
     double Rsinky = Hsink / Ksink / gridXsink / gridZsink;  // y direction
     double Ramb = Rsinky / 2;
 
-    double *Tp = T_trans;
-    double *T, *P;
-    int T_size = dimX * dimZ * (numLayer + 1);
-    if (!(T = doubleMalloc(T_size))) SUPERLU_ABORT("Malloc fails for rhs[].");
-    if (!(P = doubleMalloc(T_size))) SUPERLU_ABORT("Malloc fails for rhs[].");
+    double dt = time / (double)iter;
+    memset(solver->row_start, 0, (T_size + 1) * sizeof(int));
+    // Midx is sorted by row
+    for (int b = 0; b < MidxSize; b++) {
+        int idx0 = (int)(Midx[b][0] + 0.01);
+        int idx1 = (int)(Midx[b][1] + 0.01);
+        double c = Midx[b][2] * dt / Cap[idx0 / layer_dim];
+        solver->row_start[idx0 + 1]++;
+        solver->col[b] = idx1;
+        solver->coef[b] = idx0 == idx1 ? 1 - c : -c;
+    }
+    for (int r = 0; r < T_size; r++) {
+        solver->row_start[r + 1] += solver->row_start[r];
+        solver->src[r] = dt / Cap[r / layer_dim];
+    }
 
-    // initialize T and P
-    memset(T, 0, T_size * sizeof(*T));
-    memset(P, 0, T_size * sizeof(*T));
+    memset(solver->sink_P, 0, T_size * sizeof(double));
+    for (int i = 0; i < layer_dim; i++) solver->sink_P[i] = Tamb / Ramb;
+    return solver;
+}
 
-    for (int i = 0; i < dimX * dimZ; i++) P[i] = Tamb / Ramb;
-    for (int l = 0; l < numP; l++)
-        for (int j = 0; j < dimZ; j++)
-            for (int i = 0; i < dimX; i++) {
-                P[dimX * dimZ * (layerP[l] + 1) + i * dimZ + j] =
-                    powerM[i][j][l];
-                // printf("%.6f\n", powerM[i][j][l]);
-            }
+int transient_solver_work_size(const struct TransientSolver *solver) {
+    return 2 * solver->T_size;
+}
 
-    double dt = time / (double)iter;
+/* powerM holds the power of each active layer as [l][i][j], dummy cells
+ * included. T_trans is the temperature of the previous epoch and is
+ * updated in place. work (transient_solver_work_size doubles) is scratch
+ * space, the solver itself is read only so cases with their own T_trans
+ * and work can be solved concurrently */
+void transient_thermal_solver(const struct TransientSolver *solver,
+                              const double *powerM, double *T_trans,
+                              double *work) {
+    int layer_dim = solver->dimX * solver->dimZ;
+    double *P = work;
+    memcpy(P, solver->sink_P, solver->T_size * sizeof(double));
+    for (int l = 0; l < solver->numP; l++) {
+        memcpy(P + layer_dim * (l * 3 + 1), powerM + l * layer_dim,
+               layer_dim * sizeof(double));
+    }
 
-    ////////////// iteratively update the temperature /////////////////
-
-    // tried to optimize the following code
-    // multi-threading won't work unless you figure out T[idx0] access patterns
-    // also tried a variety of loop tiling technique, on our server block_size=8
-    // or 4 yields best performance, so let it be...
-    const int block_size = 8;
-    for (int iit = 0; iit < iter; iit++) {
-        // main calculation of the new T
-        for (int j = 0; j < MidxSize; j += block_size) {
-            int bound = j + block_size < MidxSize ? (j + block_size) : MidxSize;
-            for (int b = j; b < bound; b++) {
-                int idx0 = (int)(Midx[b][0] + 0.01);
-                int idx1 = (int)(Midx[b][1] + 0.01);
-                double tmp_c = Midx[b][2];
-                int idxC = idx0 / (dimX * dimZ);
-
-                if (idx0 == idx1) {
-                    // if (1-Midx[j][2]*dt/Cap[idxC] < 0)
-                    //    printf("NEGATIVE: idx0 = %d\n", idx0);
-                    double tmp_a = 1 - tmp_c * dt / Cap[idxC];
-                    double tmp_b = tmp_a * Tp[idx1] + P[idx0] * dt / Cap[idxC];
-                    T[idx0] += tmp_b;
-                } else {
-                    double tmp_a = tmp_c * Tp[idx1] * dt / Cap[idxC];
-                    T[idx0] -= tmp_a;
-                }
+    const int *row_start = solver->row_start;
+    const int *col = solver->col;
+    const double *coef = solver->coef;
+    const double *src = solver->src;
+    double *Tp = T_trans;
+    double *T = work + solver->T_size;
+    for (int iit = 0; iit < solver->iter; iit++) {
+        for (int r = 0; r < solver->T_size; r++) {
+            double t = 0;
+            for (int k = row_start[r]; k < row_start[r + 1]; k++) {
+                t += coef[k] * Tp[col[k]];
             }
+            T[r] = t + P[r] * src[r];
         }
-
-        // give value for the next T
-        double *Tt;  // for swap the storage between T and Tp
-        Tt = Tp;
+        // exchange T, Tp
+        double *Tt = Tp;
         Tp = T;
-        T = Tt;  // exchange T, Tp
-        memset(T, 0, dimX * dimZ * (numLayer + 1) * sizeof(*T));
+        T = Tt;
     }
-
-    // free the space
-    for (int i = 0; i < dimX; i++) {
-        for (int j = 0; j < dimZ; j++) {
-            free(powerM[i][j]);
-        }
-        free(powerM[i]);
+    if (Tp != T_trans) {
+        memcpy(T_trans, Tp, solver->T_size * sizeof(double));
     }
-    free(powerM);
-
-    SUPERLU_FREE(layerP);
-    SUPERLU_FREE(P);
-    SUPERLU_FREE(T);
+}
 
-    return Tp;
+void free_transient_solver(struct TransientSolver *solver) {
+    free(solver->row_start);
+    free(solver->col);
+    SUPERLU_FREE(solver->coef);
+    SUPERLU_FREE(solver->src);
+    SUPERLU_FREE(solver->sink_P);
+    free(solver);
 }
 
 double get_maxT(double *T, int Tsize) {
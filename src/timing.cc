@@ -18,6 +18,8 @@ Timing::Timing(const Config& config)
     int read_to_write_o = config.read_delay + config.burst_cycle +
                           config.tRTRS - config.write_delay;
     int read_to_precharge = config.AL + config.tRTP;
+    // tRDPDEN, the data burst has to finish before CKE goes low
+    int read_to_powerdown = config.read_delay + config.burst_cycle + 1;
     int readp_to_act =
         config.AL + config.burst_cycle + config.tRTP + config.tRP;
 
@@ -29,6 +31,9 @@ Timing::Timing(const Config& config)
     int write_to_write_s = std::max(config.burst_cycle, config.tCCD_S);
     int write_to_write_o = config.burst_cycle;
     int write_to_precharge = config.WL + config.burst_cycle + config.tWR;
+    // tWRPDEN and tWRAPDEN
+    int write_to_powerdown = write_to_precharge;
+    int writep_to_powerdown = write_to_precharge + 1;
 
     int precharge_to_activate = config.tRP;
     int precharge_to_precharge = config.tPPD;
@@ -50,16 +55,19 @@ Timing::Timing(const Config& config)
     int activate_to_refresh =
         config.tRC;  // need to precharge before ref, so it's tRC
 
-    // TODO: deal with different refresh rate
-    int refresh_to_refresh =
-        config.tREFI;  // refresh intervals (per rank level)
-    int refresh_to_activate = config.tRFC;  // tRFC is defined as ref to act
+    // tRFC is defined as ref to act, Config already picked tRFC2/tRFC4 for
+    // fine granularity refresh
+    int refresh_to_activate = config.tRFC;
     int refresh_to_activate_bank = config.tRFCb;
+    int refresh_bank_to_other_bank = config.tRREFD;
+    int refresh_same_bank_to_activate = config.tRFCsb;
+    int refresh_same_bank_to_other_bank = config.tREFSBRD;
+    int refresh_management_to_activate = config.tRFM;
 
     int self_refresh_entry_to_exit = config.tCKESR;
     int self_refresh_exit = config.tXS;
-    // int powerdown_to_exit = config.tCKE;
-    // int powerdown_exit = config.tXP;
+    int powerdown_to_exit = config.tCKE;
+    int powerdown_exit = config.tXP;
 
     if (config.bankgroups == 1) {
         // for a bankgroup can be disabled, in that case
@@ -80,7 +88,8 @@ Timing::Timing(const Config& config)
             {CommandType::WRITE, read_to_write},
             {CommandType::READ_PRECHARGE, read_to_read_l},
             {CommandType::WRITE_PRECHARGE, read_to_write},
-            {CommandType::PRECHARGE, read_to_precharge}};
+            {CommandType::PRECHARGE, read_to_precharge},
+            {CommandType::PD_ENTER, read_to_powerdown}};
     other_banks_same_bankgroup[static_cast<int>(CommandType::READ)] =
         std::vector<std::pair<CommandType, int> >{
             {CommandType::READ, read_to_read_l},
@@ -107,7 +116,8 @@ Timing::Timing(const Config& config)
             {CommandType::WRITE, write_to_write_l},
             {CommandType::READ_PRECHARGE, write_to_read_l},
             {CommandType::WRITE_PRECHARGE, write_to_write_l},
-            {CommandType::PRECHARGE, write_to_precharge}};
+            {CommandType::PRECHARGE, write_to_precharge},
+            {CommandType::PD_ENTER, write_to_powerdown}};
     other_banks_same_bankgroup[static_cast<int>(CommandType::WRITE)] =
         std::vector<std::pair<CommandType, int> >{
             {CommandType::READ, write_to_read_l},
@@ -133,7 +143,10 @@ Timing::Timing(const Config& config)
             {CommandType::ACTIVATE, readp_to_act},
             {CommandType::REFRESH, read_to_activate},
             {CommandType::REFRESH_BANK, read_to_activate},
-            {CommandType::SREF_ENTER, read_to_activate}};
+            {CommandType::SREF_ENTER, read_to_activate},
+            {CommandType::PD_ENTER, read_to_powerdown},
+            {CommandType::REFRESH_SAME_BANK, read_to_activate},
+            {CommandType::REFRESH_MANAGEMENT, read_to_activate}};
     other_banks_same_bankgroup[static_cast<int>(CommandType::READ_PRECHARGE)] =
         std::vector<std::pair<CommandType, int> >{
             {CommandType::READ, read_to_read_l},
@@ -159,7 +172,10 @@ Timing::Timing(const Config& config)
             {CommandType::ACTIVATE, write_to_activate},
             {CommandType::REFRESH, write_to_activate},
             {CommandType::REFRESH_BANK, write_to_activate},
-            {CommandType::SREF_ENTER, write_to_activate}};
+            {CommandType::SREF_ENTER, write_to_activate},
+            {CommandType::PD_ENTER, writep_to_powerdown},
+            {CommandType::REFRESH_SAME_BANK, write_to_activate},
+            {CommandType::REFRESH_MANAGEMENT, write_to_activate}};
     other_banks_same_bankgroup[static_cast<int>(CommandType::WRITE_PRECHARGE)] =
         std::vector<std::pair<CommandType, int> >{
             {CommandType::READ, write_to_read_l},
@@ -193,12 +209,16 @@ Timing::Timing(const Config& config)
     other_banks_same_bankgroup[static_cast<int>(CommandType::ACTIVATE)] =
         std::vector<std::pair<CommandType, int> >{
             {CommandType::ACTIVATE, activate_to_activate_l},
-            {CommandType::REFRESH_BANK, activate_to_refresh}};
+            {CommandType::REFRESH_BANK, activate_to_refresh},
+            {CommandType::REFRESH_SAME_BANK, activate_to_refresh},
+            {CommandType::REFRESH_MANAGEMENT, activate_to_refresh}};
 
     other_bankgroups_same_rank[static_cast<int>(CommandType::ACTIVATE)] =
         std::vector<std::pair<CommandType, int> >{
             {CommandType::ACTIVATE, activate_to_activate_s},
-            {CommandType::REFRESH_BANK, activate_to_refresh}};
+            {CommandType::REFRESH_BANK, activate_to_refresh},
+            {CommandType::REFRESH_SAME_BANK, activate_to_refresh},
+            {CommandType::REFRESH_MANAGEMENT, activate_to_refresh}};
 
     // command PRECHARGE
     same_bank[static_cast<int>(CommandType::PRECHARGE)] =
@@ -206,10 +226,13 @@ Timing::Timing(const Config& config)
             {CommandType::ACTIVATE, precharge_to_activate},
             {CommandType::REFRESH, precharge_to_activate},
             {CommandType::REFRESH_BANK, precharge_to_activate},
-            {CommandType::SREF_ENTER, precharge_to_activate}};
+            {CommandType::SREF_ENTER, precharge_to_activate},
+            {CommandType::REFRESH_SAME_BANK, precharge_to_activate},
+            {CommandType::REFRESH_MANAGEMENT, precharge_to_activate}};
 
     // for those who need tPPD
-    if (config.IsGDDR() || config.protocol == DRAMProtocol::LPDDR4) {
+    if (config.IsGDDR() || config.protocol == DRAMProtocol::LPDDR4 ||
+        config.IsDDR5()) {
         other_banks_same_bankgroup[static_cast<int>(CommandType::PRECHARGE)] =
             std::vector<std::pair<CommandType, int> >{
                 {CommandType::PRECHARGE, precharge_to_precharge},
@@ -221,36 +244,87 @@ Timing::Timing(const Config& config)
             };
     }
 
-    // command REFRESH_BANK
-    same_rank[static_cast<int>(CommandType::REFRESH_BANK)] =
+    // command REFRESH_BANK, the other banks only have to wait tRREFD
+    same_bank[static_cast<int>(CommandType::REFRESH_BANK)] =
         std::vector<std::pair<CommandType, int> >{
             {CommandType::ACTIVATE, refresh_to_activate_bank},
             {CommandType::REFRESH, refresh_to_activate_bank},
             {CommandType::REFRESH_BANK, refresh_to_activate_bank},
-            {CommandType::SREF_ENTER, refresh_to_activate_bank}};
+            {CommandType::SREF_ENTER, refresh_to_activate_bank},
+            {CommandType::REFRESH_MANAGEMENT, refresh_to_activate_bank}};
 
     other_banks_same_bankgroup[static_cast<int>(CommandType::REFRESH_BANK)] =
         std::vector<std::pair<CommandType, int> >{
-            {CommandType::ACTIVATE, refresh_to_activate},
-            {CommandType::REFRESH_BANK, refresh_to_refresh},
+            {CommandType::ACTIVATE, refresh_bank_to_other_bank},
+            {CommandType::REFRESH_BANK, refresh_bank_to_other_bank},
+            {CommandType::REFRESH_MANAGEMENT, refresh_bank_to_other_bank},
         };
 
     other_bankgroups_same_rank[static_cast<int>(CommandType::REFRESH_BANK)] =
         std::vector<std::pair<CommandType, int> >{
-            {CommandType::ACTIVATE, refresh_to_activate},
-            {CommandType::REFRESH_BANK, refresh_to_refresh},
+            {CommandType::ACTIVATE, refresh_bank_to_other_bank},
+            {CommandType::REFRESH_BANK, refresh_bank_to_other_bank},
+            {CommandType::REFRESH_MANAGEMENT, refresh_bank_to_other_bank},
+        };
+
+    // command REFRESH_MANAGEMENT takes its bank for tRFM and, like
+    // REFRESH_BANK, only holds the other banks back by tRREFD
+    same_bank[static_cast<int>(CommandType::REFRESH_MANAGEMENT)] =
+        std::vector<std::pair<CommandType, int> >{
+            {CommandType::ACTIVATE, refresh_management_to_activate},
+            {CommandType::REFRESH, refresh_management_to_activate},
+            {CommandType::REFRESH_BANK, refresh_management_to_activate},
+            {CommandType::SREF_ENTER, refresh_management_to_activate},
+            {CommandType::REFRESH_SAME_BANK, refresh_management_to_activate},
+            {CommandType::REFRESH_MANAGEMENT,
+             refresh_management_to_activate}};
+
+    other_banks_same_bankgroup[static_cast<int>(
+        CommandType::REFRESH_MANAGEMENT)] =
+        std::vector<std::pair<CommandType, int> >{
+            {CommandType::ACTIVATE, refresh_bank_to_other_bank},
+            {CommandType::REFRESH_BANK, refresh_bank_to_other_bank},
+            {CommandType::REFRESH_MANAGEMENT, refresh_bank_to_other_bank},
+        };
+
+    other_bankgroups_same_rank[static_cast<int>(
+        CommandType::REFRESH_MANAGEMENT)] =
+        std::vector<std::pair<CommandType, int> >{
+            {CommandType::ACTIVATE, refresh_bank_to_other_bank},
+            {CommandType::REFRESH_BANK, refresh_bank_to_other_bank},
+            {CommandType::REFRESH_MANAGEMENT, refresh_bank_to_other_bank},
         };
 
-    // REFRESH, SREF_ENTER and SREF_EXIT are isued to the entire
-    // rank  command REFRESH
+    // command REFRESH_SAME_BANK refreshes one bank in every bankgroup, the
+    // same bank list applies to each of them and the same rank list to the
+    // whole rank
+    same_bank[static_cast<int>(CommandType::REFRESH_SAME_BANK)] =
+        std::vector<std::pair<CommandType, int> >{
+            {CommandType::ACTIVATE, refresh_same_bank_to_activate},
+            {CommandType::REFRESH, refresh_same_bank_to_activate},
+            {CommandType::REFRESH_SAME_BANK, refresh_same_bank_to_activate},
+            {CommandType::SREF_ENTER, refresh_same_bank_to_activate},
+            {CommandType::REFRESH_MANAGEMENT, refresh_same_bank_to_activate}};
+
+    same_rank[static_cast<int>(CommandType::REFRESH_SAME_BANK)] =
+        std::vector<std::pair<CommandType, int> >{
+            {CommandType::ACTIVATE, refresh_same_bank_to_other_bank},
+            {CommandType::REFRESH_SAME_BANK, refresh_same_bank_to_other_bank}};
+
+    // REFRESH, SREF_ENTER, SREF_EXIT, PD_ENTER and PD_EXIT are isued to the
+    // entire rank. ACT, PRE and refreshes only need a cycle before power
+    // down entry (tACTPDEN, tPRPDEN, tREFPDEN), which issuing one command
+    // per cycle already gives.
+    // command REFRESH
     same_rank[static_cast<int>(CommandType::REFRESH)] =
         std::vector<std::pair<CommandType, int> >{
             {CommandType::ACTIVATE, refresh_to_activate},
             {CommandType::REFRESH, refresh_to_activate},
-            {CommandType::SREF_ENTER, refresh_to_activate}};
+            {CommandType::SREF_ENTER, refresh_to_activate},
+            {CommandType::REFRESH_SAME_BANK, refresh_to_activate},
+            {CommandType::REFRESH_MANAGEMENT, refresh_to_activate}};
 
     // command SREF_ENTER
-    // TODO: add power down commands
     same_rank[static_cast<int>(CommandType::SREF_ENTER)] =
         std::vector<std::pair<CommandType, int> >{
             {CommandType::SREF_EXIT, self_refresh_entry_to_exit}};
@@ -261,7 +335,32 @@ Timing::Timing(const Config& config)
             {CommandType::ACTIVATE, self_refresh_exit},
             {CommandType::REFRESH, self_refresh_exit},
             {CommandType::REFRESH_BANK, self_refresh_exit},
-            {CommandType::SREF_ENTER, self_refresh_exit}};
+            {CommandType::SREF_ENTER, self_refresh_exit},
+            {CommandType::PD_ENTER, self_refresh_exit},
+            {CommandType::REFRESH_SAME_BANK, self_refresh_exit},
+            {CommandType::REFRESH_MANAGEMENT, self_refresh_exit}};
+
+    // command PD_ENTER
+    same_rank[static_cast<int>(CommandType::PD_ENTER)] =
+        std::vector<std::pair<CommandType, int> >{
+            {CommandType::PD_EXIT, powerdown_to_exit}};
+
+    // command PD_EXIT, active power down keeps the rows open so column
+    // commands may follow right away
+    same_rank[static_cast<int>(CommandType::PD_EXIT)] =
+        std::vector<std::pair<CommandType, int> >{
+            {CommandType::READ, powerdown_exit},
+            {CommandType::WRITE, powerdown_exit},
+            {CommandType::READ_PRECHARGE, powerdown_exit},
+            {CommandType::WRITE_PRECHARGE, powerdown_exit},
+            {CommandType::ACTIVATE, powerdown_exit},
+            {CommandType::PRECHARGE, powerdown_exit},
+            {CommandType::REFRESH, powerdown_exit},
+            {CommandType::REFRESH_BANK, powerdown_exit},
+            {CommandType::SREF_ENTER, powerdown_exit},
+            {CommandType::PD_ENTER, powerdown_to_exit},
+            {CommandType::REFRESH_SAME_BANK, powerdown_exit},
+            {CommandType::REFRESH_MANAGEMENT, powerdown_exit}};
 }
 
 }  // namespace dramsim3
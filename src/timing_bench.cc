@@ -0,0 +1,111 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "./../ext/headers/args.hxx"
+#include "channel_state.h"
+
+using namespace dramsim3;
+
+namespace {
+
+// times UpdateTiming on a random command stream and returns ns per command,
+// checksum is a digest of the resulting ready cycles
+double RunCommands(const Config& config, const Timing& timing,
+                   const std::vector<Command>& cmds, bool use_kernels,
+                   uint64_t& checksum) {
+    ChannelState channel_state(config, timing);
+    channel_state.UseTimingKernels(use_kernels);
+    auto start = std::chrono::steady_clock::now();
+    uint64_t clk = 0;
+    for (const auto& cmd : cmds) {
+        channel_state.UpdateTiming(cmd, clk);
+        clk += 2;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    checksum = 0;
+    for (int r = 0; r < config.ranks; r++) {
+        for (int g = 0; g < config.bankgroups; g++) {
+            for (int b = 0; b < config.banks_per_group; b++) {
+                Command read(CommandType::READ, Address(0, r, g, b, 0, 0), 0);
+                checksum = checksum * 31 + channel_state.GetReadyCycle(read);
+            }
+        }
+    }
+    std::chrono::duration<double, std::nano> elapsed = end - start;
+    return elapsed.count() / cmds.size();
+}
+
+}  // namespace
+
+int main(int argc, const char** argv) {
+    args::ArgumentParser parser(
+        "Micro-benchmark of the timing update kernels against the generic "
+        "timing list walk.",
+        "Example: \n"
+        "./build/timingbench configs/DDR4_8Gb_x8_2400.ini "
+        "configs/HBM2_8Gb_x128.ini -n 2000000");
+    args::HelpFlag help(parser, "help", "Display the help menu", {'h', "help"});
+    args::ValueFlag<uint64_t> num_cmds_arg(parser, "num_cmds",
+                                           "Number of commands, default 1M",
+                                           {'n', "num-cmds"}, 1000000);
+    args::PositionalList<std::string> configs_arg(
+        parser, "configs", "The config files (mandatory)");
+
+    try {
+        parser.ParseCLI(argc, argv);
+    } catch (args::Help) {
+        std::cout << parser;
+        return 0;
+    } catch (args::ParseError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    std::vector<std::string> configs = args::get(configs_arg);
+    if (configs.empty()) {
+        std::cerr << parser;
+        return 1;
+    }
+    uint64_t num_cmds = args::get(num_cmds_arg);
+
+    // a mix dominated by reads and writes like in a simulation
+    const CommandType mix[] = {
+        CommandType::READ,      CommandType::READ,     CommandType::READ,
+        CommandType::WRITE,     CommandType::WRITE,    CommandType::ACTIVATE,
+        CommandType::PRECHARGE, CommandType::READ_PRECHARGE,
+        CommandType::WRITE_PRECHARGE, CommandType::REFRESH_BANK,
+        CommandType::REFRESH};
+    const int mix_size = sizeof(mix) / sizeof(mix[0]);
+
+    int status = 0;
+    for (const auto& config_file : configs) {
+        Config config(config_file, ".");
+        Timing timing(config);
+        std::mt19937_64 rng(0);
+        std::vector<Command> cmds;
+        cmds.reserve(num_cmds);
+        for (uint64_t i = 0; i < num_cmds; i++) {
+            Address addr(0, rng() % config.ranks, rng() % config.bankgroups,
+                         rng() % config.banks_per_group, 0, 0);
+            cmds.emplace_back(mix[rng() % mix_size], addr, 0);
+        }
+
+        uint64_t generic_sum, kernel_sum;
+        double generic_ns = RunCommands(config, timing, cmds, false,
+                                        generic_sum);
+        double kernel_ns = RunCommands(config, timing, cmds, true, kernel_sum);
+        std::cout << config_file << ": " << config.ranks * config.banks
+                  << " banks, generic " << generic_ns << " ns/cmd, kernels "
+                  << kernel_ns << " ns/cmd, speedup "
+                  << generic_ns / kernel_ns << "x" << std::endl;
+        if (generic_sum != kernel_sum) {
+            std::cerr << "Timing kernels disagree with the timing lists for "
+                      << config_file << std::endl;
+            status = 1;
+        }
+    }
+    return status;
+}
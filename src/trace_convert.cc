@@ -0,0 +1,46 @@
+#include <iostream>
+#include "./../ext/headers/args.hxx"
+#include "trace_reader.h"
+
+using namespace dramsim3;
+
+int main(int argc, const char **argv) {
+    args::ArgumentParser parser(
+        "Convert a (compressed) trace into the binary trace format.",
+        "Example: \n"
+        "./build/traceconvert sample_trace.txt sample_trace.bin");
+    args::HelpFlag help(parser, "help", "Display the help menu", {'h', "help"});
+    args::Positional<std::string> input_arg(parser, "input",
+                                            "Text trace file (mandatory)");
+    args::Positional<std::string> output_arg(parser, "output",
+                                             "Binary trace file (mandatory)");
+
+    try {
+        parser.ParseCLI(argc, argv);
+    } catch (args::Help) {
+        std::cout << parser;
+        return 0;
+    } catch (args::ParseError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    std::string input_file = args::get(input_arg);
+    std::string output_file = args::get(output_arg);
+    if (input_file.empty() || output_file.empty()) {
+        std::cerr << parser;
+        return 1;
+    }
+
+    TraceReader* reader = MakeTraceReader(input_file, true);
+    BinaryTraceWriter writer(output_file);
+    Transaction trans;
+    while (reader->Next(trans)) {
+        writer.Write(trans);
+    }
+    delete reader;
+    std::cout << "Converted " << writer.NumRecords() << " records to "
+              << output_file << std::endl;
+    return 0;
+}
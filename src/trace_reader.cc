@@ -0,0 +1,495 @@
+#include "trace_reader.h"
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif  // HAVE_ZLIB
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif  // HAVE_ZSTD
+
+namespace dramsim3 {
+
+namespace {
+
+uint64_t ZigZagEncode(int64_t val) {
+    return (static_cast<uint64_t>(val) << 1) ^ static_cast<uint64_t>(val >> 63);
+}
+
+int64_t ZigZagDecode(uint64_t val) {
+    return static_cast<int64_t>(val >> 1) ^ -static_cast<int64_t>(val & 1);
+}
+
+uint64_t LoadLE(const uint8_t* p, int bytes) {
+    uint64_t val = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        val = (val << 8) | p[i];
+    }
+    return val;
+}
+
+void StoreLE(uint8_t* p, uint64_t val, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = static_cast<uint8_t>(val >> (8 * i));
+    }
+}
+
+bool IsSpace(char c) { return isspace(static_cast<unsigned char>(c)) != 0; }
+
+const size_t kReadBufferSize = 1 << 20;
+
+class FileTraceInput : public TraceInput {
+   public:
+    FileTraceInput(FILE* file) : file_(file) {}
+    ~FileTraceInput() { fclose(file_); }
+    size_t Read(uint8_t* buf, size_t len) override {
+        return fread(buf, 1, len, file_);
+    }
+
+   private:
+    FILE* file_;
+};
+
+#ifdef HAVE_ZLIB
+class GzipTraceInput : public TraceInput {
+   public:
+    GzipTraceInput(const std::string& file_name) {
+        file_ = gzopen(file_name.c_str(), "rb");
+        if (file_ == nullptr) {
+            std::cerr << "Cannot open " << file_name << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        gzbuffer(file_, 1 << 17);
+    }
+    ~GzipTraceInput() { gzclose(file_); }
+    size_t Read(uint8_t* buf, size_t len) override {
+        int ret = gzread(file_, buf, static_cast<unsigned>(len));
+        if (ret < 0) {
+            int err;
+            std::cerr << "gzip error: " << gzerror(file_, &err) << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        return static_cast<size_t>(ret);
+    }
+
+   private:
+    gzFile file_;
+};
+#endif  // HAVE_ZLIB
+
+#ifdef HAVE_ZSTD
+class ZstdTraceInput : public TraceInput {
+   public:
+    ZstdTraceInput(FILE* file)
+        : file_(file),
+          in_buf_(ZSTD_DStreamInSize()),
+          in_{in_buf_.data(), 0, 0},
+          stream_(ZSTD_createDStream()) {
+        ZSTD_initDStream(stream_);
+    }
+    ~ZstdTraceInput() {
+        ZSTD_freeDStream(stream_);
+        fclose(file_);
+    }
+    size_t Read(uint8_t* buf, size_t len) override {
+        ZSTD_outBuffer out = {buf, len, 0};
+        while (out.pos == 0) {
+            if (in_.pos == in_.size) {
+                in_.size = fread(in_buf_.data(), 1, in_buf_.size(), file_);
+                in_.pos = 0;
+                if (in_.size == 0) {
+                    break;
+                }
+            }
+            size_t ret = ZSTD_decompressStream(stream_, &out, &in_);
+            if (ZSTD_isError(ret)) {
+                std::cerr << "zstd error: " << ZSTD_getErrorName(ret)
+                          << std::endl;
+                AbruptExit(__FILE__, __LINE__);
+            }
+        }
+        return out.pos;
+    }
+
+   private:
+    FILE* file_;
+    std::vector<uint8_t> in_buf_;
+    ZSTD_inBuffer in_;
+    ZSTD_DStream* stream_;
+};
+#endif  // HAVE_ZSTD
+
+}  // namespace
+
+TraceInput* OpenTraceInput(const std::string& file_name, bool* compressed) {
+    FILE* file = fopen(file_name.c_str(), "rb");
+    if (file == nullptr) {
+        std::cerr << "Trace file does not exist" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    uint8_t magic[4] = {0, 0, 0, 0};
+    size_t len = fread(magic, 1, 4, file);
+    rewind(file);
+    bool is_gzip = len >= 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+    bool is_zstd = len == 4 && magic[0] == 0x28 && magic[1] == 0xb5 &&
+                   magic[2] == 0x2f && magic[3] == 0xfd;
+    if (compressed != nullptr) {
+        *compressed = is_gzip || is_zstd;
+    }
+    if (is_gzip) {
+#ifdef HAVE_ZLIB
+        fclose(file);
+        return new GzipTraceInput(file_name);
+#else
+        std::cerr << "Built without zlib, cannot read " << file_name
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+#endif  // HAVE_ZLIB
+    } else if (is_zstd) {
+#ifdef HAVE_ZSTD
+        return new ZstdTraceInput(file);
+#else
+        std::cerr << "Built without zstd, cannot read " << file_name
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+#endif  // HAVE_ZSTD
+    }
+    return new FileTraceInput(file);
+}
+
+TextTraceReader::TextTraceReader(const std::string& file_name)
+    : TextTraceReader(OpenTraceInput(file_name, nullptr)) {}
+
+TextTraceReader::TextTraceReader(TraceInput* input)
+    : input_(input),
+      buffer_(kReadBufferSize + 1),
+      pos_(0),
+      size_(0),
+      input_done_(false),
+      line_num_(0) {}
+
+TextTraceReader::~TextTraceReader() { delete (input_); }
+
+bool TextTraceReader::NextLine(char** line) {
+    while (true) {
+        char* start = buffer_.data() + pos_;
+        char* newline =
+            static_cast<char*>(memchr(start, '\n', size_ - pos_));
+        if (newline != nullptr) {
+            *newline = '\0';
+            *line = start;
+            pos_ = newline - buffer_.data() + 1;
+            return true;
+        }
+        if (input_done_) {
+            if (pos_ == size_) {
+                return false;
+            }
+            // last line without a newline
+            buffer_[size_] = '\0';
+            *line = start;
+            pos_ = size_;
+            return true;
+        }
+        // move the partial line to the front and read more behind it
+        size_t rest = size_ - pos_;
+        memmove(buffer_.data(), start, rest);
+        pos_ = 0;
+        size_ = rest;
+        if (size_ + 1 == buffer_.size()) {
+            buffer_.resize(buffer_.size() * 2);
+        }
+        size_t len = input_->Read(reinterpret_cast<uint8_t*>(buffer_.data()) +
+                                      size_,
+                                  buffer_.size() - 1 - size_);
+        input_done_ = len == 0;
+        size_ += len;
+    }
+}
+
+bool TextTraceReader::Next(Transaction& trans) {
+    char* line;
+    while (NextLine(&line)) {
+        line_num_++;
+        const char* p = line;
+        while (IsSpace(*p)) {
+            p++;
+        }
+        if (*p == '\0') {
+            continue;
+        }
+        char* end;
+        trans.addr = strtoull(p, &end, 16);
+        bool ok = end != p;
+        p = end;
+        while (IsSpace(*p)) {
+            p++;
+        }
+        const char* op = p;
+        while (*p != '\0' && !IsSpace(*p)) {
+            p++;
+        }
+        op_.assign(op, p - op);
+        trans.added_cycle = strtoull(p, &end, 10);
+        if (!ok || end == p || op_.empty()) {
+            std::cerr << "Malformed trace line " << line_num_ << ": " << line
+                      << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        trans.is_write = IsWriteOp(op_);
+        return true;
+    }
+    return false;
+}
+
+BinaryTraceReader::BinaryTraceReader(const std::string& file_name)
+    : input_(nullptr), records_read_(0), addr_(0), cycle_(0) {
+    fd_ = open(file_name.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        std::cerr << "Trace file does not exist" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    struct stat st;
+    fstat(fd_, &st);
+    map_size_ = static_cast<size_t>(st.st_size);
+    if (map_size_ < kBinaryTraceHeaderSize) {
+        std::cerr << "Binary trace " << file_name << " is truncated"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    void* data = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (data == MAP_FAILED) {
+        std::cerr << "Cannot map trace file " << file_name << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    // records are only read once front to back
+    madvise(data, map_size_, MADV_SEQUENTIAL);
+    map_data_ = static_cast<const uint8_t*>(data);
+    cur_ = map_data_;
+    end_ = map_data_ + map_size_;
+    ReadHeader();
+}
+
+BinaryTraceReader::BinaryTraceReader(TraceInput* input)
+    : fd_(-1),
+      map_size_(0),
+      map_data_(nullptr),
+      input_(input),
+      buffer_(kReadBufferSize),
+      records_read_(0),
+      addr_(0),
+      cycle_(0) {
+    cur_ = buffer_.data();
+    end_ = buffer_.data();
+    ReadHeader();
+}
+
+BinaryTraceReader::~BinaryTraceReader() {
+    if (map_data_ != nullptr) {
+        munmap(const_cast<uint8_t*>(map_data_), map_size_);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+    delete (input_);
+}
+
+void BinaryTraceReader::ReadHeader() {
+    uint8_t header[kBinaryTraceHeaderSize];
+    for (size_t i = 0; i < kBinaryTraceHeaderSize; i++) {
+        header[i] = ReadByte();
+    }
+    if (memcmp(header, kBinaryTraceMagic, 4) != 0 ||
+        LoadLE(header + 4, 4) != kBinaryTraceVersion) {
+        std::cerr << "Unsupported binary trace" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    num_records_ = LoadLE(header + 8, 8);
+}
+
+bool BinaryTraceReader::Refill() {
+    if (input_ == nullptr) {
+        return false;
+    }
+    size_t len = input_->Read(buffer_.data(), buffer_.size());
+    cur_ = buffer_.data();
+    end_ = buffer_.data() + len;
+    return len > 0;
+}
+
+uint8_t BinaryTraceReader::ReadByte() {
+    if (cur_ == end_ && !Refill()) {
+        std::cerr << "Truncated binary trace at record " << records_read_
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    return *cur_++;
+}
+
+uint64_t BinaryTraceReader::ReadVarint() {
+    uint64_t val = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = ReadByte();
+        val |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return val;
+        }
+    }
+    std::cerr << "Corrupted binary trace at record " << records_read_
+              << std::endl;
+    AbruptExit(__FILE__, __LINE__);
+    return 0;
+}
+
+bool BinaryTraceReader::Next(Transaction& trans) {
+    if (records_read_ == num_records_) {
+        return false;
+    }
+    addr_ += static_cast<uint64_t>(ZigZagDecode(ReadVarint()));
+    uint64_t cycle_op = ReadVarint();
+    cycle_ += cycle_op >> 1;
+    trans.addr = addr_;
+    trans.added_cycle = cycle_;
+    trans.is_write = (cycle_op & 1) == 1;
+    records_read_++;
+    return true;
+}
+
+BinaryTraceWriter::BinaryTraceWriter(const std::string& file_name)
+    : num_records_(0), addr_(0), cycle_(0) {
+    file_.open(file_name, std::ofstream::out | std::ofstream::binary);
+    if (file_.fail()) {
+        std::cerr << "Cannot open " << file_name << " for writing"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    // the record count is filled in on close
+    buffer_.resize(kBinaryTraceHeaderSize, 0);
+    memcpy(buffer_.data(), kBinaryTraceMagic, 4);
+    StoreLE(buffer_.data() + 4, kBinaryTraceVersion, 4);
+}
+
+BinaryTraceWriter::~BinaryTraceWriter() {
+    Flush();
+    uint8_t count[8];
+    StoreLE(count, num_records_, 8);
+    file_.seekp(8);
+    file_.write(reinterpret_cast<const char*>(count), 8);
+    file_.close();
+}
+
+void BinaryTraceWriter::WriteVarint(uint64_t val) {
+    while (val >= 0x80) {
+        buffer_.push_back(static_cast<uint8_t>(val) | 0x80);
+        val >>= 7;
+    }
+    buffer_.push_back(static_cast<uint8_t>(val));
+}
+
+void BinaryTraceWriter::Write(const Transaction& trans) {
+    uint64_t cycle = std::max(trans.added_cycle, cycle_);
+    if (cycle - cycle_ >= (1ull << 63)) {
+        std::cerr << "Cycle gap too large to encode" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    WriteVarint(ZigZagEncode(static_cast<int64_t>(trans.addr - addr_)));
+    WriteVarint(((cycle - cycle_) << 1) | (trans.is_write ? 1 : 0));
+    addr_ = trans.addr;
+    cycle_ = cycle;
+    num_records_++;
+    if (buffer_.size() >= (1 << 20)) {
+        Flush();
+    }
+}
+
+void BinaryTraceWriter::Flush() {
+    file_.write(reinterpret_cast<const char*>(buffer_.data()), buffer_.size());
+    buffer_.clear();
+}
+
+AsyncTraceReader::AsyncTraceReader(TraceReader* reader)
+    : reader_(reader),
+      ring_(1 << 16),
+      done_(false),
+      stop_(false),
+      thread_(&AsyncTraceReader::Produce, this) {}
+
+AsyncTraceReader::~AsyncTraceReader() {
+    stop_.store(true, std::memory_order_relaxed);
+    thread_.join();
+    delete (reader_);
+}
+
+void AsyncTraceReader::Produce() {
+    Transaction trans;
+    while (reader_->Next(trans)) {
+        while (!ring_.Push(trans)) {
+            if (stop_.load(std::memory_order_relaxed)) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+    done_.store(true, std::memory_order_release);
+}
+
+bool AsyncTraceReader::Next(Transaction& trans) {
+    while (!ring_.Pop(trans)) {
+        if (done_.load(std::memory_order_acquire)) {
+            // everything pushed before done_ was set is visible now
+            return ring_.Pop(trans);
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+TraceReader* MakeTraceReader(const std::string& file_name, bool async) {
+    bool compressed = false;
+    TraceInput* input = OpenTraceInput(file_name, &compressed);
+    uint8_t magic[4] = {0, 0, 0, 0};
+    size_t len = 0;
+    while (len < 4) {
+        size_t ret = input->Read(magic + len, 4 - len);
+        if (ret == 0) {
+            break;
+        }
+        len += ret;
+    }
+    delete (input);
+
+    TraceReader* reader;
+    if (len == 4 && memcmp(magic, kBinaryTraceMagic, 4) == 0) {
+        if (compressed) {
+            reader = new BinaryTraceReader(OpenTraceInput(file_name, nullptr));
+        } else {
+            reader = new BinaryTraceReader(file_name);
+        }
+    } else {
+        reader = new TextTraceReader(OpenTraceInput(file_name, nullptr));
+    }
+    if (async) {
+        reader = new AsyncTraceReader(reader);
+    }
+    return reader;
+}
+
+std::vector<Transaction> DecodeTrace(const std::string& file_name) {
+    TraceReader* reader = MakeTraceReader(file_name, true);
+    std::vector<Transaction> trace;
+    Transaction trans;
+    while (reader->Next(trans)) {
+        trace.push_back(trans);
+    }
+    delete (reader);
+    return trace;
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,195 @@
+#ifndef __TRACE_READER_H
+#define __TRACE_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.h"
+
+namespace dramsim3 {
+
+// Binary trace format, all integers little endian:
+//   header: "DS3T", uint32 version, uint64 number of records
+//   record: varint zigzag(addr - prev_addr),
+//           varint (cycle - prev_cycle) << 1 | is_write
+// Cycles are made non-decreasing on conversion, which replays the same way
+// because a record is never issued before the one in front of it.
+constexpr char kBinaryTraceMagic[4] = {'D', 'S', '3', 'T'};
+constexpr uint32_t kBinaryTraceVersion = 1;
+constexpr size_t kBinaryTraceHeaderSize = 16;
+
+// Sequential byte source of a trace file, gzip (HAVE_ZLIB) and zstd
+// (HAVE_ZSTD) compressed files are decompressed on the fly
+class TraceInput {
+   public:
+    virtual ~TraceInput() {}
+    // read up to len bytes, returns 0 at the end of the input
+    virtual size_t Read(uint8_t* buf, size_t len) = 0;
+};
+
+// picks the decompressor from the leading bytes of the file
+TraceInput* OpenTraceInput(const std::string& file_name, bool* compressed);
+
+class TraceReader {
+   public:
+    virtual ~TraceReader() {}
+    // read the next transaction, returns false at the end of the trace
+    virtual bool Next(Transaction& trans) = 0;
+};
+
+// "<hex addr> <op> <cycle>" per line
+class TextTraceReader : public TraceReader {
+   public:
+    TextTraceReader(const std::string& file_name);
+    TextTraceReader(TraceInput* input);
+    ~TextTraceReader();
+    bool Next(Transaction& trans) override;
+
+   private:
+    TraceInput* input_;
+    std::vector<char> buffer_;
+    size_t pos_;
+    size_t size_;
+    bool input_done_;
+    uint64_t line_num_;
+    std::string op_;
+    bool NextLine(char** line);
+};
+
+// memory maps uncompressed traces, streams compressed ones
+class BinaryTraceReader : public TraceReader {
+   public:
+    BinaryTraceReader(const std::string& file_name);
+    BinaryTraceReader(TraceInput* input);
+    ~BinaryTraceReader();
+    bool Next(Transaction& trans) override;
+
+   private:
+    int fd_;
+    size_t map_size_;
+    const uint8_t* map_data_;
+    TraceInput* input_;
+    std::vector<uint8_t> buffer_;
+    const uint8_t* cur_;
+    const uint8_t* end_;
+    uint64_t num_records_;
+    uint64_t records_read_;
+    uint64_t addr_;
+    uint64_t cycle_;
+    void ReadHeader();
+    bool Refill();
+    uint8_t ReadByte();
+    uint64_t ReadVarint();
+};
+
+class BinaryTraceWriter {
+   public:
+    BinaryTraceWriter(const std::string& file_name);
+    ~BinaryTraceWriter();
+    void Write(const Transaction& trans);
+    uint64_t NumRecords() const { return num_records_; }
+
+   private:
+    std::ofstream file_;
+    std::vector<uint8_t> buffer_;
+    uint64_t num_records_;
+    uint64_t addr_;
+    uint64_t cycle_;
+    void WriteVarint(uint64_t val);
+    void Flush();
+};
+
+// Lock-free single producer single consumer ring buffer
+template <typename T>
+class SPSCRing {
+   public:
+    SPSCRing(size_t capacity) : head_(0), tail_(0) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        ring_.resize(size);
+        mask_ = size - 1;
+    }
+
+    // producer side, false if the ring is full
+    bool Push(const T& item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == ring_.size()) {
+            return false;
+        }
+        ring_[tail & mask_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, false if the ring is empty
+    bool Pop(T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = ring_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+   private:
+    std::vector<T> ring_;
+    size_t mask_;
+    // keep the two indices on separate cache lines
+    char pad_head_[64];
+    std::atomic<size_t> head_;
+    char pad_tail_[64];
+    std::atomic<size_t> tail_;
+};
+
+// Runs another reader on a background thread so that decompression and
+// parsing overlap with simulation
+class AsyncTraceReader : public TraceReader {
+   public:
+    AsyncTraceReader(TraceReader* reader);
+    ~AsyncTraceReader();
+    bool Next(Transaction& trans) override;
+
+   private:
+    TraceReader* reader_;
+    SPSCRing<Transaction> ring_;
+    std::atomic<bool> done_;
+    std::atomic<bool> stop_;
+    std::thread thread_;
+    void Produce();
+};
+
+// Replays a trace that was decoded into memory once, any number of readers
+// can share it
+class VectorTraceReader : public TraceReader {
+   public:
+    VectorTraceReader(const std::vector<Transaction>& trace)
+        : trace_(trace), pos_(0) {}
+    bool Next(Transaction& trans) override {
+        if (pos_ == trace_.size()) {
+            return false;
+        }
+        trans = trace_[pos_++];
+        return true;
+    }
+
+   private:
+    const std::vector<Transaction>& trace_;
+    size_t pos_;
+};
+
+// opens a binary or text trace depending on its (decompressed) leading
+// bytes, async moves reading onto a background thread
+TraceReader* MakeTraceReader(const std::string& file_name, bool async);
+
+// decodes the whole trace into memory
+std::vector<Transaction> DecodeTrace(const std::string& file_name);
+
+}  // namespace dramsim3
+#endif
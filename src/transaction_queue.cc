@@ -0,0 +1,131 @@
+#include "transaction_queue.h"
+
+namespace dramsim3 {
+
+TransactionQueue::TransactionQueue(int capacity, int num_cmd_queues)
+    : chains_(num_cmd_queues, Chain{-1, -1, -1}),
+      capacity_(capacity),
+      num_entries_(0),
+      free_head_(-1),
+      next_seq_(0) {
+    active_queues_.reserve(num_cmd_queues);
+}
+
+int TransactionQueue::AllocEntry() {
+    if (free_head_ < 0) {
+        // the pool grows up to the largest number of waiting transactions
+        // and is reused after that
+        entries_.push_back(Entry());
+        return static_cast<int>(entries_.size()) - 1;
+    }
+    int idx = free_head_;
+    free_head_ = entries_[idx].next;
+    return idx;
+}
+
+void TransactionQueue::Push(const Transaction& trans) {
+    int idx = AllocEntry();
+    Entry& entry = entries_[idx];
+    entry.trans = trans;
+    entry.seq = next_seq_++;
+    entry.next = -1;
+    num_entries_++;
+
+    Chain& chain = chains_[trans.queue_idx];
+    if (chain.head < 0) {
+        chain.head = idx;
+        chain.active_pos = static_cast<int>(active_queues_.size());
+        active_queues_.push_back(trans.queue_idx);
+    } else {
+        entries_[chain.tail].next = idx;
+    }
+    chain.tail = idx;
+}
+
+bool TransactionQueue::HasOlderToAddr(int head, int idx) const {
+    uint64_t addr = entries_[idx].trans.addr;
+    for (int i = head; i != idx; i = entries_[i].next) {
+        if (entries_[i].trans.addr == addr) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TransactionQueue::PopFront(int queue_idx) {
+    Chain& chain = chains_[queue_idx];
+    if (chain.head < 0) {
+        return;
+    }
+    int idx = chain.head;
+    chain.head = entries_[idx].next;
+    entries_[idx].next = free_head_;
+    free_head_ = idx;
+    num_entries_--;
+    if (chain.head < 0) {
+        int last = active_queues_.back();
+        active_queues_[chain.active_pos] = last;
+        chains_[last].active_pos = chain.active_pos;
+        active_queues_.pop_back();
+        chain.tail = -1;
+        chain.active_pos = -1;
+    }
+}
+
+void TransactionQueue::Remove(const Transaction* trans) {
+    int queue_idx = trans->queue_idx;
+    Chain& chain = chains_[queue_idx];
+    int prev = -1;
+    int idx = chain.head;
+    while (idx >= 0 && &entries_[idx].trans != trans) {
+        prev = idx;
+        idx = entries_[idx].next;
+    }
+    if (idx < 0) {
+        return;
+    } else if (prev < 0) {
+        PopFront(queue_idx);
+        return;
+    }
+    entries_[prev].next = entries_[idx].next;
+    if (chain.tail == idx) {
+        chain.tail = prev;
+    }
+    entries_[idx].next = free_head_;
+    free_head_ = idx;
+    num_entries_--;
+}
+
+void TransactionQueue::Save(CheckpointWriter& writer) const {
+    writer.Put(static_cast<uint64_t>(entries_.size()));
+    for (const auto& entry : entries_) {
+        writer.Put(entry.trans);
+        writer.Put(entry.seq);
+        writer.Put(entry.next);
+    }
+    writer.Put(chains_);
+    writer.Put(active_queues_);
+    writer.Put(num_entries_);
+    writer.Put(free_head_);
+    writer.Put(next_seq_);
+    return;
+}
+
+void TransactionQueue::Restore(CheckpointReader& reader) {
+    uint64_t num_entries;
+    reader.Get(num_entries);
+    entries_.resize(num_entries);
+    for (auto& entry : entries_) {
+        reader.Get(entry.trans);
+        reader.Get(entry.seq);
+        reader.Get(entry.next);
+    }
+    reader.Get(chains_);
+    reader.Get(active_queues_);
+    reader.Get(num_entries_);
+    reader.Get(free_head_);
+    reader.Get(next_seq_);
+    return;
+}
+
+}  // namespace dramsim3
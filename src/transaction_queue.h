@@ -0,0 +1,110 @@
+#ifndef __TRANSACTION_QUEUE_H
+#define __TRANSACTION_QUEUE_H
+
+#include <stdint.h>
+#include <vector>
+#include "checkpoint.h"
+#include "common.h"
+
+namespace dramsim3 {
+
+// Transactions waiting to move into the command queues. Besides the arrival
+// order the transactions are chained per command queue (Transaction::
+// queue_idx), so finding the oldest transaction that can move only looks at
+// the first waiting transaction of every command queue instead of scanning
+// past all transactions of the full ones. Entries come from a fixed pool.
+class TransactionQueue {
+   public:
+    TransactionQueue(int capacity, int num_cmd_queues);
+    // trans.queue_idx must be set
+    void Push(const Transaction& trans);
+    // oldest transaction of the command queues accept(queue_idx) holds for,
+    // nullptr if there is none
+    template <typename Accept>
+    const Transaction* Oldest(Accept accept) const;
+    // best transaction by less(a, b) (a is better than b) of the command
+    // queues accept(queue_idx) holds for, ties go to the older one. This
+    // looks at all waiting transactions, one never passes an older one to
+    // the same address. nullptr if there is none
+    template <typename Accept, typename Less>
+    const Transaction* Best(Accept accept, Less less) const;
+    // remove the oldest transaction waiting for command queue queue_idx
+    void PopFront(int queue_idx);
+    // remove a transaction returned by Oldest or Best
+    void Remove(const Transaction* trans);
+    size_t Size() const { return num_entries_; }
+    size_t Capacity() const { return capacity_; }
+    bool Empty() const { return num_entries_ == 0; }
+    // the pool with its chains to/from a checkpoint
+    void Save(CheckpointWriter& writer) const;
+    void Restore(CheckpointReader& reader);
+
+   private:
+    struct Entry {
+        Transaction trans;
+        uint64_t seq;
+        int next;
+    };
+
+    struct Chain {
+        int head;  // -1 if no transaction waits for the command queue
+        int tail;
+        int active_pos;  // position in active_queues_
+    };
+
+    std::vector<Entry> entries_;
+    std::vector<Chain> chains_;
+    // command queues that have waiting transactions, in no particular order
+    std::vector<int> active_queues_;
+    size_t capacity_;
+    size_t num_entries_;
+    int free_head_;
+    uint64_t next_seq_;
+
+    int AllocEntry();
+    // whether an entry before idx in its chain has the same address
+    bool HasOlderToAddr(int head, int idx) const;
+};
+
+template <typename Accept>
+const Transaction* TransactionQueue::Oldest(Accept accept) const {
+    const Entry* oldest = nullptr;
+    for (int queue_idx : active_queues_) {
+        const Entry& entry = entries_[chains_[queue_idx].head];
+        if ((oldest == nullptr || entry.seq < oldest->seq) &&
+            accept(queue_idx)) {
+            oldest = &entry;
+        }
+    }
+    return oldest == nullptr ? nullptr : &oldest->trans;
+}
+
+template <typename Accept, typename Less>
+const Transaction* TransactionQueue::Best(Accept accept, Less less) const {
+    const Entry* best = nullptr;
+    for (int queue_idx : active_queues_) {
+        if (!accept(queue_idx)) {
+            continue;
+        }
+        int head = chains_[queue_idx].head;
+        for (int idx = head; idx >= 0; idx = entries_[idx].next) {
+            const Entry& entry = entries_[idx];
+            if (best != nullptr) {
+                if (less(best->trans, entry.trans)) {
+                    continue;
+                }
+                if (!less(entry.trans, best->trans) && best->seq < entry.seq) {
+                    continue;
+                }
+            }
+            if (idx != head && HasOlderToAddr(head, idx)) {
+                continue;
+            }
+            best = &entry;
+        }
+    }
+    return best == nullptr ? nullptr : &best->trans;
+}
+
+}  // namespace dramsim3
+#endif
@@ -0,0 +1,69 @@
+#include "worker_pool.h"
+
+namespace dramsim3 {
+
+WorkerPool::WorkerPool(int num_threads)
+    : num_threads_(num_threads),
+      job_(nullptr),
+      generation_(0),
+      pending_(0),
+      stop_(false) {
+    threads_.reserve(num_threads_ - 1);
+    for (int i = 1; i < num_threads_; i++) {
+        threads_.emplace_back(&WorkerPool::WorkerLoop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkerPool::Run(const std::function<void(int)>& job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &job;
+        pending_ = num_threads_ - 1;
+        generation_++;
+    }
+    start_cv_.notify_all();
+    job(0);
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return pending_ == 0; });
+    job_ = nullptr;
+    return;
+}
+
+void WorkerPool::WorkerLoop(int worker_id) {
+    uint64_t seen_generation = 0;
+    while (true) {
+        const std::function<void(int)>* job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_cv_.wait(lock, [this, seen_generation] {
+                return stop_ || generation_ != seen_generation;
+            });
+            if (stop_) {
+                return;
+            }
+            seen_generation = generation_;
+            job = job_;
+        }
+        (*job)(worker_id);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_--;
+            if (pending_ == 0) {
+                done_cv_.notify_one();
+            }
+        }
+    }
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,38 @@
+#ifndef __WORKER_POOL_H
+#define __WORKER_POOL_H
+
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dramsim3 {
+
+// A persistent pool of threads that run the same job in lockstep, the
+// calling thread takes part as worker 0 so that N threads means N-1 spawned
+class WorkerPool {
+   public:
+    WorkerPool(int num_threads);
+    ~WorkerPool();
+    // run job(worker_id) on every worker, returns after all of them finished
+    void Run(const std::function<void(int)>& job);
+    int NumThreads() const { return num_threads_; }
+
+   private:
+    void WorkerLoop(int worker_id);
+
+    int num_threads_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const std::function<void(int)>* job_;
+    uint64_t generation_;
+    int pending_;
+    bool stop_;
+};
+
+}  // namespace dramsim3
+#endif
@@ -0,0 +1,48 @@
+#include "catch.hpp"
+#include "completion_queue.h"
+
+TEST_CASE("Completion Queue Testing", "[completion]") {
+    dramsim3::CompletionQueue queue;
+    std::vector<dramsim3::Transaction> done;
+
+    SECTION("TEST popping in (complete_cycle, arrival) order") {
+        uint64_t cycles[] = {12, 10, 12, 11, 10};
+        for (uint64_t i = 0; i < 5; i++) {
+            dramsim3::Transaction trans(i << 6, false);
+            trans.complete_cycle = cycles[i];
+            queue.Push(trans);
+        }
+        REQUIRE(queue.NextCycle() == 10);
+        queue.PopDone(9, done);
+        REQUIRE(done.empty());
+        queue.PopDone(11, done);
+        REQUIRE(done.size() == 3);
+        REQUIRE(done[0].addr == (1 << 6));
+        REQUIRE(done[1].addr == (4 << 6));
+        REQUIRE(done[2].addr == (3 << 6));
+        REQUIRE(queue.NextCycle() == 12);
+        queue.PopDone(12, done);
+        REQUIRE(done.size() == 5);
+        REQUIRE(done[3].addr == 0);
+        REQUIRE(done[4].addr == (2 << 6));
+        REQUIRE(queue.Empty());
+        REQUIRE(queue.NextCycle() == UINT64_MAX);
+    }
+
+    SECTION("TEST many completions of the same cycle") {
+        for (uint64_t i = 0; i < 1000; i++) {
+            dramsim3::Transaction trans(i << 6, i % 2 == 0);
+            trans.complete_cycle = 100 + i % 3;
+            queue.Push(trans);
+        }
+        queue.PopDone(102, done);
+        REQUIRE(done.size() == 1000);
+        for (size_t i = 1; i < done.size(); i++) {
+            const auto &prev = done[i - 1];
+            const auto &trans = done[i];
+            REQUIRE((prev.complete_cycle < trans.complete_cycle ||
+                     (prev.complete_cycle == trans.complete_cycle &&
+                      prev.addr < trans.addr)));
+        }
+    }
+}
@@ -1,4 +1,6 @@
 #define CATCH_CONFIG_MAIN
+#include <string>
+#include <vector>
 #include "catch.hpp"
 #include "configuration.h"
 
@@ -93,3 +95,78 @@ TEST_CASE("Address Mapping", "[config]") {
     }
 }
 
+
+TEST_CASE("Address mapper", "[config]") {
+    using dramsim3::AddressMapper;
+    // scattered fields: every other bit goes to the column
+    std::vector<uint64_t> masks = {0x3000,     0x0,   0x500, 0xA00,
+                                   0xFF0000ULL, 0x0AA};
+    std::vector<std::vector<uint64_t>> no_xor(AddressMapper::NUM_FIELDS);
+
+    SECTION("pext and table gather agree") {
+        AddressMapper pext, table;
+        pext.Init(masks, no_xor);
+        table.Init(masks, no_xor, false);
+        REQUIRE(std::string(table.ModeName()) == "table");
+        for (uint64_t hex_addr = 0; hex_addr < 0x1000000; hex_addr += 0x1357) {
+            auto a = pext.Decode(hex_addr);
+            auto b = table.Decode(hex_addr);
+            REQUIRE(a.channel == b.channel);
+            REQUIRE(a.bankgroup == b.bankgroup);
+            REQUIRE(a.bank == b.bank);
+            REQUIRE(a.row == b.row);
+            REQUIRE(a.column == b.column);
+            REQUIRE(pext.Channel(hex_addr) == a.channel);
+            REQUIRE(table.Channel(hex_addr) == a.channel);
+        }
+        auto addr = table.Decode(0x2A22);
+        REQUIRE(addr.channel == 2);
+        REQUIRE(addr.bankgroup == 0);
+        REQUIRE(addr.bank == 3);
+        REQUIRE(addr.column == 0b0101);
+    }
+
+    SECTION("XOR hashing") {
+        std::vector<uint64_t> contiguous = {0x40, 0x0, 0x0, 0x180,
+                                            0xFFFF0000ULL, 0x3F};
+        auto hash = no_xor;
+        hash[AddressMapper::CH] = {0x10000};
+        hash[AddressMapper::BA] = {0x20000, 0x40000 | 0x80000};
+        AddressMapper mapper;
+        mapper.Init(contiguous, hash);
+        REQUIRE(std::string(mapper.ModeName()) == "shift");
+        REQUIRE(mapper.Decode(0x0).channel == 0);
+        REQUIRE(mapper.Decode(0x10000).channel == 1);
+        REQUIRE(mapper.Decode(0x10040).channel == 0);
+        REQUIRE(mapper.Channel(0x10000) == 1);
+        REQUIRE(mapper.Decode(0x20000).bank == 1);
+        REQUIRE(mapper.Decode(0x40000).bank == 2);
+        REQUIRE(mapper.Decode(0xC0000).bank == 0);
+        REQUIRE(mapper.Decode(0xC0180).bank == 3);
+        REQUIRE(mapper.Decode(0xC0180).row == 0xC);
+    }
+}
+
+TEST_CASE("Sub-channels", "[config]") {
+    SECTION("DDR5 sub-channels are channels of their own") {
+        dramsim3::Config config("configs/DDR5_16Gb_x8_4800.ini", ".");
+        REQUIRE(config.sub_channels == 2);
+        REQUIRE(config.channels == 2);
+        REQUIRE(config.channel_size == 8192);
+        REQUIRE(config.bankgroups == 8);
+        REQUIRE(config.burst_cycle == 8);
+        REQUIRE(config.request_size_bytes == 64);
+        // the sub-channel bit sits right above the column
+        REQUIRE(config.AddressMapping(0x0).channel == 0);
+        REQUIRE(config.AddressMapping(0x40).channel == 0);
+        REQUIRE(config.AddressMapping(0x1000).channel == 1);
+    }
+
+    SECTION("HBM3 pseudo channels") {
+        dramsim3::Config config("configs/HBM3_16Gb_x64.ini", ".");
+        REQUIRE(config.channels == 32);
+        REQUIRE(config.burst_cycle == 2);
+        REQUIRE(config.request_size_bytes == 32);
+        REQUIRE(config.enable_hbm_dual_cmd);
+    }
+}
@@ -0,0 +1,95 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "configuration.h"
+#include "memory_system.h"
+
+namespace {
+
+void drain_call_back(uint64_t addr) { return; }
+
+// the DDR4 config draining writes between the watermarks 2 and 8 in
+// batches of 4 or more
+std::string WatermarkConfig() {
+    std::string file_name = "test_controller_watermarks.ini";
+    std::ifstream base("configs/DDR4_8Gb_x8_2400.ini");
+    std::ofstream config(file_name);
+    config << base.rdbuf() << "\n[system]\nwrite_high_watermark = 8\n"
+           << "write_low_watermark = 2\nwrite_min_batch = 4\n";
+    return file_name;
+}
+
+// addresses of different rows of rank 0, bankgroup bankgroup and bank 0
+std::vector<uint64_t> RowAddresses(const dramsim3::Config& config,
+                                   int bankgroup, int num_rows) {
+    std::vector<uint64_t> addrs;
+    for (uint64_t row = 1; static_cast<int>(addrs.size()) < num_rows; row++) {
+        uint64_t hex_addr =
+            (row << (config.ro_pos + config.shift_bits)) |
+            (static_cast<uint64_t>(bankgroup)
+             << (config.bg_pos + config.shift_bits));
+        auto addr = config.AddressMapping(hex_addr);
+        REQUIRE(addr.row == static_cast<int>(row));
+        REQUIRE(addr.bankgroup == bankgroup);
+        addrs.push_back(hex_addr);
+    }
+    return addrs;
+}
+
+void Run(dramsim3::MemorySystem& memory_system, int cycles) {
+    for (int i = 0; i < cycles; i++) {
+        memory_system.ClockTick();
+    }
+}
+
+}  // namespace
+
+TEST_CASE("Watermark write drain", "[controller]") {
+    std::string config_file = WatermarkConfig();
+    dramsim3::Config config(config_file, ".");
+    dramsim3::MemorySystem memory_system(config_file, ".", drain_call_back,
+                                         drain_call_back);
+    std::remove(config_file.c_str());
+    auto writes = RowAddresses(config, 1, 12);
+    auto reads = RowAddresses(config, 0, config.trans_queue_size);
+
+    // without reads the writes above the low watermark drain, and the
+    // minimum batch takes the drain below it
+    for (int i = 0; i < 3; i++) {
+        REQUIRE(memory_system.AddTransaction(writes[i], true));
+    }
+    Run(memory_system, 500);
+    // at the low watermark nothing drains
+    for (int i = 3; i < 5; i++) {
+        REQUIRE(memory_system.AddTransaction(writes[i], true));
+    }
+    Run(memory_system, 500);
+    // with reads waiting only the high watermark starts a drain, which
+    // goes on down to the low watermark
+    for (uint64_t addr : reads) {
+        REQUIRE(memory_system.AddTransaction(addr, false));
+    }
+    Run(memory_system, 10);
+    for (int i = 5; i < 11; i++) {
+        REQUIRE(memory_system.AddTransaction(writes[i], true));
+        Run(memory_system, 10);
+    }
+    Run(memory_system, 5000);
+
+    memory_system.PrintStats();
+    std::ifstream json_file("dramsim3.json");
+    nlohmann::json stats;
+    json_file >> stats;
+    const auto& channel = stats["0"];
+    REQUIRE(channel["num_write_drains"] == 2);
+    // writes are done once buffered, two of them never reach the DRAM
+    REQUIRE(channel["num_writes_done"] == 11);
+    REQUIRE(channel["num_write_cmds"] == 3 + 6);
+    REQUIRE(channel["num_reads_done"] == reads.size());
+    // the first column command is a write and the last one a read
+    REQUIRE(channel["num_wr_turnarounds"] >= 1);
+    REQUIRE(channel["num_wr_turnarounds"].get<int>() ==
+            channel["num_rw_turnarounds"].get<int>() + 1);
+}
@@ -0,0 +1,40 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "cpu.h"
+
+uint64_t CyclesUntilDone(const std::string& trace_file, int mshrs) {
+    dramsim3::CoreParams params;
+    params.mshrs = mshrs;
+    dramsim3::MultiCoreTraceCPU cpu("configs/DDR4_8Gb_x8_2400.ini", ".",
+                                    {trace_file, trace_file}, params);
+    uint64_t clk = 0;
+    while (!cpu.Done()) {
+        cpu.ClockTick();
+        clk++;
+        REQUIRE(clk < 1000000);
+    }
+    return clk;
+}
+
+TEST_CASE("Multi-core Trace CPU Testing", "[cpu]") {
+    std::string trace_file = "test_cpu.trace";
+    std::ofstream trace(trace_file);
+    // independent reads to different rows, all ready at once
+    for (int i = 0; i < 200; i++) {
+        trace << "0x" << std::hex << (i * 0x1234567ull) << " READ 0\n";
+    }
+    trace.close();
+
+    SECTION("TEST cores wait for their reads") {
+        uint64_t serial = CyclesUntilDone(trace_file, 1);
+        uint64_t parallel = CyclesUntilDone(trace_file, 16);
+        // a read takes at least tRCD + tCL once serialized
+        REQUIRE(serial > 200 * 30);
+        REQUIRE(parallel * 2 < serial);
+    }
+
+    std::remove(trace_file.c_str());
+}
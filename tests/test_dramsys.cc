@@ -1,6 +1,13 @@
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
 #include "catch.hpp"
 #include "configuration.h"
 #include "dram_system.h"
+#include "memory_system.h"
 
 bool call_back_called = false;
 void dummy_call_back(uint64_t addr) {
@@ -30,3 +37,536 @@ TEST_CASE("Jedec DRAMSystem Testing", "[dramsim3]") {
         REQUIRE(clk == tRC);
     }
 }
+
+TEST_CASE("Event driven DRAMSystem Testing", "[dramsim3]") {
+    dramsim3::Config config("configs/HBM1_4Gb_x128.ini", ".");
+    config.event_driven = true;
+
+    dramsim3::JedecDRAMSystem dramsys(config, ".", dummy_call_back,
+                                      dummy_call_back);
+
+    SECTION("TEST idle cycles do not change read latency") {
+        for (int i = 0; i < 5000; i++) {
+            dramsys.ClockTick();
+        }
+        call_back_called = false;
+        dramsys.AddTransaction(1, false);
+        int clk = 0;
+        while (true) {
+            dramsys.ClockTick();
+            clk++;
+            if (call_back_called) {
+                call_back_called = false;
+                break;
+            }
+        }
+
+        int tRC = config.tRCDRD + config.CL + config.BL;
+        REQUIRE(clk == tRC);
+    }
+}
+
+TEST_CASE("Batched DRAMSystem Testing", "[dramsim3]") {
+    dramsim3::Config config("configs/HBM1_4Gb_x128.ini", ".");
+
+    dramsim3::JedecDRAMSystem dramsys(config, ".", nullptr, nullptr);
+
+    SECTION("TEST completions are drained with their request ids") {
+        std::vector<dramsim3::Request> reqs;
+        for (int i = 0; i < 4; i++) {
+            reqs.emplace_back(i << 12, false, 100 + i);
+        }
+        REQUIRE(dramsys.AddTransactions(reqs.data(), reqs.size()) == 4);
+
+        std::vector<dramsim3::Completion> done(8);
+        size_t num_done = 0;
+        uint64_t clk = 0;
+        while (num_done < reqs.size() && clk < 1000) {
+            dramsys.ClockTick();
+            clk++;
+            num_done += dramsys.DrainCompletions(done.data() + num_done,
+                                                 done.size() - num_done);
+        }
+        REQUIRE(num_done == reqs.size());
+        for (size_t i = 0; i < num_done; i++) {
+            REQUIRE(done[i].req_id == 100 + (done[i].addr >> 12));
+            REQUIRE_FALSE(done[i].is_write);
+            REQUIRE(done[i].complete_cycle <= clk);
+        }
+        REQUIRE(dramsys.DrainCompletions(done.data(), done.size()) == 0);
+    }
+
+    SECTION("TEST completion callback returns tag, source and cycles") {
+        std::vector<dramsim3::Completion> done;
+        dramsys.RegisterCompletionCallback(
+            [&done](const dramsim3::Completion &c) { done.push_back(c); });
+        // the second read of the address is served by the first one
+        REQUIRE(dramsys.AddTransaction(0x1000, false, 7, 1, 0));
+        dramsys.ClockTick();
+        REQUIRE(dramsys.AddTransaction(0x1000, false, 8, 2, 1));
+        uint64_t clk = 1;
+        while (done.size() < 2 && clk < 1000) {
+            dramsys.ClockTick();
+            clk++;
+        }
+        REQUIRE(done.size() == 2);
+        REQUIRE(dramsys.DrainCompletions(nullptr, 0) == 0);
+        for (const auto &c : done) {
+            REQUIRE(c.addr == 0x1000);
+            REQUIRE(c.source_id == static_cast<int>(c.req_id) - 6);
+            REQUIRE(c.issue_cycle == (c.req_id == 7 ? 0u : 1u));
+            REQUIRE(c.complete_cycle > c.issue_cycle);
+        }
+    }
+
+    SECTION("TEST submission stops at the first full queue") {
+        std::vector<dramsim3::Request> reqs;
+        uint64_t addr = 0;
+        while (reqs.size() < static_cast<size_t>(config.trans_queue_size + 1)) {
+            if (dramsys.GetChannel(addr) == 0) {
+                reqs.emplace_back(addr, false, addr);
+            }
+            addr += 64;
+        }
+        REQUIRE(dramsys.AddTransactions(reqs.data(), reqs.size()) ==
+                static_cast<size_t>(config.trans_queue_size));
+    }
+}
+
+// random reads and writes as fast as the memory system takes them, the
+// completions are appended to done
+void RunRandomTraffic(dramsim3::MemorySystem &memsys, std::mt19937_64 &gen,
+                      uint64_t cycles, std::vector<dramsim3::Completion> &done) {
+    std::vector<dramsim3::Completion> drained(64);
+    uint64_t addr = gen();
+    bool is_write = gen() % 3 == 0;
+    for (uint64_t clk = 0; clk < cycles; clk++) {
+        if (memsys.AddTransaction(addr, is_write)) {
+            addr = gen();
+            is_write = gen() % 3 == 0;
+        }
+        memsys.ClockTick();
+        size_t num = memsys.DrainCompletions(drained.data(), drained.size());
+        done.insert(done.end(), drained.begin(), drained.begin() + num);
+    }
+    return;
+}
+
+TEST_CASE("Checkpoint and restore", "[dramsim3]") {
+    const char *ckpt = "test_dramsys.ckpt";
+    for (auto config_file : {"configs/DDR4_8Gb_x8_2400.ini",
+                             "configs/HMC_2GB_4Lx16.ini"}) {
+        SECTION(std::string("TEST restored system continues like the saved "
+                            "one, ") +
+                config_file) {
+            dramsim3::MemorySystem saved(config_file, ".", nullptr, nullptr);
+            std::mt19937_64 gen(1);
+            std::vector<dramsim3::Completion> done;
+            RunRandomTraffic(saved, gen, 20000, done);
+            REQUIRE_FALSE(done.empty());
+            saved.SaveCheckpoint(ckpt);
+            std::mt19937_64 restored_gen(gen);
+
+            dramsim3::MemorySystem restored(config_file, ".", nullptr,
+                                            nullptr);
+            restored.RestoreCheckpoint(ckpt);
+            std::vector<dramsim3::Completion> expected, actual;
+            RunRandomTraffic(saved, gen, 20000, expected);
+            RunRandomTraffic(restored, restored_gen, 20000, actual);
+            REQUIRE(expected.size() > 0);
+            REQUIRE(actual.size() == expected.size());
+            for (size_t i = 0; i < expected.size(); i++) {
+                REQUIRE(actual[i].addr == expected[i].addr);
+                REQUIRE(actual[i].is_write == expected[i].is_write);
+                REQUIRE(actual[i].issue_cycle == expected[i].issue_cycle);
+                REQUIRE(actual[i].complete_cycle ==
+                        expected[i].complete_cycle);
+            }
+            std::remove(ckpt);
+        }
+    }
+}
+
+TEST_CASE("Fast forward", "[dramsim3]") {
+    for (auto config_file : {"configs/DDR4_8Gb_x8_2400.ini",
+                             "configs/HMC_2GB_4Lx16.ini"}) {
+        SECTION(std::string("TEST every request completes once across "
+                            "switches, ") +
+                config_file) {
+            dramsim3::MemorySystem memsys(config_file, ".", nullptr, nullptr);
+            std::mt19937_64 gen(1);
+            std::vector<dramsim3::Completion> done;
+            size_t added = 0;
+            uint64_t clk = 0;
+            for (int phase = 0; phase < 4; phase++) {
+                memsys.SetFastForward(phase % 2 == 0);
+                REQUIRE(memsys.IsFastForward() == (phase % 2 == 0));
+                for (uint64_t end = clk + 10000; clk < end; clk++) {
+                    uint64_t addr = gen() & ~static_cast<uint64_t>(63);
+                    if (memsys.AddTransaction(addr, gen() % 3 == 0, added)) {
+                        added++;
+                    }
+                    std::vector<dramsim3::Completion> drained(64);
+                    size_t num =
+                        memsys.DrainCompletions(drained.data(), drained.size());
+                    done.insert(done.end(), drained.begin(),
+                                drained.begin() + num);
+                    memsys.ClockTick();
+                }
+            }
+            // no new requests, let both systems finish
+            for (uint64_t end = clk + 10000; clk < end; clk++) {
+                std::vector<dramsim3::Completion> drained(64);
+                size_t num =
+                    memsys.DrainCompletions(drained.data(), drained.size());
+                done.insert(done.end(), drained.begin(), drained.begin() + num);
+                memsys.ClockTick();
+            }
+            REQUIRE(added > 0);
+            REQUIRE(done.size() == added);
+            std::vector<bool> seen(added, false);
+            for (const auto &completion : done) {
+                REQUIRE(completion.req_id < added);
+                REQUIRE_FALSE(seen[completion.req_id]);
+                seen[completion.req_id] = true;
+                REQUIRE(completion.complete_cycle >= completion.issue_cycle);
+                REQUIRE(completion.complete_cycle < clk);
+            }
+        }
+    }
+}
+
+void Tick(dramsim3::MemorySystem &memsys, int cycles) {
+    for (int c = 0; c < cycles; c++) {
+        memsys.ClockTick();
+    }
+}
+
+// adds the request, ticking the clock until the memory system takes it
+void AddWhenTaken(dramsim3::MemorySystem &memsys, uint64_t addr, bool is_write,
+                  uint64_t tag) {
+    while (!memsys.AddTransaction(addr, is_write, tag)) {
+        memsys.ClockTick();
+    }
+}
+
+// completions of the requests next_request adds, it also moves the clock on
+// and returns false once there are no more. drain_cycles more cycles let the
+// last ones finish, finish sees the memory system before it goes
+std::vector<dramsim3::Completion> RunRequests(
+    std::shared_ptr<const dramsim3::Config> config,
+    const std::function<bool(dramsim3::MemorySystem &)> &next_request,
+    int drain_cycles,
+    const std::function<void(dramsim3::MemorySystem &)> &finish = nullptr) {
+    dramsim3::MemorySystem memsys(config, ".", nullptr, nullptr);
+    std::vector<dramsim3::Completion> done;
+    memsys.RegisterCompletionCallback(
+        [&done](const dramsim3::Completion &completion) {
+            done.push_back(completion);
+        });
+    while (next_request(memsys)) {
+    }
+    Tick(memsys, drain_cycles);
+    if (finish) {
+        finish(memsys);
+    }
+    return done;
+}
+
+// the same on a config of its own, read from config_file and changed by
+// setup
+std::vector<dramsim3::Completion> RunRequests(
+    const std::string &config_file,
+    const std::function<void(dramsim3::Config &)> &setup,
+    const std::function<bool(dramsim3::MemorySystem &)> &next_request,
+    int drain_cycles,
+    const std::function<void(dramsim3::MemorySystem &)> &finish = nullptr) {
+    dramsim3::Config *config = new dramsim3::Config(config_file, ".");
+    setup(*config);
+    return RunRequests(std::shared_ptr<const dramsim3::Config>(config),
+                       next_request, drain_cycles, finish);
+}
+
+// completions of requests arriving at random times, the memory clock either
+// ticked one cycle at a time or advanced to the arrival times
+std::vector<dramsim3::Completion> RunClockDomains(bool advance) {
+    std::mt19937_64 gen(3);
+    double ps_per_clk = 0;
+    uint64_t i = 0;
+    uint64_t ps = 0;
+    uint64_t clk = 0;
+    auto move_clock = [&](dramsim3::MemorySystem &memsys) {
+        if (advance) {
+            return memsys.AdvanceTo(ps);
+        }
+        uint64_t cycles = 0;
+        for (; (clk + 1) * ps_per_clk <= ps; clk++, cycles++) {
+            memsys.ClockTick();
+        }
+        return cycles;
+    };
+    return RunRequests(
+        "configs/DDR4_8Gb_x8_2400.ini",
+        [&](dramsim3::Config &config) {
+            config.event_driven = advance;
+            ps_per_clk = config.tCK * 1000;
+        },
+        [&](dramsim3::MemorySystem &memsys) {
+            if (i == 5000) {
+                ps += 10000000;
+                REQUIRE(move_clock(memsys) > 0);
+                return false;
+            }
+            // bursts with idle gaps of up to a few microseconds
+            ps += gen() % 8 == 0 ? gen() % 4000000 : gen() % 2000;
+            move_clock(memsys);
+            uint64_t addr = gen() & ~static_cast<uint64_t>(63);
+            memsys.AddTransaction(addr, gen() % 3 == 0, i);
+            i++;
+            return true;
+        },
+        0);
+}
+
+TEST_CASE("Clock domain crossing", "[dramsim3]") {
+    std::vector<dramsim3::Completion> ticked = RunClockDomains(false);
+    std::vector<dramsim3::Completion> advanced = RunClockDomains(true);
+    REQUIRE(ticked.size() > 4000);
+    REQUIRE(ticked.size() == advanced.size());
+    for (size_t i = 0; i < ticked.size(); i++) {
+        REQUIRE(ticked[i].req_id == advanced[i].req_id);
+        REQUIRE(ticked[i].complete_cycle == advanced[i].complete_cycle);
+    }
+}
+
+// completions of the same random requests on a memory system built from a
+// shared config
+std::vector<dramsim3::Completion> RunShared(
+    std::shared_ptr<const dramsim3::Config> config) {
+    std::mt19937_64 gen(5);
+    uint64_t i = 0;
+    return RunRequests(config,
+                       [&](dramsim3::MemorySystem &memsys) {
+                           uint64_t addr = gen() & ~static_cast<uint64_t>(63);
+                           AddWhenTaken(memsys, addr, gen() % 3 == 0, i);
+                           memsys.ClockTick();
+                           return ++i < 3000;
+                       },
+                       20000);
+}
+
+TEST_CASE("Memory systems on threads", "[dramsim3]") {
+    dramsim3::Config *config =
+        new dramsim3::Config("configs/DDR4_8Gb_x8_2400.ini", ".");
+    // no epoch files, all systems write to the same directory
+    config->output_level = 0;
+    std::shared_ptr<const dramsim3::Config> shared(config);
+    std::vector<dramsim3::Completion> serial = RunShared(shared);
+    REQUIRE(serial.size() == 3000);
+
+    std::vector<std::vector<dramsim3::Completion>> results(4);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < results.size(); i++) {
+        threads.emplace_back(
+            [&results, &shared, i]() { results[i] = RunShared(shared); });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (const auto &result : results) {
+        REQUIRE(result.size() == serial.size());
+        for (size_t i = 0; i < serial.size(); i++) {
+            REQUIRE(result[i].req_id == serial[i].req_id);
+            REQUIRE(result[i].complete_cycle == serial[i].complete_cycle);
+        }
+    }
+}
+
+// stats and completions of random requests to all channels of an HBM
+// stack, its channels ticked on num_threads threads
+nlohmann::json RunChannelThreads(int num_threads,
+                                 std::vector<dramsim3::Completion> &done) {
+    std::mt19937_64 gen(11);
+    uint64_t i = 0;
+    nlohmann::json stats;
+    done = RunRequests(
+        "configs/HBM2_8Gb_x128.ini",
+        [num_threads](dramsim3::Config &config) {
+            config.output_level = -1;
+            config.num_threads = num_threads;
+            config.parallel_quantum = 1;
+        },
+        [&](dramsim3::MemorySystem &memsys) {
+            uint64_t addr = gen() & ~static_cast<uint64_t>(63);
+            AddWhenTaken(memsys, addr, gen() % 3 == 0, i);
+            if (gen() % 4 == 0) {
+                memsys.ClockTick();
+            }
+            return ++i < 20000;
+        },
+        20000,
+        [&stats](dramsim3::MemorySystem &memsys) {
+            stats = memsys.FinalStats();
+        });
+    return stats;
+}
+
+TEST_CASE("Channels on threads", "[dramsim3]") {
+    std::vector<dramsim3::Completion> serial_done, threaded_done;
+    nlohmann::json serial = RunChannelThreads(1, serial_done);
+    nlohmann::json threaded = RunChannelThreads(4, threaded_done);
+    REQUIRE(serial_done.size() == 20000);
+    REQUIRE(threaded_done.size() == serial_done.size());
+    for (size_t i = 0; i < serial_done.size(); i++) {
+        REQUIRE(threaded_done[i].req_id == serial_done[i].req_id);
+        REQUIRE(threaded_done[i].complete_cycle ==
+                serial_done[i].complete_cycle);
+    }
+    REQUIRE(threaded == serial);
+}
+
+// average latency of spaced out sequential reads, all of them have to
+// complete
+double SequentialReadLatency(const std::string &prefetcher) {
+    uint64_t i = 0;
+    std::vector<dramsim3::Completion> done = RunRequests(
+        "configs/DDR4_8Gb_x8_2400.ini",
+        [&prefetcher](dramsim3::Config &config) {
+            config.output_level = 0;
+            config.prefetcher = prefetcher;
+        },
+        [&i](dramsim3::MemorySystem &memsys) {
+            REQUIRE(memsys.AddTransaction(0x10000000 + 64 * i, false, i));
+            Tick(memsys, 40);
+            return ++i < 2000;
+        },
+        1000);
+    REQUIRE(done.size() == 2000);
+    double total = 0;
+    for (const auto &completion : done) {
+        total += completion.complete_cycle - completion.issue_cycle;
+    }
+    return total / done.size();
+}
+
+TEST_CASE("Controller prefetching", "[dramsim3]") {
+    double no_prefetch = SequentialReadLatency("NONE");
+    REQUIRE(SequentialReadLatency("NEXT_LINE") < no_prefetch / 2);
+    REQUIRE(SequentialReadLatency("STRIDE") < no_prefetch / 2);
+}
+
+// the stats of channel 0 at the end of a run
+std::function<void(dramsim3::MemorySystem &)> ChannelStats(
+    nlohmann::json &stats) {
+    return [&stats](dramsim3::MemorySystem &memsys) {
+        memsys.PrintStats();
+        stats = memsys.FinalStats()["0"];
+    };
+}
+
+// alternating reads of two rows of one bank, returns the stats of the
+// channel
+nlohmann::json HammerStats(const std::string &mitigation,
+                           const std::string &tracker) {
+    uint64_t i = 0;
+    nlohmann::json stats;
+    auto done = RunRequests(
+        "configs/DDR4_8Gb_x8_2400.ini",
+        [&](dramsim3::Config &config) {
+            config.output_level = -1;
+            config.rowhammer_mitigation = mitigation;
+            config.rh_tracker = tracker;
+            config.rh_threshold = 64;
+            config.para_probability = 0.01;
+        },
+        [&i](dramsim3::MemorySystem &memsys) {
+            REQUIRE(memsys.AddTransaction((i % 2) * 0x4000000, false, i));
+            Tick(memsys, 10);
+            return ++i < 20000;
+        },
+        2000, ChannelStats(stats));
+    REQUIRE(done.size() == 20000);
+    return stats;
+}
+
+TEST_CASE("RowHammer mitigation", "[dramsim3]") {
+    auto none = HammerStats("NONE", "MISRA_GRIES");
+    REQUIRE(none["num_rfm_cmds"] == 0);
+    REQUIRE(none["num_act_cmds"] > 1000);
+    for (auto tracker : {"MISRA_GRIES", "COUNT_MIN"}) {
+        SECTION(std::string("TEST TRR refreshes every rh_threshold ACTs, ") +
+                tracker) {
+            auto trr = HammerStats("TRR", tracker);
+            // both rows are tracked exactly
+            int acts = trr["num_act_cmds"];
+            REQUIRE(trr["num_rh_triggers"] >= acts / 64 - 2);
+            REQUIRE(trr["num_rh_triggers"] <= acts / 64);
+            REQUIRE(trr["num_rfm_cmds"] > 0);
+        }
+    }
+    for (auto mitigation : {"PARA", "RFM"}) {
+        SECTION(std::string("TEST RFMs are issued, ") + mitigation) {
+            auto stats = HammerStats(mitigation, "MISRA_GRIES");
+            REQUIRE(stats["num_rfm_cmds"] > 0);
+            REQUIRE(stats["rfm_stall_cycles"] > 0);
+            REQUIRE(stats["rfm_bw_loss"] > 0);
+        }
+    }
+}
+
+// bursts of random requests with idle gaps, returns the stats of the
+// channel
+nlohmann::json StallStats(bool event_driven) {
+    std::mt19937_64 gen(7);
+    uint64_t i = 0;
+    nlohmann::json stats;
+    RunRequests(
+        "configs/DDR4_8Gb_x8_2400.ini",
+        [event_driven](dramsim3::Config &config) {
+            config.output_level = -1;
+            config.event_driven = event_driven;
+        },
+        [&](dramsim3::MemorySystem &memsys) {
+            uint64_t addr = gen() & ~static_cast<uint64_t>(63);
+            AddWhenTaken(memsys, addr, gen() % 3 == 0, i);
+            memsys.ClockTick();
+            // 20 bursts of 500
+            if (++i % 500 == 0) {
+                Tick(memsys, 5000);
+            }
+            return i < 20 * 500;
+        },
+        0, ChannelStats(stats));
+    return stats;
+}
+
+TEST_CASE("Stall attribution", "[dramsim3]") {
+    auto ticked = StallStats(false);
+    auto skipped = StallStats(true);
+    uint64_t stalls = 0;
+    for (int i = 0; i < static_cast<int>(dramsim3::StallReason::SIZE); i++) {
+        std::string name =
+            "stall_" +
+            dramsim3::StallReasonName(static_cast<dramsim3::StallReason>(i)) +
+            "_cycles";
+        REQUIRE(ticked[name] == skipped[name]);
+        stalls += ticked[name].get<uint64_t>();
+    }
+    REQUIRE(ticked["stall_queue_full_cycles"] ==
+            skipped["stall_queue_full_cycles"]);
+    // every cycle that is not a stall issues at least one command
+    uint64_t cycles = ticked["num_cycles"];
+    uint64_t cmds = ticked["num_read_cmds"].get<uint64_t>() +
+                    ticked["num_write_cmds"].get<uint64_t>() +
+                    ticked["num_act_cmds"].get<uint64_t>() +
+                    ticked["num_pre_cmds"].get<uint64_t>() +
+                    ticked["num_ref_cmds"].get<uint64_t>();
+    REQUIRE(stalls <= cycles);
+    REQUIRE(stalls + cmds >= cycles);
+    REQUIRE(ticked["stall_empty_cycles"] > 50000);
+    REQUIRE(ticked["stall_trcd_cycles"] > 0);
+    REQUIRE(ticked["stall_tccd_cycles"] > 0);
+    REQUIRE(ticked["stall_refresh_cycles"] > 0);
+    REQUIRE(ticked["data_bus_utilization"] > 0);
+    REQUIRE(ticked["data_bus_utilization"] < 1);
+}
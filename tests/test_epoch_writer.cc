@@ -0,0 +1,89 @@
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "epoch_writer.h"
+
+namespace {
+
+std::vector<nlohmann::json> EpochRecords() {
+    std::vector<nlohmann::json> records;
+    for (int epoch = 0; epoch < 3; epoch++) {
+        nlohmann::json record;
+        record["channel"] = 0;
+        record["epoch_num"] = epoch;
+        record["average_read_latency"] = 20.5 + epoch;
+        record["rank_active_cycles"]["0"] = 100 * epoch;
+        record["rank_active_cycles"]["1"] = 200 * epoch;
+        records.push_back(record);
+    }
+    return records;
+}
+
+std::string WriteRecords(const std::string& format) {
+    std::string file_name = "test_epoch_writer." + format;
+    {
+        dramsim3::EpochWriter writer(file_name, format);
+        for (auto record : EpochRecords()) {
+            writer.Write(std::move(record));
+        }
+        writer.Flush();
+    }
+    std::ifstream file(file_name, std::ifstream::binary);
+    std::string content((std::istreambuf_iterator<char>(file)),
+                        std::istreambuf_iterator<char>());
+    std::remove(file_name.c_str());
+    return content;
+}
+
+}  // namespace
+
+TEST_CASE("Epoch stats formats", "[epoch_writer]") {
+    auto records = EpochRecords();
+
+    SECTION("TEST ndjson has one record per line") {
+        std::istringstream lines(WriteRecords("ndjson"));
+        std::string line;
+        size_t num_lines = 0;
+        while (std::getline(lines, line)) {
+            REQUIRE(num_lines < records.size());
+            REQUIRE(nlohmann::json::parse(line) == records[num_lines]);
+            num_lines++;
+        }
+        REQUIRE(num_lines == records.size());
+    }
+
+    SECTION("TEST csv flattens vector stats into columns") {
+        std::istringstream lines(WriteRecords("csv"));
+        std::string line;
+        REQUIRE(std::getline(lines, line));
+        REQUIRE(line ==
+                "average_read_latency,channel,epoch_num,"
+                "rank_active_cycles.0,rank_active_cycles.1");
+        for (int epoch = 0; epoch < 3; epoch++) {
+            REQUIRE(std::getline(lines, line));
+            std::ostringstream row;
+            row << records[epoch]["average_read_latency"].dump() << ",0,"
+                << epoch << "," << 100 * epoch << "," << 200 * epoch;
+            REQUIRE(line == row.str());
+        }
+        REQUIRE_FALSE(std::getline(lines, line));
+    }
+
+    SECTION("TEST msgpack objects are concatenated") {
+        std::string content = WriteRecords("msgpack");
+        size_t offset = 0;
+        for (const auto& record : records) {
+            size_t size = nlohmann::json::to_msgpack(record).size();
+            REQUIRE(offset + size <= content.size());
+            std::vector<uint8_t> bytes(content.begin() + offset,
+                                       content.begin() + offset + size);
+            REQUIRE(nlohmann::json::from_msgpack(bytes) == record);
+            offset += size;
+        }
+        REQUIRE(offset == content.size());
+    }
+}
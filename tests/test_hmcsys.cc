@@ -1,5 +1,8 @@
+#include <fstream>
+#include <vector>
 #include "catch.hpp"
 #include "configuration.h"
+#include "hmc.h"
 #include "memory_system.h"
 
 bool hmc_called = false;
@@ -39,3 +42,72 @@ TEST_CASE("HMC System Testing", "[dramsim3][hmc]") {
         REQUIRE(clk == idle_lat);
     }
 }
+
+TEST_CASE("HMC link flow control", "[dramsim3][hmc]") {
+    dramsim3::Config config("configs/HMC_2GB_4Lx16.ini", ".");
+    config.link_flow_control = true;
+    // x16 lanes at 10Gbps carry 1 flit per 800ps memory cycle
+    dramsim3::HMCMemorySystem hmc(config, ".", hmc_callback, hmc_callback);
+
+    SECTION("TEST links take requests independently") {
+        std::vector<dramsim3::HMCRequest> reads, writes;
+        for (int i = 0; i < 4; i++) {
+            uint64_t addr = static_cast<uint64_t>(i) << 12;
+            int vault = hmc.GetChannel(addr);
+            reads.emplace_back(dramsim3::HMCReqType::RD64, addr, vault);
+            writes.emplace_back(dramsim3::HMCReqType::WR64, addr, vault);
+        }
+        // a 1-flit read per link per cycle
+        for (int link = 0; link < config.num_links; link++) {
+            REQUIRE(hmc.InsertLinkReqs(link, reads.data(), 2) == 1);
+        }
+        hmc.ClockTick();
+        // a 5-flit write keeps the link busy for 5 cycles
+        REQUIRE(hmc.InsertLinkReqs(0, writes.data(), 2) == 1);
+        REQUIRE(hmc.InsertLinkReqs(1, reads.data(), 1) == 1);
+        for (int i = 0; i < 4; i++) {
+            hmc.ClockTick();
+            REQUIRE(hmc.InsertLinkReqs(0, reads.data(), 1) == 0);
+        }
+        hmc.ClockTick();
+        REQUIRE(hmc.InsertLinkReqs(0, reads.data(), 1) == 1);
+    }
+}
+
+TEST_CASE("HMC atomics", "[dramsim3][hmc]") {
+    dramsim3::Config config("configs/HMC_2GB_4Lx16.ini", ".");
+    dramsim3::HMCMemorySystem hmc(config, ".", hmc_callback, hmc_callback);
+
+    SECTION("TEST atomics are executed in the vault") {
+        dramsim3::HMCRequest req(dramsim3::HMCReqType::INC8, 0x1000,
+                                 hmc.GetChannel(0x1000));
+        REQUIRE(req.is_atomic);
+        REQUIRE(req.writes_back);
+        REQUIRE(hmc.InsertHMCReq(req));
+        hmc_called = false;
+        int clk = 0;
+        while (!hmc_called && clk < 1000) {
+            hmc.ClockTick();
+            clk++;
+        }
+        REQUIRE(hmc_called);
+        // the 1 flit write response goes out right after the read
+        REQUIRE(clk < 60);
+
+        // the write back to DRAM is still on the way
+        for (int i = 0; i < 200; i++) {
+            hmc.ClockTick();
+        }
+        hmc.PrintStats();
+        std::ifstream json_file("dramsim3.json");
+        nlohmann::json stats;
+        json_file >> stats;
+        const auto& vault = stats[std::to_string(req.vault)];
+        REQUIRE(vault["num_read_cmds"] == 1);
+        REQUIRE(vault["num_write_cmds"] == 1);
+        REQUIRE(vault["num_atomic_reqs"] == 1);
+        // a host side increment takes 16B read and write requests and their
+        // responses, 6 flits instead of 2
+        REQUIRE(vault["atomic_link_bytes_saved"] == 4 * 16);
+    }
+}
@@ -0,0 +1,39 @@
+#include "catch.hpp"
+#include "pending_table.h"
+
+TEST_CASE("Pending Table Testing", "[pending]") {
+    dramsim3::PendingTable table(4);
+
+    SECTION("TEST merged reads in arrival order") {
+        dramsim3::Transaction trans(0x40, false);
+        for (int i = 0; i < 3; i++) {
+            trans.added_cycle = i;
+            table.Insert(trans);
+        }
+        REQUIRE(table.Count(0x40) == 3);
+        REQUIRE(table.Count(0x80) == 0);
+        REQUIRE(table.Find(0x80) == nullptr);
+        for (int i = 0; i < 3; i++) {
+            REQUIRE(table.Find(0x40)->added_cycle == i);
+            table.Erase(0x40);
+        }
+        REQUIRE(table.Empty());
+    }
+
+    SECTION("TEST growing past capacity and erasing") {
+        for (uint64_t i = 0; i < 64; i++) {
+            table.Insert(dramsim3::Transaction(i << 6, true));
+        }
+        for (uint64_t i = 0; i < 64; i += 2) {
+            table.Erase(i << 6);
+        }
+        for (uint64_t i = 0; i < 64; i++) {
+            REQUIRE(table.Count(i << 6) == static_cast<int>(i % 2));
+        }
+        for (uint64_t i = 1; i < 64; i += 2) {
+            REQUIRE(table.Find(i << 6)->addr == (i << 6));
+            table.Erase(i << 6);
+        }
+        REQUIRE(table.Empty());
+    }
+}
@@ -0,0 +1,113 @@
+#include "catch.hpp"
+#include "channel_state.h"
+#include "power_policy.h"
+#include "timing.h"
+
+namespace {
+
+dramsim3::Command RankCommand(dramsim3::CommandType cmd_type, int rank) {
+    dramsim3::Address addr;
+    addr.rank = rank;
+    return dramsim3::Command(cmd_type, addr, -1);
+}
+
+}  // namespace
+
+TEST_CASE("Power down and self refresh", "[power]") {
+    dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+    const auto PD_ENTER = dramsim3::CommandType::PD_ENTER;
+    const auto PD_EXIT = dramsim3::CommandType::PD_EXIT;
+    const auto SREF_ENTER = dramsim3::CommandType::SREF_ENTER;
+    const auto SREF_EXIT = dramsim3::CommandType::SREF_EXIT;
+
+    SECTION("TEST idle ranks power down, long idle ones self refresh") {
+        config.enable_power_down = true;
+        config.pd_threshold = 100;
+        config.enable_self_refresh = true;
+        config.sref_threshold = 1000;
+        dramsim3::PowerPolicy policy(config);
+        auto read = dramsim3::Command(dramsim3::CommandType::READ,
+                                      dramsim3::Address(0, 0, 0, 0, 0, 0), 0);
+        policy.CommandIssued(read, 10, false);
+        REQUIRE(policy.NextLowPowerCycle(0, false) == 110);
+        REQUIRE(policy.LowPowerCommand(0, false, 109) ==
+                dramsim3::CommandType::SIZE);
+        REQUIRE(policy.LowPowerCommand(0, false, 110) == PD_ENTER);
+        policy.CommandIssued(RankCommand(PD_ENTER, 0), 110, false);
+
+        // a rank that stays powered down for sref_threshold since the last
+        // access leaves power down on the way to self refresh
+        REQUIRE(policy.NextLowPowerCycle(0, true) == 1010);
+        REQUIRE(policy.LowPowerCommand(0, true, 1009) ==
+                dramsim3::CommandType::SIZE);
+        REQUIRE(policy.LowPowerCommand(0, true, 1010) == PD_EXIT);
+        policy.CommandIssued(RankCommand(PD_EXIT, 0), 1010, false);
+        REQUIRE(policy.LowPowerCommand(0, false, 1010) == SREF_ENTER);
+        // leaving low power on its own doesn't end the idle period
+        REQUIRE(policy.PredictedIdleCycles(0) == 0);
+
+        // a wake up ends it, long idle periods predict self refresh
+        policy.CommandIssued(RankCommand(SREF_EXIT, 0), 4010, true);
+        REQUIRE(policy.PredictedIdleCycles(0) == 1000);
+        policy.CommandIssued(read, 4100, false);
+        REQUIRE(policy.LowPowerCommand(0, false, 4200) == SREF_ENTER);
+
+        // without self refresh power down is as deep as it goes
+        config.enable_self_refresh = false;
+        REQUIRE(policy.LowPowerCommand(0, false, 4200) == PD_ENTER);
+        REQUIRE(policy.LowPowerCommand(0, true, 10000) ==
+                dramsim3::CommandType::SIZE);
+    }
+
+    SECTION("TEST power down and self refresh exits gate commands") {
+        dramsim3::Timing timing(config);
+        dramsim3::ChannelState channel_state(config, timing);
+        auto read = dramsim3::Command(dramsim3::CommandType::READ,
+                                      dramsim3::Address(0, 0, 0, 0, 0, 0), 0);
+        REQUIRE(channel_state.GetReadyCommand(read, 0).cmd_type ==
+                dramsim3::CommandType::ACTIVATE);
+
+        uint64_t clk = 10;
+        auto pde = channel_state.GetReadyCommand(RankCommand(PD_ENTER, 0), clk);
+        REQUIRE(pde.cmd_type == PD_ENTER);
+        channel_state.UpdateTimingAndStates(pde, clk);
+        REQUIRE(channel_state.IsRankPoweredDown(0));
+        REQUIRE_FALSE(channel_state.IsRankPoweredDown(1));
+        // a powered down rank needs PD_EXIT first, tCKE after PD_ENTER
+        uint64_t tCKE = static_cast<uint64_t>(config.tCKE);
+        REQUIRE_FALSE(channel_state.GetReadyCommand(read, clk + tCKE - 1)
+                          .IsValid());
+        auto pdx = channel_state.GetReadyCommand(read, clk + tCKE);
+        REQUIRE(pdx.cmd_type == PD_EXIT);
+        clk += tCKE;
+        channel_state.UpdateTimingAndStates(pdx, clk);
+        REQUIRE_FALSE(channel_state.IsRankPoweredDown(0));
+        // and nothing goes for tXP after it
+        uint64_t tXP = static_cast<uint64_t>(config.tXP);
+        REQUIRE_FALSE(channel_state.GetReadyCommand(read, clk + tXP - 1)
+                          .IsValid());
+        REQUIRE(channel_state.GetReadyCommand(read, clk + tXP).cmd_type ==
+                dramsim3::CommandType::ACTIVATE);
+
+        clk += 1000;
+        auto srefe =
+            channel_state.GetReadyCommand(RankCommand(SREF_ENTER, 0), clk);
+        REQUIRE(srefe.cmd_type == SREF_ENTER);
+        channel_state.UpdateTimingAndStates(srefe, clk);
+        REQUIRE(channel_state.IsRankSelfRefreshing(0));
+        // self refresh lasts tCKESR at least, and tXS after SREF_EXIT
+        uint64_t tCKESR = static_cast<uint64_t>(config.tCKESR);
+        REQUIRE_FALSE(channel_state.GetReadyCommand(read, clk + tCKESR - 1)
+                          .IsValid());
+        auto srefx = channel_state.GetReadyCommand(read, clk + tCKESR);
+        REQUIRE(srefx.cmd_type == SREF_EXIT);
+        clk += tCKESR;
+        channel_state.UpdateTimingAndStates(srefx, clk);
+        REQUIRE_FALSE(channel_state.IsRankSelfRefreshing(0));
+        uint64_t tXS = static_cast<uint64_t>(config.tXS);
+        REQUIRE_FALSE(channel_state.GetReadyCommand(read, clk + tXS - 1)
+                          .IsValid());
+        REQUIRE(channel_state.GetReadyCommand(read, clk + tXS).cmd_type ==
+                dramsim3::CommandType::ACTIVATE);
+    }
+}
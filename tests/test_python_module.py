@@ -0,0 +1,61 @@
+# Checks of the dramsim3 Python module (-DPYTHON=1), run from the repo root
+# with PYTHONPATH=. or through "make dramsim3pytest"
+import array
+import unittest
+
+import dramsim3
+
+CONFIG = "configs/DDR4_8Gb_x8_2400.ini"
+
+
+def requests(num, write_every=4):
+    addrs = array.array("Q", [i * 64 for i in range(num)])
+    writes = array.array("B", [i % write_every == 0 for i in range(num)])
+    cycles = array.array("Q", [i * 4 for i in range(num)])
+    return addrs, writes, cycles
+
+
+class MemorySystemTest(unittest.TestCase):
+
+    def setUp(self):
+        self.mem = dramsim3.MemorySystem(CONFIG)
+
+    def test_run(self):
+        addrs, writes, cycles = requests(100)
+        done = array.array("Q", [0] * 100)
+        num_done, num_cycles = self.mem.run(addrs, writes, cycles, done)
+        self.assertEqual(num_done, 100)
+        self.assertEqual(self.mem.clk, num_cycles)
+        for i in range(100):
+            self.assertGreater(done[i], cycles[i])
+        stats = self.mem.stats()
+        self.assertEqual(len(stats), 1)
+        self.assertEqual(stats[0]["num_reads_done"], 75)
+        self.assertEqual(stats[0]["num_writes_done"], 25)
+
+    def test_length_mismatch(self):
+        addrs, writes, cycles = requests(10)
+        with self.assertRaises(ValueError):
+            self.mem.run(addrs, writes[:5], cycles)
+        with self.assertRaises(ValueError):
+            self.mem.run(addrs, writes, cycles[:9])
+        with self.assertRaises(ValueError):
+            self.mem.run(addrs, writes, cycles, array.array("Q", [0] * 11))
+        # nothing ran
+        self.assertEqual(self.mem.clk, 0)
+
+    def test_wrong_dtype(self):
+        addrs, writes, cycles = requests(10)
+        with self.assertRaises(TypeError):
+            self.mem.run(array.array("d", addrs), writes, cycles)
+        with self.assertRaises(TypeError):
+            self.mem.run(addrs, array.array("H", writes), cycles)
+        with self.assertRaises(TypeError):
+            self.mem.run(addrs, writes, array.array("I", cycles))
+        with self.assertRaises(TypeError):
+            self.mem.run([0] * 10, writes, cycles)
+        self.assertEqual(self.mem.clk, 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
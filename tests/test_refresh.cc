@@ -0,0 +1,200 @@
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "channel_state.h"
+#include "command_queue.h"
+#include "refresh.h"
+#include "row_policy.h"
+#include "scheduler.h"
+#include "timing.h"
+
+namespace {
+
+// the DDR4 config with 2x or 4x fine granularity refresh
+std::string GranularityConfig(int granularity) {
+    std::string file_name =
+        "test_refresh_" + std::to_string(granularity) + "x.ini";
+    std::ifstream base("configs/DDR4_8Gb_x8_2400.ini");
+    std::ofstream config(file_name);
+    config << base.rdbuf() << "\n[system]\nrefresh_granularity = "
+           << granularity << "\n";
+    return file_name;
+}
+
+// a channel without a controller: refreshes are issued the cycle they are
+// raised and queued commands when ready, raised refreshes are counted per
+// refresh target
+struct RefreshChannel {
+    RefreshChannel(const dramsim3::Config& config)
+        : config(config),
+          timing(config),
+          channel_state(config, timing),
+          simple_stats(config, config.output_files, 0),
+          scheduler(dramsim3::MakeScheduler(config)),
+          row_policy(config),
+          cmd_queue(0, config, channel_state, simple_stats, *scheduler,
+                    row_policy),
+          refresh(config, channel_state, cmd_queue, simple_stats),
+          clk(0) {}
+
+    int Target(const dramsim3::Command& ref) const {
+        if (ref.cmd_type == dramsim3::CommandType::REFRESH_SAME_BANK) {
+            return ref.Rank() * config.banks_per_group + ref.Bank();
+        }
+        return ref.Rank();
+    }
+
+    void Tick(bool issue_commands) {
+        refresh.ClockTick();
+        while (channel_state.IsRefreshWaiting()) {
+            auto ref = channel_state.PendingRefCommand();
+            int target = Target(ref);
+            if (static_cast<int>(raised.size()) <= target) {
+                raised.resize(target + 1);
+            }
+            raised[target].push_back(clk);
+            if (ref.cmd_type == dramsim3::CommandType::REFRESH_SAME_BANK) {
+                channel_state.SameBankNeedRefresh(ref.Rank(), ref.Bank(),
+                                                  false);
+            } else {
+                channel_state.RankNeedRefresh(ref.Rank(), false);
+            }
+        }
+        if (issue_commands) {
+            auto cmd = cmd_queue.GetCommandToIssue();
+            if (cmd.IsValid()) {
+                channel_state.UpdateTimingAndStates(cmd, clk);
+                cmd_queue.InvalidateReadyCycles(cmd);
+            }
+        }
+        cmd_queue.ClockTick();
+        clk++;
+    }
+
+    // refreshes of the rank that were due so far, ranks are refreshed in
+    // turn every tREFI / ranks (RANK_LEVEL_STAGGERED)
+    int Due(int rank) const {
+        uint64_t interval =
+            static_cast<uint64_t>(config.tREFI / config.ranks);
+        uint64_t first = interval * (rank + 1);
+        return clk > first ? static_cast<int>((clk - 1 - first) /
+                                              (interval * config.ranks)) +
+                                 1
+                           : 0;
+    }
+
+    int Raised(int target) const {
+        return target < static_cast<int>(raised.size())
+                   ? static_cast<int>(raised[target].size())
+                   : 0;
+    }
+
+    const dramsim3::Config& config;
+    dramsim3::Timing timing;
+    dramsim3::ChannelState channel_state;
+    dramsim3::SimpleStats simple_stats;
+    std::unique_ptr<dramsim3::Scheduler> scheduler;
+    dramsim3::RowPolicy row_policy;
+    dramsim3::CommandQueue cmd_queue;
+    dramsim3::Refresh refresh;
+    uint64_t clk;
+    std::vector<std::vector<uint64_t>> raised;
+};
+
+}  // namespace
+
+TEST_CASE("Refresh scheduling", "[refresh]") {
+    SECTION("TEST REFsb reaches every same bank group once per tREFI") {
+        dramsim3::Config config("configs/DDR5_16Gb_x8_4800.ini", ".");
+        REQUIRE(config.refresh_policy ==
+                dramsim3::RefreshPolicy::SAME_BANK_STAGGERED);
+        RefreshChannel channel(config);
+        int targets = config.ranks * config.banks_per_group;
+        uint64_t tREFI = static_cast<uint64_t>(config.tREFI);
+        for (uint64_t i = 0; i <= 4 * tREFI; i++) {
+            channel.Tick(false);
+        }
+        for (int target = 0; target < targets; target++) {
+            REQUIRE(channel.Raised(target) == 4);
+            const auto& cycles = channel.raised[target];
+            for (size_t i = 1; i < cycles.size(); i++) {
+                REQUIRE(cycles[i] - cycles[i - 1] <= tREFI);
+            }
+        }
+    }
+
+    SECTION("TEST fine granularity refresh 2x and 4x") {
+        dramsim3::Config base("configs/DDR4_8Gb_x8_2400.ini", ".");
+        for (int granularity : {2, 4}) {
+            std::string config_file = GranularityConfig(granularity);
+            dramsim3::Config config(config_file, ".");
+            std::remove(config_file.c_str());
+            REQUIRE(config.tREFI == base.tREFI / granularity);
+            REQUIRE(config.tRFC < base.tRFC);
+            RefreshChannel channel(config);
+            uint64_t tREFI = static_cast<uint64_t>(config.tREFI);
+            uint64_t cycles = 4 * static_cast<uint64_t>(base.tREFI);
+            for (uint64_t i = 0; i <= cycles; i++) {
+                channel.Tick(false);
+            }
+            for (int rank = 0; rank < config.ranks; rank++) {
+                REQUIRE(channel.Raised(rank) == 4 * granularity);
+                const auto& raised = channel.raised[rank];
+                for (size_t i = 1; i < raised.size(); i++) {
+                    REQUIRE(raised[i] - raised[i - 1] == tREFI);
+                }
+            }
+        }
+    }
+
+    SECTION("TEST postponed refreshes are limited and paid back") {
+        dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+        config.refresh_postpone_max = 3;
+        RefreshChannel channel(config);
+        // rank 0 stays busy, the queued read is never issued
+        auto addr = dramsim3::Address(0, 0, 0, 0, 0, 0);
+        REQUIRE(channel.cmd_queue.AddCommand(
+            dramsim3::Command(dramsim3::CommandType::READ, addr, 0x0)));
+        uint64_t tREFI = static_cast<uint64_t>(config.tREFI);
+        for (uint64_t i = 0; i <= 6 * tREFI; i++) {
+            channel.Tick(false);
+            REQUIRE(channel.Raised(0) >=
+                    channel.Due(0) - config.refresh_postpone_max);
+        }
+        REQUIRE(channel.Raised(0) == 6 - config.refresh_postpone_max);
+        for (int rank = 1; rank < config.ranks; rank++) {
+            REQUIRE(channel.Raised(rank) == 6);
+        }
+        // all three refreshes are raised once the read is served
+        for (uint64_t i = 0; i < 1000; i++) {
+            channel.Tick(true);
+        }
+        REQUIRE(channel.cmd_queue.QueueEmpty());
+        REQUIRE(channel.Raised(0) == 6);
+    }
+
+    SECTION("TEST idle ranks pull refreshes in") {
+        dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+        config.refresh_pullin_max = 2;
+        RefreshChannel channel(config);
+        uint64_t tREFI = static_cast<uint64_t>(config.tREFI);
+        uint64_t tRFC = static_cast<uint64_t>(config.tRFC);
+        for (uint64_t i = 0; i <= 6 * tREFI; i++) {
+            channel.Tick(false);
+            for (int rank = 0; rank < config.ranks; rank++) {
+                REQUIRE(channel.Raised(rank) <=
+                        channel.Due(rank) + config.refresh_pullin_max);
+            }
+        }
+        for (int rank = 0; rank < config.ranks; rank++) {
+            // two ahead of time after idling for a refresh cycle time, one
+            // rank per cycle, the due ones are skipped against them
+            REQUIRE(channel.Raised(rank) == 6 + config.refresh_pullin_max);
+            REQUIRE(channel.raised[rank][0] ==
+                    tRFC + rank * config.refresh_pullin_max);
+        }
+    }
+}
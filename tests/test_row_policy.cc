@@ -0,0 +1,83 @@
+#include "catch.hpp"
+#include "row_policy.h"
+
+namespace {
+
+dramsim3::Command Access(int row, uint64_t hex_addr) {
+    return dramsim3::Command(dramsim3::CommandType::READ,
+                             dramsim3::Address(0, 0, 0, 0, row, 0), hex_addr);
+}
+
+}  // namespace
+
+TEST_CASE("Row buffer policies", "[row_policy]") {
+    dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+
+    SECTION("TEST TIMEOUT closes rows idle for row_timeout cycles") {
+        config.row_buf_policy = "TIMEOUT";
+        config.row_timeout = 50;
+        dramsim3::RowPolicy policy(config);
+        REQUIRE(policy.Policy() == dramsim3::RowBufPolicy::TIMEOUT);
+        REQUIRE(policy.ClosesIdleRows());
+        // the column commands keep the row open, the timeout closes it
+        REQUIRE(policy.ColumnCommand(false) == dramsim3::CommandType::READ);
+        REQUIRE_FALSE(policy.ClosesRow(Access(1, 0x0), false, 0));
+
+        policy.CommandIssued(
+            dramsim3::Command(dramsim3::CommandType::ACTIVATE,
+                              dramsim3::Address(0, 0, 0, 0, 1, 0), 0x0),
+            100);
+        REQUIRE(policy.TimeoutCycle(0, 0, 0) == 150);
+        policy.CommandIssued(Access(1, 0x0), 120);
+        REQUIRE(policy.TimeoutCycle(0, 0, 0) == 170);
+        // other banks keep their own timers
+        REQUIRE(policy.TimeoutCycle(0, 0, 1) == 50);
+
+        // OPEN_PAGE with aggressive precharging is the same
+        config.row_buf_policy = "OPEN_PAGE";
+        config.aggressive_precharging_enabled = true;
+        dramsim3::RowPolicy aggressive(config);
+        REQUIRE(aggressive.Policy() == dramsim3::RowBufPolicy::TIMEOUT);
+    }
+
+    SECTION("TEST PREDICTIVE follows the row hit counter of the bank") {
+        config.row_buf_policy = "PREDICTIVE";
+        dramsim3::RowPolicy policy(config);
+        REQUIRE_FALSE(policy.ClosesIdleRows());
+        // counters start at 2, a hit is expected
+        REQUIRE_FALSE(policy.ClosesRow(Access(1, 0x0), false, 0));
+        // two misses bring the counter down to 0
+        policy.CommandIssued(Access(1, 0x0), 10);
+        policy.CommandIssued(Access(2, 0x1000), 20);
+        REQUIRE(policy.ClosesRow(Access(3, 0x2000), false, 0));
+        // queued hits always keep the row open
+        REQUIRE_FALSE(policy.ClosesRow(Access(3, 0x2000), true, 0));
+        // two hits bring it back to 2
+        policy.CommandIssued(Access(2, 0x1040), 30);
+        REQUIRE(policy.ClosesRow(Access(2, 0x1080), false, 0));
+        policy.CommandIssued(Access(2, 0x1080), 40);
+        REQUIRE_FALSE(policy.ClosesRow(Access(2, 0x10c0), false, 0));
+    }
+
+    SECTION("TEST MINIMALIST closes after minimalist_hits accesses") {
+        config.row_buf_policy = "MINIMALIST";
+        config.minimalist_hits = 4;
+        dramsim3::RowPolicy policy(config);
+        // nothing queued behind the access
+        REQUIRE(policy.ClosesRow(Access(1, 0x0), false, 0));
+        // more hits queued, the fourth access closes the row
+        for (int row_hits = 0; row_hits < 3; row_hits++) {
+            REQUIRE_FALSE(policy.ClosesRow(Access(1, 0x0), true, row_hits));
+        }
+        REQUIRE(policy.ClosesRow(Access(1, 0x0), true, 3));
+    }
+
+    SECTION("TEST CLOSE_PAGE auto-precharges every access") {
+        config.row_buf_policy = "CLOSE_PAGE";
+        dramsim3::RowPolicy policy(config);
+        REQUIRE(policy.ColumnCommand(false) ==
+                dramsim3::CommandType::READ_PRECHARGE);
+        REQUIRE(policy.ColumnCommand(true) ==
+                dramsim3::CommandType::WRITE_PRECHARGE);
+    }
+}
@@ -0,0 +1,95 @@
+#include <vector>
+#include "catch.hpp"
+#include "scheduler.h"
+
+namespace {
+
+dramsim3::Command MakeRead(int source_id, int bank, int row,
+                           uint64_t hex_addr) {
+    dramsim3::Command cmd(dramsim3::CommandType::READ,
+                          dramsim3::Address(0, 0, 0, bank, row, 0), hex_addr);
+    cmd.source_id = source_id;
+    return cmd;
+}
+
+dramsim3::Command Ready(const dramsim3::Command& cmd,
+                        dramsim3::CommandType cmd_type) {
+    return dramsim3::Command(cmd_type, cmd.addr, cmd.hex_addr);
+}
+
+}  // namespace
+
+TEST_CASE("Scheduling policies", "[scheduler]") {
+    dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+    const auto READ = dramsim3::CommandType::READ;
+    const auto ACTIVATE = dramsim3::CommandType::ACTIVATE;
+
+    SECTION("TEST BLISS blacklists a streak and clears it") {
+        config.bliss_threshold = 2;
+        config.bliss_clear_interval = 100;
+        dramsim3::BLISSScheduler scheduler(config);
+        auto hog = MakeRead(0, 0, 0, 0x0);
+        auto other = MakeRead(1, 1, 0, 0x40);
+        REQUIRE(scheduler.CommandRank(hog, Ready(hog, READ)) ==
+                scheduler.CommandRank(other, Ready(other, READ)));
+        scheduler.CommandIssued(hog, 10);
+        scheduler.CommandIssued(hog, 11);
+        // a row miss of another source goes before a row hit of the hog
+        REQUIRE(scheduler.CommandRank(other, Ready(other, ACTIVATE)) <
+                scheduler.CommandRank(hog, Ready(hog, READ)));
+        std::vector<std::vector<dramsim3::Command>> queues;
+        scheduler.Update(queues, 99);
+        REQUIRE(scheduler.CommandRank(other, Ready(other, ACTIVATE)) <
+                scheduler.CommandRank(hog, Ready(hog, READ)));
+        scheduler.Update(queues, 100);
+        REQUIRE(scheduler.CommandRank(hog, Ready(hog, READ)) <
+                scheduler.CommandRank(other, Ready(other, ACTIVATE)));
+    }
+
+    SECTION("TEST PARBS marks a batch and ranks light sources first") {
+        config.parbs_marking_cap = 2;
+        dramsim3::PARBSScheduler scheduler(config);
+        // source 0 has three requests to bank 0, source 1 one to bank 1
+        std::vector<std::vector<dramsim3::Command>> queues(2);
+        for (int i = 0; i < 3; i++) {
+            queues[0].push_back(MakeRead(0, 0, i, 0x1000 * (i + 1)));
+        }
+        queues[1].push_back(MakeRead(1, 1, 0, 0x40));
+        scheduler.Update(queues, 0);
+        auto heavy = queues[0][0];
+        auto light = queues[1][0];
+        auto unmarked = queues[0][2];
+        REQUIRE(scheduler.CommandRank(light, Ready(light, READ)) <
+                scheduler.CommandRank(heavy, Ready(heavy, READ)));
+        // marked requests go first, also as row misses
+        REQUIRE(scheduler.CommandRank(heavy, Ready(heavy, ACTIVATE)) <
+                scheduler.CommandRank(unmarked, Ready(unmarked, READ)));
+
+        // the next batch forms once the marked requests are served
+        for (int i = 0; i < 2; i++) {
+            scheduler.CommandIssued(queues[0][i], i);
+        }
+        scheduler.CommandIssued(light, 2);
+        queues[0].erase(queues[0].begin(), queues[0].begin() + 2);
+        queues[1].clear();
+        scheduler.Update(queues, 3);
+        REQUIRE(scheduler.CommandRank(unmarked, Ready(unmarked, READ)) <
+                scheduler.CommandRank(heavy, Ready(heavy, READ)));
+    }
+
+    SECTION("TEST READ_PRIORITY serves reads first and drains in halves") {
+        dramsim3::ReadPriorityScheduler scheduler(config);
+        auto read = MakeRead(0, 0, 0, 0x0);
+        auto write = MakeRead(0, 1, 0, 0x40);
+        write.cmd_type = dramsim3::CommandType::WRITE;
+        REQUIRE(scheduler.CommandRank(read, Ready(read, ACTIVATE)) <
+                scheduler.CommandRank(write, Ready(write, write.cmd_type)));
+        REQUIRE(scheduler.CommandRank(read, Ready(read, READ)) <
+                scheduler.CommandRank(read, Ready(read, ACTIVATE)));
+
+        REQUIRE(scheduler.WritesToDrain(4, 16, 16, false) == 8);
+        REQUIRE(scheduler.WritesToDrain(4, 15, 16, true) == 0);
+        REQUIRE(scheduler.WritesToDrain(0, 3, 16, false) == 0);
+        REQUIRE(scheduler.WritesToDrain(0, 3, 16, true) == 3);
+    }
+}
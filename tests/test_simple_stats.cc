@@ -0,0 +1,63 @@
+#include <vector>
+#include "catch.hpp"
+#include "simple_stats.h"
+
+using dramsim3::SimpleStats;
+
+TEST_CASE("Histogram buckets", "[stats]") {
+    SECTION("TEST values fall into the bucket of their range") {
+        // one bucket per value at first
+        for (int value = 0; value < 2 * SimpleStats::kHistoSubBuckets;
+             value++) {
+            REQUIRE(SimpleStats::HistoBucket(value) == value);
+        }
+        REQUIRE(SimpleStats::HistoBucket(-5) == 0);
+        std::vector<int> values = {256, 257, 1000, 4095, 4096, 123456,
+                                   1 << 30, 2147483647};
+        for (int value : values) {
+            int bucket = SimpleStats::HistoBucket(value);
+            REQUIRE(bucket < SimpleStats::kHistoBuckets);
+            REQUIRE(SimpleStats::HistoBucketLow(bucket) <= value);
+            REQUIRE(SimpleStats::HistoBucketHigh(bucket) >= value);
+        }
+    }
+
+    SECTION("TEST buckets round trip and cover the int range") {
+        int64_t next_low = 0;
+        for (int b = 0; b < SimpleStats::kHistoBuckets; b++) {
+            int low = SimpleStats::HistoBucketLow(b);
+            int high = SimpleStats::HistoBucketHigh(b);
+            // adjacent without gaps, within 1/kHistoSubBuckets of the value
+            REQUIRE(low == next_low);
+            REQUIRE(high >= low);
+            REQUIRE(static_cast<int64_t>(high - low) *
+                        SimpleStats::kHistoSubBuckets <=
+                    low);
+            REQUIRE(SimpleStats::HistoBucket(low) == b);
+            REQUIRE(SimpleStats::HistoBucket(high) == b);
+            next_low = static_cast<int64_t>(high) + 1;
+        }
+        REQUIRE(next_low == int64_t(1) << 31);
+    }
+
+    SECTION("TEST percentiles") {
+        std::vector<uint64_t> counts(SimpleStats::kHistoBuckets, 0);
+        // 1..100 once each
+        for (int value = 1; value <= 100; value++) {
+            counts[SimpleStats::HistoBucket(value)]++;
+        }
+        auto pcts = SimpleStats::HistoPercentiles(counts, {0.5, 0.9, 0.99, 1});
+        REQUIRE(pcts == std::vector<int>({50, 90, 99, 100}));
+        // wide buckets report their largest value
+        counts[SimpleStats::HistoBucket(100000)] += 900;
+        int bucket = SimpleStats::HistoBucket(100000);
+        pcts = SimpleStats::HistoPercentiles(counts, {0.05, 0.5});
+        REQUIRE(pcts[0] == 50);
+        REQUIRE(pcts[1] == SimpleStats::HistoBucketHigh(bucket));
+        REQUIRE(pcts[1] >= 100000);
+        // nothing counted
+        std::vector<uint64_t> empty(SimpleStats::kHistoBuckets, 0);
+        REQUIRE(SimpleStats::HistoPercentiles(empty, {0.5}) ==
+                std::vector<int>({0}));
+    }
+}
@@ -0,0 +1,42 @@
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "configuration.h"
+#include "sweep.h"
+
+TEST_CASE("Parameter sweep", "[sweep]") {
+    const std::string config_file = "configs/DDR4_8Gb_x8_2400.ini";
+    dramsim3::Config base(config_file, ".");
+
+    SECTION("TEST every combination of the values is a variant") {
+        dramsim3::Sweep sweep(config_file, ".",
+                              {"system.trans_queue_size=16,32,64",
+                               "timing.CL=14,16"});
+        REQUIRE(sweep.NumVariants() == 6);
+        const std::vector<int> queue_sizes = {16, 32, 64};
+        const std::vector<int> cls = {14, 16};
+        for (size_t v = 0; v < sweep.NumVariants(); v++) {
+            dramsim3::Config* config = sweep.MakeConfig(v);
+            // the last parameter changes fastest
+            REQUIRE(config->trans_queue_size == queue_sizes[v / 2]);
+            REQUIRE(config->CL == cls[v % 2]);
+            // the rest is the base config, each variant has its own stats
+            REQUIRE(config->tRCD == base.tRCD);
+            REQUIRE(config->address_mapping == base.address_mapping);
+            std::string suffix = "dramsim3_" + std::to_string(v);
+            const std::string& prefix = config->output_files.prefix;
+            REQUIRE(prefix.size() > suffix.size());
+            REQUIRE(prefix.substr(prefix.size() - suffix.size()) == suffix);
+            delete config;
+        }
+    }
+
+    SECTION("TEST no parameters make one variant") {
+        dramsim3::Sweep sweep(config_file, ".", {});
+        REQUIRE(sweep.NumVariants() == 1);
+        dramsim3::Config* config = sweep.MakeConfig(0);
+        REQUIRE(config->trans_queue_size == base.trans_queue_size);
+        REQUIRE(config->CL == base.CL);
+        delete config;
+    }
+}
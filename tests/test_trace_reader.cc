@@ -0,0 +1,129 @@
+#include <fstream>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif  // HAVE_ZLIB
+#include "catch.hpp"
+#include "cmd_trace.h"
+#include "trace_reader.h"
+
+TEST_CASE("Trace Reader Testing", "[trace]") {
+    std::string text_file = "trace_reader_test.trace";
+    std::string binary_file = "trace_reader_test.bin";
+    std::ofstream text(text_file);
+    text << "0x2000D5C0 READ  30\n"
+         << "\n"
+         << "0x1FF96FC0 WRITE   160\n"
+         << "0x40 P_MEM_WR 100\n";
+    text.close();
+
+    SECTION("TEST text and binary traces read the same") {
+        {
+            dramsim3::TextTraceReader reader(text_file);
+            dramsim3::BinaryTraceWriter writer(binary_file);
+            dramsim3::Transaction trans;
+            while (reader.Next(trans)) {
+                writer.Write(trans);
+            }
+            REQUIRE(writer.NumRecords() == 3);
+        }
+
+        dramsim3::TraceReader* text_reader =
+            dramsim3::MakeTraceReader(text_file, false);
+        dramsim3::TraceReader* binary_reader =
+            dramsim3::MakeTraceReader(binary_file, true);
+        dramsim3::Transaction a, b;
+        for (int i = 0; i < 3; i++) {
+            REQUIRE(text_reader->Next(a));
+            REQUIRE(binary_reader->Next(b));
+            REQUIRE(a.addr == b.addr);
+            REQUIRE(a.is_write == b.is_write);
+            // cycles are made non-decreasing on conversion
+            REQUIRE(b.added_cycle == (i == 2 ? 160 : a.added_cycle));
+        }
+        REQUIRE(a.is_write);
+        REQUIRE(!text_reader->Next(a));
+        REQUIRE(!binary_reader->Next(b));
+        delete text_reader;
+        delete binary_reader;
+    }
+
+#ifdef HAVE_ZLIB
+    SECTION("TEST gzip compressed traces") {
+        std::string gzip_file = "trace_reader_test.trace.gz";
+        gzFile gz = gzopen(gzip_file.c_str(), "wb");
+        for (int i = 0; i < 1000; i++) {
+            gzprintf(gz, "0x%x %s %d\n", i * 64, i % 3 ? "READ" : "WRITE", i);
+        }
+        gzclose(gz);
+
+        dramsim3::TraceReader* reader =
+            dramsim3::MakeTraceReader(gzip_file, true);
+        dramsim3::Transaction trans;
+        int count = 0;
+        while (reader->Next(trans)) {
+            REQUIRE(trans.addr == static_cast<uint64_t>(count * 64));
+            REQUIRE(trans.is_write == (count % 3 == 0));
+            count++;
+        }
+        REQUIRE(count == 1000);
+        delete reader;
+        std::remove(gzip_file.c_str());
+    }
+#endif  // HAVE_ZLIB
+
+    std::remove(text_file.c_str());
+    std::remove(binary_file.c_str());
+}
+
+void CheckCommandTrace(const std::string& file_name, bool compress) {
+    // more than one block
+    uint64_t num_cmds = dramsim3::kCommandTraceBlockCommands * 2 + 100;
+    {
+        dramsim3::CommandTraceWriter writer(file_name, compress);
+        for (uint64_t i = 0; i < num_cmds; i++) {
+            // rank commands have no bankgroup
+            dramsim3::Address addr(i % 2, i % 3, i % 5 ? 1 : -1, i % 4, i * 7,
+                                   i % 1024);
+            writer.Write(addr.channel,
+                         dramsim3::Command(dramsim3::CommandType(i % 13),
+                                           addr, 0),
+                         i * 3 + (1ull << 40));
+        }
+    }
+
+    REQUIRE(dramsim3::CommandTraceReader::IsCommandTrace(file_name));
+    dramsim3::CommandTraceReader reader(file_name);
+    REQUIRE(reader.Compressed() == compress);
+    dramsim3::CommandTraceBlock block;
+    std::vector<dramsim3::TimedCommand> cmds;
+    uint64_t i = 0;
+    while (reader.NextBlock(block)) {
+        dramsim3::DecodeCommandBlock(block, reader.Compressed(), cmds);
+        for (const auto& timed_cmd : cmds) {
+            REQUIRE(timed_cmd.clk == i * 3 + (1ull << 40));
+            REQUIRE(timed_cmd.cmd.cmd_type == dramsim3::CommandType(i % 13));
+            REQUIRE(timed_cmd.cmd.Channel() == static_cast<int>(i % 2));
+            REQUIRE(timed_cmd.cmd.Rank() == static_cast<int>(i % 3));
+            REQUIRE(timed_cmd.cmd.Bankgroup() == (i % 5 ? 1 : -1));
+            REQUIRE(timed_cmd.cmd.Bank() == static_cast<int>(i % 4));
+            REQUIRE(timed_cmd.cmd.Row() == static_cast<int>(i * 7));
+            REQUIRE(timed_cmd.cmd.Column() == static_cast<int>(i % 1024));
+            i++;
+        }
+    }
+    REQUIRE(i == num_cmds);
+    std::remove(file_name.c_str());
+}
+
+TEST_CASE("Command Trace Testing", "[trace]") {
+    std::string file_name = "cmd_trace_test.bin";
+    SECTION("TEST commands read back in blocks") {
+        CheckCommandTrace(file_name, false);
+    }
+#ifdef HAVE_ZLIB
+    SECTION("TEST compressed command traces") {
+        CheckCommandTrace(file_name, true);
+    }
+#endif  // HAVE_ZLIB
+    REQUIRE(!dramsim3::CommandTraceReader::IsCommandTrace(file_name));
+}
@@ -0,0 +1,89 @@
+#include "catch.hpp"
+#include "transaction_queue.h"
+
+TEST_CASE("Transaction Queue Testing", "[transaction_queue]") {
+    dramsim3::TransactionQueue queue(8, 4);
+    auto accept_all = [](int queue_idx) { return true; };
+
+    SECTION("TEST oldest of the accepting command queues") {
+        for (uint64_t i = 0; i < 6; i++) {
+            dramsim3::Transaction trans(i << 6, false);
+            trans.queue_idx = static_cast<int>(i % 2);
+            queue.Push(trans);
+        }
+        REQUIRE(queue.Size() == 6);
+        REQUIRE(queue.Oldest(accept_all)->addr == 0);
+        auto not_zero = [](int queue_idx) { return queue_idx != 0; };
+        REQUIRE(queue.Oldest(not_zero)->addr == (1 << 6));
+        auto none = [](int queue_idx) { return false; };
+        REQUIRE(queue.Oldest(none) == nullptr);
+
+        // every command queue keeps arrival order
+        queue.PopFront(1);
+        REQUIRE(queue.Oldest(not_zero)->addr == (3 << 6));
+        queue.PopFront(0);
+        REQUIRE(queue.Oldest(accept_all)->addr == (2 << 6));
+    }
+
+    SECTION("TEST best by priority and removal") {
+        // priorities 0 1 2 0 2 1 alternating over 2 command queues
+        const int priorities[] = {0, 1, 2, 0, 2, 1};
+        for (uint64_t i = 0; i < 6; i++) {
+            dramsim3::Transaction trans(i << 6, false);
+            trans.priority = priorities[i];
+            trans.queue_idx = static_cast<int>(i % 2);
+            queue.Push(trans);
+        }
+        auto higher = [](const dramsim3::Transaction& a,
+                         const dramsim3::Transaction& b) {
+            return a.priority > b.priority;
+        };
+        // ties go to the older transaction
+        auto best = queue.Best(accept_all, higher);
+        REQUIRE(best->addr == (2 << 6));
+        queue.Remove(best);
+        best = queue.Best(accept_all, higher);
+        REQUIRE(best->addr == (4 << 6));
+        queue.Remove(best);
+        REQUIRE(queue.Size() == 4);
+        auto not_zero = [](int queue_idx) { return queue_idx != 0; };
+        REQUIRE(queue.Best(not_zero, higher)->addr == (1 << 6));
+        REQUIRE(queue.Oldest(accept_all)->addr == 0);
+
+        // never passes an older transaction to the same address
+        dramsim3::Transaction dup(0, true);
+        dup.priority = 3;
+        dup.queue_idx = 0;
+        queue.Push(dup);
+        REQUIRE(queue.Best(accept_all, higher)->priority == 1);
+        queue.PopFront(0);
+        REQUIRE(queue.Best(accept_all, higher)->priority == 3);
+
+        // remaining entries come out in order and are reused
+        while (!queue.Empty()) {
+            queue.Remove(queue.Oldest(accept_all));
+        }
+        for (uint64_t i = 0; i < 8; i++) {
+            dramsim3::Transaction trans(i << 6, false);
+            trans.queue_idx = static_cast<int>(i % 4);
+            queue.Push(trans);
+        }
+        REQUIRE(queue.Size() == 8);
+    }
+
+    SECTION("TEST draining and reusing entries") {
+        for (int round = 0; round < 3; round++) {
+            for (uint64_t i = 0; i < 8; i++) {
+                dramsim3::Transaction trans(i << 6, true);
+                trans.queue_idx = static_cast<int>(3 - i % 4);
+                queue.Push(trans);
+            }
+            for (uint64_t i = 0; i < 8; i++) {
+                auto trans = queue.Oldest(accept_all);
+                REQUIRE(trans->addr == (i << 6));
+                queue.PopFront(trans->queue_idx);
+            }
+            REQUIRE(queue.Empty());
+        }
+    }
+}